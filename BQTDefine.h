@@ -38,6 +38,11 @@ namespace ews {
      * on, the wavelength in water isn't connected to the frequency of the oscillator.
      */
     const bool REALISTIC_DRIP = false;
+    /**
+     * Memory the tiles of paged models (see bosgtiler) may take up before the DatabasePager
+     * expires the ones out of view, in MB. BQT_PAGED_MEMORY_MB overrides it.
+     */
+    const double PAGED_MEMORY_MB = 1024.0;
 }
 
 #endif // __EWSDEFINE_H
@@ -22,6 +22,173 @@ vtData vt;
 vtConfig c;
 
 
+// a store is a tile store with its own page tables, sharing the configuration, physical texture, caches and loading threads with all other stores.
+// vtRemoveStore() frees the id once no thread holds a page of the store anymore, vtAddStore() reuses it
+
+// checks the tile store and allocates the tables of a new store. the shared configuration must be set up already. returns the id or -1
+static int8_t _vtOpenStore(const char *_tileDir, const uint8_t _mipChainLength)
+{
+	uint8_t s = 0;
+	while ((s < MAX_STORES) && (STORE(s).tileDir != ""))
+		s++;
+
+	if (s == MAX_STORES)
+	{
+		printf("Error: can't open more than %u tile stores\n", MAX_STORES);
+		return -1;
+	}
+
+	vtStore &st = STORE(s);
+
+    if (((_mipChainLength >= 10) && (_mipChainLength <= 11))){
+        st.longMipChain=true;
+        printf("Long Mip Chain mode enabled\n");
+    }else if(((_mipChainLength >= 2) && (_mipChainLength <= 9))){
+        st.longMipChain=false;
+        printf("Long Mip Chain mode disabled\n");
+    }else{
+        fprintf(stderr,"MipChain length incorrect %d Must be _mipChainLength >= 10) && (_mipChainLength <= 11) for long chain or\n((_mipChainLength >= 2) && (_mipChainLength <= 9) for short chain\n",
+                _mipChainLength);
+        return -1;
+    }
+	assert((float)HIGHEST_MIP_LEVELS_TO_KEEP <= _mipChainLength);
+    if (st.longMipChain && !USE_MIPCALC_TEXTURE) printf("Warning: expect artifacts when using LONG_MIP_CHAIN && !USE_MIPCALC_TEXTURE\n");
+
+
+	// check the tile store, prefer the packed archive over the tile directories
+	vtArchiveHeader header;
+	const string archivePath = vtuTileArchivePath(_tileDir);
+	if (vtuReadTileArchiveHeader(archivePath.c_str(), &header))
+	{
+		if ((header.mipChainLength != _mipChainLength) || (header.pageBorder != c.pageBorder) || (header.pageDimension != c.pageDimension) || (strncmp(header.codec, c.pageCodec.c_str(), 4) != 0))
+		{
+			printf("Error: %s doesn't match MIP_CHAIN_LENGTH = %u, c.pageCodec.c_str() = %s and c.pageBorder = %u!", archivePath.c_str(), _mipChainLength, c.pageCodec.c_str(), c.pageBorder);
+			return -1;
+		}
+		if (!vtuOpenTileArchive(s, archivePath.c_str()))
+		{
+			printf("Error: couldn't map tile archive %s\n", archivePath.c_str());
+			return -1;
+		}
+		printf("Using tile archive %s\n", archivePath.c_str());
+	}
+	else
+	{
+		char buf[255];
+		for (uint8_t i = 0; i < 16; i++)
+		{
+			snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_0_0.%s", _tileDir, PATH_SEPERATOR, c.pageBorder, i, PATH_SEPERATOR, i, c.pageCodec.c_str());
+
+
+			if (vtuFileExists(buf) != (i < _mipChainLength)){
+				printf("Error: %s doesn't seem to be a page store with MIP_CHAIN_LENGTH = %u, c.pageCodec.c_str() = %s and c.pageBorder = %u!", _tileDir, _mipChainLength, c.pageCodec.c_str(), c.pageBorder);
+	            return -1;
+	        }
+		}
+	}
+
+
+	// init translation tables, offsets and allocate page table
+	st.tileDir = string(_tileDir);
+	st.mipChainLength = _mipChainLength;
+	st.virtTexDimensionPages = 2 << (st.mipChainLength - 2);
+
+	uint32_t offsetCounter = 0;
+	for (uint8_t i = 0; i < st.mipChainLength; i++)
+	{
+		st.mipTranslation[i] = (uint16_t) ((st.virtTexDimensionPages >> i) - 1); // we do -1 here so we can add +1 in the shader to allow for a mip chain length 9 which results in the translation being 255/256, this is not ideal performance wise...
+		st.pageTableMipOffsets[i] = offsetCounter;
+		offsetCounter += (st.virtTexDimensionPages >> i) * (st.virtTexDimensionPages >> i);
+	}
+
+	st.pageTables = (uint32_t **) malloc(sizeof(uint32_t *) * st.mipChainLength);
+	assert(st.pageTables);
+
+	uint32_t *pageTableBuffer = (uint32_t *) calloc(1, 4 * offsetCounter);
+	assert(pageTableBuffer);
+
+	for (uint8_t i = 0; i < st.mipChainLength; i++)
+		st.pageTables[i] = (uint32_t *)(pageTableBuffer + st.pageTableMipOffsets[i]);
+
+	st.loadGenerations = (uint32_t *) calloc(offsetCounter, sizeof(uint32_t));
+	assert(st.loadGenerations);
+	st.loadCount = 0;
+
+	return s;
+}
+
+// queues the highest mip levels of a store for the warm-up and requests its resident pages. the slots, RAM cache and buffer pools must be set up already
+static void _vtLoadStore(const uint8_t s)
+{
+	vtStore &st = STORE(s);
+
+	vtuInitPageExistence(s);
+	vtuOpenPageCache(s);
+
+	// coarsest first, the levels kept resident are loaded by the loading threads anyway
+	queue<uint32_t>	pagesToCache;
+	for (int8_t i = st.mipChainLength - 1 - HIGHEST_MIP_LEVELS_TO_KEEP; i >= st.mipChainLength - HIGHEST_MIP_LEVELS_TO_PRECACHE; i--)
+		for (uint8_t x = 0; x < (st.virtTexDimensionPages >> i); x++)
+			for (uint8_t y = 0; y < (st.virtTexDimensionPages >> i); y++)
+				if (vtuPageExists(MAKE_PAGE_INFO(s, i, x, y)))
+					pagesToCache.push(MAKE_PAGE_INFO(s, i, x, y));
+	vtWarmupPages(pagesToCache);
+
+	{	// lock
+		LOCK(vt.neededPagesMutex)
+
+		// push the resident pages, the single page of the highest mip first so that vtIsStoreReady() turns true as early as possible
+		for (int8_t i = st.mipChainLength - 1; i >= st.mipChainLength - HIGHEST_MIP_LEVELS_TO_KEEP; i--)
+			for (uint8_t x = 0; x < (st.virtTexDimensionPages >> i); x++)
+				for (uint8_t y = 0; y < (st.virtTexDimensionPages >> i); y++)
+					if (vtuPageExists(MAKE_PAGE_INFO(s, i, x, y)))
+						vt.neededPages.push_back(MAKE_PAGE_INFO(s, i, x, y));
+
+		st.active = true;
+		if (s >= vt.storeCount)
+			vt.storeCount = s + 1;
+
+#if ENABLE_MT
+		vt.neededPagesAvailableCondition.signal(); // wake up page loading thread if it is sleeping
+#endif
+	}	// unlock
+}
+
+// frees everything a store holds and makes its id available again, only called when no thread holds a page of it anymore
+static void _vtCloseStore(const uint8_t s)
+{
+	vtStore &st = STORE(s);
+
+	if (st.pageTables)
+	{
+		free(st.pageTables[0]);
+		free(st.pageTables);
+	}
+	free(st.loadGenerations);
+
+	vtuCloseTileArchive(s);
+	vtuClosePageCache(s);
+	vtuFreePageExistence(s);
+
+	if (st.pageTableTexture)
+		glDeleteTextures(1, &st.pageTableTexture);
+	if (st.mipcalcTexture)
+		glDeleteTextures(1, &st.mipcalcTexture);
+
+	st.tileDir = "";
+	st.active = st.longMipChain = false;
+	st.mipChainLength = 0;
+	st.virtTexDimensionPages = 0;
+	st.pageTables = NULL;
+	st.loadGenerations = NULL;
+	st.loadCount = 0;
+	st.pageTableTexture = st.mipcalcTexture = 0;
+	memset(st.pageTableDirtyCount, 0, sizeof(st.pageTableDirtyCount));
+	st.prefetchVertices.clear();
+	st.prefetchIndices.clear();
+}
+
+
 bool vtInit(const char *_tileDir, const char *_pageExtension, const uint8_t _pageBorder, const uint8_t _mipChainLength, const uint16_t _pageDimension,const unsigned int phys_tex_size)
 {
   #ifdef WIN32
@@ -33,34 +200,15 @@ if (GLEW_OK != err)
   exit(-1);
 }
 #endif
-	if (c.tileDir != "") vt_fatal("Error: calling vtInit() twice ain't good!\n");
+	if (vt.storeCount) vt_fatal("Error: calling vtInit() twice ain't good!\n");
 
 	assert((VT_MAG_FILTER == GL_NEAREST) || (VT_MAG_FILTER == GL_LINEAR));
 	assert((VT_MIN_FILTER == GL_NEAREST) || (VT_MIN_FILTER == GL_LINEAR) || (VT_MIN_FILTER == GL_NEAREST_MIPMAP_NEAREST) || (VT_MIN_FILTER == GL_LINEAR_MIPMAP_NEAREST) || (VT_MIN_FILTER == GL_NEAREST_MIPMAP_LINEAR) || (VT_MIN_FILTER == GL_LINEAR_MIPMAP_LINEAR));
 	assert(TEXUNIT_FOR_PHYSTEX !=  TEXUNIT_FOR_PAGETABLE);
-    /*#if LONG_MIP_CHAIN
-		if (!((_mipChainLength >= 10) && (_mipChainLength <= 11)))
-            return false;
-	#else
-		if(!((_mipChainLength >= 2) && (_mipChainLength <= 9)))
-            return false;
-    #endif*/
-    if (((_mipChainLength >= 10) && (_mipChainLength <= 11))){
-        c.longMipChain=true;
-        printf("Long Mip Chain mode enabled\n");
-    }else if(((_mipChainLength >= 2) && (_mipChainLength <= 9))){
-        c.longMipChain=false;
-        printf("Long Mip Chain mode disabled\n");
-    }else{
-        fprintf(stderr,"MipChain length incorrect %d Must be _mipChainLength >= 10) && (_mipChainLength <= 11) for long chain or\n((_mipChainLength >= 2) && (_mipChainLength <= 9) for short chain\n",
-                _mipChainLength);
-        return false;
-    }
-
 	assert((_pageDimension == 64) || (_pageDimension == 128) || (_pageDimension == 256) || (_pageDimension == 512));
 	assert((PREPASS_RESOLUTION_REDUCTION_SHIFT >= 0) && (PREPASS_RESOLUTION_REDUCTION_SHIFT <= 4));
 	assert((MAX_RAMCACHE_MB >= 50));
-	assert((HIGHEST_MIP_LEVELS_TO_KEEP >= 0) && (HIGHEST_MIP_LEVELS_TO_KEEP <= 5) && ((float)HIGHEST_MIP_LEVELS_TO_KEEP <= _mipChainLength));
+	assert((HIGHEST_MIP_LEVELS_TO_KEEP >= 0) && (HIGHEST_MIP_LEVELS_TO_KEEP <= 5));
 	assert(!(READBACK_MODE_NONE && USE_PBO_READBACK));
 	if (OPENCL_BUFFERREDUCTION) assert((READBACK_MODE_FBO || READBACK_MODE == kBackbufferGetTexImage || READBACK_MODE == kCustomReadback));
 	if (OPENCL_BUFFERREDUCTION) assert(!USE_PBO_READBACK);
@@ -73,16 +221,14 @@ if (GLEW_OK != err)
 	assert(USE_PBO_PHYSTEX == 0);
 	assert(FALLBACK_ENTRIES == 1);
 #endif
-    if (c.longMipChain && !USE_MIPCALC_TEXTURE) printf("Warning: expect artifacts when using LONG_MIP_CHAIN && !USE_MIPCALC_TEXTURE\n");
 
 	// initialize and calculate configuration
-	c.tileDir = string(_tileDir);
 	c.pageCodec = string(_pageExtension);
     //run time vary
     c.phys_tex_size=phys_tex_size;
 	if (c.pageCodec == "dxt1" || REALTIME_DXT_COMPRESSION)
 	{
-		if (REALTIME_DXT_COMPRESSION) assert((IMAGE_DECOMPRESSION_LIBRARY == DecompressionLibJPEGTurbo) || (IMAGE_DECOMPRESSION_LIBRARY == DecompressionMac));
+		if (REALTIME_DXT_COMPRESSION) assert((IMAGE_DECOMPRESSION_LIBRARY == DecompressionLibJPEGTurbo) || (IMAGE_DECOMPRESSION_LIBRARY == DecompressionTurboJPEG) || (IMAGE_DECOMPRESSION_LIBRARY == DecompressionMac));
 
 		c.pageDXTCompression = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
 		c.pageMemsize = (_pageDimension * _pageDimension / 2);
@@ -128,13 +274,21 @@ if (GLEW_OK != err)
 		}
 	}
 	c.physTexDimensionPages = c.phys_tex_size / _pageDimension;
+	c.physTexLayers = c.requestedPhysTexLayers ? c.requestedPhysTexLayers : PHYS_TEX_LAYERS;
+	if (c.physTexDimensionPages > MAX_PHYS_TEX_DIMENSION_PAGES) // too many pages to address in one layer, split it into layers of the maximum size holding about as many pages
+	{
+		const uint32_t split = c.physTexDimensionPages / MAX_PHYS_TEX_DIMENSION_PAGES;
+
+		c.physTexLayers = (uint8_t) ((c.physTexLayers * split * split > MAX_PHYS_TEX_LAYERS) ? MAX_PHYS_TEX_LAYERS : c.physTexLayers * split * split);
+		c.physTexDimensionPages = MAX_PHYS_TEX_DIMENSION_PAGES;
+		c.phys_tex_size = MAX_PHYS_TEX_DIMENSION_PAGES * _pageDimension;
+		printf("Splitting the physical texture into %u layers of %ux%u\n", c.physTexLayers, c.phys_tex_size, c.phys_tex_size);
+	}
 	c.maxCachedPages = (int)((float)MAX_RAMCACHE_MB / ((float)c.pageMemsize / (1024.0 * 1024.0)));
 	for (uint8_t i = 0; i < float(HIGHEST_MIP_LEVELS_TO_KEEP); i++)
 		c.residentPages += (uint32_t) powf(4, i);
 
 	c.pageBorder = _pageBorder;
-	c.mipChainLength = _mipChainLength;
-	c.virtTexDimensionPages = 2 << (c.mipChainLength - 2);
 	c.pageDimension = _pageDimension;
 	#if VT_MAG_FILTER == GL_LINEAR || VT_MIN_FILTER == GL_LINEAR || VT_MIN_FILTER == GL_LINEAR_MIPMAP_NEAREST || VT_MIN_FILTER == GL_LINEAR_MIPMAP_LINEAR
 		if (c.pageBorder > 1 && c.pageBorder > ANISOTROPY / 2)
@@ -149,73 +303,64 @@ if (GLEW_OK != err)
 	#endif
 
 
-	// init translation tables, offsets and allocate page table
-	uint32_t offsetCounter = 0;
-	for (uint8_t i = 0; i < c.mipChainLength; i++)
-	{
-		vt.mipTranslation[i] = (uint16_t) ((c.virtTexDimensionPages >> i) - 1); // we do -1 here so we can add +1 in the shader to allow for a mip chain length 9 which results in the translation being 255/256, this is not ideal performance wise...
-		vt.pageTableMipOffsets[i] = offsetCounter;
-		offsetCounter += (c.virtTexDimensionPages >> i) * (c.virtTexDimensionPages >> i);
-	}
-    if(c.mipChainLength >0)
-        vt.pageTables = (uint32_t **) malloc(sizeof(uint32_t *) * c.mipChainLength);
-    else
-        vt.pageTables = NULL;
-    //Clang warning fix
-    
-	assert(vt.pageTables);
-
-	uint32_t *pageTableBuffer = (uint32_t *) calloc(1, 4 * offsetCounter);
-	assert(pageTableBuffer);
-
-	for (uint8_t i = 0; i < c.mipChainLength; i++)
-		vt.pageTables[i] = (uint32_t *)(pageTableBuffer + vt.pageTableMipOffsets[i]);
-
+	const int8_t store = _vtOpenStore(_tileDir, _mipChainLength);
+	if (store < 0)
+		return false;
 
-
-	// check the tile store
-	char buf[255];
-	for (uint8_t i = 0; i < 16; i++)
-	{
-		snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_0_0.%s", _tileDir, PATH_SEPERATOR, c.pageBorder, i, PATH_SEPERATOR, i, c.pageCodec.c_str());
-
-
-		if (vtuFileExists(buf) != (i < c.mipChainLength)){
-			printf("Error: %s doesn't seem to be a page store with MIP_CHAIN_LENGTH = %u, c.pageCodec.c_str() = %s and c.pageBorder = %u!", c.tileDir.c_str(), c.mipChainLength, c.pageCodec.c_str(), c.pageBorder);
-            return false;
-        }
-	}
-
-	// precache some pages
-	queue<uint32_t>	pagesToCache;
-	for (uint8_t i = c.mipChainLength - HIGHEST_MIP_LEVELS_TO_PRECACHE; i < c.mipChainLength; i++)
-		for (uint8_t x = 0; x < (c.virtTexDimensionPages >> i); x++)
-			for (uint8_t y = 0; y < (c.virtTexDimensionPages >> i); y++)
-				pagesToCache.push(MAKE_PAGE_INFO(i, x, y));
-	vtCachePages(pagesToCache);
-
-	// push the resident pages
-	for (uint8_t i = c.mipChainLength - HIGHEST_MIP_LEVELS_TO_KEEP; i < c.mipChainLength; i++)
-		for (uint8_t x = 0; x < (c.virtTexDimensionPages >> i); x++)
-			for (uint8_t y = 0; y < (c.virtTexDimensionPages >> i); y++)
-				vt.neededPages.push_back(MAKE_PAGE_INFO(i, x, y));
+	// set up the physical texture slots and buffer pools, allocate the RAM cache and precache some pages
+	vtsInit();
+	vtcInit();
+	vtpInit(DECODED_HALF_PAGES ? c.pageMemsize + c.pageMemsize / 4 : c.pageMemsize);
+	vtResetStats();
+	vt.requestGeneration = kLoadUnwanted + 1;
+	vt.warmupPageCount = vt.warmupPagesDone = 0;
+	_vtLoadStore(store);
 
 
     #if ENABLE_MT == 1
         vt.backgroundThread = boost::thread(&vtLoadNeededPages);
 	#elif ENABLE_MT == 2
-                vt.backgroundThread.start();//vt.backgroundThread = boost::thread(&vtLoadNeededPagesDecoupled);
-                vt.backgroundThread2.start();//vt.backgroundThread2 = boost::thread(&vtDecompressNeededPagesDecoupled);
+                vtStartLoadingThreads();
+    #endif
+    #if ASYNC_FEEDBACK
+                vtStartFeedbackThread();
+    #endif
+    #if ENABLE_MT
+                vtStartWarmupThread();
+    #endif
+    #if ENABLE_MT && READAHEAD_SIBLINGS
+                vtStartReadaheadThread();
     #endif
 
 	if (c.pageDXTCompression && (c.pageBorder % 4 != 0)) printf("Warning: PAGE_BORDER should be a multiple of 4 for DXT compression\n");
 	assert(c.physTexDimensionPages <= MAX_PHYS_TEX_DIMENSION_PAGES);
-	assert(!((MIPPED_PHYSTEX == 1) && ((USE_PBO_PHYSTEX == 1) || (c.pageDXTCompression)))); // TODO: support these combinations
+	assert((c.physTexLayers >= 1) && (c.physTexLayers <= MAX_PHYS_TEX_LAYERS));
+#if GL_ES_VERSION_2_0
+	assert(c.physTexLayers == 1);
+#endif
+	assert(!((MIPPED_PHYSTEX == 1) && (c.pageDXTCompression))); // TODO: support this combination
     vt.memValid=true;
     return true;
 }
 
 bool vtScan(const char *_tileDir, char * _pageExtension, uint8_t *_pageBorder, uint8_t *_mipChainLength, uint32_t *_pageDimension)
+{
+	vtArchiveHeader header;
+
+	if (vtuReadTileArchiveHeader(vtuTileArchivePath(_tileDir).c_str(), &header))
+	{
+		*_pageBorder = header.pageBorder;
+		*_mipChainLength = header.mipChainLength;
+		*_pageDimension = header.pageDimension;
+		memcpy(_pageExtension, header.codec, 4);
+
+		return true;
+	}
+
+	return vtuScanTileDirectory(_tileDir, _pageExtension, _pageBorder, _mipChainLength, _pageDimension);
+}
+
+bool vtuScanTileDirectory(const char *_tileDir, char * _pageExtension, uint8_t *_pageBorder, uint8_t *_mipChainLength, uint32_t *_pageDimension)
 {
 	bool success = false;
 	DIR *dp;
@@ -272,7 +417,7 @@ bool vtScan(const char *_tileDir, char * _pageExtension, uint8_t *_pageBorder, u
 					{
 						*_pageDimension = 0;
 						void *image = vtuDecompressImageFile(string(string(_tileDir) + string("/") + string (tilestring) + string("/") + file).c_str(), _pageDimension);
-						free(image);
+						vtpFree(image);
 					}
 					success = true;
 					break;
@@ -290,6 +435,129 @@ bool vtScan(const char *_tileDir, char * _pageExtension, uint8_t *_pageBorder, u
 	return success;
 }
 
+// creates the page table and mipcalc textures of a store
+static void _vtPrepareStore(const uint8_t s)
+{
+	vtStore &st = STORE(s);
+
+	glGenTextures(1, &st.pageTableTexture);
+	glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PAGETABLE);
+	glBindTexture(GL_TEXTURE_2D, st.pageTableTexture);
+#if !GL_ES_VERSION_2_0
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, st.mipChainLength - 1);
+#endif
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	for (uint8_t i = 0; i < st.mipChainLength; i++)
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, st.virtTexDimensionPages >> i, st.virtTexDimensionPages >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE, st.pageTables[i]); // {GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV} doesn't seem to be faster
+
+
+	if (USE_MIPCALC_TEXTURE)
+	{
+		glGenTextures(1, &st.mipcalcTexture);
+		glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_MIPCALC);
+		glBindTexture(GL_TEXTURE_2D, st.mipcalcTexture);
+#if !GL_ES_VERSION_2_0
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, st.mipChainLength - 1);
+#endif
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, st.virtTexDimensionPages, st.virtTexDimensionPages, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); // {GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV} doesn't seem to be faster
+
+		uint32_t **mipcalcTables = (uint32_t **) malloc(sizeof(uint32_t *) * st.mipChainLength);
+		for (uint8_t i = 0; i < st.mipChainLength; i++)
+		{
+			mipcalcTables[i] = (uint32_t *) malloc(4 * (st.virtTexDimensionPages >> i) * (st.virtTexDimensionPages >> i));
+
+			for (uint16_t x = 0; x < (st.virtTexDimensionPages >> i); x++)
+			{
+				for (uint16_t y = 0; y < (st.virtTexDimensionPages >> i); y++)
+				{
+                    if (st.longMipChain)
+						(mipcalcTables[i][y * (st.virtTexDimensionPages >> i) + x]) = (0xFF << 24) + ((i + ((x & 0xFF00) >> 4) + ((y & 0xFF00) >> 2)) << 16) + (((uint8_t) y) << 8) + ((uint8_t) x); // format: ABGR
+					else
+						(mipcalcTables[i][y * (st.virtTexDimensionPages >> i) + x]) = (0xFF << 24) + (i << 16) + (y << 8) + x; // format: ABGR
+				}
+			}
+
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, st.virtTexDimensionPages >> i, st.virtTexDimensionPages >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE, mipcalcTables[i]);
+			free(mipcalcTables[i]);
+		}
+		free(mipcalcTables);
+	}
+}
+
+// the upload ring and the staging buffer are sized for the worst case of a frame, which includes the page tables of all stores
+static void _vtPrepareUploadBuffers()
+{
+	uint32_t tableBytes = 0, maxTableBytes = 0;
+
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+	{
+		if (!STORE(s).active)
+			continue;
+
+		const uint32_t bytes = (STORE(s).pageTableMipOffsets[STORE(s).mipChainLength - 1] + 1) * 4;
+
+		tableBytes += bytes;
+		maxTableBytes = max(maxTableBytes, bytes);
+	}
+
+#if !GL_ES_VERSION_2_0
+	if (USE_PBO_PHYSTEX || USE_PBO_PAGETABLE)
+	{
+		// sized for the worst case of a frame, so a buffer is never respecified or mapped twice
+		vt.uploadRingSize = (USE_PBO_PHYSTEX ? vtMaxPageUploadsPerFrame() * vtPageUploadSize() : 0) + (USE_PBO_PAGETABLE ? tableBytes : 0);
+		vt.uploadRingNext = 0;
+
+		if (!vt.uploadRing[0])
+			glGenBuffers(UPLOAD_RING_BUFFERS, vt.uploadRing);
+		for (uint8_t i = 0; i < UPLOAD_RING_BUFFERS; i++)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, vt.uploadRing[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, vt.uploadRingSize, 0, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+#endif
+
+	if (!USE_PBO_PAGETABLE)
+	{
+		free(vt.pageTableStaging);
+		vt.pageTableStaging = (uint32_t *) malloc(maxTableBytes);
+	}
+}
+
+// a frame can't request more unique pages than it has pixels or the virtual textures have pages
+static void _vtReshapeExtractTable()
+{
+	uint32_t pages = 0;
+
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		if (STORE(s).active)
+			pages += STORE(s).pageTableMipOffsets[STORE(s).mipChainLength - 1] + 1;
+
+	const uint32_t pixels = vt.w * vt.h;
+	const uint32_t maxPages = (pixels < pages) ? pixels : pages;
+
+	{	// lock
+		LOCK(vt.neededPagesMutex)
+
+		// a frame refreshes at most this many loads, so _vtApplyPageList() doesn't allocate
+		vt.wantedLoads.reserve(maxPages);
+		vt.refreshedLoads.reserve(maxPages);
+	}	// unlock
+
+#if ASYNC_FEEDBACK
+	vtReshapeFeedback(maxPages ? maxPages : 1);
+#else
+	vteFreeTable(&vt.extractTable);
+	if (!vteInitTable(&vt.extractTable, maxPages ? maxPages : 1))
+		vt_fatal("Error: couldn't allocate the page extraction table\n");
+#endif
+}
+
 void vtPrepare(const GLuint readbackShader, const GLuint renderVTShader)
 {
 	GLint max_texture_size, max_texture_units;
@@ -318,80 +586,60 @@ void vtPrepare(const GLuint readbackShader, const GLuint renderVTShader)
 
 	glGenTextures(1, &vt.physicalTexture);
 	glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PHYSTEX);
-	glBindTexture(GL_TEXTURE_2D, vt.physicalTexture);
+	glBindTexture(PHYS_TEX_TARGET, vt.physicalTexture);
 
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, VT_MAG_FILTER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, VT_MIN_FILTER);
+	glTexParameteri(PHYS_TEX_TARGET, GL_TEXTURE_MAG_FILTER, VT_MAG_FILTER);
+	glTexParameteri(PHYS_TEX_TARGET, GL_TEXTURE_MIN_FILTER, VT_MIN_FILTER);
 
 #if ANISOTROPY
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, ANISOTROPY);
+	glTexParameterf(PHYS_TEX_TARGET, GL_TEXTURE_MAX_ANISOTROPY_EXT, ANISOTROPY);
 #endif
 
 
-	if (c.pageDXTCompression)
-		glCompressedTexImage2D(GL_TEXTURE_2D, 0, c.pageDXTCompression, c.phys_tex_size, c.phys_tex_size, 0, c.pageMemsize * c.physTexDimensionPages * c.physTexDimensionPages, NULL);
-	else
-		glTexImage2D(GL_TEXTURE_2D, 0, c.pageDataFormat == GL_RGB ? GL_RGB : GL_RGBA, c.phys_tex_size, c.phys_tex_size, 0, c.pageDataFormat, c.pageDataType, NULL);
-
-
-
-	if (MIPPED_PHYSTEX)
-	{
 #if !GL_ES_VERSION_2_0
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1);
-#endif
-		glTexImage2D(GL_TEXTURE_2D, 1, c.pageDataFormat == GL_RGB ? GL_RGB : GL_RGBA, c.phys_tex_size / 2, c.phys_tex_size / 2, 0, c.pageDataFormat, c.pageDataType, NULL);
-	}
+	if (c.physTexLayers > 1)
+	{
+		GLint max_layers;
 
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS_EXT, &max_layers);
+		assert(c.physTexLayers <= max_layers);
 
+		if (c.pageDXTCompression)
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, c.pageDXTCompression, c.phys_tex_size, c.phys_tex_size, c.physTexLayers, 0, c.pageMemsize * c.physTexDimensionPages * c.physTexDimensionPages * c.physTexLayers, NULL);
+		else
+			glTexImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, c.pageDataFormat == GL_RGB ? GL_RGB : GL_RGBA, c.phys_tex_size, c.phys_tex_size, c.physTexLayers, 0, c.pageDataFormat, c.pageDataType, NULL);
 
-	glGenTextures(1, &vt.pageTableTexture);
-	glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PAGETABLE);
-	glBindTexture(GL_TEXTURE_2D, vt.pageTableTexture);
-#if !GL_ES_VERSION_2_0
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, c.mipChainLength - 1);
+		if (MIPPED_PHYSTEX)
+		{
+			glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAX_LEVEL, 1);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY_EXT, 1, c.pageDataFormat == GL_RGB ? GL_RGB : GL_RGBA, c.phys_tex_size / 2, c.phys_tex_size / 2, c.physTexLayers, 0, c.pageDataFormat, c.pageDataType, NULL);
+		}
+	}
+	else
 #endif
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-	for (uint8_t i = 0; i < c.mipChainLength; i++)
-		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, c.virtTexDimensionPages >> i, c.virtTexDimensionPages >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE, vt.pageTables[i]); // {GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV} doesn't seem to be faster
+	{
+		if (c.pageDXTCompression)
+			glCompressedTexImage2D(GL_TEXTURE_2D, 0, c.pageDXTCompression, c.phys_tex_size, c.phys_tex_size, 0, c.pageMemsize * c.physTexDimensionPages * c.physTexDimensionPages, NULL);
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, c.pageDataFormat == GL_RGB ? GL_RGB : GL_RGBA, c.phys_tex_size, c.phys_tex_size, 0, c.pageDataFormat, c.pageDataType, NULL);
 
 
-	if (USE_MIPCALC_TEXTURE)
-	{
-		glGenTextures(1, &vt.mipcalcTexture);
-		glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_MIPCALC);
-		glBindTexture(GL_TEXTURE_2D, vt.mipcalcTexture);
+
+		if (MIPPED_PHYSTEX)
+		{
 #if !GL_ES_VERSION_2_0
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, c.mipChainLength - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1);
 #endif
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 1, c.pageDataFormat == GL_RGB ? GL_RGB : GL_RGBA, c.phys_tex_size / 2, c.phys_tex_size / 2, 0, c.pageDataFormat, c.pageDataType, NULL);
+		}
+	}
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, c.virtTexDimensionPages, c.virtTexDimensionPages, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); // {GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV} doesn't seem to be faster
 
-		uint32_t **mipcalcTables = (uint32_t **) malloc(sizeof(uint32_t *) * c.mipChainLength);
-		for (uint8_t i = 0; i < c.mipChainLength; i++)
-		{
-			mipcalcTables[i] = (uint32_t *) malloc(4 * (c.virtTexDimensionPages >> i) * (c.virtTexDimensionPages >> i));
 
-			for (uint16_t x = 0; x < (c.virtTexDimensionPages >> i); x++)
-			{
-				for (uint16_t y = 0; y < (c.virtTexDimensionPages >> i); y++)
-				{
-                    if (c.longMipChain)
-						(mipcalcTables[i][y * (c.virtTexDimensionPages >> i) + x]) = (0xFF << 24) + ((i + ((x & 0xFF00) >> 4) + ((y & 0xFF00) >> 2)) << 16) + (((uint8_t) y) << 8) + ((uint8_t) x); // format: ABGR
-					else
-						(mipcalcTables[i][y * (c.virtTexDimensionPages >> i) + x]) = (0xFF << 24) + (i << 16) + (y << 8) + x; // format: ABGR
-				}
-			}
-
-			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, c.virtTexDimensionPages >> i, c.virtTexDimensionPages >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE, mipcalcTables[i]);
-			free(mipcalcTables[i]);
-		}
-		free(mipcalcTables);
-	}
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		if (STORE(s).active)
+			_vtPrepareStore(s);
 
 
 	if (READBACK_MODE_FBO || READBACK_MODE == kBackbufferGetTexImage)
@@ -409,32 +657,18 @@ void vtPrepare(const GLuint readbackShader, const GLuint renderVTShader)
 	glActiveTexture(GL_TEXTURE0);
 
 #if !GL_ES_VERSION_2_0
-	if (USE_PBO_PAGETABLE)
-	{
-		glGenBuffers(1, &vt.pboPagetable);
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, vt.pboPagetable);
-		glBufferData(GL_PIXEL_UNPACK_BUFFER, (vt.pageTableMipOffsets[c.mipChainLength - 1] + 1) * 4, 0, GL_STREAM_DRAW);
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-	}
-
-
-	if (USE_PBO_PHYSTEX)
-	{
-		glGenBuffers(1, &vt.pboPhystex);
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, vt.pboPhystex);
-		glBufferData(GL_PIXEL_UNPACK_BUFFER, c.pageMemsize * PBO_PHYSTEX_PAGES, 0, GL_STREAM_DRAW);
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-	}
-
 	if (USE_PBO_READBACK)
 	{
 		glGenBuffers(1, &vt.pboReadback);
 	}
 #endif
+
+	_vtPrepareUploadBuffers();
 }
 
-char * vtGetShaderPrelude()
+char * vtGetShaderPrelude(const uint8_t store)
 {
+	const vtStore &st = STORE(store);
 	char *buf = (char *) calloc(1, 1024);
 	snprintf(buf, 1024,	"const float phys_tex_dimension_pages = %f;\n"
 						"const float page_dimension = %f;\n"
@@ -453,11 +687,13 @@ char * vtGetShaderPrelude()
 						"#define TEXUNIT_MIPCALC TEXUNIT%i\n"
 						"#define TEXUNIT_PHYSICAL TEXUNIT%i\n"
                         "#define TEXUNIT_PAGETABLE TEXUNIT%i\n"
-                        "#define MAC_GL_DRIVER_HACK %i\n\n",
+                        "#define MAC_GL_DRIVER_HACK %i\n"
+						"#define PHYS_TEX_LAYERS %i\n"
+						"#define STORE_ID %i\n\n",
 
 						(float)c.physTexDimensionPages, (float)c.pageDimension, log2f(c.pageDimension), (float)PREPASS_RESOLUTION_REDUCTION_SHIFT,
-						(float)c.virtTexDimensionPages, (float)(c.virtTexDimensionPages * c.pageDimension), (float)c.pageBorder, float(ANISOTROPY),
-                        USE_MIPCALC_TEXTURE, c.pageBorder, MIPPED_PHYSTEX, FALLBACK_ENTRIES, ANISOTROPY, c.longMipChain, TEXUNIT_FOR_MIPCALC, TEXUNIT_FOR_PHYSTEX, TEXUNIT_FOR_PAGETABLE,MAC_GL_DRIVER_HACK);
+						(float)st.virtTexDimensionPages, (float)(st.virtTexDimensionPages * c.pageDimension), (float)c.pageBorder, float(ANISOTROPY),
+                        USE_MIPCALC_TEXTURE, c.pageBorder, MIPPED_PHYSTEX, FALLBACK_ENTRIES, ANISOTROPY, st.longMipChain, TEXUNIT_FOR_MIPCALC, TEXUNIT_FOR_PHYSTEX, TEXUNIT_FOR_PAGETABLE,MAC_GL_DRIVER_HACK, c.physTexLayers, store);
 	return buf;
 }
 
@@ -467,28 +703,53 @@ void vtShutdown()
 #if ENABLE_MT == 1
 	vt.backgroundThread.interrupt();
 #elif ENABLE_MT == 2
-        vt.backgroundThread.cancel();
-        vt.backgroundThread2.cancel();
+        vtStopLoadingThreads();
+#endif
+#if ASYNC_FEEDBACK
+	vtStopFeedbackThread();
 #endif
+#if ENABLE_MT
+	vtStopWarmupThread();
+#endif
+#if ENABLE_MT && READAHEAD_SIBLINGS
+	vtStopReadaheadThread();
+#endif
+	vtStopCapture();
+	vtStopStatsTrace();
+
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		_vtCloseStore(s);
+	vt.storeCount = 0;
 
-	free(vt.pageTables[0]);
-	free(vt.pageTables);
+	vt.prefetchPages.clear();
+	vt.wantedLoads.clear();
+	vt.refreshedLoads.clear();
+	vteFreeTable(&vt.extractTable);
+
+	vtcClearCache();
+#if IMAGE_DECOMPRESSION_LIBRARY == DecompressionTurboJPEG
+	vtuShutdownDecompression();
+#endif
+	vtpShutdown();
 
 
 	if (!USE_PBO_READBACK)
 		free(vt.readbackBuffer);
 
 	glDeleteTextures(1, &vt.physicalTexture);
-	glDeleteTextures(1, &vt.pageTableTexture);
-	if (USE_MIPCALC_TEXTURE)
-		glDeleteTextures(1, &vt.mipcalcTexture);
 
 	if (USE_PBO_READBACK)
 		glDeleteBuffers(1, &vt.pboReadback);
-	if (USE_PBO_PAGETABLE)
-		glDeleteBuffers(1, &vt.pboPagetable);
-	if (USE_PBO_PHYSTEX)
-		glDeleteBuffers(1, &vt.pboPhystex);
+	if (USE_PBO_PHYSTEX || USE_PBO_PAGETABLE)
+	{
+		glDeleteBuffers(UPLOAD_RING_BUFFERS, vt.uploadRing);
+		memset(vt.uploadRing, 0, sizeof(vt.uploadRing));
+	}
+	if (!USE_PBO_PAGETABLE)
+	{
+		free(vt.pageTableStaging);
+		vt.pageTableStaging = NULL;
+	}
 
 	if (READBACK_MODE_FBO || READBACK_MODE == kBackbufferGetTexImage)
 	{
@@ -564,6 +825,8 @@ void vtReshape(const uint16_t _w, const uint16_t _h, const float fovInDegrees, c
 		assert(vt.readbackBuffer);
 	}
 
+	_vtReshapeExtractTable();
+
 	if (PREPASS_RESOLUTION_REDUCTION_SHIFT && fovInDegrees > 0.0)
 		vtuPerspective(vt.projectionMatrix, fovInDegrees, (float)vt.w / (float)vt.h, nearPlane, farPlane);
 
@@ -582,6 +845,158 @@ void vtReshape(const uint16_t _w, const uint16_t _h, const float fovInDegrees, c
 #endif
 }
 
+int8_t vtAddStore(const char *_tileDir, const char *_pageExtension, const uint8_t _pageBorder, const uint8_t _mipChainLength, const uint16_t _pageDimension)
+{
+	if (!vt.memValid)
+	{
+		printf("Error: vtAddStore() must be called after vtInit()\n");
+		return -1;
+	}
+
+	if (OPENCL_BUFFERREDUCTION)
+	{
+		printf("Error: the OpenCL buffer reduction only reduces requests for the first store, vtAddStore() is unavailable with OPENCL_BUFFERREDUCTION\n");
+		return -1;
+	}
+
+	if ((strncmp(_pageExtension, c.pageCodec.c_str(), 4) != 0) || (_pageBorder != c.pageBorder) || (_pageDimension != c.pageDimension)) // the pages of all stores share the physical texture
+	{
+		printf("Error: %s doesn't match the page format of the first store (%s, border %u, dimension %u)\n", _tileDir, c.pageCodec.c_str(), c.pageBorder, c.pageDimension);
+		return -1;
+	}
+
+	const int8_t store = _vtOpenStore(_tileDir, _mipChainLength);
+	if (store < 0)
+		return -1;
+
+	_vtLoadStore(store);
+
+	if (vt.physicalTexture) // vtPrepare() has been called
+	{
+		_vtPrepareStore(store);
+		_vtPrepareUploadBuffers();
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	if (vt.w)
+		_vtReshapeExtractTable();
+
+	return store;
+}
+
+void vtRemoveStore(const uint8_t store)
+{
+	if (!vt.memValid || (store >= vt.storeCount) || !STORE(store).active)
+		return;
+
+	vtStore &st = STORE(store);
+
+	{	// lock
+		LOCK(vt.prefetchMutex) // the feedback thread may be projecting the proxy, it queues its pages before it lets go
+
+		st.prefetchVertices.clear();
+		st.prefetchIndices.clear();
+	}	// unlock
+
+	{	// lock
+		LOCK(vt.neededPagesMutex)
+
+		st.active = false; // no thread takes another page of it from now on
+
+		deque<uint32_t> needed, prefetch;
+		for (uint32_t i = 0; i < vt.neededPages.size(); i++)
+			if (EXTRACT_STORE(vt.neededPages[i]) != store)
+				needed.push_back(vt.neededPages[i]);
+		for (uint32_t i = 0; i < vt.prefetchPages.size(); i++)
+			if (EXTRACT_STORE(vt.prefetchPages[i]) != store)
+				prefetch.push_back(vt.prefetchPages[i]);
+		vt.neededPages.swap(needed);
+		vt.prefetchPages.swap(prefetch);
+
+#if ENABLE_MT
+		while (st.loadCount) // the pages in flight read its tile store and tables until they are finished
+			vt.loadsFinishedCondition.wait(&vt.neededPagesMutex);
+#endif
+
+		uint32_t wanted = 0;
+		for (uint32_t i = 0; i < vt.wantedLoads.size(); i++)
+			if (EXTRACT_STORE(vt.wantedLoads[i]) != store)
+				vt.wantedLoads[wanted++] = vt.wantedLoads[i];
+		vt.wantedLoads.resize(wanted);
+	}	// unlock
+
+	vtRemoveWarmupPages(store);
+
+	{	// lock
+		LOCK(vt.newPagesMutex)
+
+		queue<uint32_t> newPages;
+		while (!vt.newPages.empty())
+		{
+			if (EXTRACT_STORE(vt.newPages.front()) != store)
+				newPages.push(vt.newPages.front());
+			vt.newPages.pop();
+		}
+		vt.newPages = newPages;
+	}	// unlock
+
+	vtcRemoveStorePagesLOCK(store); // a store that reuses the id must not find them
+
+	// its slots are free for the other stores right away, including the resident ones
+	for (uint8_t layer = 0; layer < c.physTexLayers; layer++)
+		for (uint8_t column = 0; column < c.physTexDimensionPages; column++)
+			for (uint8_t row = 0; row < c.physTexDimensionPages; row++)
+			{
+				const uint8_t x = SLOT_X(column, layer), y = SLOT_Y(row, layer);
+
+				if ((STORAGE_INFO(x, y).state != kSlotFree) && (STORAGE_INFO(x, y).store == store))
+					vtsFreeSlot(x, y);
+			}
+
+	_vtCloseStore(store);
+
+	if (vt.w)
+		_vtReshapeExtractTable();
+}
+
+bool vtIsStoreReady(const uint8_t store)
+{
+	if ((store >= vt.storeCount) || !STORE(store).active)
+		return false;
+
+	const vtStore &st = STORE(store);
+
+	return (!vtuPageExists(MAKE_PAGE_INFO(store, st.mipChainLength - 1, 0, 0)) || ((uint8_t) PAGE_TABLE(store, st.mipChainLength - 1, 0, 0) == kTableMapped));
+}
+
+uint8_t vtGetStoreCount()
+{
+	uint8_t count = 0;
+
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		if (STORE(s).active)
+			count++;
+
+	return count;
+}
+
+void vtBindStore(const uint8_t store)
+{
+	if ((store >= vt.storeCount) || !STORE(store).active)
+		return;
+
+	glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PAGETABLE);
+	glBindTexture(GL_TEXTURE_2D, STORE(store).pageTableTexture);
+
+	if (USE_MIPCALC_TEXTURE)
+	{
+		glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_MIPCALC);
+		glBindTexture(GL_TEXTURE_2D, STORE(store).mipcalcTexture);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+}
+
 float vtGetBias()
 {
 	if (MIPPED_PHYSTEX)
@@ -589,3 +1004,18 @@ float vtGetBias()
 	else
 		return vt.bias;
 }
+
+void vtSetPhysicalTextureLayers(const uint8_t layers)
+{
+	c.requestedPhysTexLayers = (layers > MAX_PHYS_TEX_LAYERS) ? MAX_PHYS_TEX_LAYERS : layers;
+}
+
+void vtSetTargetOccupancy(const float occupancy)
+{
+	c.targetOccupancy = (occupancy <= 0.0f) ? 0.0f : ((occupancy < 0.1f) ? 0.1f : ((occupancy > 1.0f) ? 1.0f : occupancy));
+}
+
+void vtSetDecompressionThreads(const uint8_t count)
+{
+	c.decompressionThreads = (count > 64) ? 64 : count;
+}
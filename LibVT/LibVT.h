@@ -30,6 +30,8 @@
  * @param[in] _pageBorder		This is the border each page has in pixels, Values:	0-8
  * @param[in] _mipChainLength	The length of the mipchain, determined by the virt. tex. size and the page size, Values: 2 - 11
  * @param[in] _pageDimension	This is the width/height of a single page in pixels, Values: 64, 128, 256 or 512
+ * @note The tile store becomes store 0, more can be added with vtAddStore().
+ * @note With ENABLE_MT the HIGHEST_MIP_LEVELS_TO_PRECACHE levels are loaded in the background after it returns, see vtGetWarmupProgress().
 */
 //void		vtInit(const char *_tileDir, const char *_pageExtension, const uint8_t _pageBorder, const uint8_t _mipChainLength, const uint16_t _pageDimension);
 bool vtInit(const char *_tileDir, const char *_pageExtension, const uint8_t _pageBorder, const uint8_t _mipChainLength, const uint16_t _pageDimension,const unsigned int phys_tex_size);
@@ -52,11 +54,64 @@ void		vtPrepare(const GLuint readbackShader, const GLuint renderVTShader);
 void		vtPrepareOpenCL(const GLuint requestTexture);
 
 /*!
- * @fn vtGetShaderPrelude()
+ * @fn vtGetShaderPrelude(const uint8_t store)
  * @brief Returns the shader prelude that must be prepended to the virtual texturing shaders bevore compiling them.
+ * @param[in] store	The store the shaders render, 0 for the one from vtInit(). Every store needs its own programs, the prelude holds its dimensions and id. vtPrepare() only sets the sampler uniforms of the programs of store 0.
  * @return The shader prelude buffer, must be free()ed after usage.
  */
-char *		vtGetShaderPrelude();
+char *		vtGetShaderPrelude(const uint8_t store);
+
+/*!
+ * @fn vtAddStore(const char *_tileDir, const char *_pageExtension, const uint8_t _pageBorder, const uint8_t _mipChainLength, const uint16_t _pageDimension)
+ * @brief Opens another tile store that shares the physical texture, the caches and the loading threads with the one from vtInit().
+ * @param[in] _tileDir			The full path to the tile directory.
+ * @param[in] _pageExtension	Must be the same as for vtInit().
+ * @param[in] _pageBorder		Must be the same as for vtInit().
+ * @param[in] _mipChainLength	The length of the mipchain of this store, Values: 2 - 11
+ * @param[in] _pageDimension	Must be the same as for vtInit().
+ * @return The id of the store for vtGetShaderPrelude(), vtBindStore() and vtSetPrefetchGeometry(), or -1 on failure.
+ * @note Call it after vtInit(), before or after vtPrepare() and vtReshape(). At most MAX_STORES stores can be open at the same time, the id of a removed store may be returned again. Fails if OPENCL_BUFFERREDUCTION is 1.
+ */
+int8_t		vtAddStore(const char *_tileDir, const char *_pageExtension, const uint8_t _pageBorder, const uint8_t _mipChainLength, const uint16_t _pageDimension);
+
+/*!
+ * @fn vtRemoveStore(const uint8_t store)
+ * @brief Stops loading pages for the given store and frees its slots in the physical texture for the other stores.
+ * @param[in] store	The id returned by vtAddStore(), or 0.
+ * @note Its geometry must not be rendered anymore. Waits for the pages of the store that are being loaded, then closes the tile store and frees its tables and id.
+ */
+void		vtRemoveStore(const uint8_t store);
+
+/*!
+ * @fn vtGetStoreCount()
+ * @brief Returns the number of stores that have been opened and not removed.
+ */
+uint8_t		vtGetStoreCount();
+
+/*!
+ * @fn vtBindStore(const uint8_t store)
+ * @brief Binds the page table (and mipcalc) texture of the given store, must be called before rendering its geometry in both passes if there is more than one store.
+ * @post Has the following side effect: glActiveTexture(GL_TEXTURE0);
+ * @param[in] store	The id of the store.
+ */
+void		vtBindStore(const uint8_t store);
+
+/*!
+ * @fn vtIsStoreReady(const uint8_t store)
+ * @brief Returns true once the page of the highest mip level of the store is in the physical texture, so its geometry can be rendered with a (coarse) texture.
+ * @param[in] store	The id of the store.
+ * @note Pages are mapped in vtMapNewPages(), so it only changes while frames are rendered.
+ */
+bool		vtIsStoreReady(const uint8_t store);
+
+/*!
+ * @fn vtGetWarmupProgress(uint32_t *donePages, uint32_t *totalPages)
+ * @brief Reports the progress of precaching the highest mip levels of all stores into the RAM cache.
+ * @param[out] donePages	The pages loaded so far.
+ * @param[out] totalPages	The pages queued since vtInit(), the warm-up is finished when both are equal.
+ * @note Rendering doesn't have to wait for the warm-up, its pages just load faster once they are needed.
+ */
+void		vtGetWarmupProgress(uint32_t *donePages, uint32_t *totalPages);
 
 
 /*!
@@ -122,10 +177,21 @@ void		vtShutdown();
  * @param[out] _mipChainLength	A pointer to a uint8_t where the size of the mip chain length will be stored.
  * @param[out] _pageDimension	A pointer to a uint32_t where the size of the tiles will be stored.
  * @return Returns whether the directory seems to be a valid tile store.
+ * @note If the directory contains a tile archive created by vtPackTileStore() the configuration is read from its header.
  */
 bool		vtScan(const char *_tileDir, char * _pageExtension, uint8_t *_pageBorder, uint8_t *_mipChainLength, uint32_t *_pageDimension);
 
 
+/*!
+ * @fn vtPackTileStore(const char *_tileDir)
+ * @brief Packs all tiles of the tile store at the given path into a single memory-mappable archive file ("tiles.vta") inside that directory.
+ * @param[in] _tileDir			The path of the tile directory to pack.
+ * @return Returns whether the archive could be written.
+ * @note vtInit() prefers the archive over the tile directories if both are present. The tile files are neither modified nor removed.
+ */
+bool		vtPackTileStore(const char *_tileDir);
+
+
 /*!
  * @fn vtGetBias()
  * @brief Provides the bias that should be used for the float bias for the uniform "mip_bias" for both shaders.
@@ -133,6 +199,108 @@ bool		vtScan(const char *_tileDir, char * _pageExtension, uint8_t *_pageBorder,
  */
 float		vtGetBias();
 
+/*!
+ * @fn vtSetTargetOccupancy(const float occupancy)
+ * @brief Overrides DYNAMIC_LOD_TARGET_OCCUPANCY, the share of the physical texture the dynamic LoD adjustment aims to fill with the pages the view needs.
+ * @param[in] occupancy		Between 0.1 and 1.0, 0 restores DYNAMIC_LOD_TARGET_OCCUPANCY.
+ * @note Takes effect on the next vtMapNewPages(). Only used if DYNAMIC_LOD_ADJUSTMENT is on.
+ */
+void		vtSetTargetOccupancy(const float occupancy);
+
+
+/*!
+ * @fn vtSetPhysicalTextureLayers(const uint8_t layers)
+ * @brief Overrides PHYS_TEX_LAYERS, the number of layers of the physical texture, each of the size passed to vtInit().
+ * @param[in] layers		The number of layers of the 2D texture array, 1 for a plain 2D texture, 0 restores PHYS_TEX_LAYERS. At most 8.
+ * @note Must be called before vtInit(), takes effect on the next vtInit(). More than 1 layer needs GL_EXT_texture_array.
+ */
+void		vtSetPhysicalTextureLayers(const uint8_t layers);
+
+/*!
+ * @fn vtSetDecompressionThreads(const uint8_t count)
+ * @brief Overrides DECOMPRESSION_THREADS, the number of threads that decompress pages if ENABLE_MT is 2.
+ * @param[in] count		The number of decompression threads to start, 0 means one per processor core minus two.
+ * @note Must be called before vtInit(), takes effect on the next vtInit().
+ */
+void		vtSetDecompressionThreads(const uint8_t count);
+
+/*!
+ * @fn vtSetPageCacheDirectory(const char *cacheDir)
+ * @brief Keeps every decoded page in a persistent cache file inside cacheDir, so later sessions with the same tile store copy pages from there instead of reading and decompressing them.
+ * @param[in] cacheDir	An existing directory, NULL or "" turns the page cache off. Each tile store and configuration gets its own file of at most PAGE_CACHE_MB.
+ * @note Must be called before vtInit(), takes effect on the next vtInit(). Pages are stored in the format they are uploaded in, so the files are specific to the machine and build.
+ */
+void		vtSetPageCacheDirectory(const char *cacheDir);
+
+
+/*!
+ * @fn vtSetPrefetchGeometry(const uint8_t store, const float *vertices, const float *texcoords, const uint32_t *indices, const uint32_t triangleCount)
+ * @brief Gives vtPrefetch() the virtual textured mesh of a store to project, it is copied and simplified to at most 2 * PREFETCH_PROXY_RESOLUTION^2 triangles.
+ * @param[in] store			The store the mesh is textured with, each store has its own mesh.
+ * @param[in] vertices		x, y, z per vertex, in the space the view matrices passed to vtPrefetch() transform from.
+ * @param[in] texcoords		u, v per vertex, the virtual texture coordinates.
+ * @param[in] indices		3 vertex indices per triangle, or NULL if the vertices are 3 per triangle.
+ * @param[in] triangleCount	The number of triangles.
+ * @note Call it after vtInit(), vtShutdown() forgets the geometry.
+ */
+void		vtSetPrefetchGeometry(const uint8_t store, const float *vertices, const float *texcoords, const uint32_t *indices, const uint32_t triangleCount);
+
+/*!
+ * @fn vtPrefetch(const double *viewMatrices, const double *projectionMatrices, const uint32_t poseCount)
+ * @brief Queues the pages that the given predicted camera poses will need, so they are in the RAM cache by the time the prepass asks for them.
+ * @param[in] viewMatrices			poseCount view matrices, 16 doubles each, column major like osg::Matrixd::ptr(). The nearest pose in time comes first and is loaded first.
+ * @param[in] projectionMatrices	poseCount projection matrices, column major.
+ * @param[in] poseCount				The number of poses, 0 drops the pages still queued by the last call.
+ * @note Call it once per frame after vtExtractNeededPages(), each call replaces the queue of the last one. The pages are loaded only while there are no requests from the prepass, at most PREFETCH_MAX_PAGES of them, and they aren't mapped until the prepass requests them. Does nothing without vtSetPrefetchGeometry(). With ASYNC_FEEDBACK it only copies the poses, the projection runs on the feedback thread.
+ */
+void		vtPrefetch(const double *viewMatrices, const double *projectionMatrices, const uint32_t poseCount);
+
+
+/*!
+ * @fn vtStartCapture(const char *capturePath)
+ * @brief Starts recording every buffer passed to vtExtractNeededPages() together with the camera pose, for replay with the vt_replay tool.
+ * @param[in] capturePath	The file to write to, it is overwritten. Captures grow by w * h * 4 bytes per frame.
+ * @return false if the file couldn't be opened or vtInit() hasn't been called.
+ */
+bool		vtStartCapture(const char *capturePath);
+void		vtStopCapture();
+
+/*!
+ * @fn vtSetCameraPose(const double viewMatrix[16], const double projectionMatrix[16])
+ * @brief Sets the camera pose that is recorded with the next readback buffer, call it before vtExtractNeededPages() while capturing.
+ * @param[in] viewMatrix		The view matrix, column major.
+ * @param[in] projectionMatrix	The projection matrix, column major.
+ */
+void		vtSetCameraPose(const double viewMatrix[16], const double projectionMatrix[16]);
+
+
+/*!
+ * @fn vtGetPoolStats(vtPoolStats *pagePool, vtPoolStats *bufferPools)
+ * @brief Reports the usage of the buffer pools that back every page on its way from disk to the physical texture.
+ * @param[out] pagePool		Statistics of the pool of decoded page buffers, may be NULL.
+ * @param[out] bufferPools	Statistics of all pools for compressed and temporary buffers combined, may be NULL.
+ * @note The hit rate is hits / (hits + misses), bytesHighWater is the peak memory held in blocks at the same time.
+ */
+void		vtGetPoolStats(vtPoolStats *pagePool, vtPoolStats *bufferPools);
+
+
+/*!
+ * @fn vtGetStats(vtStats *stats)
+ * @brief Reports what the paging pipeline did in the last frame: queue depths, RAM cache and compressed cache usage, disk and decompression totals, upload time and the current bias.
+ * @param[out] stats	Filled with the statistics, all zero before vtInit().
+ * @note Cheap enough to call every frame, it only takes the queue and cache locks briefly.
+ */
+void		vtGetStats(vtStats *stats);
+
+/*!
+ * @fn vtStartStatsTrace(const char *tracePath)
+ * @brief Starts writing one CSV row of vtGetStats() per vtMapNewPages() call, the totals are written as per frame differences.
+ * @param[in] tracePath	The file to write to, it is overwritten.
+ * @return false if the file couldn't be opened.
+ */
+bool		vtStartStatsTrace(const char *tracePath);
+void		vtStopStatsTrace();
+
 
 /*!
  * @fn vtPerformOpenCLBufferReduction()
@@ -166,7 +334,9 @@ void		vtExtractNeededPagesOpenCL();
  * \b 5.) Now adjust your realtime application to use LibVT as documented: <br>
  * At startup call \link vtInit() vtInit() \endlink with the path to your tile store, the border width, the mipchain length and the tilesize<br>
  * Call \link vtGetShaderPrelude() vtGetShaderPrelude() \endlink to obtain the prelude to prepend to the shaders and load the readback and renderVT shaders.<br>
+ * To render several tile stores, open the others with \link vtAddStore() vtAddStore() \endlink, load the shaders once per store with its prelude and call \link vtBindStore() vtBindStore() \endlink before rendering the geometry of each store.<br>
  * When OpenGL is callable call \link vtPrepare() vtPrepare() \endlink and pass it the shader objects.<br>
+ * The first frames can be rendered right away, \link vtIsStoreReady() vtIsStoreReady() \endlink tells when a store has its coarsest mip level and \link vtGetWarmupProgress() vtGetWarmupProgress() \endlink how far the background precaching is.<br>
  * Call  \link vtReshape() vtReshape() \endlink now with the screen width, height, as well as fov, nearplane and farplane (only imporant in readback reduction mode). This call must also be made every time any of these values change, i.e. at viewport resize time.<br>
  * Now in the renderloop, call \link vtPrepareReadback() vtPrepareReadback() \endlink, render with the readback shader, call \link vtPerformReadback() vtPerformReadback() \endlink, \link vtExtractNeededPages() vtExtractNeededPages() \endlink, \link vtMapNewPages() vtMapNewPages() \endlink, and then render with the renderVT shader. Additionally pass the result of \link vtGetBias() vtGetBias() \endlink to both shaders as value for "mip_bias" each frame if you have the dynamic lod adjustment turned on.<br>
  * At shutdown call  \link vtShutdown() vtShutdown() \endlink<br><br>
@@ -281,7 +451,7 @@ void		vtExtractNeededPagesOpenCL();
  * {
  * 	vtInit("/Path/to/the/tile/dir/", "jpg", 0, 8, 256); // jpeg tiles, no border, mipchain length 8, and 256x256 tiles
  *
- * 	char *prelude = vtGetShaderPrelude();
+ * 	char *prelude = vtGetShaderPrelude(0);
  *
  * 	readbackShader = loadShadersWithPrelude("readback", prelude);
  * 	renderVTShader = loadShadersWithPrelude("renderVT", prelude);
@@ -384,7 +554,7 @@ void		vtExtractNeededPagesOpenCL();
  * 	cgGLLoadProgram(cgReadbackFragmentProgram);
  * 	
  * 	cgReadbackParamMipcalcTexture = cgGetNamedParameter(cgReadbackFragmentProgram, "mipcalcTexture");
- * 	cgGLSetTextureParameter(cgReadbackParamMipcalcTexture, vt.mipcalcTexture);
+ * 	cgGLSetTextureParameter(cgReadbackParamMipcalcTexture, vt.stores[0].mipcalcTexture);
  * 	cgGLEnableTextureParameter(cgReadbackParamMipcalcTexture);
  * 	
  * 	cgReadbackParamMipBias = cgGetNamedParameter(cgReadbackFragmentProgram, "mip_bias");
@@ -406,7 +576,7 @@ void		vtExtractNeededPagesOpenCL();
  * 	cgGLEnableTextureParameter(cgRenderParamPhysicalTexture);
  * 	
  * 	cgRenderParamPageTableTexture = cgGetNamedParameter(cgRenderFragmentProgram, "pageTableTexture");
- * 	cgGLSetTextureParameter(cgRenderParamPageTableTexture, vt.pageTableTexture);
+ * 	cgGLSetTextureParameter(cgRenderParamPageTableTexture, vt.stores[0].pageTableTexture);
  * 	cgGLEnableTextureParameter(cgRenderParamPageTableTexture);
  * 	
  * 	cgRenderParamMipBias = cgGetNamedParameter(cgRenderFragmentProgram, "mip_bias");
@@ -496,7 +666,7 @@ void		vtExtractNeededPagesOpenCL();
  * {
  * 	vtInit("/Path/to/the/tile/dir/", "jpg", 0, 8, 256); // jpeg tiles, no border, mipchain length 8, and 256x256 tiles
  *
- * 	char *prelude = vtGetShaderPrelude();
+ * 	char *prelude = vtGetShaderPrelude(0);
  *
  * 	combined = loadShadersWithPrelude("combined", prelude); // use the combined shader for a single MRT pass
  *
@@ -21,27 +21,256 @@
 extern vtData vt;
 extern vtConfig c;
 
+// the cache is a set of RAMCACHE_SHARDS intrusive hash tables, each with its own LRU list and lock
+// every operation is O(1), eviction happens when inserting so it runs on the loading threads and never on the render thread
+// the compressed cache uses the same shards for tile files, it is budgeted in bytes and its entries are taken out while they are being decompressed
+
+static inline uint32_t _vtcHash(uint32_t pageInfo)
+{
+	uint32_t h = pageInfo;	// the low byte of a page key is the mip level, so mix all bits down before using them
+
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+static inline vtCacheShard & _vtcShard(vtCacheShard *shards, uint32_t hash)
+{
+	return shards[hash & (RAMCACHE_SHARDS - 1)];
+}
+
+static inline vtCacheEntry ** _vtcBucket(vtCacheShard &shard, uint32_t hash)
+{
+	return &shard.buckets[(hash / RAMCACHE_SHARDS) & shard.bucketMask];
+}
+
+static inline void _vtcUnlink(vtCacheEntry *entry)
+{
+	entry->lruPrev->lruNext = entry->lruNext;
+	entry->lruNext->lruPrev = entry->lruPrev;
+}
+
+static inline void _vtcLinkFront(vtCacheShard &shard, vtCacheEntry *entry)
+{
+	entry->lruPrev = &shard.lru;
+	entry->lruNext = shard.lru.lruNext;
+	shard.lru.lruNext->lruPrev = entry;
+	shard.lru.lruNext = entry;
+}
+
+static vtCacheEntry * _vtcFind(vtCacheShard &shard, uint32_t hash, uint32_t pageInfo)
+{
+	if (!shard.buckets)
+		return NULL;
+
+	for (vtCacheEntry *entry = *_vtcBucket(shard, hash); entry; entry = entry->hashNext)
+		if (entry->pageInfo == pageInfo)
+			return entry;
+
+	return NULL;
+}
+
+static void * _vtcDetachEntry(vtCacheShard &shard, uint32_t hash, vtCacheEntry *entry)
+{
+	vtCacheEntry **link = _vtcBucket(shard, hash);
+	void *data = entry->data;
+
+	while (*link != entry)
+		link = &(*link)->hashNext;
+	*link = entry->hashNext;
+
+	_vtcUnlink(entry);
+	shard.count--;
+	shard.bytes -= vtpSize(data);
+
+	free(entry);
+
+	return data;
+}
+
+static void _vtcRemoveEntry(vtCacheShard &shard, uint32_t hash, vtCacheEntry *entry)
+{
+	vtpFree(_vtcDetachEntry(shard, hash, entry));
+}
+
+static void _vtcInsertEntry(vtCacheShard &shard, uint32_t hash, uint32_t pageInfo, void *data)
+{
+	vtCacheEntry *entry = (vtCacheEntry *) malloc(sizeof(vtCacheEntry));
+	assert(entry);
+
+	vtCacheEntry **bucket = _vtcBucket(shard, hash);
+	entry->pageInfo = pageInfo;
+	entry->pinCount = 0;
+	entry->data = data;
+	entry->hashNext = *bucket;
+	*bucket = entry;
+
+	_vtcLinkFront(shard, entry);
+	shard.count++;
+	shard.bytes += vtpSize(data);
+}
+
+static void _vtcEvictIfNecessary(vtCacheShard &shard)
+{
+	vtCacheEntry *entry = shard.lru.lruPrev;
+
+	while (((shard.count > shard.maxCount) || (shard.bytes > shard.maxBytes)) && (entry != &shard.lru))
+	{
+		vtCacheEntry *prev = entry->lruPrev;
+
+		if (!entry->pinCount)
+		{
+#if DEBUG_LOG > 1
+			printf("Un-loading page from RAM-cache: Mip:%u %u/%u\n", EXTRACT_MIP(entry->pageInfo), EXTRACT_X(entry->pageInfo), EXTRACT_Y(entry->pageInfo));
+#endif
+			_vtcRemoveEntry(shard, _vtcHash(entry->pageInfo), entry);
+			shard.evictions++;
+		}
+
+		entry = prev;
+	}
+}
+
+static void _vtcInitShards(vtCacheShard *shards, uint32_t maxCount, uint64_t maxBytes, uint32_t expectedCount)
+{
+	uint32_t bucketCount = 16;
+
+	while (bucketCount < expectedCount)
+		bucketCount <<= 1;
+
+	for (uint8_t i = 0; i < RAMCACHE_SHARDS; i++)
+	{
+		vtCacheShard &shard = shards[i];
+		LOCK(shard.mutex)
+
+		free(shard.buckets);
+		shard.buckets = (vtCacheEntry **) calloc(bucketCount, sizeof(vtCacheEntry *));
+		assert(shard.buckets);
+		shard.bucketMask = bucketCount - 1;
+		shard.count = 0;
+		shard.maxCount = maxCount;
+		shard.bytes = shard.evictions = 0;
+		shard.maxBytes = maxBytes;
+		shard.lru.lruNext = shard.lru.lruPrev = &shard.lru;
+	}
+}
+
+static void _vtcRemoveStoreEntries(vtCacheShard *shards, const uint8_t store)
+{
+	for (uint8_t i = 0; i < RAMCACHE_SHARDS; i++)
+	{
+		vtCacheShard &shard = shards[i];
+		LOCK(shard.mutex)
+
+		if (!shard.buckets)
+			continue;
+
+		vtCacheEntry *entry = shard.lru.lruNext;
+		while (entry != &shard.lru)
+		{
+			vtCacheEntry *next = entry->lruNext;
+			if ((EXTRACT_STORE(entry->pageInfo) == store) && !entry->pinCount)
+				_vtcRemoveEntry(shard, _vtcHash(entry->pageInfo), entry);
+			entry = next;
+		}
+	}
+}
+
+static void _vtcClearShards(vtCacheShard *shards)
+{
+	for (uint8_t i = 0; i < RAMCACHE_SHARDS; i++)
+	{
+		vtCacheShard &shard = shards[i];
+		LOCK(shard.mutex)
+
+		if (!shard.buckets)
+			continue;
+
+		vtCacheEntry *entry = shard.lru.lruNext;
+		while (entry != &shard.lru)
+		{
+			vtCacheEntry *next = entry->lruNext;
+			vtpFree(entry->data);
+			free(entry);
+			entry = next;
+		}
+
+		free(shard.buckets);
+		shard.buckets = NULL;
+		shard.bucketMask = 0;
+		shard.count = 0;
+		shard.bytes = 0;
+		shard.lru.lruNext = shard.lru.lruPrev = &shard.lru;
+	}
+}
+
+void vtcInit()
+{
+	const uint32_t maxCount = c.maxCachedPages / RAMCACHE_SHARDS + 1;
+
+	vtcClearCache();
+
+	_vtcInitShards(vt.cacheShards, maxCount, ~(uint64_t) 0, maxCount);
+
+	if (MAX_COMPRESSED_RAMCACHE_MB && !(c.pageDXTCompression && !REALTIME_DXT_COMPRESSION)) // DXT tiles are uploaded as they are, caching their files would just duplicate the RAM cache
+	{
+		const uint64_t maxBytes = (uint64_t) MAX_COMPRESSED_RAMCACHE_MB * 1024 * 1024 / RAMCACHE_SHARDS;
+
+		_vtcInitShards(vt.compressedCacheShards, 0xFFFFFFFF, maxBytes, (uint32_t) (maxBytes / (c.pageMemsize / 16 + 1))); // sized for tiles of 1/16 of a decoded page
+	}
+}
+
+void vtcClearCache()
+{
+	_vtcClearShards(vt.cacheShards);
+	_vtcClearShards(vt.compressedCacheShards);
+}
+
 void vtcRemoveCachedPageLOCK(uint32_t pageInfo)
 {
-	LOCK(vt.cachedPagesMutex)
-	
-	return _vtcRemoveCachedPage(pageInfo);
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.cacheShards, hash);
+	LOCK(shard.mutex)
+
+	vtCacheEntry *entry = _vtcFind(shard, hash, pageInfo);
+
+	if (entry && !entry->pinCount)
+		_vtcRemoveEntry(shard, hash, entry);
+}
+
+// walks all entries, only for vtRemoveStore(). its id may be reused, so the pages of the old store must not be found anymore
+void vtcRemoveStorePagesLOCK(const uint8_t store)
+{
+	_vtcRemoveStoreEntries(vt.cacheShards, store);
+	_vtcRemoveStoreEntries(vt.compressedCacheShards, store);
 }
 
 void vtcTouchCachedPage(uint32_t pageInfo)
 {
-	vt.cachedPagesAccessTimes[pageInfo] = vt.thisFrameClock;
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.cacheShards, hash);
+	LOCK(shard.mutex)
+
+	vtCacheEntry *entry = _vtcFind(shard, hash, pageInfo);
+
+	if (entry)
+	{
+		_vtcUnlink(entry);
+		_vtcLinkFront(shard, entry);
+	}
 }
 
 void vtcSplitPagelistIntoCachedAndNoncachedLOCK(queue<uint32_t> *s, queue<uint32_t> *cached, queue<uint32_t> *nonCached)
 {
-	LOCK(vt.cachedPagesMutex)
-
 	while(!s->empty())
 	{
 		uint32_t page = s->front();
 
-		if (vt.cachedPages.count(page))
+		if (vtcIsPageInCacheLOCK(page))
 			cached->push(page);
 		else
 			nonCached->push(page);
@@ -52,80 +281,106 @@ void vtcSplitPagelistIntoCachedAndNoncachedLOCK(queue<uint32_t> *s, queue<uint32
 
 bool vtcIsPageInCacheLOCK(uint32_t pageInfo)
 {
-	LOCK(vt.cachedPagesMutex)
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.cacheShards, hash);
+	LOCK(shard.mutex)
 
-	return (vt.cachedPages.count(pageInfo) > 0);
+	return (_vtcFind(shard, hash, pageInfo) != NULL);
 }
 
-void vtcInsertPageIntoCacheLOCK(uint32_t pageInfo, void * image_data)
+bool vtcInsertPageIntoCacheLOCK(uint32_t pageInfo, void * image_data)
 {
-	LOCK(vt.cachedPagesMutex)
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.cacheShards, hash);
+	LOCK(shard.mutex)
+
+	assert(shard.buckets);
+
+	if (_vtcFind(shard, hash, pageInfo)) // another thread was faster, keep the page that is already there
+	{
+		vtpFree(image_data);
+		return false;
+	}
+
+	_vtcInsertEntry(shard, hash, pageInfo, image_data);
+	_vtcEvictIfNecessary(shard);
 
-	vt.cachedPages.insert(pair<uint32_t, void *>(pageInfo, image_data));
+	return true;
 }
 
 void * vtcRetrieveCachedPageLOCK(uint32_t pageInfo)
 {
-	LOCK(vt.cachedPagesMutex)
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.cacheShards, hash);
+	LOCK(shard.mutex)
 
-	//assert(vt.cachedPages.count(pageInfo));
-    if(vt.cachedPages.count(pageInfo) == 0){
-        fprintf(stderr,"Cached page count equals 0 vtcRetrieveCachedPageLOCK\n");
-        return NULL;
-    }
-        
-	return vt.cachedPages.find(pageInfo)->second;
-}
+	vtCacheEntry *entry = _vtcFind(shard, hash, pageInfo);
 
-void vtcReduceCacheIfNecessaryLOCK(clock_t currentTime)
-{
-	LOCK(vt.cachedPagesMutex)
+	if (!entry) // evicted between the request and the mapping, it will be requested again
+		return NULL;
 
-	uint32_t size = (uint32_t)vt.cachedPages.size();
+	entry->pinCount++; // must be balanced with vtcReleaseCachedPageLOCK() once the data has been uploaded
+	_vtcUnlink(entry);
+	_vtcLinkFront(shard, entry);
 
-	if (size > c.maxCachedPages)
-	{
-		uint32_t pagesToErase = (size - c.maxCachedPages) * 4;
-		if (pagesToErase > (c.maxCachedPages / 10)) pagesToErase = c.maxCachedPages / 10;
-		multimap<clock_t, uint32_t> oldestPages;
+	return entry->data;
+}
 
-#if DEBUG_LOG > 0
-		printf("RAM-cache has %i too many pages - erasing the %i least recently touched pages!\n", (size - c.maxCachedPages), pagesToErase);
-#endif
+void vtcReleaseCachedPageLOCK(uint32_t pageInfo)
+{
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.cacheShards, hash);
+	LOCK(shard.mutex)
 
-		for (uint32_t i = 0; i < pagesToErase; i++)
-			oldestPages.insert(pair<clock_t, uint32_t>(currentTime+1+i, i));
+	vtCacheEntry *entry = _vtcFind(shard, hash, pageInfo);
 
-		map<uint32_t, clock_t>::iterator cachedIter;
-		for(cachedIter = vt.cachedPagesAccessTimes.begin(); cachedIter != vt.cachedPagesAccessTimes.end(); ++cachedIter)
-		{
-			if (cachedIter->second < oldestPages.rbegin()->first)
-			{
-				oldestPages.insert(pair<clock_t, uint32_t>(cachedIter->second, cachedIter->first));
+	assert(entry && entry->pinCount);
+	if (entry)
+		entry->pinCount--;
+}
 
-				oldestPages.erase(--oldestPages.rbegin().base()); // this really is the easiest way to just erase the last element - C++ sucks
-			}
-		}
+bool vtcInsertCompressedPageLOCK(uint32_t pageInfo, void *file_data)
+{
+	if (!file_data)
+		return false;
 
-		assert(oldestPages.size() == pagesToErase);
+	if (vtuIsArchiveData(file_data)) // mapped, the OS caches it already
+	{
+		vtuUnloadPageFile(file_data);
+		return false;
+	}
 
-		multimap<clock_t, uint32_t>::iterator oldestIter;
-		for(oldestIter = oldestPages.begin(); oldestIter != oldestPages.end(); ++oldestIter)
-		{
-			uint32_t pageInfo = oldestIter->second;
-			_vtcRemoveCachedPage(pageInfo);
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.compressedCacheShards, hash);
+	LOCK(shard.mutex)
 
-#if DEBUG_LOG > 1
-			printf("Un-loading page from RAM-cache: Mip:%u %u/%u\n", EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo));
-#endif
-		}
+	if (!shard.buckets || _vtcFind(shard, hash, pageInfo) || (vtpSize(file_data) > shard.maxBytes)) // turned off, loaded twice or too big
+	{
+		vtpFree(file_data);
+		return false;
 	}
+
+	_vtcInsertEntry(shard, hash, pageInfo, file_data);
+	_vtcEvictIfNecessary(shard);
+
+	return true;
 }
 
-void _vtcRemoveCachedPage(uint32_t pageInfo)
+void * vtcTakeCompressedPageLOCK(uint32_t pageInfo, uint32_t *file_size)
 {
-	void *data = vt.cachedPages[pageInfo];
-	free(data);
-	vt.cachedPages.erase(pageInfo);
-	vt.cachedPagesAccessTimes.erase(pageInfo);
+	const uint32_t hash = _vtcHash(pageInfo);
+	vtCacheShard &shard = _vtcShard(vt.compressedCacheShards, hash);
+	LOCK(shard.mutex)
+
+	vtCacheEntry *entry = _vtcFind(shard, hash, pageInfo);
+
+	if (!entry)
+		return NULL;
+
+	void *file_data = _vtcDetachEntry(shard, hash, entry); // the caller owns it until it hands it back with vtcInsertCompressedPageLOCK()
+
+	if (file_size)
+		*file_size = vtpSize(file_data);
+
+	return file_data;
 }
@@ -0,0 +1,109 @@
+/*
+ *  LibVT_Capture.cpp
+ *
+ *
+ *  Recording of readback buffers and camera poses for offline replay.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Internal.h"
+#include "LibVT.h"
+
+extern vtData vt;
+extern vtConfig c;
+
+// a capture is a vtCaptureHeader with the page store configuration, followed by one vtCaptureFrame and its readback buffer per call of vtExtractNeededPages()
+// tools/vt_replay.cpp feeds these frames through the loading pipeline without a GPU
+
+bool vtStartCapture(const char *capturePath)
+{
+	vtCaptureHeader header;
+
+	vtStopCapture();
+
+	if (!vt.memValid)
+	{
+		printf("Error: vtStartCapture() must be called after vtInit()\n");
+		return false;
+	}
+
+	vt.captureFile = fopen(capturePath, "wb");
+	if (!vt.captureFile)
+	{
+		printf("Error: can't open %s for capturing\n", capturePath);
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, VT_CAPTURE_MAGIC, 4);
+	header.version = VT_CAPTURE_VERSION;
+	header.pageDimension = c.pageDimension;
+	header.physTexSize = c.phys_tex_size;
+	header.pageBorder = c.pageBorder;
+	header.mipChainLength = STORE(0).mipChainLength; // replays cover the first store, requests of the others are skipped
+	header.physTexLayers = c.physTexLayers;
+	strncpy(header.codec, c.pageCodec.c_str(), sizeof(header.codec) - 1);
+	header.tileDirLength = (uint32_t) STORE(0).tileDir.length();
+
+	if ((fwrite(&header, sizeof(header), 1, vt.captureFile) != 1) ||
+		(fwrite(STORE(0).tileDir.c_str(), 1, header.tileDirLength, vt.captureFile) != header.tileDirLength) ||
+		(fflush(vt.captureFile) != 0)) // a full disk shows up only once the buffer is written
+	{
+		printf("Error: writing the header of %s failed, it is removed\n", capturePath);
+		vtStopCapture();
+		remove(capturePath); // a capture without a complete header can't be replayed
+		return false;
+	}
+
+	vt.captureStartTime = vtuTime();
+
+	for (uint8_t i = 0; i < 16; i++)
+		vt.cameraView[i] = vt.cameraProjection[i] = (i % 5 == 0) ? 1.0 : 0.0;
+
+	return true;
+}
+
+void vtStopCapture()
+{
+	if (!vt.captureFile)
+		return;
+
+	fclose(vt.captureFile);
+	vt.captureFile = NULL;
+}
+
+void vtSetCameraPose(const double viewMatrix[16], const double projectionMatrix[16])
+{
+	memcpy(vt.cameraView, viewMatrix, sizeof(vt.cameraView));
+	memcpy(vt.cameraProjection, projectionMatrix, sizeof(vt.cameraProjection));
+}
+
+void vtCaptureReadback(const uint32_t *buffer)
+{
+	vtCaptureFrame frame;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.frame = vt.thisFrame;
+	frame.w = vt.w;
+	frame.h = vt.h;
+	frame.real_w = vt.real_w;
+	frame.real_h = vt.real_h;
+	frame.time = vtuTime() - vt.captureStartTime;
+	memcpy(frame.view, vt.cameraView, sizeof(frame.view));
+	memcpy(frame.projection, vt.cameraProjection, sizeof(frame.projection));
+
+	if ((fwrite(&frame, sizeof(frame), 1, vt.captureFile) != 1) ||
+		(fwrite(buffer, 4, vt.w * vt.h, vt.captureFile) != vt.w * vt.h))
+	{
+		printf("Error: writing the capture failed, capturing stopped\n");
+		vtStopCapture();
+	}
+}
@@ -79,6 +79,32 @@
  */
 #define MAX_RAMCACHE_MB				500//2000
 
+/*!
+ * @def		RAMCACHE_SHARDS
+ * @brief	The RAM cache is split into this many independently locked LRU lists, pages are distributed by a hash of their key <br>
+ * Note:	Affects lock contention between the loading threads and the render thread <br>
+ * Values:	1, 2, 4, 8, 16 (must be a power of two)
+ */
+#define RAMCACHE_SHARDS				8
+
+/*!
+ * @def		MAX_COMPRESSED_RAMCACHE_MB
+ * @brief	The maximal amount of megabytes to use for caching the compressed tile files after they have been decompressed, 0 turns this cache off <br>
+ * Note:	Affects RAM usage / performance <br>
+ * Values:	0 - FREE_RAM_IN_SYSTEM <br>
+ * Info:	A page that was evicted from the RAM cache is decompressed again from here instead of being read from disk, which matters when the tile store is on a network share. JPEG tiles are 10 - 20 times smaller than decoded pages, so this holds many more pages than the RAM cache for the same amount of memory. Not used for DXT tiles, which aren't decompressed, and for tile archives, which are memory mapped anyway.
+ */
+#define MAX_COMPRESSED_RAMCACHE_MB	200
+
+/*!
+ * @def		PAGE_CACHE_MB
+ * @brief	The maximal size of the persistent page cache file of a tile store, see vtSetPageCacheDirectory() <br>
+ * Note:	Affects disk usage / performance <br>
+ * Values:	64 - FREE_DISK_SPACE <br>
+ * Info:	The file is sparse, it only grows by the pages that are actually decoded. Once it is full no more pages are added, delete it to start over.
+ */
+#define PAGE_CACHE_MB				4096
+
 /*!
  * @def		PREPASS_RESOLUTION_REDUCTION_SHIFT
  * @brief	Perform readback on full screen resolution or shifted right x times <br>
@@ -97,8 +123,8 @@
 
 /*!
  * @def		HIGHEST_MIP_LEVELS_TO_PRECACHE
- * @brief	Load the X highest mip levels to the RAM cache before starting <br>
- * Note:	Affects startupTime / runtimePerformance <br>
+ * @brief	Load the X highest mip levels to the RAM cache at startup <br>
+ * Note:	Affects startupTime / runtimePerformance, with ENABLE_MT they are loaded by a warm-up thread and vtInit() doesn't wait for them <br>
  * Values:	0 - 7 (must be lower than the mipchain length)
  */
 #define HIGHEST_MIP_LEVELS_TO_PRECACHE	0
@@ -119,28 +145,70 @@
  */
 #define USE_PBO_READBACK			0
 
+/*!
+ * @def		PHYS_TEX_LAYERS
+ * @brief	The number of layers of the physical texture. With more than 1 it is a 2D texture array (GL_EXT_texture_array) of that many layers of the size passed to vtInit(), and the slot allocator spans all of them, so the working set can exceed the 64x64 pages one layer holds. A size passed to vtInit() that holds more than 64x64 pages is split into layers of 64x64 pages anyway. Can be overridden with vtSetPhysicalTextureLayers(). <br>
+ * Note:	Affects VRAM usage / quality <br>
+ * Values:	1 - 8 <br>
+ * Info:	More than 1 requires GL_EXT_texture_array, and GL_EXT_gpu_shader4 if gradients are used for sampling.
+ */
+#define PHYS_TEX_LAYERS				1
+
 /*!
  * @def		USE_PBO_PAGETABLE
- * @brief	Perform asynchronous pagetable texture uploading with the help of a Pixel Buffer Object.
+ * @brief	Perform asynchronous pagetable texture uploading through the upload ring of Pixel Buffer Objects, see UPLOAD_RING_BUFFERS.
  * Note:	Affects VRAM usage / performance <br>
  * Values:	0 - 1
  */
-#define USE_PBO_PAGETABLE			0
+#if defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE
+	#define USE_PBO_PAGETABLE		0
+#else
+	#define USE_PBO_PAGETABLE		1
+#endif
 
 /*!
  * @def		USE_PBO_PHYSTEX
- * @brief	Perform asynchronous physical texture uploading with the help of a Pixel Buffer Object.
+ * @brief	Perform asynchronous physical texture uploading through the upload ring of Pixel Buffer Objects, see UPLOAD_RING_BUFFERS.
  * Note:	Affects VRAM usage / performance <br>
  * Values:	0 - 1
  */
-#define USE_PBO_PHYSTEX				0
+#if defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE
+	#define USE_PBO_PHYSTEX			0
+#else
+	#define USE_PBO_PHYSTEX			1
+#endif
+
 /*!
- * @def		PBO_PHYSTEX_PAGES
- * @brief	The size of the PBO for phystex updates in pages. Limits the amount of new pages that can be sent to the GPU in one frame.
- * Note:	Affects VRAM usage / performance <br>
- * Values:	1 - 30
+ * @def		UPLOAD_RING_BUFFERS
+ * @brief	The number of Pixel Buffer Objects vtMapNewPages() cycles through if USE_PBO_PHYSTEX or USE_PBO_PAGETABLE is on. They are allocated once in vtPrepare(), and a buffer is written again only after the GPU had UPLOAD_RING_BUFFERS - 1 frames to consume it, so mapping it doesn't stall. <br>
+ * Note:	Affects VRAM usage / performance, each buffer holds MAX_UPLOAD_KB_PER_FRAME of pages plus the whole page table <br>
+ * Values:	2 - 4
  */
-#define PBO_PHYSTEX_PAGES			15
+#define UPLOAD_RING_BUFFERS			3
+
+/*!
+ * @def		MAX_UPLOAD_KB_PER_FRAME
+ * @brief	The amount of page data vtMapNewPages() sends to the physical texture per call. Pages beyond it wait in the queue for the next frame, so a burst of loaded pages is spread over several frames instead of causing one long one. At least one page is uploaded per frame. <br>
+ * Note:	Affects performance / VRAM usage <br>
+ * Values:	256 - 65536
+ */
+#define MAX_UPLOAD_KB_PER_FRAME		4096
+
+/*!
+ * @def		MAX_UPLOAD_MS_PER_FRAME
+ * @brief	Milliseconds after which vtMapNewPages() stops mapping new pages and leaves the rest for the next frame, checked between pages. <br>
+ * Note:	Affects performance <br>
+ * Values:	0.5 - 16.0
+ */
+#define MAX_UPLOAD_MS_PER_FRAME		2.0
+
+/*!
+ * @def		PAGETABLE_DIRTY_RECTS
+ * @brief	The number of rectangles per page table mip level that collect the entries changed since the last upload. Changes next to a rectangle grow it, others start a new one until they run out, then the rectangle that grows least absorbs it. Each rectangle is one texture upload. <br>
+ * Note:	Affects performance <br>
+ * Values:	1 - 32
+ */
+#define PAGETABLE_DIRTY_RECTS		8
 
 /*!
  * @def		USE_MIPCALC_TEXTURE
@@ -156,7 +224,7 @@
  * @brief	Compress tiles to DXT1 before sending them to the GPU. <br>
  * Note:	Affects performance, correctness and VRAM usage <br>
  * Values:	0 - 1 <br>
- * Info:	This currently only works with DecompressionLibJPEGTurbo or DecompressionMac. Reduces GPU memory requirements to just 1/8.
+ * Info:	This currently only works with DecompressionLibJPEGTurbo, DecompressionTurboJPEG or DecompressionMac. Reduces GPU memory requirements to just 1/8. Pages are compressed by the decompression threads with the fast mode of dxt.cpp, which is vectorised with SSE2 and costs less than the decompression of the JPEG itself.
  */
 #define REALTIME_DXT_COMPRESSION	0
 
@@ -164,14 +232,47 @@
  * @def		DYNAMIC_LOD_ADJUSTMENT
  * @brief	Turn this on to make LibVT dynamically adjust the mipmap lod bias to make the required tiles fit the physical page.  <br>
  * Note:	Affects quality <br>
- * Info:	Can be off if your scene fits anyway, turn it on to provide smooth degradation instead if dropping tiles randomly. Algorithm is a bit unstable. Requires that you pass vtGetBias() as value for the uniform "mip_bias" to the shaders (both!). <br>
+ * Info:	Can be off if your scene fits anyway, turn it on to provide smooth degradation instead if dropping tiles randomly. A PI controller drives the bias so the pages the view needs fill DYNAMIC_LOD_TARGET_OCCUPANCY of the physical texture. Requires that you pass vtGetBias() as value for the uniform "mip_bias" to the shaders (both!) every frame. <br>
  * Values:	0 - 1
  */
 #define DYNAMIC_LOD_ADJUSTMENT		1
 
+/*!
+ * @def		DYNAMIC_LOD_TARGET_OCCUPANCY
+ * @brief	The share of the physical texture the needed pages (plus the resident ones) should occupy with DYNAMIC_LOD_ADJUSTMENT. The rest is headroom for pages that come into view, so the bias only goes up before the texture overflows and starts thrashing. Can be changed at runtime with vtSetTargetOccupancy(). <br>
+ * Note:	Affects quality / performance <br>
+ * Values:	0.5 - 1.0
+ */
+#define DYNAMIC_LOD_TARGET_OCCUPANCY	0.85
+
+/*!
+ * @def		DYNAMIC_LOD_HYSTERESIS
+ * @brief	Deadband of the bias controller, in mip levels of occupancy error. One mip level of bias changes the page count by about 4x, 0.05 ignores occupancy changes of up to 7% around the target so the bias doesn't flicker while the view is steady. <br>
+ * Note:	Affects quality <br>
+ * Values:	0.0 - 0.25
+ */
+#define DYNAMIC_LOD_HYSTERESIS		0.05
+
+/*!
+ * @def		DYNAMIC_LOD_GAIN_P
+ * @brief	Proportional gain of the bias controller, in mip levels of bias per mip level of occupancy error. <br>
+ * Note:	Affects quality <br>
+ * Values:	0.0 - 1.0
+ */
+#define DYNAMIC_LOD_GAIN_P			0.3
+
+/*!
+ * @def		DYNAMIC_LOD_GAIN_I
+ * @brief	Integral gain of the bias controller, per frame. It removes the remaining error over about 1 / DYNAMIC_LOD_GAIN_I frames. <br>
+ * Note:	Affects quality <br>
+ * Values:	0.01 - 0.2
+ */
+#define DYNAMIC_LOD_GAIN_I			0.1
+
 /*!
  * @def		OPENCL_BUFFERREDUCTION
  * @brief	Turn this on if you want to use the OpenCL buffer compression kernels which can 1.) provide speedups in 2 pass mode because the readback is on a few bytes instead of a large buffer 2.) enable a single pass solution <br>
+ * Note:	Supports a single tile store, vtAddStore() fails <br>
  * Values:	0 - 1
  */
 #define OPENCL_BUFFERREDUCTION		0
@@ -207,6 +308,82 @@
         #define ENABLE_MT				2
 #endif
 
+/*!
+ * @def		DECOMPRESSION_THREADS
+ * @brief	The number of page decompression threads to use if ENABLE_MT is 2 <br>
+ * Note:	Affects performance, can be overridden at runtime with vtSetDecompressionThreads() <br>
+ * Values:	0 - 64 (0 = one thread per processor core minus the render and loading threads, at least 1)
+ */
+#define DECOMPRESSION_THREADS		0
+
+/*!
+ * @def		PREFETCH_MAX_PAGES
+ * @brief	The maximum number of pages one vtPrefetch() call queues <br>
+ * Note:	Affects performance, prefetched pages take RAM cache space from the pages that are in use, so this is further limited to a quarter of the RAM cache <br>
+ * Values:	0 - 4096 (0 = no prefetching)
+ */
+#define PREFETCH_MAX_PAGES			256
+
+/*!
+ * @def		PREFETCH_PROXY_RESOLUTION
+ * @brief	vtSetPrefetchGeometry() simplifies the mesh by merging all vertices that fall into the same cell of a grid of this size over the virtual texture <br>
+ * Note:	Affects performance / accuracy of vtPrefetch(), which projects every triangle of the simplified mesh <br>
+ * Values:	16 - 1024
+ */
+#define PREFETCH_PROXY_RESOLUTION	128
+
+/*!
+ * @def		PREFETCH_SUBDIVISION_PIXELS
+ * @brief	vtPrefetch() splits projected triangles until they are smaller than this on screen, so each part gets its own mip level <br>
+ * Note:	Affects performance / accuracy of vtPrefetch() <br>
+ * Values:	32 - 512
+ */
+#define PREFETCH_SUBDIVISION_PIXELS	128
+
+/*!
+ * @def		DECOMPRESSION_BATCH
+ * @brief	The maximum number of pages a loading or decompression thread takes from its queue at once <br>
+ * Note:	Affects performance, bigger batches mean less locking but worse balancing between the decompression threads <br>
+ * Values:	1 - 32
+ */
+#define DECOMPRESSION_BATCH			8
+
+/*!
+ * @def		IO_BATCH
+ * @brief	The maximum number of requests the loading thread reads from disk together if ENABLE_MT is 2 <br>
+ * Note:	Affects performance, the reads of a batch are issued at once and done in on-disk order, which hides most of the latency of network shares and spinning disks. The decompression threads only get the pages of a batch once all of them are read <br>
+ * Values:	DECOMPRESSION_BATCH - 256
+ */
+#define IO_BATCH					32
+
+/*!
+ * @def		READAHEAD_SIBLINGS
+ * @brief	Let the OS read the tiles next to the ones that were loaded, i.e. the other three children of their parent, in the background <br>
+ * Note:	Affects disk IO / performance, they go to the file cache of the OS and not into the RAM cache. With ENABLE_MT the hints are given by a low priority thread of their own <br>
+ * Values:	0 - 1
+ */
+#define READAHEAD_SIBLINGS			0
+
+/*!
+ * @def		ASYNC_FEEDBACK
+ * @brief	Analyze the readback buffer on a separate thread instead of inside vtExtractNeededPages() <br>
+ * Note:	Affects performance, the render thread only copies the buffer into a ring and applies the result of an earlier frame, so page requests lag 1-2 frames behind <br>
+ * Values:	0 - 1 (requires ENABLE_MT)
+ */
+#if ENABLE_MT
+	#define ASYNC_FEEDBACK			1
+#else
+	#define ASYNC_FEEDBACK			0
+#endif
+
+/*!
+ * @def		FEEDBACK_RING_SIZE
+ * @brief	The number of readback buffers in flight with ASYNC_FEEDBACK, a frame's feedback is dropped if all of them are busy <br>
+ * Note:	Affects RAM usage / performance <br>
+ * Values:	2 - 4
+ */
+#define FEEDBACK_RING_SIZE			3
+
 
 /*!
  * @def		FALLBACK_ENTRIES
@@ -220,18 +397,26 @@
  * @def		IMAGE_DECOMPRESSION_LIBRARY
  * @brief	Sets the image decompression library that will be used <br>
  * Note:	When setting to a library which doesn't handle all formats, this restricts the possible image formats at runtime <br>
- * Values:	DecompressionLibPNG, DecompressionSTBIPNG, DecompressionLibJPEG, DecompressionLibJPEGTurbo, DecompressionSTBIJPEG, DecompressionMac, DecompressionDevil, DecompressionLibJPEGTurbo
+ * Values:	DecompressionLibPNG, DecompressionSTBIPNG, DecompressionLibJPEG, DecompressionLibJPEGTurbo, DecompressionTurboJPEG, DecompressionSTBIJPEG, DecompressionMac, DecompressionDevil <br>
+ * Note:	DecompressionTurboJPEG uses the TurboJPEG API of libjpeg-turbo, it is chosen on Linux if CMake finds it (VT_HAVE_TURBOJPEG)
  */
 #ifdef __APPLE__
 #define IMAGE_DECOMPRESSION_LIBRARY	DecompressionMac//DecompressionLibJPEG//DecompressionMac//DecompressionLibJPEGTurbo
 /* Horrible hack to make seams dissapear on Macs driver issue????? */
 #define MAC_GL_DRIVER_HACK 1
+#elif defined(VT_HAVE_TURBOJPEG)
+#define IMAGE_DECOMPRESSION_LIBRARY DecompressionTurboJPEG
+#define MAC_GL_DRIVER_HACK 0
 #else 
 #define IMAGE_DECOMPRESSION_LIBRARY DecompressionLibJPEG
 #define MAC_GL_DRIVER_HACK 0
 #endif
 
 
+#if IO_BATCH < DECOMPRESSION_BATCH
+	#error IO_BATCH must be at least DECOMPRESSION_BATCH
+#endif
+
 #if (FALLBACK_ENTRIES == 1) && (HIGHEST_MIP_LEVELS_TO_KEEP == 0)
 	#error FALLBACK_ENTRIES requires HIGHEST_MIP_LEVELS_TO_KEEP >= 1
 #endif
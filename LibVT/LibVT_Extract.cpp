@@ -0,0 +1,286 @@
+/*
+ *  LibVT_Extract.cpp
+ *
+ *
+ *  Page request extraction from the readback buffer.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Extract.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <algorithm>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define VTE_AVX2	1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define VTE_SSE2	1
+#endif
+
+#define kEmptyKey		0xFFFFFFFF	// can't collide with a page key, the mip nibble of a valid key is < 12
+#define kStoreAlphaMask	0xF0000000	// pixels with any other top nibble don't request a page, see MAX_STORES
+
+// the readback buffer is mostly made of large areas with the same page, so the kernel works on runs of identical pixels:
+// a run is decoded and counted once when it ends, SIMD is used to skip over vectors that continue the current run.
+
+static inline bool _vteDecode(const vteParams *p, const uint32_t pixel, uint32_t *pageInfo)
+{
+	if ((pixel & kStoreAlphaMask) != kStoreAlphaMask)	// format: BGRA		mip, x, y, 255 - store
+		return false;
+
+	const uint32_t store = 255 - (pixel >> 24);
+	const vteStoreParams &s = p->stores[store];
+	const uint32_t b1 = pixel & 0xFF, b2 = (pixel >> 8) & 0xFF, b3 = (pixel >> 16) & 0xFF;
+	const uint32_t mip = s.longMipChain ? (b1 & 0x0F) : b1;
+
+	if (mip >= s.mipChainLength)
+		return false;
+
+	const uint32_t shift = p->shiftByMip ? mip : 0;
+	const uint32_t y_coord = s.longMipChain ? ((b2 | ((b1 & 0xC0) << 2)) >> shift) : (b2 >> shift);
+	const uint32_t x_coord = s.longMipChain ? ((b3 | ((b1 & 0x30) << 4)) >> shift) : (b3 >> shift);
+	const uint32_t dim = s.virtTexDimensionPages >> mip;
+
+	if ((x_coord >= dim) || (y_coord >= dim))
+		return false;
+
+	*pageInfo = s.longMipChain ? ((x_coord << 20) + (y_coord << 8) + (store << 4) + mip) : ((x_coord << 16) + (y_coord << 8) + (store << 4) + mip);
+
+	return true;
+}
+
+static inline void _vteAdd(vteTable *t, const uint32_t pageInfo, const uint32_t count)
+{
+	uint32_t slot = (pageInfo * 0x9E3779B1u) >> t->shift;
+
+	while (1)
+	{
+		const uint32_t key = t->keys[slot];
+
+		if (key == pageInfo)
+		{
+			t->pages[t->slotOfPage[slot]].count += count;
+			return;
+		}
+		if (key == kEmptyKey)
+			break;
+
+		slot = (slot + 1) & t->mask;
+	}
+
+	assert(t->pageCount < t->maxPages);
+
+	t->keys[slot] = pageInfo;
+	t->slotOfPage[slot] = t->pageCount;
+	t->usedSlots[t->pageCount] = slot;
+	t->pages[t->pageCount].pageInfo = pageInfo;
+	t->pages[t->pageCount].count = count;
+	t->pageCount++;
+}
+
+static inline void _vteFlushRun(const vteParams *p, vteTable *t, const uint32_t pixel, const uint32_t run)
+{
+	uint32_t pageInfo;
+
+	if (run && _vteDecode(p, pixel, &pageInfo))
+		_vteAdd(t, pageInfo, run);
+}
+
+static void _vteReset(vteTable *t)
+{
+	for (uint32_t i = 0; i < t->pageCount; i++) // pages can't be used to find the keys, _vtApplyPageList() compacts them in place
+		t->keys[t->usedSlots[i]] = kEmptyKey;
+
+	t->pageCount = 0;
+}
+
+bool vteInitTable(vteTable *t, uint32_t maxPages)
+{
+	uint32_t bits = 4;
+
+	while ((1u << bits) < maxPages * 2) // keep the load factor <= 0.5
+		bits++;
+
+	t->maxPages = maxPages;
+	t->pageCount = 0;
+	t->mask = (1u << bits) - 1;
+	t->shift = 32 - bits;
+	t->keys = (uint32_t *) malloc((1u << bits) * sizeof(uint32_t));
+	t->slotOfPage = (uint32_t *) malloc((1u << bits) * sizeof(uint32_t));
+	t->usedSlots = (uint32_t *) malloc(maxPages * sizeof(uint32_t));
+	t->pages = (vtePageCount *) malloc(maxPages * sizeof(vtePageCount));
+
+	if (!t->keys || !t->slotOfPage || !t->usedSlots || !t->pages)
+	{
+		vteFreeTable(t);
+		return false;
+	}
+
+	for (uint32_t i = 0; i <= t->mask; i++)
+		t->keys[i] = kEmptyKey;
+
+	return true;
+}
+
+void vteFreeTable(vteTable *t)
+{
+	free(t->keys);
+	free(t->slotOfPage);
+	free(t->usedSlots);
+	free(t->pages);
+
+	t->keys = t->slotOfPage = t->usedSlots = NULL;
+	t->pages = NULL;
+	t->pageCount = t->maxPages = 0;
+}
+
+uint32_t vteExtractPagesScalar(const vteParams *p, const uint32_t *buffer, vteTable *t)
+{
+	const uint32_t n = p->w * p->h;
+	uint32_t last = 0, run = 0;	// 0 has alpha 0 so it is never decoded
+
+	_vteReset(t);
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		const uint32_t pixel = buffer[i];
+
+		if (pixel == last)
+			run++;
+		else
+		{
+			_vteFlushRun(p, t, last, run);
+			last = pixel;
+			run = 1;
+		}
+	}
+	_vteFlushRun(p, t, last, run);
+
+	return t->pageCount;
+}
+
+uint32_t vteExtractPages(const vteParams *p, const uint32_t *buffer, vteTable *t)
+{
+#if VTE_AVX2 || VTE_SSE2
+	const uint32_t n = p->w * p->h;
+	uint32_t last = 0, run = 0, i = 0;
+
+	_vteReset(t);
+
+#if VTE_AVX2
+	const uint32_t lanes = 8;
+	const __m256i alphaMask = _mm256_set1_epi32((int) kStoreAlphaMask);
+
+	for (; i + lanes <= n; i += lanes)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i *) (buffer + i));
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(v, _mm256_set1_epi32((int) last))) == -1)
+		{
+			run += lanes;		// the whole vector continues the current run
+			continue;
+		}
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(v, alphaMask), alphaMask)) == 0)
+		{
+			_vteFlushRun(p, t, last, run);
+			last = buffer[i + lanes - 1];	// nothing in here requests a page, just carry the last pixel over as the current (invalid) run
+			run = 0;
+			continue;
+		}
+#else
+	const uint32_t lanes = 4;
+	const __m128i alphaMask = _mm_set1_epi32((int) kStoreAlphaMask);
+
+	for (; i + lanes <= n; i += lanes)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *) (buffer + i));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, _mm_set1_epi32((int) last))) == 0xFFFF)
+		{
+			run += lanes;		// the whole vector continues the current run
+			continue;
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, alphaMask), alphaMask)) == 0)
+		{
+			_vteFlushRun(p, t, last, run);
+			last = buffer[i + lanes - 1];	// nothing in here requests a page, just carry the last pixel over as the current (invalid) run
+			run = 0;
+			continue;
+		}
+#endif
+
+		for (uint32_t j = i; j < i + lanes; j++)
+		{
+			const uint32_t pixel = buffer[j];
+
+			if (pixel == last)
+				run++;
+			else
+			{
+				_vteFlushRun(p, t, last, run);
+				last = pixel;
+				run = 1;
+			}
+		}
+	}
+
+	for (; i < n; i++)
+	{
+		const uint32_t pixel = buffer[i];
+
+		if (pixel == last)
+			run++;
+		else
+		{
+			_vteFlushRun(p, t, last, run);
+			last = pixel;
+			run = 1;
+		}
+	}
+	_vteFlushRun(p, t, last, run);
+
+	return t->pageCount;
+#else
+	return vteExtractPagesScalar(p, buffer, t);
+#endif
+}
+
+static bool _vteMorePriority(const vtePageCount &a, const vtePageCount &b)
+{
+	const uint8_t mipA = (uint8_t) (a.pageInfo & 0x0F), mipB = (uint8_t) (b.pageInfo & 0x0F); // the mip is the low nibble of the page key
+
+	if (mipA != mipB)
+		return mipA > mipB;
+
+	if (a.count != b.count)
+		return a.count > b.count;
+
+	return a.pageInfo < b.pageInfo;
+}
+
+void vteSortPagesByPriority(vtePageCount *pages, uint32_t count)
+{
+	std::sort(pages, pages + count, _vteMorePriority); // introsort works in place, no allocation
+}
+
+const char *vteKernelName()
+{
+#if VTE_AVX2
+	return "AVX2";
+#elif VTE_SSE2
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
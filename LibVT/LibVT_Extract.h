@@ -0,0 +1,81 @@
+/*
+ *  LibVT_Extract.h
+ *
+ *
+ *  Page request extraction from the readback buffer.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+// this header must stay free of GL and OSG includes so the kernel can be built into tools that run without a GPU
+
+#ifndef LIBVT_EXTRACT_H
+#define LIBVT_EXTRACT_H
+
+#include <stdint.h>
+
+#define MAX_STORES					16		// the readback shader writes 255 - store into the alpha channel, page keys keep the store above the mip in their low byte
+
+struct vteStoreParams
+{
+	uint32_t	virtTexDimensionPages;
+	uint8_t		mipChainLength;			// 0 for unused stores, their pixels are ignored
+	bool		longMipChain;
+};
+
+struct vteParams
+{
+	uint32_t	w, h;					// dimensions of the readback buffer in pixels, rows are tightly packed
+	bool		shiftByMip;				// coordinates in the buffer are at mip 0 resolution and must be shifted down (USE_MIPCALC_TEXTURE == 0)
+	vteStoreParams	stores[MAX_STORES];
+};
+
+struct vtePageCount
+{
+	uint32_t	pageInfo;				// same encoding as MAKE_PAGE_INFO()
+	uint32_t	count;					// number of pixels that requested this page
+};
+
+struct vteTable
+{
+	uint32_t		*keys;				// open addressing hash table of page keys, kEmptyKey marks an unused slot
+	uint32_t		*slotOfPage;		// index into pages for every used slot
+	uint32_t		*usedSlots;			// the used slots in order of discovery, so the table can be cleared in O(pageCount)
+	vtePageCount	*pages;				// the unique pages found by the last extraction, in order of discovery. callers may sort or overwrite them
+	uint32_t		pageCount, maxPages;
+	uint32_t		mask, shift;
+};
+
+/*!
+ * @fn vteInitTable(vteTable *table, uint32_t maxPages)
+ * @brief Allocates a table that can hold maxPages unique pages. This is the only allocation, extraction itself never allocates.
+ * @param[in] maxPages	Upper bound of unique pages per frame, min(buffer pixels, virtual texture pages) can never overflow.
+ */
+bool		vteInitTable(vteTable *table, uint32_t maxPages);
+void		vteFreeTable(vteTable *table);
+
+/*!
+ * @fn vteExtractPages(const vteParams *params, const uint32_t *buffer, vteTable *table)
+ * @brief Decodes the BGRA readback buffer and collects every valid page once together with its pixel coverage.
+ * @return The number of unique pages, stored in table->pages.
+ * @note Uses AVX2 or SSE2 to skip runs of identical pixels if the compiler targets them, vteExtractPagesScalar() otherwise.
+ */
+uint32_t	vteExtractPages(const vteParams *params, const uint32_t *buffer, vteTable *table);
+uint32_t	vteExtractPagesScalar(const vteParams *params, const uint32_t *buffer, vteTable *table);
+
+/*!
+ * @fn vteSortPagesByPriority(vtePageCount *pages, uint32_t count)
+ * @brief Sorts pages in place into loading order: coarse mips first so every region gets some texture quickly, then by descending pixel coverage. Ties are broken by page key so the order is deterministic.
+ */
+void		vteSortPagesByPriority(vtePageCount *pages, uint32_t count);
+
+const char *vteKernelName();
+
+#endif
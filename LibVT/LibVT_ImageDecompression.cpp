@@ -31,7 +31,8 @@ void * _vtuDecompressMac(CGImageSourceRef imageSourceRef, uint32_t *pic_size, co
 	size_t height = CGImageGetHeight(imageRef);
 	CGRect rect = {{0, 0}, {width, height}};
 
-	void *image_data = calloc(width * 4, height);
+	void *image_data = vtpAlloc(width * 4 * height);
+	memset(image_data, 0, width * 4 * height);
 
 	CGContextRef bitmapContext = CGBitmapContextCreate(image_data, width, height, 8, width * 4, CGColorSpaceCreateDeviceRGB(), kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Host );
 	CGContextTranslateCTM (bitmapContext, 0, height);
@@ -130,7 +131,7 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 	else
 		assert((ilGetInteger(IL_IMAGE_WIDTH) == *pic_size) && (ilGetInteger(IL_IMAGE_HEIGHT) == *pic_size));
 
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 	memcpy(image_data, data, c.pageMemsize);
 	ilDeleteImages(1, &ilName);
 
@@ -166,7 +167,7 @@ void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint3
 	else
 		assert((ilGetInteger(IL_IMAGE_WIDTH) == *pic_size) && (ilGetInteger(IL_IMAGE_HEIGHT) == *pic_size));
 
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 	memcpy(image_data, data, c.pageMemsize);
 	ilDeleteImages(1, &ilName);
 
@@ -191,7 +192,7 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 
 	strcpy(image_info->filename, imagePath);
 	MC::Image *image = ReadImage(image_info, exception);
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 
 	assert(image);
 
@@ -218,7 +219,7 @@ void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint3
 
 	MC::ImageInfo *image_info = CloneImageInfo((MC::ImageInfo *) NULL);
 	MC::Image *image = BlobToImage(image_info, file_data, file_size, exception);
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 
 	assert(image);
 
@@ -257,7 +258,7 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 
 	assert(cinfo.output_components == 3);
 
-	char *image_data = (char *)malloc(cinfo.output_width * cinfo.output_width * 3);
+	char *image_data = (char *)vtpAlloc(cinfo.output_width * cinfo.output_width * 3);
 	char *rows[cinfo.output_width];
 	
 	for (uint16_t i = 0; i < cinfo.output_width; i++)
@@ -331,7 +332,7 @@ void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint3
 {
 	struct jpeg_decompress_struct cinfo;
 	struct jpeg_error_mgr jerr;
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 	char *rows[c.pageDimension];
 
 
@@ -391,7 +392,7 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 	png_structp png_ptr;
 	png_infop info_ptr;
 	FILE *f = fopen(imagePath, "rb");
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 	char *rows[c.pageDimension];
 
 	assert(f);
@@ -429,7 +430,7 @@ void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint3
 {
 	png_structp png_ptr;
 	png_infop info_ptr;
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 	char *rows[c.pageDimension];
 
 
@@ -484,7 +485,7 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 	else
 		assert(((uint32_t)width == *pic_size) && ((uint32_t)height == *pic_size));
 
-	char *image_data = (char *)malloc(c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(c.pageMemsize);
 	for (uint16_t i = 0; i < c.pageDimension; i++)
 		memcpy(image_data + i * c.pageDimension * 3, data + (c.pageDimension-i-1) * c.pageDimension * 3, c.pageDimension * 3); //TODO: this isn't performance optimal
 
@@ -506,7 +507,7 @@ void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint3
 	else
                 assert(((uint32_t)width == *pic_size) && ((uint32_t)height == *pic_size));
 
-        char *image_data = (char *)malloc(c.pageMemsize);
+        char *image_data = (char *)vtpAlloc(c.pageMemsize);
         for (uint16_t i = 0; i < c.pageDimension; i++)
                 memcpy(image_data + i * c.pageDimension * 3, data + (c.pageDimension-i-1) * c.pageDimension * 3, c.pageDimension * 3); //TODO: this isn't performance optimal
 
@@ -533,7 +534,11 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 	else
 		assert((width == *pic_size) && (height == *pic_size));
 
-	return data;
+	void *image_data = vtpAlloc(width * height * 3); // stbi allocates with malloc, pages must come from the pool
+	memcpy(image_data, data, width * height * 3);
+	free(data);
+
+	return image_data;
 }
 
 void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint32_t *pic_size)
@@ -549,7 +554,11 @@ void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint3
 	else
 		assert((width == *pic_size) && (height == *pic_size));
 
-	return data;
+	void *image_data = vtpAlloc(width * height * 3); // stbi allocates with malloc, pages must come from the pool
+	memcpy(image_data, data, width * height * 3);
+	free(data);
+
+	return image_data;
 }
 #elif IMAGE_DECOMPRESSION_LIBRARY == DecompressionLibJPEGTurbo
 #include "libjpeg-turbo/jpeglib.h"
@@ -610,7 +619,7 @@ void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint3
 	struct jpeg_decompress_struct cinfo;
 	struct jpeg_error_mgr jerr;
 
-	char *image_data = (char *)malloc(REALTIME_DXT_COMPRESSION ? c.pageDimension * c.pageDimension * 4 : c.pageMemsize);
+	char *image_data = (char *)vtpAlloc(REALTIME_DXT_COMPRESSION ? c.pageDimension * c.pageDimension * 4 : c.pageMemsize);
 	char *rows[c.pageDimension];
 
 
@@ -670,7 +679,7 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 	
 	assert((cinfo.output_width == *pic_size) && (cinfo.output_height == *pic_size));
 
-	char *image_data = (char *)malloc(cinfo.output_width * cinfo.output_width * (REALTIME_DXT_COMPRESSION ? 4 : 3));
+	char *image_data = (char *)vtpAlloc(cinfo.output_width * cinfo.output_width * (REALTIME_DXT_COMPRESSION ? 4 : 3));
 	char *rows[cinfo.output_width];
 	
 	if (cinfo.output_components == (REALTIME_DXT_COMPRESSION ? 4 : 3))
@@ -695,6 +704,120 @@ void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
 
 	return image_data;
 }
+#elif IMAGE_DECOMPRESSION_LIBRARY == DecompressionTurboJPEG
+
+#include <turbojpeg.h>
+
+// a TurboJPEG handle keeps its decoder state between images, so handles are reused instead of being set up for every page.
+// idle handles wait in a free list, so there is one per thread that decompresses and they live until vtShutdown().
+static vector<tjhandle>		_decompressors;
+#if ENABLE_MT
+static OpenThreads::Mutex	_decompressorsMutex;
+#endif
+
+static tjhandle _vtuTakeDecompressor()
+{
+	{	// lock
+		LOCK(_decompressorsMutex)
+
+		if (!_decompressors.empty())
+		{
+			tjhandle handle = _decompressors.back();
+			_decompressors.pop_back();
+			return handle;
+		}
+	}	// unlock
+
+	return tjInitDecompress();
+}
+
+static void _vtuReturnDecompressor(tjhandle handle)
+{
+	LOCK(_decompressorsMutex)
+
+	_decompressors.push_back(handle);
+}
+
+void vtuShutdownDecompression()
+{
+	LOCK(_decompressorsMutex)
+
+	for (uint32_t i = 0; i < _decompressors.size(); i++)
+		tjDestroy(_decompressors[i]);
+	_decompressors.clear();
+}
+
+static void _vtuDownsampleInto(const uint8_t *page, uint8_t *half, uint32_t width, uint32_t height, uint32_t bpp)
+{
+	const uint32_t stride = width * bpp;
+
+	for (uint32_t y = 0; y < height / 2; y++)
+	{
+		const uint8_t *row1 = page + (y * 2) * stride, *row2 = row1 + stride;
+
+		for (uint32_t x = 0; x < width / 2; x++, row1 += bpp * 2, row2 += bpp * 2, half += bpp)
+			for (uint32_t k = 0; k < bpp; k++)
+				half[k] = (uint8_t) ((row1[k] + row1[bpp + k] + row2[k] + row2[bpp + k]) / 4);
+	}
+}
+
+void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint32_t *pic_size)
+{
+	const int pixelFormat = REALTIME_DXT_COMPRESSION ? TJPF_RGBX : TJPF_RGB;
+	unsigned char *jpeg = (unsigned char *) file_data;
+	tjhandle handle = _vtuTakeDecompressor();
+	int width, height, subsampling, colorspace;
+
+	if (!handle)
+	{
+		printf("WARNING: skipping decompressing JPG, TurboJPEG can't create a decompressor: %s\n", tjGetErrorStr());
+		return NULL;
+	}
+
+	if (tjDecompressHeader3(handle, jpeg, file_size, &width, &height, &subsampling, &colorspace) != 0)
+	{
+		printf("WARNING: skipping decompressing corrupt JPG: %s\n", tjGetErrorStr());
+		_vtuReturnDecompressor(handle);
+		return NULL;
+	}
+
+	if (*pic_size == 0)
+		*pic_size = width;
+	else
+		assert(((uint32_t) width == *pic_size) && ((uint32_t) height == *pic_size));
+
+	// decode straight into the page buffer, bottom up because page rows are stored in OpenGL order
+	const uint32_t pageSize = width * height * tjPixelSize[pixelFormat];
+	uint8_t *image_data = (uint8_t *) vtpAlloc(DECODED_HALF_PAGES ? pageSize + pageSize / 4 : pageSize);
+	assert(image_data);
+
+	if (tjDecompress2(handle, jpeg, file_size, image_data, width, 0, height, pixelFormat, TJFLAG_BOTTOMUP) != 0)
+	{
+		printf("WARNING: skipping decompressing JPG: %s\n", tjGetErrorStr());
+		_vtuReturnDecompressor(handle);
+		vtpFree(image_data);
+		return NULL;
+	}
+
+	_vtuReturnDecompressor(handle);
+
+	if (DECODED_HALF_PAGES) // the half resolution level for the mipped physical texture, box filtered from the decoded page which takes less than half the time of a second scaled decode
+		_vtuDownsampleInto(image_data, image_data + pageSize, width, height, tjPixelSize[pixelFormat]);
+
+	return image_data;
+}
+
+void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size)
+{
+	uint32_t file_size = 0;
+	void *file_data = vtuLoadFile(imagePath, 0, &file_size);
+	void *image_data = vtuDecompressImageBuffer(file_data, file_size, pic_size);
+
+	vtpFree(file_data);
+
+	return image_data;
+}
+
 #else
 	#error NO_IMAGE_DECOMPRESSION_LIBRARY
 #endif
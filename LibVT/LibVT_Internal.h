@@ -16,6 +16,7 @@ You should have received a copy of the GNU Lesser General Public License along w
 */
 
 #include "LibVT_Config.h"
+#include "LibVT_Extract.h"
 
 
 #include <time.h>
@@ -124,6 +125,18 @@ class LibVTBackgroundThread : public OpenThreads::Thread {
 class LibVTBackgroundThread2 : public OpenThreads::Thread {
     virtual void run();
 
+};
+class LibVTFeedbackThread : public OpenThreads::Thread {
+    virtual void run();
+
+};
+class LibVTWarmupThread : public OpenThreads::Thread {
+    virtual void run();
+
+};
+class LibVTReadaheadThread : public OpenThreads::Thread {
+    virtual void run();
+
 };
 enum {
 	kCustomReadback = 1,
@@ -139,10 +152,16 @@ enum {
 	kTableMapped = 0xFF
 };
 
+enum {	// vtStore::loadGenerations, request generations start above these
+	kLoadIdle = 0,
+	kLoadUnwanted = 1
+};
+
 #define MIPPED_PHYSTEX				(VT_MIN_FILTER == GL_NEAREST_MIPMAP_NEAREST || \
 									VT_MIN_FILTER == GL_LINEAR_MIPMAP_NEAREST || \
 									VT_MIN_FILTER == GL_NEAREST_MIPMAP_LINEAR || \
 									VT_MIN_FILTER == GL_LINEAR_MIPMAP_LINEAR)
+#define DECODED_HALF_PAGES			(MIPPED_PHYSTEX && (IMAGE_DECOMPRESSION_LIBRARY == DecompressionTurboJPEG))	// page buffers carry their half resolution level after c.pageMemsize bytes
 #define READBACK_MODE_NONE			(READBACK_MODE == kCustomReadback)
 #define READBACK_MODE_FBO			(READBACK_MODE >= kFBOReadPixels)
 #define READBACK_MODE_BACKBUFFER	((READBACK_MODE < kFBOReadPixels) && (!READBACK_MODE_NONE))
@@ -157,6 +176,7 @@ enum {
 #define DecompressionSTBIPNG 5
 #define DecompressionLibJPEG 8
 #define DecompressionLibJPEGTurbo 9
+#define DecompressionTurboJPEG 10
 #define DecompressionSTBIJPEG 11
 #define DecompressionMac 16
 #define DecompressionDevil 17
@@ -180,16 +200,25 @@ enum {
 */
 
 
-#define MAKE_PAGE_INFO(m, x, y) ((c.longMipChain) ? ((x << 20) + (y << 8) + m) : ((x << 16) + (y << 8) + m))
-#define EXTRACT_Y(page)		((c.longMipChain) ? ((uint16_t) ((((uint32_t) (page)) >> 8) & 0xFFF)) : (BYTE2(page)))
-#define EXTRACT_X(page)	((c.longMipChain) ? ((uint16_t) ((((uint32_t) (page)) >> 20) & 0xFFF)) : (BYTE3(page)))
+// page keys carry the store in the high nibble of the low byte and the mip in the low nibble, the layout of x and y depends on the mip chain of the store
+#define STORE(s)					(vt.stores[(s)])
+#define EXTRACT_STORE(page)			((uint8_t) (BYTE1(page) >> 4))
+#define EXTRACT_MIP(page)			((uint8_t) (BYTE1(page) & 0x0F))
+#define PAGE_STORE(page)			STORE(EXTRACT_STORE(page))
+
+#define MAKE_PAGE_INFO(s, m, x, y)	((STORE(s).longMipChain) ? (((x) << 20) + ((y) << 8) + ((s) << 4) + (m)) : (((x) << 16) + ((y) << 8) + ((s) << 4) + (m)))
+#define EXTRACT_Y(page)		((PAGE_STORE(page).longMipChain) ? ((uint16_t) ((((uint32_t) (page)) >> 8) & 0xFFF)) : (BYTE2(page)))
+#define EXTRACT_X(page)	((PAGE_STORE(page).longMipChain) ? ((uint16_t) ((((uint32_t) (page)) >> 20) & 0xFFF)) : (BYTE3(page)))
 
 
 
-#define PAGE_TABLE(m, x, y)			(vt.pageTables[(m)][(y) * (c.virtTexDimensionPages >> (m)) + (x)])
-#define EXTRACT_MIP(page)			(BYTE1(page))
+#define PAGE_TABLE(s, m, x, y)		(STORE(s).pageTables[(m)][(y) * (STORE(s).virtTexDimensionPages >> (m)) + (x)])
+#define PAGE_INDEX(s, m, x, y)		(STORE(s).pageTableMipOffsets[(m)] + (y) * (STORE(s).virtTexDimensionPages >> (m)) + (x))	// position of a page in all mip levels of the page table of its store, for per page arrays
+#define LOAD_GENERATION(page)		(PAGE_STORE(page).loadGenerations[PAGE_INDEX(EXTRACT_STORE(page), EXTRACT_MIP(page), EXTRACT_X(page), EXTRACT_Y(page))])
+// false for keys that outlived their store, e.g. feedback submitted before vtRemoveStore() for an id that vtAddStore() has reused since
+#define PAGE_IN_STORE(page)			(PAGE_STORE(page).active && (EXTRACT_MIP(page) < PAGE_STORE(page).mipChainLength) && (EXTRACT_X(page) < (PAGE_STORE(page).virtTexDimensionPages >> EXTRACT_MIP(page))) && (EXTRACT_Y(page) < (PAGE_STORE(page).virtTexDimensionPages >> EXTRACT_MIP(page))))
 
-#define MIP_INFO(mip)		((c.longMipChain) ? (c.mipChainLength - 1 - mip) :(vt.mipTranslation[mip]))
+#define MIP_INFO(s, mip)		((STORE(s).longMipChain) ? (STORE(s).mipChainLength - 1 - mip) :(STORE(s).mipTranslation[mip]))
 
 /*
 #if LONG_MIP_CHAIN
@@ -210,76 +239,346 @@ enum {
     #define fast_assert(x)			assert((x))
 #endif
 
-#define touchMipRow(mip, row) {	vt.mipLevelTouched[mip] = true; \
-								vt.mipLevelMinrow[mip] = (vt.mipLevelMinrow[mip] < row) ? vt.mipLevelMinrow[mip] : row; \
-								vt.mipLevelMaxrow[mip] = (vt.mipLevelMaxrow[mip] > row) ? vt.mipLevelMaxrow[mip] : row; }
-
 #define MAX_PHYS_TEX_DIMENSION_PAGES 64
+#define MAX_PHYS_TEX_LAYERS			8		// the layer goes into the bits of the page table x and y bytes above MAX_PHYS_TEX_DIMENSION_PAGES, see SLOT_X()
+
+#define kNoSlot	0xFFFF
+
+enum {
+	kSlotFree = 0,
+	kSlotUsed = 1,
+	kSlotResident = 2
+};
 
 struct storageInfo
 {
-	clock_t		clockUsed;
+	uint32_t	frameUsed;			// vt.thisFrame when the page in this slot was last needed, 0 if the slot is free
 	uint16_t	x, y;
 	uint8_t		mip;
+	uint8_t		store;
+	uint8_t		state;				// kSlotFree slots are on the free list, kSlotUsed slots on the LRU list, kSlotResident slots on neither
+	uint16_t	prev, next;			// list links, slot indices as returned by SLOT_INDEX()
 //	bool		active;
 };
 
+// slot coordinates are the bytes the page table entry stores: the position of the page in its layer of the physical texture, with the 2 low bits of the layer above the x position and the high bit above the y position
+#define SLOT_X(column, layer)		((column) + ((layer) % 4) * MAX_PHYS_TEX_DIMENSION_PAGES)
+#define SLOT_Y(row, layer)			((row) + ((layer) / 4) * MAX_PHYS_TEX_DIMENSION_PAGES)
+#define SLOT_COLUMN(x)				((x) % MAX_PHYS_TEX_DIMENSION_PAGES)
+#define SLOT_ROW(y)					((y) % MAX_PHYS_TEX_DIMENSION_PAGES)
+#define SLOT_LAYER(x, y)			((x) / MAX_PHYS_TEX_DIMENSION_PAGES + ((y) / MAX_PHYS_TEX_DIMENSION_PAGES) * 4)
+#define SLOT_VALID(x, y)			((SLOT_COLUMN(x) < c.physTexDimensionPages) && (SLOT_ROW(y) < c.physTexDimensionPages) && (SLOT_LAYER(x, y) < c.physTexLayers))
+
+#if GL_ES_VERSION_2_0
+	#define PHYS_TEX_TARGET			GL_TEXTURE_2D		// no texture arrays, c.physTexLayers is always 1
+#else
+	#define PHYS_TEX_TARGET			((c.physTexLayers > 1) ? GL_TEXTURE_2D_ARRAY_EXT : GL_TEXTURE_2D)
+#endif
+
+#define SLOT_INDEX(x, y)			((uint16_t)(((y) / MAX_PHYS_TEX_DIMENSION_PAGES) * 256 * MAX_PHYS_TEX_DIMENSION_PAGES + (x) * MAX_PHYS_TEX_DIMENSION_PAGES + SLOT_ROW(y)))
+#define SLOT_INFO(s)				(vt.textureStorageInfo[(s)])
+#define STORAGE_INFO(x, y)			SLOT_INFO(SLOT_INDEX(x, y))
+
+struct vtCacheEntry
+{
+	uint32_t		pageInfo;
+	uint32_t		pinCount;		// > 0 while the render thread is uploading the page, pinned pages are not evicted
+	void			*data;
+	vtCacheEntry	*hashNext;
+	vtCacheEntry	*lruPrev, *lruNext;
+};
+
+struct vtCacheShard
+{
+	vtCacheEntry	**buckets;
+	uint32_t		bucketMask;
+	uint32_t		count, maxCount;
+	uint64_t		bytes, maxBytes, evictions;
+	vtCacheEntry	lru;			// sentinel, lru.lruNext is the most recently used entry, lru.lruPrev the least recently used one
+#if ENABLE_MT
+	OpenThreads::Mutex	mutex;
+#endif
+};
+
+struct vtDirtyRect
+{
+	uint16_t	x0, y0, x1, y1;	// inclusive, in page table entries
+};
+
+struct vtCompressedPage
+{
+	uint32_t	pageInfo;
+	uint32_t	size;
+	void		*data;
+};
+
+struct vtPrefetchVertex
+{
+	float		position[3];
+	float		texcoord[2];
+};
+
+enum {
+	kFeedbackFree = 0,
+	kFeedbackSubmitted = 1,
+	kFeedbackProcessing = 2,
+	kFeedbackDone = 3
+};
+
+struct vtFeedbackSlot
+{
+	uint32_t	*buffer;			// copy of the readback buffer
+	vteParams	params;				// snapshot of the buffer layout at submission
+	vteTable	table;				// the unique pages, sorted by priority once processed
+	uint32_t	uniquePages, frame;
+	uint8_t		state;
+};
+
+#define VT_BUFFER_POOLS				11			// power of two size classes from VT_BUFFER_POOL_MIN to 1MB, bigger buffers are malloc()ed
+#define VT_BUFFER_POOL_MIN			1024
+
+struct vtPoolStats
+{
+	uint32_t	blockSize;			// 0 for the combined buffer pools
+	uint32_t	blocksAllocated;	// blocks carved out of slabs so far, slabs are never returned before vtShutdown()
+	uint32_t	blocksInUse, blocksHighWater;
+	uint64_t	bytesHighWater;
+	uint64_t	hits, misses;		// allocations served from the free list / that had to allocate a new slab
+};
+
+struct vtPool
+{
+	void			*freeList;
+	vector<uint8_t *>	slabs;
+	vtPoolStats		stats;
+#if ENABLE_MT
+	OpenThreads::Mutex	mutex;
+#endif
+};
+
+#define VT_CAPTURE_MAGIC			"LVTC"
+#define VT_CAPTURE_VERSION			1
+
+struct vtCaptureHeader						// followed by tileDirLength characters of the tile directory
+{
+	char		magic[4];
+	uint32_t	version;
+	uint32_t	pageDimension, physTexSize;
+	uint8_t		pageBorder, mipChainLength, physTexLayers, reserved;	// physTexLayers is 0 in captures from before the layered physical texture
+	char		codec[8];
+	uint32_t	tileDirLength;
+};
+
+struct vtCaptureFrame						// followed by w * h BGRA pixels, the buffer passed to vtExtractNeededPages()
+{
+	uint32_t	frame;
+	uint32_t	w, h, real_w, real_h;
+	uint32_t	reserved;
+	double		time;						// seconds since vtStartCapture()
+	double		view[16], projection[16];	// column major like osg::Matrixd::ptr()
+};
+
+struct vtStats
+{
+	uint32_t	frame;							// vt.thisFrame
+	uint16_t	necessaryPageCount, newPageCount, missingPageCount;	// of the last frame
+	uint32_t	cachedRequestCount, diskRequestCount;				// of the last applied feedback
+	uint32_t	neededQueueDepth;				// pages waiting to be read from disk
+	uint32_t	compressedQueueDepth;			// pages read but waiting to be decompressed, always 0 unless ENABLE_MT is 2
+	uint32_t	newQueueDepth;					// pages in the RAM cache waiting for vtMapNewPages()
+	uint32_t	prefetchQueueDepth;				// pages from vtPrefetch() waiting for the loading thread to be idle
+	uint32_t	cachedPages, maxCachedPages;
+	uint64_t	cachedBytes;
+	uint32_t	compressedCachedPages;			// tile files in the compressed cache, see MAX_COMPRESSED_RAMCACHE_MB
+	uint64_t	compressedCachedBytes;
+	uint64_t	cacheEvictions;					// the counters from here on are totals since vtInit()
+	uint64_t	compressedCacheHits;			// pages decompressed from the compressed cache instead of being read from disk
+	uint64_t	pageCacheHits;					// pages copied from the persistent page cache instead of being read and decompressed
+	uint64_t	pagesPrefetched;				// pages loaded into the RAM cache for vtPrefetch()
+	uint64_t	pagesCancelled;					// requests dropped by the loading thread because the page left the working set before it was read
+	uint64_t	pagesRead, diskBytesRead;
+	uint64_t	pagesDecompressed;
+	double		decompressionSeconds;			// summed over all decompression threads
+	double		uploadSeconds;					// spent in the last vtMapNewPages()
+	uint32_t	uploadBytes;					// page and page table data sent to the GPU by the last vtMapNewPages()
+	float		bias;
+};
+
+#define VT_ARCHIVE_FILENAME			"tiles.vta"
+#define VT_ARCHIVE_MAGIC			"LVTA"
+#define VT_ARCHIVE_VERSION			1
+
+struct vtArchiveHeader
+{
+	char		magic[4];
+	uint32_t	version;
+	uint32_t	pageDimension;
+	uint8_t		pageBorder, mipChainLength, reserved[2];
+	char		codec[4];
+	uint32_t	indexCount;
+	uint64_t	indexOffset;
+};
+
+struct vtArchiveEntry
+{
+	uint64_t	offset;
+	uint32_t	length;
+	uint32_t	reserved;
+};
+
+#define VT_PAGECACHE_MAGIC			"LVPC"
+#define VT_PAGECACHE_VERSION		2
+
+struct vtPageCacheHeader
+{
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	identity;			// hash of the tile store path, its modification times and the page format, also the file name
+	uint32_t	slotSize, slotCount, usedSlots;
+	uint32_t	indexCount;
+	uint32_t	dirty;				// set while the file is mapped, a file still marked dirty when opened wasn't closed properly and its index can't be trusted
+	uint64_t	indexOffset, slotsOffset;
+};
+
 struct vtConfig // TODO: constify?
 {
     uint32_t		pageDimension;
 
-    string			tileDir, pageCodec;
+    string			pageCodec;			// shared by all stores, they decode into the same physical texture
+    string			pageCacheDir;		// set by vtSetPageCacheDirectory(), empty if there is no persistent page cache
 
-    uint8_t			pageBorder, mipChainLength;
+    uint8_t			pageBorder;
 
     // derived values:
-    uint32_t		pageMemsize, maxCachedPages, physTexDimensionPages, virtTexDimensionPages, residentPages,phys_tex_size;
+    uint32_t		pageMemsize, maxCachedPages, physTexDimensionPages, residentPages,phys_tex_size;	// residentPages is per store
+    uint8_t			physTexLayers;		// 1 for a plain 2D physical texture, else the depth of the 2D texture array
     GLenum			pageDataFormat, pageDataType, pageDXTCompression;
-    bool longMipChain;
+    uint8_t			decompressionThreads;
+    uint8_t			requestedPhysTexLayers;	// set by vtSetPhysicalTextureLayers(), 0 means PHYS_TEX_LAYERS
+    float			targetOccupancy;	// set by vtSetTargetOccupancy(), 0 means DYNAMIC_LOD_TARGET_OCCUPANCY
 };
 
-struct vtData
+// a tile store with its own virtual texture and page table. all stores share the physical texture, the slots and the caches, see MAKE_PAGE_INFO() for how their pages are told apart
+struct vtStore
 {
-    bool memValid;
+	string					tileDir;			// empty if the store id is unused, vtRemoveStore() frees it once no thread holds a page of the store anymore
+	bool					active;				// false once vtRemoveStore() has been called
+	bool					longMipChain;
+	uint8_t					mipChainLength;
+	uint32_t				virtTexDimensionPages;
 	uint16_t				mipTranslation[12];
 	uint32_t				pageTableMipOffsets[12];
-	GLuint					fbo, fboColorTexture, fboDepthTexture, physicalTexture, pageTableTexture, mipcalcTexture, pboReadback, pboPagetable, pboPhystex;
-
+	uint32_t				**pageTables;
+	uint32_t				*loadGenerations;	// per page in PAGE_INDEX() order: kLoadIdle, kLoadUnwanted while a loading thread owns it but nobody needs it (prefetched or cancelled), else the requestGeneration that last asked for it. guarded by neededPagesMutex
+	uint32_t				loadCount;			// pages of this store owned by a loading, warm-up or readahead thread. guarded by neededPagesMutex
+	GLuint					pageTableTexture, mipcalcTexture;
+	vtDirtyRect				pageTableDirty[12][PAGETABLE_DIRTY_RECTS];	// page table entries changed since the last upload
+	uint8_t					pageTableDirtyCount[12];
+	const uint8_t			*archiveData;		// non-NULL if the page store is a memory mapped tile archive
+	uint64_t				archiveSize;
+	const vtArchiveEntry	*archiveIndex;
+	uint8_t					archiveMipChainLength;
+	uint8_t					*pageCacheData;		// non-NULL if the persistent page cache file is mapped
+	uint64_t				pageCacheSize;
+	vtPageCacheHeader		*pageCacheHeader;
+	uint32_t				*pageCacheIndex;
+#ifdef WIN32
+	void					*pageCacheFile;		// kept open while mapped, its lock keeps other processes out of the file
+#else
+	int						pageCacheFile;
+#endif
+	uint8_t					*pageExistence;		// one bit per page in PAGE_INDEX() order, set if the page is present in the store
+	uint64_t				newestTileTime;		// the newest modification time of the tile files seen by vtuInitPageExistence(), 0 for archives or without a page cache
+	vector<vtPrefetchVertex>	prefetchVertices;	// the proxy mesh from vtSetPrefetchGeometry(). guarded by prefetchMutex
+	vector<uint32_t>		prefetchIndices;
+};
 
-	bool					mipLevelTouched[12];
-	uint16_t				mipLevelMinrow[12];
-	uint16_t				mipLevelMaxrow[12];
-	storageInfo				textureStorageInfo[MAX_PHYS_TEX_DIMENSION_PAGES][MAX_PHYS_TEX_DIMENSION_PAGES];	// yes allocating this to the max size is a memory waste - it consumes 50k - but a vector of vectors is 1 magnitude slower
+struct vtData
+{
+    bool memValid;
+	uint8_t					storeCount;			// stores[] below storeCount have been used since vtInit(), check vtStore::active
+	GLuint					fbo, fboColorTexture, fboDepthTexture, physicalTexture, pboReadback;
+	GLuint					uploadRing[UPLOAD_RING_BUFFERS];	// pixel buffer objects for USE_PBO_PHYSTEX / USE_PBO_PAGETABLE, used round robin once per vtMapNewPages()
+	uint32_t				uploadRingSize;
+	uint8_t					uploadRingNext;
+	uint32_t				*pageTableStaging;	// packs dirty rectangles for uploading if USE_PBO_PAGETABLE is off
+	storageInfo				textureStorageInfo[MAX_PHYS_TEX_LAYERS * MAX_PHYS_TEX_DIMENSION_PAGES * MAX_PHYS_TEX_DIMENSION_PAGES];	// indexed by SLOT_INDEX(). yes allocating this to the max size is a memory waste - it consumes 512k - but a vector of vectors is 1 magnitude slower
 
 	uint16_t				necessaryPageCount, newPageCount, missingPageCount;
+	uint32_t				cachedRequestCount, diskRequestCount;	// requests of the last applied feedback that were in the RAM cache / had to go to the loader
+	uint32_t				requestGeneration;	// incremented for every page list that replaces neededPages, starts above kLoadUnwanted. guarded by neededPagesMutex
+	uint64_t				pagesRead, diskBytesRead, pagesDecompressed;	// totals for vtGetStats(), guarded by statsMutex
+	uint64_t				compressedCacheHits;
+	uint64_t				pageCacheHits;
+	uint64_t				pagesPrefetched;
+	uint64_t				pagesCancelled;
+	double					decompressionSeconds;
+	double					uploadSeconds;		// time spent in the last vtMapNewPages()
+	uint32_t				uploadBytes;
 	float					bias;
-	uint32_t				*readbackBuffer, **pageTables;
-	clock_t					thisFrameClock;
+	float					biasIntegral;	// state of the bias controller in vtMapNewPages()
+	uint32_t				*readbackBuffer;
+	uint32_t				thisFrame;		// frame counter, incremented on every readback
+	uint16_t				slotFreeList, slotLRUHead, slotLRUTail;
 	uint32_t				w, h, real_w, real_h;
 	double					projectionMatrix[4][4];
 	double					fovInDegrees;
-	deque<uint32_t>			neededPages;
+	uint32_t				pagePoolBlockSize;	// pools live across vtInit() / vtShutdown() because vtScan() decodes a page before vtInit()
+	vtPool					pools[VT_BUFFER_POOLS + 1];	// pools[0] holds decoded pages, the others compressed and temporary buffers
+	FILE					*captureFile;		// non-NULL between vtStartCapture() and vtStopCapture()
+	double					captureStartTime;
+	FILE					*traceFile;			// non-NULL between vtStartStatsTrace() and vtStopStatsTrace()
+	vtStats					traceLast;			// the totals of the previous trace row
+	double					cameraView[16], cameraProjection[16];
+	vtStore					stores[MAX_STORES];
+	vteTable				extractTable;		// sized in vtReshape(), used by vtExtractNeededPages() without allocating
+	deque<uint32_t>			neededPages;		// the requests of the last applied feedback that still wait for a loading thread, in vteSortPagesByPriority() order
+	deque<uint32_t>			prefetchPages;		// from vtPrefetch(), most important first, only loaded while neededPages is empty. guarded by neededPagesMutex
+	vector<uint32_t>		wantedLoads;		// pages owned by a loading thread whose load generation was requestGeneration when they were added, the candidates for cancelling. may hold finished pages. guarded by neededPagesMutex
+	vector<uint32_t>		refreshedLoads;		// scratch for _vtApplyPageList(), the wantedLoads of the next generation
 	queue<uint32_t>			newPages;
-	map<uint32_t, void *>	cachedPages;
-	map<uint32_t, clock_t>	cachedPagesAccessTimes;
+	deque<uint32_t>			warmupPages;		// precached in the background by the warm-up thread, coarsest mip first. guarded by warmupMutex
+	uint32_t				warmupPageCount, warmupPagesDone;	// for vtGetWarmupProgress(), since vtInit(). guarded by warmupMutex
+	deque<uint32_t>			readaheadPages;		// tiles the readahead thread hints to the OS, newest last. guarded by readaheadMutex
+	vtCacheShard			cacheShards[RAMCACHE_SHARDS];
+	vtCacheShard			compressedCacheShards[RAMCACHE_SHARDS];	// tile files that have been decompressed, budgeted in bytes
 
 #if ENABLE_MT
         OpenThreads::Condition		neededPagesAvailableCondition;
+	OpenThreads::Condition		loadsFinishedCondition;		// vtRemoveStore() waits on it with neededPagesMutex for the loadCount of the store to drop to 0
         OpenThreads::Mutex			neededPagesMutex;
         OpenThreads::Mutex			newPagesMutex;
-        OpenThreads::Mutex			cachedPagesMutex;
+	OpenThreads::Mutex			statsMutex;
+	OpenThreads::Mutex			pageCacheMutex;
+	OpenThreads::Mutex			pageExistenceMutex;		// serializes vtuMarkPageMissing(), vtuPageExists() reads without it
+	OpenThreads::Mutex			prefetchMutex;
         LibVTBackgroundThread			backgroundThread;
+	LibVTWarmupThread		warmupThread;
+	OpenThreads::Mutex		warmupMutex;
+	OpenThreads::Condition	warmupPagesAvailableCondition;
+	LibVTReadaheadThread	readaheadThread;
+	OpenThreads::Mutex		readaheadMutex;
+	OpenThreads::Condition	readaheadPagesAvailableCondition;
 #endif
 
 #if ENABLE_MT > 1
-         LibVTBackgroundThread2			backgroundThread2;
+	LibVTBackgroundThread2		*decompressionThreads;
+	uint8_t					decompressionThreadCount;
         OpenThreads::Mutex			compressedMutex;
-	queue<uint32_t>			newCompressedPages;
-	map<uint32_t, void *>	compressedPages;
-	map<uint32_t, uint32_t>	compressedPagesSizes;
+	deque<vtCompressedPage>	newCompressedPages;
          OpenThreads::Condition		compressedPagesAvailableCondition;
 #endif
 
+#if ASYNC_FEEDBACK
+	LibVTFeedbackThread		feedbackThread;
+	OpenThreads::Mutex		feedbackMutex;
+	OpenThreads::Condition	feedbackSubmittedCondition, feedbackProcessedCondition;
+	vtFeedbackSlot			feedbackRing[FEEDBACK_RING_SIZE];
+	uint32_t				feedbackSize;		// pixels per buffer in the ring
+	vector<double>			prefetchViews, prefetchProjections;	// the poses of the last vtPrefetch() the feedback thread hasn't taken yet. guarded by feedbackMutex
+	bool					prefetchPosesPending;
+#endif
+
 #if OPENCL_BUFFERREDUCTION
 	cl_context				cl_shared_context;
 	cl_device_id			cl_device;
@@ -298,23 +597,67 @@ void vtLoadNeededPages();
 void vtLoadNeededPagesDecoupled();
 void vtDecompressNeededPagesDecoupled();
 void vtCachePages(queue<uint32_t> pagesToCache);
+void vtWarmupPages(queue<uint32_t> pagesToCache);
+void vtRemoveWarmupPages(const uint8_t store);
+void vtStartWarmupThread();
+void vtStopWarmupThread();
+void vtReadaheadPages(const vector<uint32_t> &pages);
+void vtStartReadaheadThread();
+void vtStopReadaheadThread();
+void vtStartLoadingThreads();
+void vtStopLoadingThreads();
+
+void vtReshapeFeedback(const uint32_t maxPages);
+void vtStartFeedbackThread();
+void vtStopFeedbackThread();
+
+void vtPrefetchPoses(const double *viewMatrices, const double *projectionMatrices, const uint32_t poseCount);
 
 
+void vtcInit();
+void vtcClearCache();
 void vtcRemoveCachedPageLOCK(uint32_t pageInfo);
+void vtcRemoveStorePagesLOCK(const uint8_t store);
 void vtcTouchCachedPage(uint32_t pageInfo);
 void vtcSplitPagelistIntoCachedAndNoncachedLOCK(queue<uint32_t> *s, queue<uint32_t> *cached, queue<uint32_t> *nonCached);
 bool vtcIsPageInCacheLOCK(uint32_t pageInfo);
-void vtcInsertPageIntoCacheLOCK(uint32_t pageInfo, void * image_data);
+bool vtcInsertPageIntoCacheLOCK(uint32_t pageInfo, void * image_data);
 void * vtcRetrieveCachedPageLOCK(uint32_t pageInfo);
-void vtcReduceCacheIfNecessaryLOCK(clock_t currentTime);
-void _vtcRemoveCachedPage(uint32_t pageInfo);
+void vtcReleaseCachedPageLOCK(uint32_t pageInfo);
+bool vtcInsertCompressedPageLOCK(uint32_t pageInfo, void *file_data);
+void * vtcTakeCompressedPageLOCK(uint32_t pageInfo, uint32_t *file_size);
+
+void vtsInit();
+bool vtsAllocateSlot(uint8_t *x, uint8_t *y, bool *wasFree);
+void vtsAssignSlot(uint8_t x, uint8_t y, uint8_t store, uint8_t mip, uint16_t x_coord, uint16_t y_coord);
+void vtsTouchSlot(uint8_t x, uint8_t y);
+void vtsFreeSlot(uint8_t x, uint8_t y);
+
+void vtpInit(uint32_t pageBlockSize);
+void vtpShutdown();
+void * vtpAlloc(uint32_t size);
+void * vtpAllocPage();
+void vtpFree(void *data);
+uint32_t vtpSize(const void *data);
+
+void vtCaptureReadback(const uint32_t *buffer);
+void vtStatsPagesRead(uint32_t count, uint64_t bytes);
+void vtStatsCompressedCacheHits(uint32_t count);
+void vtStatsPageCacheHits(uint32_t count);
+void vtStatsPagesPrefetched(uint32_t count);
+void vtStatsPagesCancelled(uint32_t count);
+void vtStatsPagesDecompressed(uint32_t count, double seconds);
+void vtStatsTraceFrame();
+void vtResetStats();
 
 void vtPrepareOpenCL();
 void vtReshapeOpenCL(const uint16_t _w, const uint16_t _h);
 
 
-void vtUnmapPage(int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location);
-void vtUnmapPageCompleteley(int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location);
+void vtUnmapPage(int store, int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location);
+void vtUnmapPageCompleteley(int store, int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location);
+uint32_t vtPageUploadSize();
+uint32_t vtMaxPageUploadsPerFrame();
 
 
 char		vtuFileExists(char *path);
@@ -322,10 +665,33 @@ void *		vtuLoadFile(const char *filePath, const uint32_t offset, uint32_t *file_
 uint32_t *	vtuDownsampleImageRGBA(const uint32_t *tex);
 uint32_t *	vtuDownsampleImageRGB(const uint32_t *tex);
 void		vtuPerspective(double m[4][4], double fovy, double aspect,	double zNear, double zFar);
+double		vtuTime();
+
+bool		vtuScanTileDirectory(const char *_tileDir, char * _pageExtension, uint8_t *_pageBorder, uint8_t *_mipChainLength, uint32_t *_pageDimension);
+string		vtuTileArchivePath(const char *_tileDir);
+bool		vtuReadTileArchiveHeader(const char *archivePath, vtArchiveHeader *header);
+bool		vtuOpenTileArchive(const uint8_t store, const char *archivePath);
+void		vtuCloseTileArchive(const uint8_t store);
+const void *vtuArchiveTile(const uint8_t store, uint8_t mip, uint16_t x, uint16_t y_disk, uint32_t *size);
+bool		vtuIsArchiveData(const void *data);
+void		vtuInitPageExistence(const uint8_t store);
+void		vtuFreePageExistence(const uint8_t store);
+bool		vtuPageExists(uint32_t pageInfo);
+void		vtuMarkPageMissing(uint32_t pageInfo);
+bool		vtuOpenPageCache(const uint8_t store);
+void		vtuClosePageCache(const uint8_t store);
+void *		vtuLoadCachedPage(uint32_t pageInfo);
+void		vtuStorePageInCache(uint32_t pageInfo, const void *image_data);
+void *		vtuLoadPageFile(uint32_t pageInfo, const uint32_t offset, uint32_t *file_size);
+void		vtuUnloadPageFile(void *file_data);
+void		vtuLoadPageFiles(vtCompressedPage *pages, const uint32_t count, const uint32_t offset);
+void		vtuReadaheadSiblingPages(const vtCompressedPage *pages, const uint32_t count);
+void		vtuAdvisePageFile(const uint32_t pageInfo);
 
 
 
 void * vtuDecompressImageFile(const char *imagePath, uint32_t *pic_size);
 void * vtuDecompressImageBuffer(const void *file_data, uint32_t file_size, uint32_t *pic_size);
+void vtuShutdownDecompression();
 void * vtuCompressRGBA_DXT1(void *rgba);
 void * vtuCompressRGBA_DXT5(void *rgba);
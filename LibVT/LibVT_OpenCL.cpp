@@ -84,9 +84,10 @@ void vtPrepareOpenCL(const GLuint requestTexture)
 	cl_int              numDevices, i;
 	size_t              ret_size;
 	cl_int              err;
-	int					numItems = vt.pageTableMipOffsets[c.mipChainLength-1]+1;
+	int					numItems = STORE(0).pageTableMipOffsets[STORE(0).mipChainLength-1]+1;
 
 	assert(!LONG_MIP_CHAIN); // TODO: make this compatible
+	assert(vt.storeCount == 1); // the quadtree covers the first store only, vtAddStore() refuses more
 
 	vt.cl_device = NULL;
 	if (requestTexture)
@@ -195,24 +196,24 @@ void vtPrepareOpenCL(const GLuint requestTexture)
     if (!vt.mem_quadtree || err)
 		vt_fatal("clCreateBuffer() failed. (%d)\n", err);
 
-	vt.mem_offsets = clCreateBuffer(vt.cl_shared_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (12 * sizeof(int)), &vt.pageTableMipOffsets, &err);
+	vt.mem_offsets = clCreateBuffer(vt.cl_shared_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (12 * sizeof(int)), &STORE(0).pageTableMipOffsets, &err);
     if (!vt.mem_offsets || err)
 		vt_fatal("clCreateBuffer() failed. (%d)\n", err);
 
 	int w[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-	for (uint8_t i = 0; i < c.mipChainLength; i++)
-		w[i] = (uint16_t) (c.virtTexDimensionPages >> i);
+	for (uint8_t i = 0; i < STORE(0).mipChainLength; i++)
+		w[i] = (uint16_t) (STORE(0).virtTexDimensionPages >> i);
 	vt.mem_widths = clCreateBuffer(vt.cl_shared_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (12 * sizeof(int)), &w, &err);
     if (!vt.mem_widths || err)
 		vt_fatal("clCreateBuffer() failed. (%d)\n", err);
 
-	vt.mem_list = clCreateBuffer(vt.cl_shared_context, CL_MEM_WRITE_ONLY, (c.physTexDimensionPages * c.physTexDimensionPages * 2 * sizeof(uint32_t) + 1), NULL, &err);
+	vt.mem_list = clCreateBuffer(vt.cl_shared_context, CL_MEM_WRITE_ONLY, (c.physTexDimensionPages * c.physTexDimensionPages * c.physTexLayers * 2 * sizeof(uint32_t) + 1), NULL, &err);
 	if (!vt.mem_list || err)
 		vt_fatal("clCreateBuffer() failed. (%d)\n", err);
 
 
 
-	vt.list_buffer = (uint32_t *)malloc((c.physTexDimensionPages * c.physTexDimensionPages * 2 * sizeof(uint32_t) + 1));
+	vt.list_buffer = (uint32_t *)malloc((c.physTexDimensionPages * c.physTexDimensionPages * c.physTexLayers * 2 * sizeof(uint32_t) + 1));
 
 	int reduction = 1 << OPENCL_REDUCTION_SHIFT;
     clSetKernelArg(vt.kernel_buffer_to_quadtree, 1, sizeof(cl_mem), &vt.mem_quadtree);
@@ -233,7 +234,7 @@ void vtReshapeOpenCL(const uint16_t _w, const uint16_t _h)
  	cl_int              err;
 	size_t              workgroup_size;
     size_t              num_groups;
-	int					numItems = vt.pageTableMipOffsets[c.mipChainLength-1]+1;
+	int					numItems = STORE(0).pageTableMipOffsets[STORE(0).mipChainLength-1]+1;
 
 	clGetKernelWorkGroupInfo(vt.kernel_buffer_to_quadtree, vt.cl_device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &workgroup_size, NULL);
     {
@@ -292,7 +293,7 @@ void vtReshapeOpenCL(const uint16_t _w, const uint16_t _h)
 void vtPerformOpenCLBufferReduction()
 {
   	cl_int              err;
-//	int					numItems = vt.pageTableMipOffsets[c.mipChainLength-1]+1;
+//	int					numItems = STORE(0).pageTableMipOffsets[STORE(0).mipChainLength-1]+1;
 	static int			frame = 1;
 	uint8_t				framecounter = (frame % 255) + 1;
 
@@ -337,7 +338,7 @@ void vtPerformOpenCLBufferReduction()
 //    if (err)
 //		vt_fatal("clEnqueueReadBuffer() failed. (%d)\n", err);
 
-    err = clEnqueueReadBuffer(vt.cl_queue, vt.mem_list, CL_FALSE, 0, ((c.physTexDimensionPages * c.physTexDimensionPages * 2 * sizeof(uint32_t) + 1)), vt.list_buffer, 0, NULL, NULL);
+    err = clEnqueueReadBuffer(vt.cl_queue, vt.mem_list, CL_FALSE, 0, ((c.physTexDimensionPages * c.physTexDimensionPages * c.physTexLayers * 2 * sizeof(uint32_t) + 1)), vt.list_buffer, 0, NULL, NULL);
     if (err)
 		vt_fatal("clEnqueueReadBuffer() failed. (%d)\n", err);
 
@@ -346,7 +347,7 @@ void vtPerformOpenCLBufferReduction()
 		vt_fatal("clEnqueueReleaseGLObjects() failed. (%d)\n", err);
 
 
-//	verify_pagetable_results("RGBA 8-bit", NULL, c.virtTexDimensionPages, c.virtTexDimensionPages, c.mipChainLength, vt.list_buffer, (c.physTexDimensionPages * c.physTexDimensionPages * 2 * sizeof(int) + 1));
+//	verify_pagetable_results("RGBA 8-bit", NULL, STORE(0).virtTexDimensionPages, STORE(0).virtTexDimensionPages, STORE(0).mipChainLength, vt.list_buffer, (c.physTexDimensionPages * c.physTexDimensionPages * 2 * sizeof(int) + 1));
 
 //	free(gpu_pagetable_results);
 }
@@ -354,7 +355,7 @@ void vtPerformOpenCLBufferReduction()
 void vtExtractNeededPagesOpenCL()
 {
 	queue<uint32_t> tmpPages;
-	const clock_t clocks = vt.thisFrameClock = clock();
+	const uint32_t frame = ++vt.thisFrame;
 
 	clFinish(vt.cl_queue); // finish kernel and readback
 
@@ -371,7 +372,7 @@ void vtExtractNeededPagesOpenCL()
 
 			uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
 			uint8_t mip = EXTRACT_MIP(pageInfo);
-			*((uint8_t *)&PAGE_TABLE(mip, x_coord, y_coord)) = kTableFree;
+			*((uint8_t *)&PAGE_TABLE(0, mip, x_coord, y_coord)) = kTableFree;
 		}
 	}       // unlock
 
@@ -380,27 +381,27 @@ void vtExtractNeededPagesOpenCL()
 
 	for (uint32_t i = 1; i < vt.list_buffer[0]; i++)
 	{
-		for (int8_t m = c.mipChainLength-1; m >= 0; m--)
+		for (int8_t m = STORE(0).mipChainLength-1; m >= 0; m--)
 		{
 			uint32_t page = vt.list_buffer[i];
 
-			if (page >= vt.pageTableMipOffsets[m])
+			if (page >= STORE(0).pageTableMipOffsets[m])
 			{
-				page -= vt.pageTableMipOffsets[m];
+				page -= STORE(0).pageTableMipOffsets[m];
 
-				int y = page / (c.virtTexDimensionPages >> m);
-				int x = page - (y * (c.virtTexDimensionPages >> m));
+				int y = page / (STORE(0).virtTexDimensionPages >> m);
+				int x = page - (y * (STORE(0).virtTexDimensionPages >> m));
 
 
 //				printf("%i   %i %i %i\n", r, l, x, y);
 
 
-				const uint32_t pageEntry = PAGE_TABLE(m, x, y);
+				const uint32_t pageEntry = PAGE_TABLE(0, m, x, y);
 
 
-				if ((uint8_t) pageEntry == kTableFree) // if page is not mapped, add it to the download list and make sure we don't handle it again this frame
+				if (((uint8_t) pageEntry == kTableFree) && vtuPageExists(MAKE_PAGE_INFO(0, m, x, y))) // if page is not mapped, add it to the download list and make sure we don't handle it again this frame. pages outside the footprint of a sparse store keep the fallback entry
 				{
-					const uint32_t pageInfo = MAKE_PAGE_INFO(m, x, y);
+					const uint32_t pageInfo = MAKE_PAGE_INFO(0, m, x, y);
 
 					tmpPages.push(pageInfo);
 #if DEBUG_LOG > 0
@@ -409,7 +410,7 @@ void vtExtractNeededPagesOpenCL()
 
 					// we just want to set the alpha channel, luckly this byte is right there on little endian
 					// setting just the lowest byte matters for the fallback-entry-mode, else a non-mapped page is empty anyway
-					*((uint8_t *)&PAGE_TABLE(m, x, y)) = kTableMappingInProgress;
+					*((uint8_t *)&PAGE_TABLE(0, m, x, y)) = kTableMappingInProgress;
 
 					vtcTouchCachedPage(pageInfo);
 
@@ -418,11 +419,12 @@ void vtExtractNeededPagesOpenCL()
 				{
 					const uint8_t yInTexture = BYTE2(pageEntry), xInTexture = BYTE3(pageEntry);
 
-					fast_assert((xInTexture < c.physTexDimensionPages) && (yInTexture < c.physTexDimensionPages));
+					fast_assert(SLOT_VALID(xInTexture, yInTexture));
 
-					vt.textureStorageInfo[xInTexture][yInTexture].clockUsed = clocks;	// touch page in physical texture
+					if (STORAGE_INFO(xInTexture, yInTexture).frameUsed != frame)
+						vtsTouchSlot(xInTexture, yInTexture);	// touch page in physical texture
 
-					vtcTouchCachedPage(MAKE_PAGE_INFO(m, x, y));			// touch page in RAM cache
+					vtcTouchCachedPage(MAKE_PAGE_INFO(0, m, x, y));			// touch page in RAM cache
 				}
 
 
@@ -516,7 +518,7 @@ void vtShutdownOpenCL()
 //
 //	for (int i = 1; i < res[0]; i++)
 //	{
-//		for (int8_t l = c.mipChainLength-1; l >= 0; l--)
+//		for (int8_t l = STORE(0).mipChainLength-1; l >= 0; l--)
 //		{
 //			int r = res[i];
 //
@@ -524,8 +526,8 @@ void vtShutdownOpenCL()
 //			{
 //				r -= vt.pageTableMipOffsets[l];
 //
-//				int y = r / (c.virtTexDimensionPages >> l);
-//				int x = r - (y * (c.virtTexDimensionPages >> l));
+//				int y = r / (STORE(0).virtTexDimensionPages >> l);
+//				int x = r - (y * (STORE(0).virtTexDimensionPages >> l));
 ////				printf("%i   %i %i %i\n", r, l, x, y);
 //				break;
 //			}
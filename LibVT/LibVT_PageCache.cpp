@@ -0,0 +1,358 @@
+/*
+ *  LibVT_PageCache.cpp
+ *
+ *
+ *  Persistent cache of decoded pages across sessions, one memory mapped file per tile store.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Internal.h"
+#include "LibVT.h"
+
+#include <sys/stat.h>
+#ifdef WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/file.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+extern vtData vt;
+extern vtConfig c;
+
+// cache file layout (native endian, the file is specific to this machine anyway):
+//	vtPageCacheHeader			- padded to 4096 bytes
+//	uint32_t[indexCount]		- one entry per page of the virtual texture, ordered like the page tables, slot + 1 or 0 if the page isn't cached
+//	slots						- slotCount pages of slotSize bytes in the format they are uploaded in, starting at a 4096 byte boundary
+// the file is named after a hash of the tile store's path, modification times (including the newest tile's) and the page format, so a changed store or configuration gets a new file. every open store has its own file.
+// slots are handed out in the order pages are decoded until the file is full, nothing is ever evicted. the file is created sparse, so it only takes the space of the pages written.
+// a process holds an exclusive lock on the file as long as it has it mapped, another process opening the same store runs without the cache instead of sharing the index.
+// the header is marked dirty on open and clean after everything was flushed on close, a file left dirty by a crash is started over, its index may point at slots never written.
+
+#define kPageCacheAlignment		4096
+
+static bool _vtuValidPageCacheHeader(const vtPageCacheHeader &header, uint64_t identity, uint32_t slotSize, uint64_t slotCount, uint32_t indexCount, uint64_t indexOffset, uint64_t slotsOffset)
+{
+	return (memcmp(header.magic, VT_PAGECACHE_MAGIC, 4) == 0) && (header.version == VT_PAGECACHE_VERSION) && !header.dirty &&
+		   (header.identity == identity) && (header.slotSize == slotSize) && (header.slotCount == slotCount) && (header.indexCount == indexCount) &&
+		   (header.indexOffset == indexOffset) && (header.slotsOffset == slotsOffset) && (header.usedSlots <= slotCount);
+}
+
+static uint64_t _vtuHash(uint64_t hash, const void *data, size_t length) // FNV-1a
+{
+	const uint8_t *bytes = (const uint8_t *) data;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t _vtuModificationTime(const string &path)
+{
+	struct stat st;
+
+	if (stat(path.c_str(), &st) != 0)
+		return 0;
+
+	return (uint64_t) st.st_mtime;
+}
+
+static uint64_t _vtuPageCacheIdentity(const uint8_t store)
+{
+	const vtStore &st = STORE(store);
+	char buf[2048];
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+#ifdef WIN32
+	if (!_fullpath(buf, st.tileDir.c_str(), sizeof(buf)))
+#else
+	if (!realpath(st.tileDir.c_str(), buf))
+#endif
+		snprintf(buf, sizeof(buf), "%s", st.tileDir.c_str());
+	hash = _vtuHash(hash, buf, strlen(buf));
+
+	// rewriting a store in place doesn't touch the level directories, a tool may not even rewrite the page of the highest mip level. the newest tile catches any rewritten one
+	uint64_t times[4] = {_vtuModificationTime(vtuTileArchivePath(st.tileDir.c_str())), 0, 0, st.newestTileTime};
+	const uint8_t top = st.mipChainLength - 1;
+
+	snprintf(buf, sizeof(buf), "%s%stiles_b%u_level%u", st.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, 0);
+	times[1] = _vtuModificationTime(buf);
+	snprintf(buf, sizeof(buf), "%s%stiles_b%u_level%u%stile_%u_0_0.%s", st.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, top, PATH_SEPERATOR, top, c.pageCodec.c_str());
+	times[2] = _vtuModificationTime(buf);
+	hash = _vtuHash(hash, times, sizeof(times));
+
+	snprintf(buf, sizeof(buf), "%u %u %u %s %u %u %u %u %u", VT_PAGECACHE_VERSION, c.pageDimension, c.pageBorder, c.pageCodec.c_str(), st.mipChainLength, vt.pagePoolBlockSize,
+			 (uint32_t) c.pageDataFormat, (uint32_t) c.pageDXTCompression, (uint32_t) DECODED_HALF_PAGES);
+
+	return _vtuHash(hash, buf, strlen(buf));
+}
+
+static inline uint32_t _vtuPageCachePosition(uint32_t pageInfo)
+{
+	return PAGE_INDEX(EXTRACT_STORE(pageInfo), EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo));
+}
+
+bool vtuOpenPageCache(const uint8_t store)
+{
+	vtStore &st = STORE(store);
+
+	vtuClosePageCache(store); // vtInit() may be called again without vtShutdown()
+
+	if (c.pageCacheDir.empty() || (c.pageDXTCompression && !REALTIME_DXT_COMPRESSION)) // DXT tiles are read in the upload format already
+		return false;
+
+	char name[32];
+	uint32_t indexCount = 0;
+
+	for (uint8_t i = 0; i < st.mipChainLength; i++)
+		indexCount += (st.virtTexDimensionPages >> i) * (st.virtTexDimensionPages >> i);
+
+	const uint64_t identity = _vtuPageCacheIdentity(store);
+	const uint32_t slotSize = vt.pagePoolBlockSize;
+	uint64_t slotCount = (uint64_t) PAGE_CACHE_MB * 1024 * 1024 / slotSize;
+	if (slotCount > indexCount)
+		slotCount = indexCount;
+
+	const uint64_t indexOffset = kPageCacheAlignment;
+	const uint64_t slotsOffset = (indexOffset + (uint64_t) indexCount * sizeof(uint32_t) + kPageCacheAlignment - 1) / kPageCacheAlignment * kPageCacheAlignment;
+	const uint64_t size = slotsOffset + slotCount * slotSize;
+
+	snprintf(name, sizeof(name), "%016llx.vtpc", (long long unsigned int) identity);
+	const string path = c.pageCacheDir + string(PATH_SEPERATOR) + string(name);
+
+	// an existing file is reused if its header matches exactly and it was closed properly, anything else is truncated and starts out empty
+	vtPageCacheHeader header;
+	bool valid = false;
+
+#ifdef WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		printf("Error: can't open the page cache %s\n", path.c_str());
+		return false;
+	}
+
+	OVERLAPPED lockRange; // a byte far past the end, locked ranges can't be read through other handles
+	memset(&lockRange, 0, sizeof(lockRange));
+	lockRange.Offset = 0xFFFFFFFF;
+	lockRange.OffsetHigh = 0x7FFFFFFF;
+	if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &lockRange))
+	{
+		printf("Warning: the page cache %s is in use by another process, running without it\n", path.c_str());
+		CloseHandle(file);
+		return false;
+	}
+
+	DWORD bytesRead = 0;
+	valid = ReadFile(file, &header, sizeof(header), &bytesRead, NULL) && (bytesRead == sizeof(header)) &&
+			_vtuValidPageCacheHeader(header, identity, slotSize, slotCount, indexCount, indexOffset, slotsOffset);
+
+	LARGE_INTEGER fileSize, zero, newSize;
+	GetFileSizeEx(file, &fileSize);
+	if (!valid || ((uint64_t) fileSize.QuadPart != size))
+	{
+		zero.QuadPart = 0;
+		newSize.QuadPart = (LONGLONG) size;
+		valid = false;
+
+		SetFilePointerEx(file, zero, NULL, FILE_BEGIN);	// truncating first zeroes the index
+		SetEndOfFile(file);
+		SetFilePointerEx(file, newSize, NULL, FILE_BEGIN);
+		SetEndOfFile(file);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, 0, NULL);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	st.pageCacheFile = file; // closing it releases the lock
+#else
+	int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		printf("Error: can't open the page cache %s\n", path.c_str());
+		return false;
+	}
+
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		printf("Warning: the page cache %s is in use by another process, running without it\n", path.c_str());
+		close(fd);
+		return false;
+	}
+
+	valid = (pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header)) &&
+			_vtuValidPageCacheHeader(header, identity, slotSize, slotCount, indexCount, indexOffset, slotsOffset);
+
+	struct stat fileStat;
+	if ((fstat(fd, &fileStat) != 0) || !valid || ((uint64_t) fileStat.st_size != size))
+	{
+		valid = false;
+
+		if ((ftruncate(fd, 0) != 0) || (ftruncate(fd, (off_t) size) != 0)) // truncating first zeroes the index, the slots stay sparse
+		{
+			printf("Error: can't create the page cache %s\n", path.c_str());
+			close(fd);
+			return false;
+		}
+	}
+
+	void *data = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	st.pageCacheFile = fd; // closing it releases the lock
+
+#ifdef MADV_RANDOM
+	madvise(data, (size_t) size, MADV_RANDOM);
+#endif
+#endif
+
+	st.pageCacheData = (uint8_t *) data;
+	st.pageCacheSize = size;
+	st.pageCacheHeader = (vtPageCacheHeader *) data;
+	st.pageCacheIndex = (uint32_t *) (st.pageCacheData + indexOffset);
+
+	if (!valid)
+	{
+		memcpy(st.pageCacheHeader->magic, VT_PAGECACHE_MAGIC, 4);
+		st.pageCacheHeader->version = VT_PAGECACHE_VERSION;
+		st.pageCacheHeader->identity = identity;
+		st.pageCacheHeader->slotSize = slotSize;
+		st.pageCacheHeader->slotCount = (uint32_t) slotCount;
+		st.pageCacheHeader->usedSlots = 0;
+		st.pageCacheHeader->indexCount = indexCount;
+		st.pageCacheHeader->indexOffset = indexOffset;
+		st.pageCacheHeader->slotsOffset = slotsOffset;
+	}
+
+	// on disk before any index entry written from now on
+	st.pageCacheHeader->dirty = 1;
+#ifdef WIN32
+	FlushViewOfFile(st.pageCacheHeader, sizeof(vtPageCacheHeader));
+	FlushFileBuffers(file);
+#else
+	msync(st.pageCacheData, kPageCacheAlignment, MS_SYNC);
+#endif
+
+	printf("Using page cache %s with %u of %u pages\n", path.c_str(), st.pageCacheHeader->usedSlots, st.pageCacheHeader->slotCount);
+
+	return true;
+}
+
+void vtuClosePageCache(const uint8_t store)
+{
+	vtStore &st = STORE(store);
+
+	if (!st.pageCacheData)
+		return;
+
+	// the slots and the index have to be on disk before the header says they are consistent
+#ifdef WIN32
+	FlushViewOfFile(st.pageCacheData, 0);
+	FlushFileBuffers((HANDLE) st.pageCacheFile);
+	st.pageCacheHeader->dirty = 0;
+	FlushViewOfFile(st.pageCacheHeader, sizeof(vtPageCacheHeader));
+	UnmapViewOfFile(st.pageCacheData);
+	CloseHandle((HANDLE) st.pageCacheFile);
+#else
+	msync(st.pageCacheData, (size_t) st.pageCacheSize, MS_SYNC);
+	st.pageCacheHeader->dirty = 0;
+	msync(st.pageCacheData, kPageCacheAlignment, MS_ASYNC);
+	munmap(st.pageCacheData, (size_t) st.pageCacheSize);
+	close(st.pageCacheFile);
+#endif
+
+	st.pageCacheData = NULL;
+	st.pageCacheSize = 0;
+	st.pageCacheHeader = NULL;
+	st.pageCacheIndex = NULL;
+}
+
+void * vtuLoadCachedPage(uint32_t pageInfo)
+{
+	const vtStore &st = PAGE_STORE(pageInfo);
+
+	if (!st.pageCacheData)
+		return NULL;
+
+	uint32_t slot;
+
+	{	// lock
+		LOCK(vt.pageCacheMutex)
+
+		slot = st.pageCacheIndex[_vtuPageCachePosition(pageInfo)];
+	}	// unlock
+
+	if (!slot)
+		return NULL;
+
+	const uint32_t slotSize = st.pageCacheHeader->slotSize;
+	void *image_data = vtpAlloc(slotSize);
+	assert(image_data);
+
+	memcpy(image_data, st.pageCacheData + st.pageCacheHeader->slotsOffset + (uint64_t) (slot - 1) * slotSize, slotSize);
+
+	return image_data;
+}
+
+void vtuStorePageInCache(uint32_t pageInfo, const void *image_data)
+{
+	vtStore &st = PAGE_STORE(pageInfo);
+
+	if (!st.pageCacheData || (vtpSize(image_data) != st.pageCacheHeader->slotSize))
+		return;
+
+	const uint32_t position = _vtuPageCachePosition(pageInfo), slotSize = st.pageCacheHeader->slotSize;
+	uint32_t slot;
+
+	{	// lock
+		LOCK(vt.pageCacheMutex)
+
+		if (st.pageCacheIndex[position] || (st.pageCacheHeader->usedSlots == st.pageCacheHeader->slotCount)) // already cached or full
+			return;
+
+		slot = st.pageCacheHeader->usedSlots++;
+	}	// unlock
+
+	memcpy(st.pageCacheData + st.pageCacheHeader->slotsOffset + (uint64_t) slot * slotSize, image_data, slotSize);
+
+	{	// lock
+		LOCK(vt.pageCacheMutex)
+
+		st.pageCacheIndex[position] = slot + 1; // only published once the data is complete
+	}	// unlock
+}
+
+void vtSetPageCacheDirectory(const char *cacheDir)
+{
+	c.pageCacheDir = cacheDir ? cacheDir : "";
+}
@@ -22,10 +22,205 @@ extern vtData vt;
 extern vtConfig c;
 
 
+static void * _vtLoadAndDecompressPage(uint32_t pageInfo)
+{
+	void *image_data = vtuLoadCachedPage(pageInfo);
+
+	if (image_data)
+	{
+		vtStatsPageCacheHits(1);
+		return image_data;
+	}
+
+	if (c.pageDXTCompression && !REALTIME_DXT_COMPRESSION)
+	{
+		uint32_t size = 0;
+		void *file_data = vtuLoadPageFile(pageInfo, 8, &size);
+
+		vtStatsPagesRead(file_data ? 1 : 0, size);
+
+		if (file_data && vtuIsArchiveData(file_data)) // the cache owns its pages, so archive data has to be copied
+		{
+			image_data = vtpAlloc(size);
+			assert(image_data);
+			memcpy(image_data, file_data, size);
+		}
+		else
+			image_data = file_data;
+	}
+	else if (PAGE_STORE(pageInfo).archiveData || MAX_COMPRESSED_RAMCACHE_MB)
+	{
+		uint32_t size = 0;
+		void *file_data = vtcTakeCompressedPageLOCK(pageInfo, &size);
+
+		if (file_data)
+			vtStatsCompressedCacheHits(1);
+		else
+		{
+			file_data = vtuLoadPageFile(pageInfo, 0, &size);
+
+			if (!file_data)
+				return NULL;
+
+			vtStatsPagesRead(1, size);
+		}
+
+		const double start = vtuTime();
+		image_data = vtuDecompressImageBuffer(file_data, size, &c.pageDimension);
+		vtStatsPagesDecompressed(1, vtuTime() - start);
+
+		if (image_data)
+			vtcInsertCompressedPageLOCK(pageInfo, file_data); // keeps it for the next time the page is evicted from the RAM cache, or unloads it
+		else
+			vtuUnloadPageFile(file_data);
+	}
+	else
+	{
+		char buf[255];
+		const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
+		const uint8_t mip = EXTRACT_MIP(pageInfo);
+		const vtStore &st = PAGE_STORE(pageInfo);
+
+		snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_%u_%u.%s", st.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, mip, PATH_SEPERATOR, mip, x_coord, st.mipTranslation[mip] - y_coord, c.pageCodec.c_str()); // convert from lower left coordinates (opengl) to top left (tile store on disk)
+
+		const double start = vtuTime();
+		image_data = vtuDecompressImageFile(buf, &c.pageDimension);
+		vtStatsPagesRead(1, 0); // the decoder reads the file itself, so the time includes reading and the size is unknown
+		vtStatsPagesDecompressed(1, vtuTime() - start);
+	}
+
+	if (REALTIME_DXT_COMPRESSION && image_data)
+	{
+		void *compressed_data =	vtuCompressRGBA_DXT1(image_data);
+		vtpFree(image_data);
+		image_data = compressed_data;
+	}
+
+	if (image_data)
+		vtuStorePageInCache(pageInfo, image_data);
+
+	return image_data;
+}
+
+// a loading thread owns a page from the moment it takes it from neededPages or prefetchPages until it passes it on, see vtStore::loadGenerations.
+// requests for a page that is in flight are coalesced into that load, loads that were cancelled in the meantime are dropped before they reach the disk
+
+// hands a page back, vtRemoveStore() waits for the last one of a removed store. must be called with neededPagesMutex locked
+static void _vtReleasePage(const uint32_t pageInfo)
+{
+	vtStore &st = PAGE_STORE(pageInfo);
+
+	st.loadCount--;
+#if ENABLE_MT
+	if (!st.loadCount && !st.active)
+		vt.loadsFinishedCondition.broadcast();
+#endif
+}
+
+#if ENABLE_MT
+// the warm-up and readahead threads hold a page of a store the same way while they read it, fails if the store has been removed
+static bool _vtAcquirePageLOCK(const uint32_t pageInfo)
+{
+	LOCK(vt.neededPagesMutex)
+
+	if (!PAGE_IN_STORE(pageInfo))
+		return false;
+
+	PAGE_STORE(pageInfo).loadCount++;
+	return true;
+}
+
+static void _vtReleasePageLOCK(const uint32_t pageInfo)
+{
+	LOCK(vt.neededPagesMutex)
+
+	_vtReleasePage(pageInfo);
+}
+#endif
+
+// takes up to limit requests, prefetched pages only if there were none. must be called with neededPagesMutex locked
+static void _vtTakePages(queue<uint32_t> &pages, const uint32_t limit, const uint32_t prefetchLimit, bool *prefetch)
+{
+	uint32_t taken = 0;
+
+	while (!vt.neededPages.empty() && taken < limit) // TODO: all this copying could use preallocation of necessary space (not only here)
+	{
+		const uint32_t pageInfo = vt.neededPages.front();vt.neededPages.pop_front();
+		uint32_t &generation = LOAD_GENERATION(pageInfo);
+
+		if (generation == kLoadIdle)
+		{
+			PAGE_STORE(pageInfo).loadCount++;
+			pages.push(pageInfo);
+		}
+		if (generation != vt.requestGeneration) // an owned page, e.g. prefetched right now, is passed on by that load
+		{
+			generation = vt.requestGeneration;
+			vt.wantedLoads.push_back(pageInfo);
+		}
+		taken++;
+	}
+
+	*prefetch = !taken; // prefetched pages only while there are no real requests
+	taken = 0;
+	while (*prefetch && !vt.prefetchPages.empty() && taken < prefetchLimit)
+	{
+		const uint32_t pageInfo = vt.prefetchPages.front();vt.prefetchPages.pop_front();
+
+		if ((LOAD_GENERATION(pageInfo) != kLoadIdle) || ((uint8_t) PAGE_TABLE(EXTRACT_STORE(pageInfo), EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo)) != kTableFree)) // being loaded, requested or mapped since vtPrefetch()
+			continue;
+
+		LOAD_GENERATION(pageInfo) = kLoadUnwanted;
+		PAGE_STORE(pageInfo).loadCount++;
+		pages.push(pageInfo);
+		taken++;
+	}
+}
+
+// false if the page isn't needed anymore and must not be loaded
+static bool _vtStartLoad(const uint32_t pageInfo, const bool prefetch)
+{
+	LOCK(vt.neededPagesMutex)
+
+	uint32_t &generation = LOAD_GENERATION(pageInfo);
+
+	if ((generation != kLoadUnwanted) || prefetch)
+		return true;
+
+	generation = kLoadIdle; // cancelled, _vtApplyPageList() freed its page table entry already
+	_vtReleasePage(pageInfo);
+	return false;
+}
+
+// ends the loads and passes the pages on to newPages, prefetched and cancelled ones just stay in the RAM cache.
+// they are queued before the loads end, once vtRemoveStore() stops waiting no page of the store can show up in newPages anymore
+static void _vtFinishLoads(const uint32_t *pages, const uint32_t count)
+{
+	LOCK(vt.neededPagesMutex)
+
+	{	// lock
+		LOCK(vt.newPagesMutex)
+
+		for (uint32_t i = 0; i < count; i++)
+			if (LOAD_GENERATION(pages[i]) != kLoadUnwanted)
+				vt.newPages.push(pages[i]);
+	}	// unlock
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t &generation = LOAD_GENERATION(pages[i]);
+
+		if (generation != kLoadIdle)
+		{
+			generation = kLoadIdle;
+			_vtReleasePage(pages[i]);
+		}
+	}
+}
+
 #if ENABLE_MT < 2
 void vtLoadNeededPages()
 {
-        char buf[255];
 
 #if ENABLE_MT
 	try {
@@ -37,6 +232,7 @@ void vtLoadNeededPages()
 		{
 			queue<uint32_t>	tmpNewPages;
 			queue<uint32_t>	neededPages;
+			bool prefetch = false;
 
 
 			{	// lock
@@ -44,63 +240,50 @@ void vtLoadNeededPages()
 
 #if ENABLE_MT
 				{
-					while(vt.neededPages.empty())
+					while(vt.neededPages.empty() && vt.prefetchPages.empty())
 					{
 						vt.neededPagesAvailableCondition.wait(scoped_lock); // sleep as long as there are no pages to be loaded
 					}
 				}
 #endif
 
-				uint8_t i = 0;	// limit to 1 pages at once
-				while(!vt.neededPages.empty() && i < limit) // TODO: all this copying could use preallocation of necessary space (not only here)
-				{
-					neededPages.push(vt.neededPages.front());vt.neededPages.pop_front();
-					i ++;
-				}
+				_vtTakePages(neededPages, limit, 1, &prefetch); // ENABLE_MT 0 loads on the render thread so it takes only one prefetched page
 			}	// unlock
 
 			while(!neededPages.empty())
 			{
-				const uint32_t pageInfo = neededPages.front();neededPages.pop();
-				const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-				const uint8_t mip = EXTRACT_MIP(pageInfo);
-				void *image_data;
+				uint32_t pageInfo = neededPages.front();neededPages.pop();
 
+				if (!_vtStartLoad(pageInfo, prefetch))
+				{
+					vtStatsPagesCancelled(1);
+					continue;
+				}
 
 				// load tile from cache or harddrive
 				if (!vtcIsPageInCacheLOCK(pageInfo))
 				{
-                                        snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_%u_%u.%s", c.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, mip, PATH_SEPERATOR, mip, x_coord, vt.mipTranslation[mip] - y_coord, c.pageCodec.c_str()); // convert from lower left coordinates (opengl) to top left (tile store on disk)
-
 #if DEBUG_LOG > 0
-					printf("Loading and decompressing page from Disk: Mip:%u %u/%u\n", mip, x_coord, y_coord);
+					printf("Loading and decompressing page from Disk: Mip:%u %u/%u\n", EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo));
 #endif
 
-					if (c.pageDXTCompression && !REALTIME_DXT_COMPRESSION)
-						image_data = vtuLoadFile(buf, 8, NULL);
-					else
-						image_data = vtuDecompressImageFile(buf, &c.pageDimension);
+					void *image_data = _vtLoadAndDecompressPage(pageInfo);
 
-					if (REALTIME_DXT_COMPRESSION)
+					if (image_data)
 					{
-						void *compressed_data =	vtuCompressRGBA_DXT1(image_data);
-						free(image_data);
-						image_data = compressed_data;
+						vtcInsertPageIntoCacheLOCK(pageInfo, image_data);
+						if (prefetch)
+							vtStatsPagesPrefetched(1);
 					}
-
-					vtcInsertPageIntoCacheLOCK(pageInfo, image_data);
+					else
+						vtuMarkPageMissing(pageInfo); // passed on anyway if it was requested, vtMapNewPages() frees its page table entry
 				}
 //				else
 //					assert(0);
 
 				//usleep(500000); // for testin' what happens when pages are loaded slowly
 
-				{	// lock
-					LOCK(vt.newPagesMutex)
-
-					vt.newPages.push(pageInfo);
-
-				}	// unlock
+				_vtFinishLoads(&pageInfo, 1); // prefetched pages aren't mapped until they are requested
 			}
 		}
 #if ENABLE_MT
@@ -113,63 +296,122 @@ void vtLoadNeededPages()
 #else
 void LibVTBackgroundThread::run()//vtLoadNeededPagesDecoupled()
 {
-	char buf[255];
-
         //try {
-		const int limit = 1;
 		while (1)
 		{
-			queue<uint32_t>	tmpNewPages;
 			queue<uint32_t>	neededPages;
+			vector<vtCompressedPage> loadedPages, diskPages;
+			uint64_t loadedBytes = 0;
+			uint32_t compressedCacheHits = 0, pageCacheHits = 0, prefetchedPages = 0, cancelledPages = 0;
+			uint32_t finishedPages[IO_BATCH];	// pages that don't need the decompression threads
+			uint32_t finishedCount = 0;
+			bool prefetch = false;
 
 
 			{	// lock
 				LOCK(vt.neededPagesMutex)
 
 				{
-					while(vt.neededPages.empty())
+					while(vt.neededPages.empty() && vt.prefetchPages.empty())
 					{
                                                 vt.neededPagesAvailableCondition.wait(&vt.neededPagesMutex);
 					}
 				}
 
-				uint8_t i = 0;	// limit to 5 pages at once
-				while(!vt.neededPages.empty() && i < limit)
-				{
-					neededPages.push(vt.neededPages.front());vt.neededPages.pop_front();
-					i ++;
-				}
+				_vtTakePages(neededPages, IO_BATCH, IO_BATCH, &prefetch);
 			}	// unlock
 
 			while(!neededPages.empty())
 			{
 				const uint32_t pageInfo = neededPages.front();neededPages.pop();
-				const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-				const uint8_t mip = EXTRACT_MIP(pageInfo);
+
+				if (!_vtStartLoad(pageInfo, prefetch))
+				{
+					cancelledPages++;
+					continue;
+				}
 
 				// load tile from cache or harddrive
 				if (!vtcIsPageInCacheLOCK(pageInfo))
 				{
-					snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_%u_%u.%s", c.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, mip, PATH_SEPERATOR, mip, x_coord, vt.mipTranslation[mip] - y_coord, c.pageCodec.c_str()); // convert from lower left coordinates (opengl) to top left (tile store on disk)
+					if (prefetch)
+						prefetchedPages++;
+
+					void *image_data = vtuLoadCachedPage(pageInfo); // already decoded by an earlier session, it skips the decompression threads
+
+					if (image_data)
+					{
+						vtcInsertPageIntoCacheLOCK(pageInfo, image_data);
+						finishedPages[finishedCount++] = pageInfo;
+						pageCacheHits++;
+						continue;
+					}
 
 #if DEBUG_LOG > 0
-					printf("Loading page from Disk: Mip:%u %u/%u (%i)\n", mip, x_coord, y_coord, pageInfo);
+					printf("Loading page from Disk: Mip:%u %u/%u (%i)\n", EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo), pageInfo);
 #endif
 
-					uint32_t size = 0;
-					void *file_data = vtuLoadFile(buf, (c.pageDXTCompression && !REALTIME_DXT_COMPRESSION) ? 8 : 0, &size);
+					vtCompressedPage page;
+					page.pageInfo = pageInfo;
+					page.size = 0;
+					page.data = vtcTakeCompressedPageLOCK(pageInfo, &page.size);
 
-					{	// lock
-						LOCK(vt.compressedMutex)
+					if (page.data)
+					{
+						loadedPages.push_back(page);
+						compressedCacheHits++;
+					}
+					else
+						diskPages.push_back(page); // read together below
+				}
+				else // loaded by another request or a prefetch in the meantime
+					finishedPages[finishedCount++] = pageInfo;
+			}
 
-						vt.newCompressedPages.push(pageInfo);
-						vt.compressedPages.insert(pair<uint32_t, void *>(pageInfo, file_data));
-						vt.compressedPagesSizes.insert(pair<uint32_t, uint32_t>(pageInfo, size));
+			if (!diskPages.empty())
+			{
+				vtuLoadPageFiles(&diskPages[0], (uint32_t) diskPages.size(), (c.pageDXTCompression && !REALTIME_DXT_COMPRESSION) ? 8 : 0);
 
-                                                vt.compressedPagesAvailableCondition.signal();
-					}	// unlock
+				for (uint32_t i = 0; i < diskPages.size(); i++)
+				{
+					if (diskPages[i].data)
+					{
+						loadedBytes += diskPages[i].size;
+						loadedPages.push_back(diskPages[i]);
+					}
+					else
+					{
+						vtuMarkPageMissing(diskPages[i].pageInfo);
+						finishedPages[finishedCount++] = diskPages[i].pageInfo; // passed on if it was requested, vtMapNewPages() frees its page table entry
+					}
 				}
 			}
+
+			vtStatsPagesRead((uint32_t) loadedPages.size() - compressedCacheHits, loadedBytes);
+			vtStatsCompressedCacheHits(compressedCacheHits);
+			vtStatsPageCacheHits(pageCacheHits);
+			vtStatsPagesPrefetched(prefetchedPages);
+			vtStatsPagesCancelled(cancelledPages);
+
+#if READAHEAD_SIBLINGS
+			if (!diskPages.empty()) // before the batch is finished, the store can't be removed while its tables are looked at. it only queues hints for the readahead thread
+				vtuReadaheadSiblingPages(&diskPages[0], (uint32_t) diskPages.size());
+#endif
+
+			if (finishedCount)
+				_vtFinishLoads(finishedPages, finishedCount);
+
+			if (!loadedPages.empty())
+			{	// lock
+				LOCK(vt.compressedMutex)
+
+				vt.newCompressedPages.insert(vt.newCompressedPages.end(), loadedPages.begin(), loadedPages.end());
+
+				if (loadedPages.size() > 1)
+					vt.compressedPagesAvailableCondition.broadcast();
+				else
+					vt.compressedPagesAvailableCondition.signal();
+			}	// unlock
 		}
 /*	}
         catch (boost::thread_interrupted const&)
@@ -180,11 +422,10 @@ void LibVTBackgroundThread::run()//vtLoadNeededPagesDecoupled()
 void LibVTBackgroundThread2::run()//void vtDecompressNeededPagesDecoupled()
 {
         //try {
-		const int limit = 5;
 		while (1)
 		{
-			queue<uint32_t>	tmpNewPages;
-			queue<uint32_t>	neededPages;
+			vtCompressedPage pages[DECOMPRESSION_BATCH];
+			uint8_t pageCount = 0;
 
 
 			{	// lock
@@ -197,102 +438,289 @@ void LibVTBackgroundThread2::run()//void vtDecompressNeededPagesDecoupled()
 					}
 				}
 
-				uint8_t i = 0;	// limit to 5 pages at once
-				while(!vt.newCompressedPages.empty() && i < limit)
+				// take a fair share of the queue so the other workers get something to do too
+				uint32_t limit = (uint32_t)vt.newCompressedPages.size() / vt.decompressionThreadCount + 1;
+				if (limit > DECOMPRESSION_BATCH) limit = DECOMPRESSION_BATCH;
+
+				while(!vt.newCompressedPages.empty() && pageCount < limit)
 				{
-					neededPages.push(vt.newCompressedPages.front());vt.newCompressedPages.pop();
-					i ++;
+					pages[pageCount++] = vt.newCompressedPages.front();vt.newCompressedPages.pop_front();
 				}
 			}	// unlock
 
-			while(!neededPages.empty())
-			{
-				const uint32_t pageInfo = neededPages.front();neededPages.pop();
-				void *file_data;
-				uint32_t size;
-
-				{	// lock
-					LOCK(vt.compressedMutex)
-
-					file_data = vt.compressedPages.find(pageInfo)->second;
-					size = vt.compressedPagesSizes.find(pageInfo)->second;
+			uint32_t decompressedPages[DECOMPRESSION_BATCH];
+			uint8_t decompressedCount = 0;
+			const double start = vtuTime();
 
+			for (uint8_t i = 0; i < pageCount; i++)
+			{
+				const uint32_t pageInfo = pages[i].pageInfo;
 
-					vt.compressedPages.erase(pageInfo);
-					vt.compressedPagesSizes.erase(pageInfo);
-				}	// unlock
-
-				if (file_data && size) // this prevents problems because pages can be added twice because they are already loaded but not decompressed
-				{
 #if DEBUG_LOG > 0
-					const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-					const uint8_t mip = EXTRACT_MIP(pageInfo);
-					printf("Decompressing page from buffer: Mip:%u %u/%u (%i)\n", mip, x_coord, y_coord, pageInfo);
+				printf("Decompressing page from buffer: Mip:%u %u/%u (%i)\n", EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo), pageInfo);
 #endif
 
-					void *image_data = vtuDecompressImageBuffer(file_data, size, &c.pageDimension);
-
-					free(file_data);
+				void *image_data = vtuDecompressImageBuffer(pages[i].data, pages[i].size, &c.pageDimension);
 
-					if (REALTIME_DXT_COMPRESSION)
-					{
-						void *compressed_data =	vtuCompressRGBA_DXT1(image_data);
-						free(image_data);
-						image_data = compressed_data;
-					}
+				if (!image_data) // corrupt page, it is never requested again and vtMapNewPages() frees its page table entry
+				{
+					vtuUnloadPageFile(pages[i].data);
+					vtuMarkPageMissing(pageInfo);
+					decompressedPages[decompressedCount++] = pageInfo;
+					continue;
+				}
 
-					vtcInsertPageIntoCacheLOCK(pageInfo, image_data);
+				vtcInsertCompressedPageLOCK(pageInfo, pages[i].data); // keeps it for the next time the page is evicted from the RAM cache, or unloads it
 
-					{	// lock
-						LOCK(vt.newPagesMutex)
+				if (REALTIME_DXT_COMPRESSION)
+				{
+					void *compressed_data =	vtuCompressRGBA_DXT1(image_data);
+					vtpFree(image_data);
+					image_data = compressed_data;
+				}
 
-						vt.newPages.push(pageInfo);
+				vtuStorePageInCache(pageInfo, image_data);
 
-					}	// unlock
-				}
+				vtcInsertPageIntoCacheLOCK(pageInfo, image_data);
+				decompressedPages[decompressedCount++] = pageInfo;
 			}
+
+			vtStatsPagesDecompressed(pageCount, vtuTime() - start);
+
+			if (decompressedCount)
+				_vtFinishLoads(decompressedPages, decompressedCount);
 		}
 /*	}
 	catch (boost::thread_interrupted const&)
 	{
         }*/
 }
+
+void vtStartLoadingThreads()
+{
+	uint8_t count = c.decompressionThreads ? c.decompressionThreads : DECOMPRESSION_THREADS;
+
+	if (!count)
+	{
+		const int cores = OpenThreads::GetNumberOfProcessors() - 2; // leave the render and the loading thread alone
+		count = (uint8_t) ((cores < 1) ? 1 : ((cores > 64) ? 64 : cores));
+	}
+
+	vt.decompressionThreadCount = count;
+	vt.decompressionThreads = new LibVTBackgroundThread2[count];
+
+	vt.backgroundThread.start();//vt.backgroundThread = boost::thread(&vtLoadNeededPagesDecoupled);
+	for (uint8_t i = 0; i < count; i++)
+		vt.decompressionThreads[i].start();//vt.backgroundThread2 = boost::thread(&vtDecompressNeededPagesDecoupled);
+
+#if DEBUG_LOG > 0
+	printf("Started %u decompression threads\n", count);
+#endif
+}
+
+void vtStopLoadingThreads()
+{
+	vt.backgroundThread.cancel();
+	vt.backgroundThread.join();	// it may hold pool buffers, which must be back before vtpShutdown()
+
+	for (uint8_t i = 0; i < vt.decompressionThreadCount; i++)
+		vt.decompressionThreads[i].cancel();
+	for (uint8_t i = 0; i < vt.decompressionThreadCount; i++)
+		vt.decompressionThreads[i].join();
+
+	delete [] vt.decompressionThreads;
+	vt.decompressionThreads = NULL;
+	vt.decompressionThreadCount = 0;
+
+	{	// lock
+		LOCK(vt.compressedMutex)
+
+		while (!vt.newCompressedPages.empty())
+		{
+			vtuUnloadPageFile(vt.newCompressedPages.front().data);vt.newCompressedPages.pop_front();
+		}
+	}	// unlock
+}
 #endif
 
 void vtCachePages(queue<uint32_t> pagesToCache)
 {
-	char buf[255];
-
 	while(!pagesToCache.empty())
 	{
 		const uint32_t pageInfo = pagesToCache.front();pagesToCache.pop();
-		const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-		const uint8_t mip = EXTRACT_MIP(pageInfo);
-		void *image_data;
 
 
 		// load tile from cache or harddrive
 		if (!vtcIsPageInCacheLOCK(pageInfo))
 		{
-			snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_%u_%u.%s", c.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, mip, PATH_SEPERATOR, mip, x_coord, vt.mipTranslation[mip] - y_coord, c.pageCodec.c_str()); // convert from lower left coordinates (opengl) to top left (tile store on disk)
-
 #if DEBUG_LOG > 0
-			printf("Caching page from Disk: Mip:%u %u/%u\n", mip, x_coord, y_coord);
+			printf("Caching page from Disk: Mip:%u %u/%u\n", EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo));
 #endif
 
-			if (c.pageDXTCompression && !REALTIME_DXT_COMPRESSION)
-				image_data = vtuLoadFile(buf, 8, NULL);
+			void *image_data = _vtLoadAndDecompressPage(pageInfo);
+
+			if (image_data)
+				vtcInsertPageIntoCacheLOCK(pageInfo, image_data);
 			else
-				image_data = vtuDecompressImageFile(buf, &c.pageDimension);
+				vtuMarkPageMissing(pageInfo);
+		}
+	}
+}
 
-			if (REALTIME_DXT_COMPRESSION)
-			{
-				void *compressed_data =	vtuCompressRGBA_DXT1(image_data);
-				free(image_data);
-				image_data = compressed_data;
-			}
+// warm-up: precaching the highest mip levels of a store takes long for deep precache settings, so with ENABLE_MT it happens on its own thread
+// while the application goes on, e.g. with parsing the mesh. the resident pages don't wait for it, they go through the loading threads
+void vtWarmupPages(queue<uint32_t> pagesToCache)
+{
+#if ENABLE_MT
+	LOCK(vt.warmupMutex)
+
+	vt.warmupPageCount += (uint32_t) pagesToCache.size();
+	while (!pagesToCache.empty())
+	{
+		vt.warmupPages.push_back(pagesToCache.front());pagesToCache.pop();
+	}
 
-			vtcInsertPageIntoCacheLOCK(pageInfo, image_data);
+	vt.warmupPagesAvailableCondition.signal();
+#else
+	const uint32_t count = (uint32_t) pagesToCache.size();
+
+	vtCachePages(pagesToCache);
+
+	vt.warmupPageCount += count;
+	vt.warmupPagesDone += count;
+#endif
+}
+
+// drops the pages of a removed store that haven't been warmed up yet, they count as done
+void vtRemoveWarmupPages(const uint8_t store)
+{
+	LOCK(vt.warmupMutex)
+
+	deque<uint32_t> pages;
+	for (uint32_t i = 0; i < vt.warmupPages.size(); i++)
+		if (EXTRACT_STORE(vt.warmupPages[i]) != store)
+			pages.push_back(vt.warmupPages[i]);
+
+	vt.warmupPagesDone += (uint32_t) (vt.warmupPages.size() - pages.size());
+	vt.warmupPages.swap(pages);
+}
+
+#if ENABLE_MT
+void LibVTWarmupThread::run()
+{
+	while (1)
+	{
+		queue<uint32_t>	pagesToCache;
+
+		{	// lock
+			LOCK(vt.warmupMutex)
+
+			while (vt.warmupPages.empty())
+				vt.warmupPagesAvailableCondition.wait(&vt.warmupMutex);
+
+			pagesToCache.push(vt.warmupPages.front());vt.warmupPages.pop_front();
+		}	// unlock
+
+		setCancelModeDisable(); // a page that is being loaded holds pool buffers, vtStopWarmupThread() cancels between pages
+		if (_vtAcquirePageLOCK(pagesToCache.front())) // its store may have been removed since it was queued
+		{
+			const uint32_t pageInfo = pagesToCache.front();
+
+			vtCachePages(pagesToCache);
+			_vtReleasePageLOCK(pageInfo);
 		}
+		setCancelModeDeferred();
+
+		{	// lock
+			LOCK(vt.warmupMutex)
+
+			vt.warmupPagesDone++;
+		}	// unlock
 	}
 }
+
+void vtStartWarmupThread()
+{
+	vt.warmupThread.start();
+}
+
+void vtStopWarmupThread()
+{
+	{	// lock
+		LOCK(vt.warmupMutex)
+
+		vt.warmupPages.clear(); // the current page is finished, then the thread is cancelled while waiting for the next one
+	}	// unlock
+
+	vt.warmupThread.cancel();
+	vt.warmupThread.join();
+}
+
+// only the latest requests are worth reading ahead for, older hints are dropped once this many are waiting
+#define READAHEAD_QUEUE_LIMIT (IO_BATCH * 3 * 4)
+
+void vtReadaheadPages(const vector<uint32_t> &pages)
+{
+	if (pages.empty())
+		return;
+
+	LOCK(vt.readaheadMutex)
+
+	vt.readaheadPages.insert(vt.readaheadPages.end(), pages.begin(), pages.end());
+	while (vt.readaheadPages.size() > READAHEAD_QUEUE_LIMIT)
+		vt.readaheadPages.pop_front();
+
+	vt.readaheadPagesAvailableCondition.signal();
+}
+
+void LibVTReadaheadThread::run()
+{
+	while (1)
+	{
+		uint32_t pageInfo;
+
+		{	// lock
+			LOCK(vt.readaheadMutex)
+
+			while (vt.readaheadPages.empty())
+				vt.readaheadPagesAvailableCondition.wait(&vt.readaheadMutex);
+
+			pageInfo = vt.readaheadPages.back();vt.readaheadPages.pop_back();
+		}	// unlock
+
+		if (!_vtAcquirePageLOCK(pageInfo)) // its store has been removed meanwhile
+			continue;
+
+		if (!vtcIsPageInCacheLOCK(pageInfo)) // it may have been requested meanwhile
+			vtuAdvisePageFile(pageInfo);
+
+		_vtReleasePageLOCK(pageInfo);
+	}
+}
+
+void vtStartReadaheadThread()
+{
+	vt.readaheadThread.setSchedulePriority(OpenThreads::Thread::THREAD_PRIORITY_LOW);
+	vt.readaheadThread.start();
+}
+
+void vtStopReadaheadThread()
+{
+	{	// lock
+		LOCK(vt.readaheadMutex)
+
+		vt.readaheadPages.clear();
+	}	// unlock
+
+	vt.readaheadThread.cancel();
+	vt.readaheadThread.join();
+}
+#endif
+
+void vtGetWarmupProgress(uint32_t *donePages, uint32_t *totalPages)
+{
+	LOCK(vt.warmupMutex)
+
+	*donePages = vt.warmupPagesDone;
+	*totalPages = vt.warmupPageCount;
+}
@@ -21,284 +21,457 @@
 extern vtData vt;
 extern vtConfig c;
 
-void _mapPageFallbackEntries(int m, int x_coord, int y_coord, int mip, int x, int y);
-void _unmapPageFallbackEntries(int m, int x_coord, int y_coord, int x_search, int y_search, int mip_repl, int x_repl, int y_repl);
+void _mapPageFallbackEntries(int s, int m, int x_coord, int y_coord, int mip, int x, int y);
+void _unmapPageFallbackEntries(int s, int m, int x_coord, int y_coord, int x_search, int y_search, int mip_repl, int x_repl, int y_repl);
 
 
 void __debugEraseCachedPages();
 //#define DEBUG_ERASE_CACHED_PAGES_EVERY_FRAME
 
 
+struct vtPageUpload
+{
+	uint8_t		x, y;			// slot in the physical texture
+	uint32_t	offset;			// of the page data in the upload ring buffer
+};
 
 
-void vtMapNewPages()
+uint32_t vtPageUploadSize()
 {
-	queue<uint32_t>	newPages, zero;
+	return c.pageMemsize + (MIPPED_PHYSTEX ? c.pageMemsize / 4 : 0);
+}
 
+uint32_t vtMaxPageUploadsPerFrame()
+{
+	const uint32_t pages = MAX_UPLOAD_KB_PER_FRAME * 1024 / vtPageUploadSize();
 
-#if !ENABLE_MT
-	vtLoadNeededPages();
-#endif
+	return pages ? pages : 1;
+}
 
+// grows the dirty rectangle the entry is in or next to, else starts a new one. when they are all used up the one that grows least takes it
+static inline void _vtTouchPageTable(const uint8_t store, const uint8_t mip, const uint16_t x, const uint16_t y)
+{
+	vtDirtyRect *rects = STORE(store).pageTableDirty[mip];
+	uint8_t &count = STORE(store).pageTableDirtyCount[mip];
+	uint32_t bestGrowth = 0xFFFFFFFF, bestSide = 0;
+	uint8_t best = 0;
 
-	{	// lock
-		LOCK(vt.newPagesMutex)
+	for (uint8_t i = 0; i < count; i++)
+	{
+		const vtDirtyRect &r = rects[i];
+		const uint32_t w = r.x1 + 1 - r.x0, h = r.y1 + 1 - r.y0;
+		const uint32_t gw = ((x > r.x1) ? x : r.x1) + 1 - ((x < r.x0) ? x : r.x0);
+		const uint32_t gh = ((y > r.y1) ? y : r.y1) + 1 - ((y < r.y0) ? y : r.y0);
+		const uint32_t growth = gw * gh - w * h;
 
-		vt.missingPageCount = vt.neededPages.size(); // just stats keeping
+		if (!growth)
+			return;
 
-		if (USE_PBO_PHYSTEX)
+		if (growth < bestGrowth)
 		{
-			uint8_t i = 0;
-			vt.newPageCount = 0;
-			while (i < PBO_PHYSTEX_PAGES && !vt.newPages.empty())
-			{
-				newPages.push(vt.newPages.front());vt.newPages.pop();
-				i++;
-				vt.newPageCount++;  // just stats keeping
-			}
+			bestGrowth = growth;
+			bestSide = (w > h) ? w : h;
+			best = i;
 		}
+	}
+
+	if (!count || ((bestGrowth > bestSide) && (count < PAGETABLE_DIRTY_RECTS))) // not adjacent to any rectangle
+	{
+		vtDirtyRect &r = rects[count++];
+		r.x0 = r.x1 = x;
+		r.y0 = r.y1 = y;
+		return;
+	}
+
+	vtDirtyRect &r = rects[best];
+	if (x < r.x0) r.x0 = x;
+	if (x > r.x1) r.x1 = x;
+	if (y < r.y0) r.y0 = y;
+	if (y > r.y1) r.y1 = y;
+}
+
+static inline void _vtRequeueNewPages(queue<uint32_t> &newPages)
+{
+	LOCK(vt.newPagesMutex)
+
+	vt.newPageCount -= (uint16_t) newPages.size(); // just stats keeping, these are retried next frame
+
+	while (!newPages.empty())
+	{
+		vt.newPages.push(newPages.front());newPages.pop();
+	}
+}
+
+static void _vtUploadPage(const uint8_t x, const uint8_t y, const void *image_data, const void *mippedData)
+{
+	const uint32_t column = SLOT_COLUMN(x), row = SLOT_ROW(y);
+
+#if !GL_ES_VERSION_2_0
+	if (c.physTexLayers > 1)
+	{
+		const uint32_t layer = SLOT_LAYER(x, y);
+
+		if (c.pageDXTCompression)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, column * c.pageDimension, row * c.pageDimension, layer, c.pageDimension, c.pageDimension, 1, c.pageDXTCompression, c.pageMemsize, image_data);
 		else
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, column * c.pageDimension, row * c.pageDimension, layer, c.pageDimension, c.pageDimension, 1, c.pageDataFormat, c.pageDataType, image_data);
+
+		if (MIPPED_PHYSTEX)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 1, column * (c.pageDimension / 2), row * (c.pageDimension / 2), layer, (c.pageDimension / 2), (c.pageDimension / 2), 1, c.pageDataFormat, c.pageDataType, mippedData);
+
+		return;
+	}
+#endif
+
+	if (c.pageDXTCompression)
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, column * c.pageDimension, row * c.pageDimension, c.pageDimension, c.pageDimension, c.pageDXTCompression, c.pageMemsize, image_data);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, column * c.pageDimension, row * c.pageDimension, c.pageDimension, c.pageDimension, c.pageDataFormat, c.pageDataType, image_data);
+
+	if (MIPPED_PHYSTEX)
+		glTexSubImage2D(GL_TEXTURE_2D, 1, column * (c.pageDimension / 2), row * (c.pageDimension / 2), (c.pageDimension / 2), (c.pageDimension / 2), c.pageDataFormat, c.pageDataType, mippedData);
+}
+
+// packs the dirty rectangles of the page table of a store at buffer + offset and uploads them, from the bound upload ring buffer if USE_PBO_PAGETABLE. returns the bytes packed
+static uint32_t _vtUploadPageTable(const uint8_t store, uint8_t *buffer, uint32_t offset)
+{
+	vtStore &st = STORE(store);
+	const uint32_t start = offset;
+
+	glBindTexture(GL_TEXTURE_2D, st.pageTableTexture);
+
+	for (uint8_t i = 0; i < st.mipChainLength; i++)
+	{
+		const uint32_t dim = st.virtTexDimensionPages >> i;
+		uint32_t area = 0;
+
+		for (uint8_t r = 0; r < st.pageTableDirtyCount[i]; r++)
+			area += (st.pageTableDirty[i][r].x1 + 1 - st.pageTableDirty[i][r].x0) * (st.pageTableDirty[i][r].y1 + 1 - st.pageTableDirty[i][r].y0);
+
+		if (area > dim * dim) // merged rectangles overlap, the whole level is cheaper and keeps a level within its share of the buffer
 		{
-			newPages = vt.newPages;
-			vt.newPageCount = newPages.size();  // just stats keeping
-			vt.newPages = zero;
+			st.pageTableDirtyCount[i] = 1;
+			st.pageTableDirty[i][0].x0 = st.pageTableDirty[i][0].y0 = 0;
+			st.pageTableDirty[i][0].x1 = st.pageTableDirty[i][0].y1 = dim - 1;
 		}
-	}	// unlock
 
-	// we do this here instead of in vtLoadNeededPages() when new pages are actually mapped so it runs on the mainThread and the cachedPagesAccessTimes structure doesn't need to be locked
-	vtcReduceCacheIfNecessaryLOCK(vt.thisFrameClock);
+		for (uint8_t r = 0; r < st.pageTableDirtyCount[i]; r++)
+		{
+			const vtDirtyRect &rect = st.pageTableDirty[i][r];
+			const uint32_t w = rect.x1 + 1 - rect.x0, h = rect.y1 + 1 - rect.y0;
+
+			for (uint32_t y = 0; y < h; y++) // tightly packed, GL ES has no GL_UNPACK_ROW_LENGTH
+				memcpy(buffer + offset + y * w * 4, st.pageTables[i] + (rect.y0 + y) * dim + rect.x0, w * 4);
 
-	if (!newPages.empty())
+			glTexSubImage2D(GL_TEXTURE_2D, i, rect.x0, rect.y0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, (USE_PBO_PAGETABLE ? (uint8_t *) NULL : buffer) + offset);
+			offset += w * h * 4;
+		}
+
+		st.pageTableDirtyCount[i] = 0;
+	}
+
+	return offset - start;
+}
+
+static inline bool _vtPageTableDirty(const uint8_t store)
+{
+	if (!STORE(store).active)
+		return false;
+
+	for (uint8_t i = 0; i < STORE(store).mipChainLength; i++)
+		if (STORE(store).pageTableDirtyCount[i])
+			return true;
+
+	return false;
+}
+
+static inline bool _vtPageTablesDirty()
+{
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		if (_vtPageTableDirty(s))
+			return true;
+
+	return false;
+}
+
+// the dirty page tables of all stores, packed one after the other if they go through the upload ring, else each at the start of the staging buffer. returns the bytes packed
+static uint32_t _vtUploadPageTables(uint8_t *buffer, uint32_t offset)
+{
+	uint32_t bytes = 0;
+
+	glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PAGETABLE);
+
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		if (_vtPageTableDirty(s))
+			bytes += _vtUploadPageTable(s, buffer, USE_PBO_PAGETABLE ? offset + bytes : offset);
+
+	return bytes;
+}
+
+// binds and maps the next buffer of the upload ring. it was last used UPLOAD_RING_BUFFERS - 1 frames ago, so the GPU should be done with it
+static uint8_t * _vtMapUploadRing()
+{
+	uint8_t *ring = NULL;
+
+#if !GL_ES_VERSION_2_0
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, vt.uploadRing[vt.uploadRingNext]);
+	vt.uploadRingNext = (vt.uploadRingNext + 1) % UPLOAD_RING_BUFFERS;
+
+	ring = (uint8_t *)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	assert(ring);
+#endif
+
+	return ring;
+}
+
+// PI controller for the LoD bias. the error is the log4 of the occupancy over the target, in mip levels like the bias, because each level of bias changes the page count by about 4x. that keeps the loop gain the same for small and overflowing working sets
+static void _vtAdjustBias()
+{
+	const float target = c.targetOccupancy ? c.targetOccupancy : DYNAMIC_LOD_TARGET_OCCUPANCY;
+	const float capacity = (float) (c.physTexDimensionPages * c.physTexDimensionPages * c.physTexLayers);
+	uint8_t stores = 0, mipChainLength = 1;
+
+	for (uint8_t s = 0; s < vt.storeCount; s++)
 	{
-		bool foundSlot = true;
-		const void *image_data;
+		if (!STORE(s).active)
+			continue;
 
-		for (uint8_t i = 0; i < c.mipChainLength; i++)
-		{
-#ifdef DEBUG_ERASE_CACHED_PAGES_EVERY_FRAME
-			vt.mipLevelTouched[i] = true;
-			vt.mipLevelMinrow[i] = 0;
-			vt.mipLevelMaxrow[i] = (c.virtTexDimensionPages >> i) - 1;
-#else
-			vt.mipLevelTouched[i] = false;
-			vt.mipLevelMinrow[i] = (uint16_t) c.virtTexDimensionPages >> i;
-			vt.mipLevelMaxrow[i] = 0;
+		stores++;
+		if (STORE(s).mipChainLength > mipChainLength)
+			mipChainLength = STORE(s).mipChainLength;
+	}
+
+	const float demand = (float) (vt.necessaryPageCount + c.residentPages * stores);
+	const float maxBias = (float) (mipChainLength - 1);
+	float error = 0.5f * log2f(demand / (target * capacity));
+
+	if (fabsf(error) <= DYNAMIC_LOD_HYSTERESIS) // close enough, hold the bias
+		error = 0.0f;
+	else // measured from the edge of the deadband, so the bias doesn't jump when leaving it
+		error -= (error > 0.0f) ? DYNAMIC_LOD_HYSTERESIS : -DYNAMIC_LOD_HYSTERESIS;
+
+	vt.biasIntegral += DYNAMIC_LOD_GAIN_I * error;
+	vt.biasIntegral = (vt.biasIntegral < 0.0f) ? 0.0f : ((vt.biasIntegral > maxBias) ? maxBias : vt.biasIntegral); // no windup while the bias is clamped
+
+	const float bias = vt.biasIntegral + DYNAMIC_LOD_GAIN_P * error;
+
+	vt.bias = (bias < 0.0f) ? 0.0f : ((bias > maxBias) ? maxBias : bias);
+}
+
+void vtMapNewPages()
+{
+	queue<uint32_t>	newPages;
+	vector<vtPageUpload> pageUploads;
+	uint32_t uploadBytes = 0;
+
+
+#if !ENABLE_MT
+	vtLoadNeededPages();
 #endif
-		}
 
+	const double start = vtuTime();
+	const uint32_t maxPages = vtMaxPageUploadsPerFrame();
 
+	{	// lock
+		LOCK(vt.neededPagesMutex)
 
-#if USE_PBO_PHYSTEX
-		uint8_t xCoordinatesForPageMapping[PBO_PHYSTEX_PAGES];
-		uint8_t yCoordinatesForPageMapping[PBO_PHYSTEX_PAGES];
-		uint8_t newPageCount = 0;
+		vt.missingPageCount = vt.neededPages.size(); // just stats keeping
+	}	// unlock
 
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, vt.pboPhystex);
-		glBufferData(GL_PIXEL_UNPACK_BUFFER, c.pageMemsize * PBO_PHYSTEX_PAGES, 0, GL_STREAM_DRAW);
+	{	// lock
+		LOCK(vt.newPagesMutex)
 
-		uint8_t *phys_buffer = (uint8_t *)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
-		assert(phys_buffer);
+		vt.newPageCount = 0;
+		while (vt.newPageCount < maxPages && !vt.newPages.empty()) // the rest waits for the next frame, MAX_UPLOAD_KB_PER_FRAME
+		{
+			newPages.push(vt.newPages.front());vt.newPages.pop();
+			vt.newPageCount++;  // just stats keeping
+		}
+	}	// unlock
+
+#ifdef DEBUG_ERASE_CACHED_PAGES_EVERY_FRAME
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		for (uint8_t i = 0; i < STORE(s).mipChainLength; i++)
+		{
+			STORE(s).pageTableDirtyCount[i] = 1;
+			STORE(s).pageTableDirty[i][0].x0 = STORE(s).pageTableDirty[i][0].y0 = 0;
+			STORE(s).pageTableDirty[i][0].x1 = STORE(s).pageTableDirty[i][0].y1 = (STORE(s).virtTexDimensionPages >> i) - 1;
+		}
 #endif
 
+	uint8_t *ring = NULL;
+
+	if (USE_PBO_PHYSTEX && !newPages.empty())
+		ring = _vtMapUploadRing();
+
+	if (!newPages.empty())
+	{
+		bool foundSlot = true;
+		const void *image_data;
 
 		glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PHYSTEX);
 
+		if (USE_PBO_PHYSTEX)
+			pageUploads.reserve(newPages.size());
+
 		while(!newPages.empty() && foundSlot)
 		{
+			if (uploadBytes && ((vtuTime() - start) * 1000.0 > MAX_UPLOAD_MS_PER_FRAME)) // out of time, the rest waits for the next frame
+			{
+				_vtRequeueNewPages(newPages);
+				break;
+			}
+
 			const uint32_t pageInfo = newPages.front();newPages.pop();
 			const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-			const uint8_t mip = EXTRACT_MIP(pageInfo);
+			const uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
+
+			if (!STORE(store).active || ((uint8_t) PAGE_TABLE(store, mip, x_coord, y_coord) == kTableMapped)) // loaded for a store that has been removed since, or passed on twice
+			{
+				vt.newPageCount--; // just stats keeping
+				continue;
+			}
 
 			image_data = vtcRetrieveCachedPageLOCK(pageInfo);
-            if(image_data == NULL){
-                continue;
-            }
-			// find slot
-			bool foundFree = false;
-			uint8_t x, y, storedX = 0, storedY = 0;
-			clock_t lowestClock = vt.thisFrameClock;
-
-			foundSlot = false;
-
-			// find least recently used or free page
-			for (x = 0; x < c.physTexDimensionPages; x++)
+			if (image_data == NULL) // failed to load or evicted from the RAM cache before it could be mapped, free it in the page table so the next readback requests it again if it still exists
 			{
-				for (y = 0; y < c.physTexDimensionPages; y++)
-				{
-					if ((vt.textureStorageInfo[x][y].clockUsed < lowestClock) && (vt.textureStorageInfo[x][y].mip < c.mipChainLength - HIGHEST_MIP_LEVELS_TO_KEEP))
-					{
-						lowestClock = vt.textureStorageInfo[x][y].clockUsed;
-						storedX = x;
-						storedY = y;
-						foundSlot = true;
-
-						if (lowestClock == 0)
-						{
-							foundFree = true;
-							break;
-						}
-					}
-				}
-				if (foundFree)
-					break;
+				*((uint8_t *)&PAGE_TABLE(store, mip, x_coord, y_coord)) = kTableFree;
+				continue;
 			}
+			// take a free slot or the least recently used one
+			bool foundFree;
+			uint8_t x, y;
+
+			foundSlot = vtsAllocateSlot(&x, &y, &foundFree);
 
 
 			if (foundSlot)
 			{
-				x = storedX;
-				y = storedY;
-
 				if (!foundFree)
 				{
 					// unmap page
 #if DEBUG_LOG > 0
-					printf("Unloading page from VRAM: Mip:%u %u/%u from %u/%u lastUsed: %llu\n", vt.textureStorageInfo[x][y].mip, vt.textureStorageInfo[x][y].x, vt.textureStorageInfo[x][y].y, x, y, (long long unsigned int)lowestClock);
+					printf("Unloading page from VRAM: Store:%u Mip:%u %u/%u from %u/%u lastUsed: %u\n", STORAGE_INFO(x, y).store, STORAGE_INFO(x, y).mip, STORAGE_INFO(x, y).x, STORAGE_INFO(x, y).y, x, y, STORAGE_INFO(x, y).frameUsed);
 #endif
 
-					vtUnmapPage(vt.textureStorageInfo[x][y].mip, vt.textureStorageInfo[x][y].x, vt.textureStorageInfo[x][y].y, x, y); // dont need complete version cause we map a new page at the same location
+					vtUnmapPage(STORAGE_INFO(x, y).store, STORAGE_INFO(x, y).mip, STORAGE_INFO(x, y).x, STORAGE_INFO(x, y).y, x, y); // dont need complete version cause we map a new page at the same location
 				}
 
-				assert((x < c.physTexDimensionPages) && (y < c.physTexDimensionPages));
+				assert(SLOT_VALID(x, y));
 
 
 				// map page
 				//vt.textureStorageInfo[x][y].active = true;
-				vt.textureStorageInfo[x][y].x = x_coord;
-				vt.textureStorageInfo[x][y].y = y_coord;
-				vt.textureStorageInfo[x][y].mip = mip;
-				vt.textureStorageInfo[x][y].clockUsed = vt.thisFrameClock;
+				vtsAssignSlot(x, y, store, mip, x_coord, y_coord);
 
 
 
-				PAGE_TABLE(mip, x_coord, y_coord) = (MIP_INFO(mip) << 24) + (x << 16) + (y << 8) + kTableMapped;
+				PAGE_TABLE(store, mip, x_coord, y_coord) = (MIP_INFO(store, mip) << 24) + (x << 16) + (y << 8) + kTableMapped;
 
 
-				touchMipRow(mip, y_coord)
+				_vtTouchPageTable(store, mip, x_coord, y_coord);
 
 				if (FALLBACK_ENTRIES)
 				{
 					if (mip >= 1)
 					{
-						_mapPageFallbackEntries(mip - 1, x_coord * 2, y_coord * 2, mip, x, y);
-						_mapPageFallbackEntries(mip - 1, x_coord * 2, y_coord * 2 + 1, mip, x, y);
-						_mapPageFallbackEntries(mip - 1, x_coord * 2 + 1, y_coord * 2, mip, x, y);
-						_mapPageFallbackEntries(mip - 1, x_coord * 2 + 1, y_coord * 2 + 1, mip, x, y);
+						_mapPageFallbackEntries(store, mip - 1, x_coord * 2, y_coord * 2, mip, x, y);
+						_mapPageFallbackEntries(store, mip - 1, x_coord * 2, y_coord * 2 + 1, mip, x, y);
+						_mapPageFallbackEntries(store, mip - 1, x_coord * 2 + 1, y_coord * 2, mip, x, y);
+						_mapPageFallbackEntries(store, mip - 1, x_coord * 2 + 1, y_coord * 2 + 1, mip, x, y);
 					}
 				}
 
-
-#if USE_PBO_PHYSTEX
-				memcpy(phys_buffer + c.pageMemsize * newPageCount, image_data, c.pageMemsize);
-				xCoordinatesForPageMapping[newPageCount] = x;
-				yCoordinatesForPageMapping[newPageCount] = y;
-
-				newPageCount ++;
-#else
-
-
-				if (c.pageDXTCompression)
-					glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x * c.pageDimension, y * c.pageDimension, c.pageDimension, c.pageDimension, c.pageDXTCompression, c.pageMemsize, image_data);
-				else
-					glTexSubImage2D(GL_TEXTURE_2D, 0, x * c.pageDimension, y * c.pageDimension, c.pageDimension, c.pageDimension, c.pageDataFormat, c.pageDataType, image_data);
-
+				const void *mippedData = NULL;
 #if MIPPED_PHYSTEX
-				uint32_t *mippedData;
-
-				if (IMAGE_DECOMPRESSION_LIBRARY == DecompressionMac) // TODO: assert away other option
+				if (DECODED_HALF_PAGES) // the decompressor already produced it
+					mippedData = (const uint8_t *) image_data + c.pageMemsize;
+				else if (IMAGE_DECOMPRESSION_LIBRARY == DecompressionMac) // TODO: assert away other option
 					mippedData = vtuDownsampleImageRGBA((const uint32_t *)image_data);
 				else
 					mippedData = vtuDownsampleImageRGB((const uint32_t *)image_data);
+#endif
+
+				if (USE_PBO_PHYSTEX)
+				{
+					vtPageUpload upload = {x, y, uploadBytes};
+
+					memcpy(ring + uploadBytes, image_data, c.pageMemsize);
+					if (MIPPED_PHYSTEX)
+						memcpy(ring + uploadBytes + c.pageMemsize, mippedData, c.pageMemsize / 4);
+					pageUploads.push_back(upload);
+				}
+				else
+					_vtUploadPage(x, y, image_data, mippedData);
+
+				uploadBytes += vtPageUploadSize();
 
-				glTexSubImage2D(GL_TEXTURE_2D, 1, x * (c.pageDimension / 2), y * (c.pageDimension / 2), (c.pageDimension / 2), (c.pageDimension / 2), c.pageDataFormat, c.pageDataType, mippedData);
-				free(mippedData);
+#if MIPPED_PHYSTEX
+				if (!DECODED_HALF_PAGES)
+					vtpFree((void *) mippedData);
 #endif
 #if DEBUG_LOG > 0
-				printf("Loading page to VRAM: Mip:%u %u/%u to %u/%u\n", mip, x_coord, y_coord, x, y);
-#endif
+				printf("Loading page to VRAM: Store:%u Mip:%u %u/%u to %u/%u\n", store, mip, x_coord, y_coord, x, y);
 #endif
 			}
 			else
-			{	// lock
-				LOCK(vt.newPagesMutex)
-
-				printf("WARNING: skipping page loading because there are no free slots %i %i \n", vt.necessaryPageCount, c.physTexDimensionPages * c.physTexDimensionPages);
+			{
+				printf("WARNING: skipping page loading because there are no free slots %i %i \n", vt.necessaryPageCount, c.physTexDimensionPages * c.physTexDimensionPages * c.physTexLayers);
 
-				vt.newPages.push(pageInfo);
+				queue<uint32_t> retry;
 
+				retry.push(pageInfo);
 				while (!newPages.empty())
 				{
-					vt.newPages.push(newPages.front());newPages.pop();
+					retry.push(newPages.front());newPages.pop();
 				}
-			}	// unlock
-		}
-
-#if USE_PBO_PHYSTEX
-		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				_vtRequeueNewPages(retry);
+			}
 
-		for (uint8_t i = 0; i < newPageCount; i++)
-		{
-			if (c.pageDXTCompression)
-				glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, xCoordinatesForPageMapping[i] * c.pageDimension, yCoordinatesForPageMapping[i] * c.pageDimension, c.pageDimension, c.pageDimension, c.pageDXTCompression, c.pageMemsize, (uint8_t *) NULL + (i * c.pageMemsize));
-			else
-				glTexSubImage2D(GL_TEXTURE_2D, 0, xCoordinatesForPageMapping[i] * c.pageDimension, yCoordinatesForPageMapping[i] * c.pageDimension, c.pageDimension, c.pageDimension, c.pageDataFormat, c.pageDataType,  (uint8_t *) NULL + (i * c.pageMemsize));
+			vtcReleaseCachedPageLOCK(pageInfo); // the page data has been copied to the texture or the upload ring, the cache may evict it again
 		}
+	}
 
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-#endif
-
-		glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PAGETABLE);
+	if (USE_PBO_PAGETABLE && !ring && _vtPageTablesDirty())
+		ring = _vtMapUploadRing();
 
+#if !GL_ES_VERSION_2_0
+	if (ring)
+	{
+		uint32_t tableBytes = 0;
 
-#if USE_PBO_PAGETABLE
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, vt.pboPagetable);
-		glBufferData(GL_PIXEL_UNPACK_BUFFER, (vt.pageTableMipOffsets[c.mipChainLength - 1] + 1) * 4, 0, GL_STREAM_DRAW);
+		if (USE_PBO_PAGETABLE)
+			tableBytes = _vtUploadPageTables(ring, uploadBytes); // packed behind the pages, the uploads are sourced once the buffer is unmapped
 
-		uint32_t *table_buffer = (uint32_t *)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
-		assert(table_buffer);
-		memcpy(table_buffer, vt.pageTables[0], (vt.pageTableMipOffsets[c.mipChainLength - 1] + 1) * 4);
 		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
-#endif
-
 
-		// done, upload pageTable
-		for (uint8_t i = 0; i < c.mipChainLength; i++)
+		if (USE_PBO_PHYSTEX && !pageUploads.empty())
 		{
-			if (vt.mipLevelTouched[i] == true) // the whole touched, minrow, maxrow mess is there so we update only between the lowest and highest modified row, or nothing at all if no pixels are touched. ideally the page table updates should be much more finely grained than that.
-			{
-#if USE_PBO_PAGETABLE
-				glTexSubImage2D(GL_TEXTURE_2D, i, 0, vt.mipLevelMinrow[i], c.virtTexDimensionPages >> i, vt.mipLevelMaxrow[i] + 1 - vt.mipLevelMinrow[i], GL_RGBA, GL_UNSIGNED_BYTE, (uint32_t *) NULL + (vt.pageTableMipOffsets[i] + (c.virtTexDimensionPages >> i) * vt.mipLevelMinrow[i]));
-#else
-				glTexSubImage2D(GL_TEXTURE_2D, i, 0, vt.mipLevelMinrow[i], c.virtTexDimensionPages >> i, vt.mipLevelMaxrow[i] + 1 - vt.mipLevelMinrow[i], GL_RGBA, GL_UNSIGNED_BYTE, vt.pageTables[i] + (c.virtTexDimensionPages >> i) * vt.mipLevelMinrow[i]);
-#endif
-			}
-		}
+			glActiveTexture(GL_TEXTURE0 + TEXUNIT_FOR_PHYSTEX);
 
+			for (uint32_t i = 0; i < pageUploads.size(); i++)
+				_vtUploadPage(pageUploads[i].x, pageUploads[i].y, (uint8_t *) NULL + pageUploads[i].offset, (uint8_t *) NULL + pageUploads[i].offset + c.pageMemsize);
+		}
 
-#if USE_PBO_PAGETABLE
+		uploadBytes += tableBytes;
 		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
 #endif
 
-		glActiveTexture(GL_TEXTURE0);
-	}
+	if (!USE_PBO_PAGETABLE && _vtPageTablesDirty())
+		uploadBytes += _vtUploadPageTables((uint8_t *) vt.pageTableStaging, 0);
 
-	if (DYNAMIC_LOD_ADJUSTMENT)
-	{	// automatic LoD bias adjustment
-		float std; // TODO: doing this here is a BUG
+	glActiveTexture(GL_TEXTURE0);
 
-		if (MIPPED_PHYSTEX)
-			std = -0.5;
-		else
-			std = 0.;
+	vt.uploadBytes = uploadBytes; // just stats keeping
 
-		int pageOverflow =	vt.necessaryPageCount + c.residentPages - c.physTexDimensionPages * c.physTexDimensionPages;
+	if (DYNAMIC_LOD_ADJUSTMENT)
+		_vtAdjustBias();
 
-		if (pageOverflow > -2.0f)
-			vt.bias += 0.1f;
+	vt.uploadSeconds = vtuTime() - start; // just stats keeping
 
-		if (pageOverflow < -7.0f && vt.bias > 0.0f)
-			vt.bias -= 0.1f;
-	}
+	if (vt.traceFile)
+		vtStatsTraceFrame();
 
 #ifdef DEBUG_ERASE_CACHED_PAGES_EVERY_FRAME
 	__debugEraseCachedPages();
@@ -310,9 +483,9 @@ void vtMapNewPages()
 //	{
 //		for (int y = 0; y < c.physTexDimensionPages; y++)
 //		{
-//			if ((vt.textureStorageInfo[x][y].clockUsed == vt.thisFrameClock))
+//			if ((STORAGE_INFO(x, y).frameUsed == vt.thisFrame))
 //			{
-//				printf("PAGE: %i ", MAKE_PAGE_INFO(vt.textureStorageInfo[x][y].mip, vt.textureStorageInfo[x][y].x, vt.textureStorageInfo[x][y].y));
+//				printf("PAGE: %i ", MAKE_PAGE_INFO(STORAGE_INFO(x, y).store, STORAGE_INFO(x, y).mip, STORAGE_INFO(x, y).x, STORAGE_INFO(x, y).y));
 //			}
 //		}
 //	}
@@ -320,68 +493,65 @@ void vtMapNewPages()
 }
 
 
-void _mapPageFallbackEntries(int m, int x_coord, int y_coord, int mip, int x, int y) // TODO: test long mip chain
+void _mapPageFallbackEntries(int s, int m, int x_coord, int y_coord, int mip, int x, int y) // TODO: test long mip chain
 {
-	const uint32_t pageEntry = PAGE_TABLE(m, x_coord, y_coord);
+	const uint32_t pageEntry = PAGE_TABLE(s, m, x_coord, y_coord);
 
 	if ((uint8_t) pageEntry != kTableMapped)
 	{
-		PAGE_TABLE(m, x_coord, y_coord) = (MIP_INFO(mip) << 24) + (x << 16) + (y << 8) + ((uint8_t) pageEntry);
-		touchMipRow(m, y_coord)
+		PAGE_TABLE(s, m, x_coord, y_coord) = (MIP_INFO(s, mip) << 24) + (x << 16) + (y << 8) + ((uint8_t) pageEntry);
+		_vtTouchPageTable(s, m, x_coord, y_coord);
 
 		if (m >= 1)
 		{
-			_mapPageFallbackEntries(m - 1, x_coord * 2, y_coord * 2, mip, x, y);
-			_mapPageFallbackEntries(m - 1, x_coord * 2, y_coord * 2 + 1, mip, x, y);
-			_mapPageFallbackEntries(m - 1, x_coord * 2 + 1, y_coord * 2, mip, x, y);
-			_mapPageFallbackEntries(m - 1, x_coord * 2 + 1, y_coord * 2 + 1, mip, x, y);
+			_mapPageFallbackEntries(s, m - 1, x_coord * 2, y_coord * 2, mip, x, y);
+			_mapPageFallbackEntries(s, m - 1, x_coord * 2, y_coord * 2 + 1, mip, x, y);
+			_mapPageFallbackEntries(s, m - 1, x_coord * 2 + 1, y_coord * 2, mip, x, y);
+			_mapPageFallbackEntries(s, m - 1, x_coord * 2 + 1, y_coord * 2 + 1, mip, x, y);
 		}
 	}
 }
 
-void _unmapPageFallbackEntries(int m, int x_coord, int y_coord, int x_search, int y_search, int mip_repl, int x_repl, int y_repl)
+void _unmapPageFallbackEntries(int s, int m, int x_coord, int y_coord, int x_search, int y_search, int mip_repl, int x_repl, int y_repl)
 {
-	const uint32_t pageEntry = PAGE_TABLE(m, x_coord, y_coord);
+	const uint32_t pageEntry = PAGE_TABLE(s, m, x_coord, y_coord);
 
 	if ((BYTE3(pageEntry) == x_search) && (BYTE2(pageEntry) == y_search))
 	{
-		PAGE_TABLE(m, x_coord, y_coord) = (mip_repl << 24) + (x_repl << 16) + (y_repl << 8) + ((uint8_t) pageEntry);
-		touchMipRow(m, y_coord)
+		PAGE_TABLE(s, m, x_coord, y_coord) = (mip_repl << 24) + (x_repl << 16) + (y_repl << 8) + ((uint8_t) pageEntry);
+		_vtTouchPageTable(s, m, x_coord, y_coord);
 
 		if (m >= 1)
 		{
-			_unmapPageFallbackEntries(m - 1, x_coord * 2, y_coord * 2, x_search, y_search, mip_repl, x_repl, y_repl);
-			_unmapPageFallbackEntries(m - 1, x_coord * 2, y_coord * 2 + 1, x_search, y_search, mip_repl, x_repl, y_repl);
-			_unmapPageFallbackEntries(m - 1, x_coord * 2 + 1, y_coord * 2, x_search, y_search, mip_repl, x_repl, y_repl);
-			_unmapPageFallbackEntries(m - 1, x_coord * 2 + 1, y_coord * 2 + 1, x_search, y_search, mip_repl, x_repl, y_repl);
+			_unmapPageFallbackEntries(s, m - 1, x_coord * 2, y_coord * 2, x_search, y_search, mip_repl, x_repl, y_repl);
+			_unmapPageFallbackEntries(s, m - 1, x_coord * 2, y_coord * 2 + 1, x_search, y_search, mip_repl, x_repl, y_repl);
+			_unmapPageFallbackEntries(s, m - 1, x_coord * 2 + 1, y_coord * 2, x_search, y_search, mip_repl, x_repl, y_repl);
+			_unmapPageFallbackEntries(s, m - 1, x_coord * 2 + 1, y_coord * 2 + 1, x_search, y_search, mip_repl, x_repl, y_repl);
 		}
 	}
 }
 
-void vtUnmapPage(int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location)
+void vtUnmapPage(int store, int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location)
 {
 	if (FALLBACK_ENTRIES)
 	{
-		const uint32_t pageEntry = PAGE_TABLE(mipmap_level + 1, x_coord / 2, y_coord / 2);
-		*((uint8_t *)&PAGE_TABLE(mipmap_level, x_coord, y_coord)) = kTableFree;
+		const uint32_t pageEntry = PAGE_TABLE(store, mipmap_level + 1, x_coord / 2, y_coord / 2);
+		*((uint8_t *)&PAGE_TABLE(store, mipmap_level, x_coord, y_coord)) = kTableFree;
 		
-		_unmapPageFallbackEntries(mipmap_level, x_coord, y_coord, x_storage_location, y_storage_location, BYTE4(pageEntry), BYTE3(pageEntry), BYTE2(pageEntry));
+		_unmapPageFallbackEntries(store, mipmap_level, x_coord, y_coord, x_storage_location, y_storage_location, BYTE4(pageEntry), BYTE3(pageEntry), BYTE2(pageEntry));
 	}
 	else
 	{
-		PAGE_TABLE(mipmap_level, x_coord, y_coord) = kTableFree;
-		touchMipRow(mipmap_level, y_coord)
+		PAGE_TABLE(store, mipmap_level, x_coord, y_coord) = kTableFree;
+		_vtTouchPageTable(store, mipmap_level, x_coord, y_coord);
 	}
 }
 				  
-void vtUnmapPageCompleteley(int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location)
+void vtUnmapPageCompleteley(int store, int mipmap_level, int x_coord, int y_coord, int x_storage_location, int y_storage_location)
 {
-	vtUnmapPage(mipmap_level, x_coord, y_coord, x_storage_location, y_storage_location);
+	vtUnmapPage(store, mipmap_level, x_coord, y_coord, x_storage_location, y_storage_location);
 
-	vt.textureStorageInfo[x_storage_location][y_storage_location].x = 0;
-	vt.textureStorageInfo[x_storage_location][y_storage_location].y = 0;
-	vt.textureStorageInfo[x_storage_location][y_storage_location].mip = 0;
-	vt.textureStorageInfo[x_storage_location][y_storage_location].clockUsed = 0;
+	vtsFreeSlot(x_storage_location, y_storage_location);
 }
 
 
@@ -389,21 +559,13 @@ void vtUnmapPageCompleteley(int mipmap_level, int x_coord, int y_coord, int x_st
 void __debugEraseCachedPages()
 {
 #ifdef DEBUG_ERASE_CACHED_PAGES_EVERY_FRAME
-	for (uint8_t i = 0; i < c.mipChainLength; i++)
-		for (uint16_t x = 0; x < (c.virtTexDimensionPages >> i); x++)
-			for (uint16_t y = 0; y < (c.virtTexDimensionPages >> i); y++)
-				PAGE_TABLE(i, x, y) = kTableFree;
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		for (uint8_t i = 0; i < STORE(s).mipChainLength; i++)
+			for (uint16_t x = 0; x < (STORE(s).virtTexDimensionPages >> i); x++)
+				for (uint16_t y = 0; y < (STORE(s).virtTexDimensionPages >> i); y++)
+					PAGE_TABLE(s, i, x, y) = kTableFree;
 
 
-	for (int x = 0; x < c.physTexDimensionPages; x++)
-	{
-		for (int y = 0; y < c.physTexDimensionPages; y++)
-		{
-			vt.textureStorageInfo[x][y].x = 0;
-			vt.textureStorageInfo[x][y].y = 0;
-			vt.textureStorageInfo[x][y].mip = 0;
-			vt.textureStorageInfo[x][y].clockUsed = 0;
-		}
-	}
+	vtsInit();
 #endif
 }
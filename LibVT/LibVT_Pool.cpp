@@ -0,0 +1,225 @@
+/*
+ *  LibVT_Pool.cpp
+ *
+ *
+ *  Slab pools for page and file buffers.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Internal.h"
+#include "LibVT.h"
+
+extern vtData vt;
+extern vtConfig c;
+
+// every buffer that travels through the loading pipeline (file data, decoded pages, DXT pages, downsampled mips) comes from here.
+// pool 0 holds blocks of exactly one decoded page, pools 1..VT_BUFFER_POOLS hold power of two size classes for everything else.
+// blocks are carved out of slabs that are only returned to the system in vtpShutdown(), freed blocks go to a per pool free list.
+// each block is preceded by a small header that names its pool so vtpFree() doesn't need to know where a buffer came from.
+
+#define kPoolHeaderSize		16
+#define kPoolNone			0xFF		// too big for any pool, plain malloc
+#define kSlabBytes			(1024 * 1024)
+
+struct vtPoolHeader
+{
+	uint8_t		pool;
+	uint8_t		reserved[3];
+	uint32_t	size;
+	void		*next;				// free list link, only valid while the block is free
+};
+
+static inline uint32_t _vtpBlockSize(uint8_t pool)
+{
+	return (pool == 0) ? vt.pagePoolBlockSize : (VT_BUFFER_POOL_MIN << (pool - 1));
+}
+
+static void * _vtpAllocFromPool(uint8_t pool)
+{
+	vtPool &p = vt.pools[pool];
+	LOCK(p.mutex)
+
+	if (!p.freeList)
+	{
+		const uint32_t stride = (kPoolHeaderSize + _vtpBlockSize(pool) + 15) & ~15u;
+		uint32_t blocks = kSlabBytes / stride;
+		if (pool == 0 && blocks < 16) blocks = 16;	// there are thousands of pages in flight, don't slab them one by one
+		if (blocks < 1) blocks = 1;
+
+		uint8_t *slab = (uint8_t *) malloc((size_t) stride * blocks);
+		if (!slab)
+			return NULL;
+
+		p.slabs.push_back(slab);
+		p.stats.blocksAllocated += blocks;
+
+		for (uint32_t i = 0; i < blocks; i++)
+		{
+			vtPoolHeader *h = (vtPoolHeader *) (slab + (size_t) i * stride);
+			h->pool = pool;
+			h->next = p.freeList;
+			p.freeList = h;
+		}
+		p.stats.misses++;
+	}
+	else
+		p.stats.hits++;
+
+	vtPoolHeader *h = (vtPoolHeader *) p.freeList;
+	p.freeList = h->next;
+
+	p.stats.blocksInUse++;
+	if (p.stats.blocksInUse > p.stats.blocksHighWater)
+		p.stats.blocksHighWater = p.stats.blocksInUse;
+
+	return h;
+}
+
+void vtpInit(uint32_t pageBlockSize)
+{
+	vtPool &p = vt.pools[0];
+	LOCK(p.mutex)
+
+	if (vt.pagePoolBlockSize == pageBlockSize)
+		return;
+
+	assert(!p.stats.blocksInUse); // vtShutdown() returns every page before the page size can change
+
+	for (uint32_t s = 0; s < p.slabs.size(); s++)
+		free(p.slabs[s]);
+
+	p.slabs.clear();
+	p.freeList = NULL;
+	memset(&p.stats, 0, sizeof(p.stats));
+
+	vt.pagePoolBlockSize = pageBlockSize;
+}
+
+void vtpShutdown()
+{
+	for (uint8_t i = 0; i <= VT_BUFFER_POOLS; i++)
+	{
+		vtPool &p = vt.pools[i];
+		LOCK(p.mutex)
+
+		if (p.stats.blocksInUse)
+			printf("Warning: shutting down buffer pool %u with %u blocks still in use\n", i, p.stats.blocksInUse);
+
+		for (uint32_t s = 0; s < p.slabs.size(); s++)
+			free(p.slabs[s]);
+
+		p.slabs.clear();
+		p.freeList = NULL;
+		memset(&p.stats, 0, sizeof(p.stats));
+	}
+
+	vt.pagePoolBlockSize = 0;
+}
+
+void * vtpAlloc(uint32_t size)
+{
+	uint8_t pool = kPoolNone;
+	vtPoolHeader *h = NULL;
+
+	if (vt.pagePoolBlockSize && (size <= vt.pagePoolBlockSize) && (size > vt.pagePoolBlockSize / 2))
+		pool = 0;
+	else
+	{
+		for (uint8_t i = 1; i <= VT_BUFFER_POOLS; i++)
+		{
+			if (size <= _vtpBlockSize(i))
+			{
+				pool = i;
+				break;
+			}
+		}
+	}
+
+	if (pool != kPoolNone)
+		h = (vtPoolHeader *) _vtpAllocFromPool(pool);
+	else
+		h = (vtPoolHeader *) malloc(kPoolHeaderSize + size);
+
+	if (!h)
+		return NULL;
+
+	h->pool = pool;
+	h->size = size;
+
+	return (uint8_t *) h + kPoolHeaderSize;
+}
+
+void * vtpAllocPage()
+{
+	assert(vt.pagePoolBlockSize);
+
+	return vtpAlloc(vt.pagePoolBlockSize);
+}
+
+void vtpFree(void *data)
+{
+	if (!data)
+		return;
+
+	vtPoolHeader *h = (vtPoolHeader *) ((uint8_t *) data - kPoolHeaderSize);
+
+	if (h->pool == kPoolNone)
+	{
+		free(h);
+		return;
+	}
+
+	assert(h->pool <= VT_BUFFER_POOLS);
+
+	vtPool &p = vt.pools[h->pool];
+	LOCK(p.mutex)
+
+	h->next = p.freeList;
+	p.freeList = h;
+	p.stats.blocksInUse--;
+}
+
+uint32_t vtpSize(const void *data)
+{
+	return ((const vtPoolHeader *) ((const uint8_t *) data - kPoolHeaderSize))->size;
+}
+
+void vtGetPoolStats(vtPoolStats *pagePool, vtPoolStats *bufferPools)
+{
+	if (pagePool)
+	{
+		LOCK(vt.pools[0].mutex)
+
+		*pagePool = vt.pools[0].stats;
+		pagePool->blockSize = vt.pagePoolBlockSize;
+	}
+
+	if (bufferPools)
+	{
+		memset(bufferPools, 0, sizeof(vtPoolStats));
+
+		for (uint8_t i = 1; i <= VT_BUFFER_POOLS; i++)
+		{
+			LOCK(vt.pools[i].mutex)
+
+			const vtPoolStats &s = vt.pools[i].stats;
+			bufferPools->blocksAllocated += s.blocksAllocated;
+			bufferPools->blocksInUse += s.blocksInUse;
+			bufferPools->blocksHighWater += s.blocksHighWater;
+			bufferPools->bytesHighWater += (uint64_t) s.blocksHighWater * _vtpBlockSize(i);
+			bufferPools->hits += s.hits;
+			bufferPools->misses += s.misses;
+		}
+	}
+
+	if (pagePool)
+		pagePool->bytesHighWater = (uint64_t) pagePool->blocksHighWater * vt.pagePoolBlockSize;
+}
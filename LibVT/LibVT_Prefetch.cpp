@@ -0,0 +1,314 @@
+/*
+ *  LibVT_Prefetch.cpp
+ *
+ *
+ *  Loads pages for predicted camera poses into the RAM cache before the prepass asks for them.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Internal.h"
+#include "LibVT.h"
+
+#include <algorithm>
+
+extern vtData vt;
+extern vtConfig c;
+
+// LibVT never sees the geometry, so the application hands in a copy of the textured mesh of every store once, which is simplified to a proxy of at most
+// 2 * PREFETCH_PROXY_RESOLUTION^2 triangles. vtPrefetch() projects the proxy with each predicted pose, picks a mip level per triangle from the
+// ratio of its texture and screen area like the prepass does per pixel, and queues the pages under it. the loading thread only takes them
+// while there are no real requests and puts them into the RAM cache without mapping them, so a page that is needed later is mapped in the
+// same frame it is requested.
+
+#define kPrefetchMaxDepth		6		// subdivision levels, a triangle becomes at most 4^6 parts
+#define kPrefetchMinW			1e-4f	// vertices closer to the eye plane than this are treated as behind the camera
+
+struct vtPrefetchClipVertex
+{
+	float		x, y, z, w;
+	float		u, v;
+};
+
+struct vtPrefetchPass
+{
+	vector<uint64_t>	*pages;		// pageInfo << 32 | priority
+	uint32_t			priority;	// of the pose, the mip level is added
+	uint8_t				store;
+	float				width, height, texels, bias;
+};
+
+static inline uint32_t _vtPrefetchCell(float u, float v)
+{
+	const float g = (float) PREFETCH_PROXY_RESOLUTION;
+	const int x = (int) (u * g), y = (int) (v * g);
+
+	return (uint32_t) ((y < 0) ? 0 : ((y >= PREFETCH_PROXY_RESOLUTION) ? PREFETCH_PROXY_RESOLUTION - 1 : y)) * PREFETCH_PROXY_RESOLUTION +
+		   (uint32_t) ((x < 0) ? 0 : ((x >= PREFETCH_PROXY_RESOLUTION) ? PREFETCH_PROXY_RESOLUTION - 1 : x));
+}
+
+static inline vtPrefetchClipVertex _vtPrefetchMidpoint(const vtPrefetchClipVertex &a, const vtPrefetchClipVertex &b) // projection is linear in clip space, so the midpoint stays exact
+{
+	vtPrefetchClipVertex m;
+
+	m.x = (a.x + b.x) * 0.5f;
+	m.y = (a.y + b.y) * 0.5f;
+	m.z = (a.z + b.z) * 0.5f;
+	m.w = (a.w + b.w) * 0.5f;
+	m.u = (a.u + b.u) * 0.5f;
+	m.v = (a.v + b.v) * 0.5f;
+
+	return m;
+}
+
+static void _vtPrefetchTriangle(const vtPrefetchPass &pass, const vtPrefetchClipVertex &p0, const vtPrefetchClipVertex &p1, const vtPrefetchClipVertex &p2, const uint8_t depth)
+{
+	// outside the frustum if all vertices are on the outer side of the same plane
+	if (((p0.x > p0.w) && (p1.x > p1.w) && (p2.x > p2.w)) || ((p0.x < -p0.w) && (p1.x < -p1.w) && (p2.x < -p2.w)) ||
+		((p0.y > p0.w) && (p1.y > p1.w) && (p2.y > p2.w)) || ((p0.y < -p0.w) && (p1.y < -p1.w) && (p2.y < -p2.w)) ||
+		((p0.z > p0.w) && (p1.z > p1.w) && (p2.z > p2.w)) || ((p0.z < -p0.w) && (p1.z < -p1.w) && (p2.z < -p2.w)))
+		return;
+
+	const bool behind = (p0.w < kPrefetchMinW) || (p1.w < kPrefetchMinW) || (p2.w < kPrefetchMinW);
+	float sx[3], sy[3];
+
+	if (!behind)
+	{
+		sx[0] = (p0.x / p0.w * 0.5f + 0.5f) * pass.width;		sy[0] = (p0.y / p0.w * 0.5f + 0.5f) * pass.height;
+		sx[1] = (p1.x / p1.w * 0.5f + 0.5f) * pass.width;		sy[1] = (p1.y / p1.w * 0.5f + 0.5f) * pass.height;
+		sx[2] = (p2.x / p2.w * 0.5f + 0.5f) * pass.width;		sy[2] = (p2.y / p2.w * 0.5f + 0.5f) * pass.height;
+	}
+
+	// big triangles are split, perspective makes their near and far ends need different mip levels
+	if (behind || (max(max(sx[0], sx[1]), sx[2]) - min(min(sx[0], sx[1]), sx[2]) > PREFETCH_SUBDIVISION_PIXELS) ||
+				  (max(max(sy[0], sy[1]), sy[2]) - min(min(sy[0], sy[1]), sy[2]) > PREFETCH_SUBDIVISION_PIXELS))
+	{
+		if (depth < kPrefetchMaxDepth)
+		{
+			const vtPrefetchClipVertex ab = _vtPrefetchMidpoint(p0, p1), bc = _vtPrefetchMidpoint(p1, p2), ca = _vtPrefetchMidpoint(p2, p0);
+
+			_vtPrefetchTriangle(pass, p0, ab, ca, depth + 1);
+			_vtPrefetchTriangle(pass, ab, p1, bc, depth + 1);
+			_vtPrefetchTriangle(pass, ca, bc, p2, depth + 1);
+			_vtPrefetchTriangle(pass, ab, bc, ca, depth + 1);
+			return;
+		}
+		if (behind)
+			return;
+	}
+
+	const float screenArea = fabsf((sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0])) * 0.5f;
+	const float textureArea = fabsf((p1.u - p0.u) * (p2.v - p0.v) - (p2.u - p0.u) * (p1.v - p0.v)) * 0.5f * pass.texels * pass.texels;
+
+	if ((screenArea < 0.01f) || (textureArea <= 0.0f)) // edge on or degenerate
+		return;
+
+	const float level = 0.5f * log2f(textureArea / screenArea) + pass.bias + 0.5f;
+	const vtStore &st = STORE(pass.store);
+	const uint8_t mip = (uint8_t) ((level < 0.0f) ? 0 : ((level > st.mipChainLength - 1) ? st.mipChainLength - 1 : level));
+	const float dimension = (float) (st.virtTexDimensionPages >> mip);
+	const int maxCoord = (int) dimension - 1;
+
+	const int x0 = max(0, min(maxCoord, (int) floorf(min(min(p0.u, p1.u), p2.u) * dimension))), x1 = max(0, min(maxCoord, (int) floorf(max(max(p0.u, p1.u), p2.u) * dimension)));
+	const int y0 = max(0, min(maxCoord, (int) floorf(min(min(p0.v, p1.v), p2.v) * dimension))), y1 = max(0, min(maxCoord, (int) floorf(max(max(p0.v, p1.v), p2.v) * dimension)));
+
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++)
+			pass.pages->push_back(((uint64_t) MAKE_PAGE_INFO(pass.store, mip, x, y) << 32) + pass.priority + (st.mipChainLength - 1 - mip)); // coarse pages first, they cover more
+}
+
+void vtSetPrefetchGeometry(const uint8_t store, const float *vertices, const float *texcoords, const uint32_t *indices, const uint32_t triangleCount)
+{
+	assert(store < MAX_STORES);
+	vtStore &st = STORE(store);
+	const uint32_t cellCount = PREFETCH_PROXY_RESOLUTION * PREFETCH_PROXY_RESOLUTION;
+	vector<double> sums(cellCount * 5, 0.0);
+	vector<uint32_t> counts(cellCount, 0);
+	vector<uint64_t> triangles;
+
+	// vertex clustering in texture space: every vertex moves to the mean of its cell, triangles that collapse disappear
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t cells[3];
+
+		for (uint8_t k = 0; k < 3; k++)
+		{
+			const uint32_t v = indices ? indices[t * 3 + k] : t * 3 + k;
+			const uint32_t cell = _vtPrefetchCell(texcoords[v * 2], texcoords[v * 2 + 1]);
+
+			sums[cell * 5 + 0] += vertices[v * 3];
+			sums[cell * 5 + 1] += vertices[v * 3 + 1];
+			sums[cell * 5 + 2] += vertices[v * 3 + 2];
+			sums[cell * 5 + 3] += texcoords[v * 2];
+			sums[cell * 5 + 4] += texcoords[v * 2 + 1];
+			counts[cell]++;
+			cells[k] = cell;
+		}
+
+		if ((cells[0] == cells[1]) || (cells[1] == cells[2]) || (cells[2] == cells[0]))
+			continue;
+
+		const uint32_t first = min(min(cells[0], cells[1]), cells[2]);
+		const uint8_t rotation = (first == cells[0]) ? 0 : ((first == cells[1]) ? 1 : 2); // keep the winding, cells fit into 21 bits
+
+		triangles.push_back(((uint64_t) cells[rotation] << 42) + ((uint64_t) cells[(rotation + 1) % 3] << 21) + cells[(rotation + 2) % 3]);
+	}
+
+	sort(triangles.begin(), triangles.end());
+	triangles.erase(unique(triangles.begin(), triangles.end()), triangles.end());
+
+	vector<uint32_t> vertexOfCell(cellCount, 0);
+	vector<vtPrefetchVertex> proxyVertices;
+	vector<uint32_t> proxyIndices;
+
+	proxyIndices.reserve(triangles.size() * 3);
+
+	for (uint32_t cell = 0; cell < cellCount; cell++)
+	{
+		if (!counts[cell])
+			continue;
+
+		vtPrefetchVertex vertex;
+		for (uint8_t k = 0; k < 3; k++)
+			vertex.position[k] = (float) (sums[cell * 5 + k] / counts[cell]);
+		for (uint8_t k = 0; k < 2; k++)
+			vertex.texcoord[k] = (float) (sums[cell * 5 + 3 + k] / counts[cell]);
+
+		vertexOfCell[cell] = (uint32_t) proxyVertices.size();
+		proxyVertices.push_back(vertex);
+	}
+
+	for (uint32_t i = 0; i < triangles.size(); i++)
+	{
+		proxyIndices.push_back(vertexOfCell[(uint32_t) (triangles[i] >> 42)]);
+		proxyIndices.push_back(vertexOfCell[(uint32_t) (triangles[i] >> 21) & 0x1FFFFF]);
+		proxyIndices.push_back(vertexOfCell[(uint32_t) triangles[i] & 0x1FFFFF]);
+	}
+
+	{	// lock
+		LOCK(vt.prefetchMutex) // the feedback thread may be projecting the old proxy
+
+		st.prefetchVertices.swap(proxyVertices);
+		st.prefetchIndices.swap(proxyIndices);
+	}	// unlock
+
+#if DEBUG_LOG > 0
+	printf("Prefetch proxy of store %u: %u of %u triangles\n", store, (uint32_t) triangles.size(), triangleCount);
+#endif
+}
+
+void vtPrefetch(const double *viewMatrices, const double *projectionMatrices, const uint32_t poseCount)
+{
+#if ASYNC_FEEDBACK
+	// the projection runs on the feedback thread after the buffer submitted last, poses it hasn't taken yet are replaced
+	LOCK(vt.feedbackMutex)
+
+	vt.prefetchViews.assign(viewMatrices, viewMatrices + poseCount * 16);
+	vt.prefetchProjections.assign(projectionMatrices, projectionMatrices + poseCount * 16);
+	vt.prefetchPosesPending = true;
+	vt.feedbackSubmittedCondition.signal();
+#else
+	vtPrefetchPoses(viewMatrices, projectionMatrices, poseCount);
+#endif
+}
+
+void vtPrefetchPoses(const double *viewMatrices, const double *projectionMatrices, const uint32_t poseCount)
+{
+	vector<uint64_t> pages;
+	const uint32_t maxPages = min((uint32_t) PREFETCH_MAX_PAGES, c.maxCachedPages / 4);
+
+	LOCK(vt.prefetchMutex) // held until the pages are queued, vtRemoveStore() takes it before it closes a store
+
+	if (vt.memValid && maxPages && vt.real_w && vt.real_h)
+	{
+		vtPrefetchPass pass;
+
+		pass.pages = &pages;
+		pass.width = (float) vt.real_w;
+		pass.height = (float) vt.real_h;
+		pass.bias = vtGetBias();
+
+		for (uint8_t s = 0; s < vt.storeCount; s++) // the poses are shared, each store has its own proxy. pages of all stores compete for the same budget
+		{
+			const vtStore &st = STORE(s);
+
+			if (!st.active || st.prefetchIndices.empty())
+				continue;
+
+			vector<vtPrefetchClipVertex> clip(st.prefetchVertices.size());
+
+			pass.store = s;
+			pass.texels = (float) (st.virtTexDimensionPages * (c.pageDimension - 2 * c.pageBorder));
+
+			for (uint32_t p = 0; p < poseCount; p++)
+			{
+				const double *view = viewMatrices + p * 16, *projection = projectionMatrices + p * 16;
+				double m[16];
+
+				for (uint8_t col = 0; col < 4; col++) // column major, m = projection * view
+					for (uint8_t row = 0; row < 4; row++)
+						m[col * 4 + row] = projection[row] * view[col * 4] + projection[4 + row] * view[col * 4 + 1] + projection[8 + row] * view[col * 4 + 2] + projection[12 + row] * view[col * 4 + 3];
+
+				for (uint32_t i = 0; i < clip.size(); i++)
+				{
+					const float *position = st.prefetchVertices[i].position;
+
+					clip[i].x = (float) (m[0] * position[0] + m[4] * position[1] + m[8] * position[2] + m[12]);
+					clip[i].y = (float) (m[1] * position[0] + m[5] * position[1] + m[9] * position[2] + m[13]);
+					clip[i].z = (float) (m[2] * position[0] + m[6] * position[1] + m[10] * position[2] + m[14]);
+					clip[i].w = (float) (m[3] * position[0] + m[7] * position[1] + m[11] * position[2] + m[15]);
+					clip[i].u = st.prefetchVertices[i].texcoord[0];
+					clip[i].v = st.prefetchVertices[i].texcoord[1];
+				}
+
+				pass.priority = p << 4;
+
+				for (uint32_t i = 0; i < st.prefetchIndices.size(); i += 3)
+					_vtPrefetchTriangle(pass, clip[st.prefetchIndices[i]], clip[st.prefetchIndices[i + 1]], clip[st.prefetchIndices[i + 2]], 0);
+			}
+		}
+
+		// keep every page once with its best priority, then order by priority
+		sort(pages.begin(), pages.end());
+
+		uint32_t count = 0, last = 0;
+		for (uint32_t i = 0; i < pages.size(); i++)
+		{
+			const uint32_t pageInfo = (uint32_t) (pages[i] >> 32);
+
+			if (i && (pageInfo == last))
+				continue;
+			last = pageInfo;
+
+			const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
+			const uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
+
+			if (((uint8_t) PAGE_TABLE(store, mip, x_coord, y_coord) == kTableFree) && vtuPageExists(pageInfo) && !vtcIsPageInCacheLOCK(pageInfo)) // not mapped, being loaded, absent or ready already
+				pages[count++] = ((pages[i] & 0xFFFFFFFF) << 32) + pageInfo;
+		}
+		pages.resize(count);
+		sort(pages.begin(), pages.end());
+		if (pages.size() > maxPages)
+			pages.resize(maxPages);
+	}
+
+	{	// lock
+		LOCK(vt.neededPagesMutex)
+
+		vt.prefetchPages.clear(); // a new prediction replaces the old one
+		for (uint32_t i = 0; i < pages.size(); i++)
+			vt.prefetchPages.push_back((uint32_t) pages[i]);
+
+#if ENABLE_MT
+		if (!pages.empty())
+			vt.neededPagesAvailableCondition.signal(); // wake up page loading thread if it is sleeping
+#endif
+	}	// unlock
+}
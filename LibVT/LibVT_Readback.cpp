@@ -119,203 +119,410 @@ void vtPerformReadback()
 	}
 }
 
-void vtExtractNeededPages(const uint32_t *ext_buffer_BGRA)
-{
-	const uint32_t width = vt.w;
-	const clock_t clocks = vt.thisFrameClock = clock();
-	queue<uint32_t>	tmpPages;
+#define kRequestCached	0x80000000	// flag in vtePageCount::count, a request can never cover 2^31 pixels
 
-	map<uint32_t, uint16_t> tmpPages1;
-	multimap<uint16_t, uint32_t> tmpPages2;
-
-	const uint32_t *buffer;
+// turns a list of unique pages from the readback buffer into page table state changes and loading requests.
+// neededPagesMutex is held throughout so the page list, the page table states and the load generations change together for the loading threads
+static void _vtApplyPageList(vtePageCount *pages, const uint32_t uniquePages, const bool sorted)
+{
+	const uint32_t frame = vt.thisFrame;
+	uint32_t requestCount = 0;
+	bool haveCachedPages = false;
 
 	vt.necessaryPageCount = 0;
 
-	assert(!OPENCL_BUFFERREDUCTION);
-
-	if (READBACK_MODE_NONE)
-		buffer = ext_buffer_BGRA;
-	else
-	{
-#if !GL_ES_VERSION_2_0
-		if (USE_PBO_READBACK)
-		{
-			glBindBuffer(GL_PIXEL_PACK_BUFFER, vt.pboReadback);
-			buffer = (uint32_t *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
-		}
-		else
-#endif
-			buffer = vt.readbackBuffer;
-	}
-
-	// erase pages that were requested in previous frames in the pagetable. if they are still necessary they will be readded
 	{	// lock
 		LOCK(vt.neededPagesMutex)
 
+		const uint32_t generation = (vt.requestGeneration + 1 > kLoadUnwanted) ? vt.requestGeneration + 1 : kLoadUnwanted + 1; // skips the reserved values when wrapping
+
+		// erase pages that were requested in previous frames in the pagetable. if they are still necessary they will be readded
 		for (uint32_t i = 0; i < vt.neededPages.size(); i++)
 		{
 			uint32_t pageInfo = vt.neededPages[i];
 
 			uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-			uint8_t mip = EXTRACT_MIP(pageInfo);
-			*((uint8_t *)&PAGE_TABLE(mip, x_coord, y_coord)) = kTableFree;
+			uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
+			*((uint8_t *)&PAGE_TABLE(store, mip, x_coord, y_coord)) = kTableFree;
 		}
-	}	// unlock
+		vt.neededPages.clear();
 
-	if(!buffer){
-        printf("FAIL FAIL no buffer!!!!!!!!!!\n");
-        return;
-    }
-///*2*/	list<uint32_t> l;				// testcode for determining how many pages are visible each frame
-///*1*/	map<uint32_t, uint16_t> bla;	// testcode for producing a reference list of pages with pixel coverage information for quality tests. make sure not to use prepass resolutin reuduction. make sure each frame is rendered at a specific walkthrough position because the code can slow down very much. see also corresponding testcode in vtMapNewPages()
-
-	for (uint32_t y = 0; y < vt.h; y++)
-	{
-		const uint32_t rows = y * width;
-
-		for (uint32_t x = 0; x < vt.w; x++)
+		for (uint32_t i = 0; i < uniquePages; i++)
 		{
-            
-			//const uint32_t tmp = *(buffer + rows + x);	// format: BGRA		mip, x, y, STATUS
-            //const uint32_t pixel =  ((tmp >> 16) & 0xFF) | (tmp & 0xFF00FF00) | ((tmp & 0xFF) << 16);
-            const uint32_t pixel =*(buffer + rows + x);
-            const uint8_t mip = (c.longMipChain) ? BYTE1(pixel) & 0x0F : BYTE1(pixel);
-			const uint8_t shift = (USE_MIPCALC_TEXTURE ? 0 : mip);
-            const uint16_t y_coord = (c.longMipChain) ? ((BYTE2(pixel) | ((BYTE1(pixel) & 0xC0)) << 2) >> shift) : (BYTE2(pixel) >> shift);
-            const uint16_t x_coord = (c.longMipChain) ? ((BYTE3(pixel) | ((BYTE1(pixel) & 0x30)) << 4) >> shift) : (BYTE3(pixel) >> shift);
-          
-            if ((BYTE4(pixel) == 255) && (mip < c.mipChainLength) && (y_coord < (c.virtTexDimensionPages >> mip)) && (x_coord < (c.virtTexDimensionPages >> mip)))
-			{
-///*2*/			l.push_back(MAKE_PAGE_INFO(mip, x_coord, y_coord));
+			const uint32_t pageInfo = pages[i].pageInfo;
 
-				const uint32_t pageEntry = PAGE_TABLE(mip, x_coord, y_coord);
+			if (!PAGE_IN_STORE(pageInfo)) // removed since the feedback was submitted, its id may belong to another store by now
+				continue;
 
-				if ((uint8_t) pageEntry == kTableFree) // if page is not mapped, add it to the download list and make sure we don't handle it again this frame
-				{
-					const uint32_t pageInfo = MAKE_PAGE_INFO(mip, x_coord, y_coord);
+			const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
+			const uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
 
-					tmpPages1[pageInfo] = 1;
-///*1*/				bla[pageInfo] = 1;
+			const uint32_t pageEntry = PAGE_TABLE(store, mip, x_coord, y_coord);
+
+			if ((uint8_t) pageEntry == kTableFree) // if page is not mapped, add it to the download list
+			{
+				if (!vtuPageExists(pageInfo)) // outside the footprint of a sparse store, the fallback entry of the parent page stays
+					continue;
 
 #if DEBUG_LOG > 0
-					printf("Requesting page: Mip:%u %u/%u\n", mip, x_coord, y_coord);
+				printf("Requesting page: Store:%u Mip:%u %u/%u\n", store, mip, x_coord, y_coord);
 #endif
 
-					// we just want to set the alpha channel, luckly this byte is right there on little endian
-					// setting just the lowest byte matters for the fallback-entry-mode, else a non-mapped page is empty anyway
-					*((uint8_t *)&PAGE_TABLE(mip, x_coord, y_coord)) = kTableMappingInProgress;
+				// we just want to set the alpha channel, luckly this byte is right there on little endian
+				// setting just the lowest byte matters for the fallback-entry-mode, else a non-mapped page is empty anyway
+				*((uint8_t *)&PAGE_TABLE(store, mip, x_coord, y_coord)) = kTableMappingInProgress;
 
-					vtcTouchCachedPage(pageInfo);
+				vtcTouchCachedPage(pageInfo);
 
-					vt.necessaryPageCount++;
-				}
-				else if ((uint8_t) pageEntry == kTableMapped)	// if the page is mapped we need to mark it used
+				vt.necessaryPageCount++;
+
+				uint32_t &loadGeneration = LOAD_GENERATION(pageInfo);
+				if (loadGeneration != kLoadIdle) // a cancelled or prefetched load is still running, its loading thread passes the page on
 				{
-					const uint8_t yInTexture = BYTE2(pageEntry), xInTexture = BYTE3(pageEntry);
+					loadGeneration = generation;
+					vt.refreshedLoads.push_back(pageInfo);
+					continue;
+				}
 
-					fast_assert((xInTexture < c.physTexDimensionPages) && (yInTexture < c.physTexDimensionPages));
+				pages[requestCount++] = pages[i]; // compact the requests to the front, in place and in order
+			}
+			else if ((uint8_t) pageEntry == kTableMapped)	// if the page is mapped we need to mark it used
+			{
+				const uint8_t yInTexture = BYTE2(pageEntry), xInTexture = BYTE3(pageEntry);
 
-					if (vt.textureStorageInfo[xInTexture][yInTexture].clockUsed != clocks)
-					{
-						vt.textureStorageInfo[xInTexture][yInTexture].clockUsed = clocks;	// touch page in physical texture
+				fast_assert(SLOT_VALID(xInTexture, yInTexture));
 
-						vtcTouchCachedPage(MAKE_PAGE_INFO(mip, x_coord, y_coord));			// touch page in RAM cache
+				if (STORAGE_INFO(xInTexture, yInTexture).frameUsed != frame)
+				{
+					vtsTouchSlot(xInTexture, yInTexture);	// touch page in physical texture
 
-						vt.necessaryPageCount++;
-					}
+					vtcTouchCachedPage(pageInfo);			// touch page in RAM cache
 
-///*1*/				const uint32_t pageInfo = MAKE_PAGE_INFO(mip, x_coord, y_coord);
-///*1*/				if (bla.count(pageInfo)) bla[pageInfo] = bla[pageInfo] + 1;
-///*1*/				else	bla[pageInfo] = 1;
+					vt.necessaryPageCount++;
 				}
-				else if ((uint8_t) pageEntry == kTableMappingInProgress)
+			}
+			else // kTableMappingInProgress: the page is being loaded since an earlier frame or waits for vtMapNewPages(), it stays wanted
+			{
+				uint32_t &loadGeneration = LOAD_GENERATION(pageInfo);
+				if ((loadGeneration != kLoadIdle) && (loadGeneration != generation))
 				{
-					const uint32_t pageInfo = MAKE_PAGE_INFO(mip, x_coord, y_coord);
-
-					if (tmpPages1.count(pageInfo))
-						tmpPages1[pageInfo] = tmpPages1[pageInfo] + 1;
-
-///*1*/				if (bla.count(pageInfo)) bla[pageInfo] = bla[pageInfo] + 1;
-///*1*/				else bla[pageInfo] = 1;
+					loadGeneration = generation;
+					vt.refreshedLoads.push_back(pageInfo);
 				}
 			}
 		}
-	}
-	
-///*2*/		l.sort();
-///*2*/		l.unique();
-///*2*/		printf("%i \n", (int)l.size());
-    
-    
-	map<uint32_t, uint16_t>::iterator tmpPagesIter1;
-	multimap<uint16_t, uint32_t>::reverse_iterator tmpPagesIter2;
-	
-///*1*/	printf("NEWFRAME\n\n");
-///*1*/	for(tmpPagesIter1 = bla.begin(); tmpPagesIter1 != bla.end(); ++tmpPagesIter1)
-///*1*/	printf("PAGE: %i %i\n", tmpPagesIter1->first, tmpPagesIter1->second);
-
-	for(tmpPagesIter1 = tmpPages1.begin(); tmpPagesIter1 != tmpPages1.end(); ++tmpPagesIter1) // pages sorting by importance
-		tmpPages2.insert(pair<uint16_t, uint32_t>(tmpPagesIter1->second, tmpPagesIter1->first));
-	for(tmpPagesIter2 = tmpPages2.rbegin(); tmpPagesIter2 != tmpPages2.rend(); ++tmpPagesIter2)
-		tmpPages.push(tmpPagesIter2->second);
 
+		// loads for pages that dropped out of the working set are cancelled, the loading threads drop them unless they were read already. the resident pages from vtInit() always stay
+		// only the loads wanted last frame can be stale, the ones refreshed above carry the new generation already
+		for (uint32_t i = 0; i < vt.wantedLoads.size(); i++)
+		{
+			const uint32_t pageInfo = vt.wantedLoads[i];
+			uint32_t &loadGeneration = LOAD_GENERATION(pageInfo);
 
-#if !GL_ES_VERSION_2_0
-	if (USE_PBO_READBACK)
-	{
-		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
-		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-	}
-#endif
-
-	queue<uint32_t>	cachedPages;
-	queue<uint32_t>	nonCachedPages;
-
-	vtcSplitPagelistIntoCachedAndNoncachedLOCK(&tmpPages, &cachedPages, &nonCachedPages);
-
+			if (loadGeneration != vt.requestGeneration) // refreshed, finished or cancelled already
+				continue;
 
-	{	// lock
-		LOCK(vt.neededPagesMutex)
+			if (EXTRACT_MIP(pageInfo) < PAGE_STORE(pageInfo).mipChainLength - HIGHEST_MIP_LEVELS_TO_KEEP)
+			{
+				loadGeneration = kLoadUnwanted;
+				*((uint8_t *)&PAGE_TABLE(EXTRACT_STORE(pageInfo), EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo))) = kTableFree;
+			}
+			else
+			{
+				loadGeneration = generation;
+				vt.refreshedLoads.push_back(pageInfo);
+			}
+		}
+		vt.wantedLoads.swap(vt.refreshedLoads);
+		vt.refreshedLoads.clear();
 
-		vt.neededPages.clear(); // erase old pages we already unmarked them them in the pagetable above. we erase old requests here because we don't want the loading thread stalled while we do our calculations
+		if (!sorted)
+			vteSortPagesByPriority(pages, requestCount); // coarse mips first, then by coverage
 
-		if (!nonCachedPages.empty())
+		vt.cachedRequestCount = vt.diskRequestCount = 0;
+		for (uint32_t i = 0; i < requestCount; i++)
 		{
-			while(!nonCachedPages.empty())
+			if (vtcIsPageInCacheLOCK(pages[i].pageInfo))
 			{
-				const uint32_t pageInfo = nonCachedPages.front();
-
-				vt.neededPages.push_back(pageInfo);nonCachedPages.pop();
+				pages[i].count |= kRequestCached;
+				haveCachedPages = true;
+				vt.cachedRequestCount++;  // just stats keeping
+			}
+			else
+			{
+				vt.neededPages.push_back(pages[i].pageInfo);
+				vt.diskRequestCount++;  // just stats keeping
 
 #if DEBUG_LOG > 0
-				const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-				const uint8_t mip = EXTRACT_MIP(pageInfo);
-				printf("Requesting page for loading from disk: Mip:%u %u/%u (%i)\n", mip, x_coord, y_coord, pageInfo);
+				const uint32_t pageInfo = pages[i].pageInfo;
+				printf("Requesting page for loading from disk: Mip:%u %u/%u (%i)\n", EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo), pageInfo);
 #endif
 			}
+		}
+
+		vt.requestGeneration = generation;
 
 #if ENABLE_MT
-                        vt.neededPagesAvailableCondition.signal(); // wake up page loading thread if it is sleeping
+		if (vt.diskRequestCount)
+			vt.neededPagesAvailableCondition.signal(); // wake up page loading thread if it is sleeping
 #endif
-		}
 	}	// unlock
 
-	if (!cachedPages.empty()) // pass needed pages that are cached right to newPages so they don't have to roundtrip to another possibly busy thread. this is a optimization just for the MT path.
+	if (haveCachedPages) // pass needed pages that are cached right to newPages so they don't have to roundtrip to another possibly busy thread. this is a optimization just for the MT path.
 	{	// lock
 		LOCK(vt.newPagesMutex)
 
-		while(!cachedPages.empty())
+		for (uint32_t i = 0; i < requestCount; i++)
 		{
-			const uint32_t pageInfo = cachedPages.front();
+			if (!(pages[i].count & kRequestCached))
+				continue;
 
-			vt.newPages.push(pageInfo);cachedPages.pop();
+			vt.newPages.push(pages[i].pageInfo);
 
 #if DEBUG_LOG > 0
-			const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
-			const uint8_t mip = EXTRACT_MIP(pageInfo);
-			printf("Loading page from RAM-cache: Mip:%u %u/%u (%i)\n", mip, x_coord, y_coord, pageInfo);
+			const uint32_t pageInfo = pages[i].pageInfo;
+			printf("Loading page from RAM-cache: Mip:%u %u/%u (%i)\n", EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo), pageInfo);
+#endif
+		}
+	}	// unlock
+}
+
+static void _vtFeedbackParams(vteParams *params)
+{
+	params->w = vt.w;
+	params->h = vt.h;
+	params->shiftByMip = !USE_MIPCALC_TEXTURE;
+
+	for (uint8_t s = 0; s < MAX_STORES; s++)
+	{
+		const bool active = (s < vt.storeCount) && STORE(s).active;
+
+		params->stores[s].virtTexDimensionPages = active ? STORE(s).virtTexDimensionPages : 0;
+		params->stores[s].mipChainLength = active ? STORE(s).mipChainLength : 0;
+		params->stores[s].longMipChain = active && STORE(s).longMipChain;
+	}
+}
+
+#if ASYNC_FEEDBACK
+static vtFeedbackSlot * _vtNewestFeedbackSlot(const uint8_t state) // must be called with feedbackMutex locked, older slots in that state are freed because they are superseded
+{
+	vtFeedbackSlot *newest = NULL;
+
+	for (uint8_t i = 0; i < FEEDBACK_RING_SIZE; i++)
+	{
+		vtFeedbackSlot *slot = &vt.feedbackRing[i];
+
+		if (slot->state != state)
+			continue;
+
+		if (!newest || (slot->frame > newest->frame))
+		{
+			if (newest)
+				newest->state = kFeedbackFree;
+			newest = slot;
+		}
+		else
+			slot->state = kFeedbackFree;
+	}
+
+	return newest;
+}
+
+static void _vtSubmitFeedback(const uint32_t *buffer)
+{
+	LOCK(vt.feedbackMutex)
+
+	if (vt.feedbackSize != vt.w * vt.h)
+		return;
+
+	vtFeedbackSlot *slot = NULL;
+	for (uint8_t i = 0; i < FEEDBACK_RING_SIZE && !slot; i++)
+		if (vt.feedbackRing[i].state == kFeedbackFree)
+			slot = &vt.feedbackRing[i];
+
+	if (!slot) // the worker is behind, drop this frame's feedback
+		return;
+
+	memcpy(slot->buffer, buffer, vt.feedbackSize * 4);
+	_vtFeedbackParams(&slot->params);
+	slot->frame = vt.thisFrame;
+	slot->state = kFeedbackSubmitted;
+
+	vt.feedbackSubmittedCondition.signal();
+}
+
+void LibVTFeedbackThread::run()
+{
+	while (1)
+	{
+		vtFeedbackSlot *slot;
+		vector<double> views, projections;
+		bool prefetch;
+
+		{	// lock
+			LOCK(vt.feedbackMutex)
+
+			while (!(slot = _vtNewestFeedbackSlot(kFeedbackSubmitted)) && !vt.prefetchPosesPending)
+				vt.feedbackSubmittedCondition.wait(&vt.feedbackMutex);
+
+			if (slot)
+				slot->state = kFeedbackProcessing;
+
+			prefetch = vt.prefetchPosesPending;
+			vt.prefetchPosesPending = false;
+			views.swap(vt.prefetchViews);
+			projections.swap(vt.prefetchProjections);
+		}	// unlock
+
+		if (slot)
+		{
+			slot->uniquePages = vteExtractPages(&slot->params, slot->buffer, &slot->table);
+			vteSortPagesByPriority(slot->table.pages, slot->uniquePages);
+
+			{	// lock
+				LOCK(vt.feedbackMutex)
+
+				slot->state = kFeedbackDone;
+				vt.feedbackProcessedCondition.broadcast();
+			}	// unlock
+		}
+
+		if (prefetch) // the proxy projection of vtPrefetch(), kept off the render thread
+		{
+			setCancelModeDisable(); // it takes the locks the render thread needs
+			vtPrefetchPoses(views.empty() ? NULL : &views[0], views.empty() ? NULL : &projections[0], (uint32_t) (views.size() / 16));
+			setCancelModeDeferred();
+		}
+	}
+}
+
+void vtReshapeFeedback(const uint32_t maxPages)
+{
+	LOCK(vt.feedbackMutex)
+
+	while (1) // the worker must not be inside one of the buffers we are about to replace
+	{
+		bool processing = false;
+		for (uint8_t i = 0; i < FEEDBACK_RING_SIZE; i++)
+			processing |= (vt.feedbackRing[i].state == kFeedbackProcessing);
+
+		if (!processing)
+			break;
+
+		vt.feedbackProcessedCondition.wait(&vt.feedbackMutex);
+	}
+
+	vt.feedbackSize = vt.w * vt.h;
+
+	for (uint8_t i = 0; i < FEEDBACK_RING_SIZE; i++)
+	{
+		vtFeedbackSlot *slot = &vt.feedbackRing[i];
+
+		free(slot->buffer);
+		slot->buffer = (uint32_t *) malloc(vt.feedbackSize * 4);
+		vteFreeTable(&slot->table);
+
+		if (!slot->buffer || !vteInitTable(&slot->table, maxPages))
+			vt_fatal("Error: couldn't allocate the feedback ring\n");
+
+		slot->uniquePages = 0;
+		slot->frame = 0;
+		slot->state = kFeedbackFree;
+	}
+}
+
+void vtStartFeedbackThread()
+{
+	vt.feedbackThread.start();
+}
+
+void vtStopFeedbackThread()
+{
+	vt.feedbackThread.cancel();
+	vt.feedbackThread.join();
+
+	for (uint8_t i = 0; i < FEEDBACK_RING_SIZE; i++)
+	{
+		free(vt.feedbackRing[i].buffer);
+		vt.feedbackRing[i].buffer = NULL;
+		vteFreeTable(&vt.feedbackRing[i].table);
+		vt.feedbackRing[i].state = kFeedbackFree;
+	}
+
+	vt.prefetchViews.clear();
+	vt.prefetchProjections.clear();
+	vt.prefetchPosesPending = false;
+	vt.feedbackSize = 0;
+}
 #endif
+
+void vtExtractNeededPages(const uint32_t *ext_buffer_BGRA)
+{
+	const uint32_t *buffer;
+
+	vt.thisFrame++;
+
+	assert(!OPENCL_BUFFERREDUCTION);
+
+	if (READBACK_MODE_NONE)
+		buffer = ext_buffer_BGRA;
+	else
+	{
+#if !GL_ES_VERSION_2_0
+		if (USE_PBO_READBACK)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, vt.pboReadback);
+			buffer = (uint32_t *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
 		}
+		else
+#endif
+			buffer = vt.readbackBuffer;
+	}
+
+	if(!buffer){
+        printf("FAIL FAIL no buffer!!!!!!!!!!\n");
+        return;
+    }
+
+	if (vt.captureFile)
+		vtCaptureReadback(buffer);
+
+#if ASYNC_FEEDBACK
+	// apply the newest result the worker has finished, then hand it this frame's buffer
+	vtFeedbackSlot *slot;
+
+	{	// lock
+		LOCK(vt.feedbackMutex)
+
+		slot = _vtNewestFeedbackSlot(kFeedbackDone);
 	}	// unlock
+
+	if (slot)
+	{
+		_vtApplyPageList(slot->table.pages, slot->uniquePages, true);
+
+		LOCK(vt.feedbackMutex)
+		slot->state = kFeedbackFree;
+	}
+
+	_vtSubmitFeedback(buffer);
+#else
+	// collect every page in the buffer once, with the number of pixels requesting it
+	vteParams params;
+	_vtFeedbackParams(&params);
+
+	const uint32_t uniquePages = vteExtractPages(&params, buffer, &vt.extractTable);
+#endif
+
+#if !GL_ES_VERSION_2_0
+	if (USE_PBO_READBACK)
+	{
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+#endif
+
+#if !ASYNC_FEEDBACK
+	_vtApplyPageList(vt.extractTable.pages, uniquePages, false);
+#endif
 }
@@ -0,0 +1,175 @@
+/*
+ *  LibVT_SlotAllocator.cpp
+ *
+ *
+ *  Physical texture slot management.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Internal.h"
+#include "LibVT.h"
+
+extern vtData vt;
+extern vtConfig c;
+
+// free slots are kept on a singly linked free list, used slots on a doubly linked LRU list ordered by vt.thisFrame (head = most recently used)
+// slots holding pages of the HIGHEST_MIP_LEVELS_TO_KEEP levels are on neither list and therefore never evicted
+// the lists span all layers of the physical texture, slots are addressed by the x and y bytes of their page table entries, see SLOT_X()
+
+static void _vtsUnlinkLRU(uint16_t slot)
+{
+	storageInfo &info = SLOT_INFO(slot);
+
+	if (info.prev != kNoSlot)
+		SLOT_INFO(info.prev).next = info.next;
+	else
+		vt.slotLRUHead = info.next;
+
+	if (info.next != kNoSlot)
+		SLOT_INFO(info.next).prev = info.prev;
+	else
+		vt.slotLRUTail = info.prev;
+
+	info.prev = info.next = kNoSlot;
+}
+
+static void _vtsLinkLRUHead(uint16_t slot)
+{
+	storageInfo &info = SLOT_INFO(slot);
+
+	info.prev = kNoSlot;
+	info.next = vt.slotLRUHead;
+
+	if (vt.slotLRUHead != kNoSlot)
+		SLOT_INFO(vt.slotLRUHead).prev = slot;
+	else
+		vt.slotLRUTail = slot;
+
+	vt.slotLRUHead = slot;
+}
+
+void vtsInit()
+{
+	vt.slotFreeList = vt.slotLRUHead = vt.slotLRUTail = kNoSlot;
+
+	for (int layer = c.physTexLayers - 1; layer >= 0; layer--) // pushed in reverse so the first layer is filled first
+	{
+		for (int column = c.physTexDimensionPages - 1; column >= 0; column--)
+		{
+			for (int row = c.physTexDimensionPages - 1; row >= 0; row--)
+			{
+				const uint8_t x = SLOT_X(column, layer), y = SLOT_Y(row, layer);
+				storageInfo &info = STORAGE_INFO(x, y);
+
+				info.x = 0;
+				info.y = 0;
+				info.mip = 0;
+				info.store = 0;
+				info.frameUsed = 0;
+				info.state = kSlotFree;
+				info.prev = kNoSlot;
+				info.next = vt.slotFreeList;
+
+				vt.slotFreeList = SLOT_INDEX(x, y);
+			}
+		}
+	}
+}
+
+bool vtsAllocateSlot(uint8_t *x, uint8_t *y, bool *wasFree)
+{
+	uint16_t slot;
+
+	if (vt.slotFreeList != kNoSlot)
+	{
+		slot = vt.slotFreeList;
+		vt.slotFreeList = SLOT_INFO(slot).next;
+		*wasFree = true;
+	}
+	else
+	{
+		slot = vt.slotLRUTail;
+
+		if ((slot == kNoSlot) || (SLOT_INFO(slot).frameUsed >= vt.thisFrame)) // every slot is needed this frame
+			return false;
+
+		_vtsUnlinkLRU(slot);
+		*wasFree = false;
+	}
+
+	storageInfo &info = SLOT_INFO(slot);
+	info.state = kSlotFree;
+	info.prev = info.next = kNoSlot;
+
+	*x = (uint8_t) ((slot / MAX_PHYS_TEX_DIMENSION_PAGES) % 256); // the inverse of SLOT_INDEX()
+	*y = (uint8_t) (slot % MAX_PHYS_TEX_DIMENSION_PAGES + (slot / (256 * MAX_PHYS_TEX_DIMENSION_PAGES)) * MAX_PHYS_TEX_DIMENSION_PAGES);
+
+	return true;
+}
+
+void vtsAssignSlot(uint8_t x, uint8_t y, uint8_t store, uint8_t mip, uint16_t x_coord, uint16_t y_coord)
+{
+	storageInfo &info = STORAGE_INFO(x, y);
+
+	assert(info.state == kSlotFree);
+
+	info.x = x_coord;
+	info.y = y_coord;
+	info.mip = mip;
+	info.store = store;
+	info.frameUsed = vt.thisFrame;
+
+	if (mip >= STORE(store).mipChainLength - HIGHEST_MIP_LEVELS_TO_KEEP)
+		info.state = kSlotResident;
+	else
+	{
+		info.state = kSlotUsed;
+		_vtsLinkLRUHead(SLOT_INDEX(x, y));
+	}
+}
+
+void vtsTouchSlot(uint8_t x, uint8_t y)
+{
+	storageInfo &info = STORAGE_INFO(x, y);
+
+	info.frameUsed = vt.thisFrame;
+
+	if ((info.state == kSlotUsed) && (vt.slotLRUHead != SLOT_INDEX(x, y)))
+	{
+		const uint16_t slot = SLOT_INDEX(x, y);
+
+		_vtsUnlinkLRU(slot);
+		_vtsLinkLRUHead(slot);
+	}
+}
+
+void vtsFreeSlot(uint8_t x, uint8_t y)
+{
+	storageInfo &info = STORAGE_INFO(x, y);
+	const uint16_t slot = SLOT_INDEX(x, y);
+
+	if (info.state == kSlotFree)
+		return;
+
+	if (info.state == kSlotUsed)
+		_vtsUnlinkLRU(slot);
+
+	info.x = 0;
+	info.y = 0;
+	info.mip = 0;
+	info.store = 0;
+	info.frameUsed = 0;
+	info.state = kSlotFree;
+	info.prev = kNoSlot;
+	info.next = vt.slotFreeList;
+
+	vt.slotFreeList = slot;
+}
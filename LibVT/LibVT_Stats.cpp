@@ -0,0 +1,214 @@
+/*
+ *  LibVT_Stats.cpp
+ *
+ *
+ *  Per-frame statistics of the paging pipeline and their CSV trace.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Internal.h"
+#include "LibVT.h"
+
+extern vtData vt;
+extern vtConfig c;
+
+// the loading threads add to the totals once per batch, so statsMutex is taken a few times per frame at most.
+// the trace has one row per vtMapNewPages(), totals are written as the difference to the previous row.
+
+void vtStatsPagesRead(uint32_t count, uint64_t bytes)
+{
+	if (!count)
+		return;
+
+	LOCK(vt.statsMutex)
+
+	vt.pagesRead += count;
+	vt.diskBytesRead += bytes;
+}
+
+void vtStatsCompressedCacheHits(uint32_t count)
+{
+	if (!count)
+		return;
+
+	LOCK(vt.statsMutex)
+
+	vt.compressedCacheHits += count;
+}
+
+void vtStatsPageCacheHits(uint32_t count)
+{
+	if (!count)
+		return;
+
+	LOCK(vt.statsMutex)
+
+	vt.pageCacheHits += count;
+}
+
+void vtStatsPagesPrefetched(uint32_t count)
+{
+	if (!count)
+		return;
+
+	LOCK(vt.statsMutex)
+
+	vt.pagesPrefetched += count;
+}
+
+void vtStatsPagesCancelled(uint32_t count)
+{
+	if (!count)
+		return;
+
+	LOCK(vt.statsMutex)
+
+	vt.pagesCancelled += count;
+}
+
+void vtStatsPagesDecompressed(uint32_t count, double seconds)
+{
+	if (!count)
+		return;
+
+	LOCK(vt.statsMutex)
+
+	vt.pagesDecompressed += count;
+	vt.decompressionSeconds += seconds;
+}
+
+void vtGetStats(vtStats *stats)
+{
+	memset(stats, 0, sizeof(vtStats));
+
+	if (!vt.memValid)
+		return;
+
+	stats->frame = vt.thisFrame;
+	stats->necessaryPageCount = vt.necessaryPageCount;
+	stats->newPageCount = vt.newPageCount;
+	stats->missingPageCount = vt.missingPageCount;
+	stats->cachedRequestCount = vt.cachedRequestCount;
+	stats->diskRequestCount = vt.diskRequestCount;
+	stats->uploadSeconds = vt.uploadSeconds;
+	stats->uploadBytes = vt.uploadBytes;
+	stats->bias = vtGetBias();
+	stats->maxCachedPages = c.maxCachedPages;
+
+	{	// lock
+		LOCK(vt.neededPagesMutex)
+
+		stats->neededQueueDepth = (uint32_t) vt.neededPages.size();
+		stats->prefetchQueueDepth = (uint32_t) vt.prefetchPages.size();
+	}	// unlock
+
+	{	// lock
+		LOCK(vt.newPagesMutex)
+
+		stats->newQueueDepth = (uint32_t) vt.newPages.size();
+	}	// unlock
+
+#if ENABLE_MT > 1
+	{	// lock
+		LOCK(vt.compressedMutex)
+
+		stats->compressedQueueDepth = (uint32_t) vt.newCompressedPages.size();
+	}	// unlock
+#endif
+
+	for (uint8_t i = 0; i < RAMCACHE_SHARDS; i++)
+	{
+		LOCK(vt.cacheShards[i].mutex)
+
+		stats->cachedPages += vt.cacheShards[i].count;
+		stats->cachedBytes += vt.cacheShards[i].bytes;
+		stats->cacheEvictions += vt.cacheShards[i].evictions;
+	}
+
+	for (uint8_t i = 0; i < RAMCACHE_SHARDS; i++)
+	{
+		LOCK(vt.compressedCacheShards[i].mutex)
+
+		stats->compressedCachedPages += vt.compressedCacheShards[i].count;
+		stats->compressedCachedBytes += vt.compressedCacheShards[i].bytes;
+	}
+
+	{	// lock
+		LOCK(vt.statsMutex)
+
+		stats->pagesRead = vt.pagesRead;
+		stats->compressedCacheHits = vt.compressedCacheHits;
+		stats->pageCacheHits = vt.pageCacheHits;
+		stats->pagesPrefetched = vt.pagesPrefetched;
+		stats->pagesCancelled = vt.pagesCancelled;
+		stats->diskBytesRead = vt.diskBytesRead;
+		stats->pagesDecompressed = vt.pagesDecompressed;
+		stats->decompressionSeconds = vt.decompressionSeconds;
+	}	// unlock
+}
+
+void vtResetStats()
+{
+	LOCK(vt.statsMutex)
+
+	vt.pagesRead = vt.diskBytesRead = vt.pagesDecompressed = vt.compressedCacheHits = vt.pageCacheHits = vt.pagesPrefetched = vt.pagesCancelled = 0;
+	vt.decompressionSeconds = vt.uploadSeconds = 0.0;
+}
+
+bool vtStartStatsTrace(const char *tracePath)
+{
+	vtStopStatsTrace();
+
+	vt.traceFile = fopen(tracePath, "w");
+	if (!vt.traceFile)
+	{
+		printf("Error: can't open %s for the statistics trace\n", tracePath);
+		return false;
+	}
+
+	fprintf(vt.traceFile, "frame,necessary_pages,new_pages,missing_pages,cached_requests,disk_requests,needed_queue,compressed_queue,new_queue,prefetch_queue,cached_pages,cached_mb,compressed_cached_mb,evictions,compressed_hits,page_cache_hits,pages_prefetched,pages_cancelled,pages_read,disk_kb_read,pages_decompressed,decompression_ms,upload_kb,upload_ms,bias\n");
+
+	vtGetStats(&vt.traceLast);
+
+	return true;
+}
+
+void vtStopStatsTrace()
+{
+	if (!vt.traceFile)
+		return;
+
+	fclose(vt.traceFile);
+	vt.traceFile = NULL;
+}
+
+void vtStatsTraceFrame()
+{
+	vtStats s;
+
+	vtGetStats(&s);
+
+	fprintf(vt.traceFile, "%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.2f,%.2f,%llu,%llu,%llu,%llu,%llu,%llu,%.1f,%llu,%.3f,%.1f,%.3f,%.2f\n",
+			s.frame, s.necessaryPageCount, s.newPageCount, s.missingPageCount, s.cachedRequestCount, s.diskRequestCount,
+			s.neededQueueDepth, s.compressedQueueDepth, s.newQueueDepth, s.prefetchQueueDepth, s.cachedPages, s.cachedBytes / (1024.0 * 1024.0), s.compressedCachedBytes / (1024.0 * 1024.0),
+			(long long unsigned int) (s.cacheEvictions - vt.traceLast.cacheEvictions),
+			(long long unsigned int) (s.compressedCacheHits - vt.traceLast.compressedCacheHits),
+			(long long unsigned int) (s.pageCacheHits - vt.traceLast.pageCacheHits),
+			(long long unsigned int) (s.pagesPrefetched - vt.traceLast.pagesPrefetched),
+			(long long unsigned int) (s.pagesCancelled - vt.traceLast.pagesCancelled),
+			(long long unsigned int) (s.pagesRead - vt.traceLast.pagesRead),
+			(s.diskBytesRead - vt.traceLast.diskBytesRead) / 1024.0,
+			(long long unsigned int) (s.pagesDecompressed - vt.traceLast.pagesDecompressed),
+			(s.decompressionSeconds - vt.traceLast.decompressionSeconds) * 1000.0,
+			s.uploadBytes / 1024.0, s.uploadSeconds * 1000.0, s.bias);
+
+	vt.traceLast = s;
+}
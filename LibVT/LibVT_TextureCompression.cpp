@@ -30,9 +30,9 @@ void * vtuCompressRGBA_DXT1(void *rgba)
 #else
 
 	int out_bytes = 0;
-	uint8_t *out = (uint8_t *)malloc((c.pageDimension+3)*(c.pageDimension+3)/16*8);
+	uint8_t *out = (uint8_t *)vtpAlloc(((c.pageDimension+3)/4)*((c.pageDimension+3)/4)*8); // exactly c.pageMemsize, so DXT1 pages come from the page pool
 
-	CompressImageDXT1((const byte*)rgba, out, c.pageDimension, c.pageDimension, out_bytes);
+	CompressImageDXT1((const uint8_t *)rgba, out, c.pageDimension, c.pageDimension, out_bytes);
 
 	return out;
 #endif
@@ -43,9 +43,9 @@ void * vtuCompressRGBA_DXT5(void *rgba)
 #if defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE
 #else
 	int out_bytes = 0;
-	uint8_t *out = (uint8_t *)malloc((c.pageDimension+3)*(c.pageDimension+3)/16*16);
+	uint8_t *out = (uint8_t *)vtpAlloc(((c.pageDimension+3)/4)*((c.pageDimension+3)/4)*16);
 
-	CompressImageDXT5((const byte*)rgba, out, c.pageDimension, c.pageDimension, out_bytes);
+	CompressImageDXT5((const uint8_t *)rgba, out, c.pageDimension, c.pageDimension, out_bytes);
 
 	return out;
 #endif
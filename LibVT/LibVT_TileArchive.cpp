@@ -0,0 +1,702 @@
+/*
+ *  LibVT_TileArchive.cpp
+ *
+ *
+ *  Single-file, memory-mapped page store, and the map of which pages a store contains.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "LibVT_Internal.h"
+#include "LibVT.h"
+
+#include <sys/stat.h>
+#ifdef WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+#include <algorithm>
+
+extern vtData vt;
+extern vtConfig c;
+
+// archive layout (little endian):
+//	vtArchiveHeader
+//	vtArchiveEntry[indexCount]	- ordered by mip, then row (top left origin, like the tile files), then column
+//	tile data					- the unmodified tile files, back to back
+// an entry with length 0 denotes a tile that is not present in the store
+
+static uint32_t _vtuArchiveIndexCount(uint8_t mipChainLength)
+{
+	const uint32_t virtTexDimensionPages = 2 << (mipChainLength - 2);
+	uint32_t count = 0;
+
+	for (uint8_t i = 0; i < mipChainLength; i++)
+		count += (virtTexDimensionPages >> i) * (virtTexDimensionPages >> i);
+
+	return count;
+}
+
+static uint32_t _vtuArchiveIndexPosition(uint8_t mipChainLength, uint8_t mip, uint16_t x, uint16_t y_disk)
+{
+	const uint32_t virtTexDimensionPages = 2 << (mipChainLength - 2);
+	uint32_t offset = 0;
+
+	for (uint8_t i = 0; i < mip; i++)
+		offset += (virtTexDimensionPages >> i) * (virtTexDimensionPages >> i);
+
+	return offset + y_disk * (virtTexDimensionPages >> mip) + x;
+}
+
+string vtuTileArchivePath(const char *_tileDir)
+{
+	return string(_tileDir) + string(PATH_SEPERATOR) + string(VT_ARCHIVE_FILENAME);
+}
+
+bool vtuReadTileArchiveHeader(const char *archivePath, vtArchiveHeader *header)
+{
+	FILE *f = fopen(archivePath, "rb");
+
+	if (!f)
+		return false;
+
+	size_t result = fread(header, 1, sizeof(vtArchiveHeader), f);
+	fclose(f);
+
+	if ((result != sizeof(vtArchiveHeader)) || (memcmp(header->magic, VT_ARCHIVE_MAGIC, 4) != 0))
+		return false;
+
+	if (header->version != VT_ARCHIVE_VERSION)
+	{
+		printf("Error: %s has unsupported archive version %u\n", archivePath, header->version);
+		return false;
+	}
+
+	if ((header->mipChainLength < 2) || (header->mipChainLength > 11) || (header->indexCount != _vtuArchiveIndexCount(header->mipChainLength)))
+	{
+		printf("Error: %s has a corrupt archive header\n", archivePath);
+		return false;
+	}
+
+	return true;
+}
+
+bool vtuOpenTileArchive(const uint8_t store, const char *archivePath)
+{
+	vtArchiveHeader header;
+
+	if (!vtuReadTileArchiveHeader(archivePath, &header))
+		return false;
+
+#ifdef WIN32
+	HANDLE file = CreateFileA(archivePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data)
+		return false;
+
+	const uint64_t size = (uint64_t) fileSize.QuadPart;
+#else
+	int fd = open(archivePath, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, (size_t) fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // the mapping keeps the file referenced
+	if (data == MAP_FAILED)
+		return false;
+
+#ifdef MADV_RANDOM
+	madvise(data, (size_t) fileStat.st_size, MADV_RANDOM); // page requests are scattered, sequential readahead just wastes IO
+#endif
+
+	const uint64_t size = (uint64_t) fileStat.st_size;
+#endif
+
+	if (size < header.indexOffset + (uint64_t) header.indexCount * sizeof(vtArchiveEntry))
+	{
+		printf("Error: %s is truncated\n", archivePath);
+#ifdef WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(data, (size_t) size);
+#endif
+		return false;
+	}
+
+	vtStore &st = STORE(store);
+
+	st.archiveData = (const uint8_t *) data;
+	st.archiveSize = size;
+	st.archiveIndex = (const vtArchiveEntry *) (st.archiveData + header.indexOffset);
+	st.archiveMipChainLength = header.mipChainLength;
+
+	return true;
+}
+
+void vtuCloseTileArchive(const uint8_t store)
+{
+	vtStore &st = STORE(store);
+
+	if (!st.archiveData)
+		return;
+
+#ifdef WIN32
+	UnmapViewOfFile((void *) st.archiveData);
+#else
+	munmap((void *) st.archiveData, (size_t) st.archiveSize);
+#endif
+
+	st.archiveData = NULL;
+	st.archiveSize = 0;
+	st.archiveIndex = NULL;
+	st.archiveMipChainLength = 0;
+}
+
+const void * vtuArchiveTile(const uint8_t store, uint8_t mip, uint16_t x, uint16_t y_disk, uint32_t *size)
+{
+	const vtStore &st = STORE(store);
+	const vtArchiveEntry &entry = st.archiveIndex[_vtuArchiveIndexPosition(st.archiveMipChainLength, mip, x, y_disk)];
+
+	if ((entry.length == 0) || (entry.offset + entry.length > st.archiveSize))
+	{
+		*size = 0;
+		return NULL;
+	}
+
+	*size = entry.length;
+	return st.archiveData + entry.offset;
+}
+
+bool vtuIsArchiveData(const void *data)
+{
+	for (uint8_t s = 0; s < vt.storeCount; s++)
+		if (STORE(s).archiveData && ((const uint8_t *) data >= STORE(s).archiveData) && ((const uint8_t *) data < STORE(s).archiveData + STORE(s).archiveSize))
+			return true;
+
+	return false;
+}
+
+static void _vtuTileFilePath(const uint32_t pageInfo, char *buf)
+{
+	const uint8_t mip = EXTRACT_MIP(pageInfo);
+	const vtStore &st = PAGE_STORE(pageInfo);
+
+	snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_%u_%u.%s", st.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, mip, PATH_SEPERATOR, mip, EXTRACT_X(pageInfo), st.mipTranslation[mip] - EXTRACT_Y(pageInfo), c.pageCodec.c_str()); // convert from lower left coordinates (opengl) to top left (tile store on disk)
+}
+
+void * vtuLoadPageFile(uint32_t pageInfo, const uint32_t offset, uint32_t *file_size)
+{
+	const uint16_t y_coord = EXTRACT_Y(pageInfo), x_coord = EXTRACT_X(pageInfo);
+	const uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
+	const vtStore &st = STORE(store);
+	const uint16_t y_disk = st.mipTranslation[mip] - y_coord; // convert from lower left coordinates (opengl) to top left (tile store on disk)
+
+	if (st.archiveData)
+	{
+		uint32_t size;
+		const uint8_t *tile = (const uint8_t *) vtuArchiveTile(store, mip, x_coord, y_disk, &size);
+
+		if (!tile || size <= offset)
+		{
+			printf("Error: tried to load nonexisting tile from archive %s: Mip:%u %u/%u\n", st.tileDir.c_str(), mip, x_coord, y_disk);
+			if (file_size) *file_size = 0;
+			return NULL;
+		}
+
+		if (file_size) *file_size = size - offset;
+		return (void *) (tile + offset); // zero-copy, must be released with vtuUnloadPageFile()
+	}
+	else
+	{
+		char buf[255];
+
+		_vtuTileFilePath(pageInfo, buf);
+
+		if (file_size) *file_size = 0;
+		return vtuLoadFile(buf, offset, file_size);
+	}
+}
+
+void vtuUnloadPageFile(void *file_data)
+{
+	if (file_data && !vtuIsArchiveData(file_data))
+		vtpFree(file_data);
+}
+
+// batched reading: the loading thread reads the tiles of all requests it took at once. the OS is told about all of them first, so it can
+// queue the reads and sort them itself, then they are read in on-disk order. tile archives are memory mapped and laid out in the order of
+// their index, for them the hint is all there is to do, the pages fault in when decoded. the tile names of a directory store say nothing
+// about where their data is, those files are read in inode order - file systems mostly allocate both in the order the files were written.
+
+// the position of a page's tile in its archive, and the order directory stores are opened in
+static uint64_t _vtuPageFileLocation(const uint32_t pageInfo)
+{
+	const uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
+	const vtStore &st = STORE(store);
+	const uint16_t y_disk = st.mipTranslation[mip] - EXTRACT_Y(pageInfo);
+
+	return ((uint64_t) store << 32) + _vtuArchiveIndexPosition(st.archiveData ? st.archiveMipChainLength : st.mipChainLength, mip, EXTRACT_X(pageInfo), y_disk);
+}
+
+#ifndef WIN32
+static void _vtuAdviseArchiveData(const void *data, const uint32_t size)
+{
+#ifdef MADV_WILLNEED
+	static const uintptr_t pageSize = (uintptr_t) sysconf(_SC_PAGESIZE);
+	const uintptr_t start = ((uintptr_t) data) & ~(pageSize - 1);
+
+	madvise((void *) start, ((uintptr_t) data) + size - start, MADV_WILLNEED);
+#endif
+}
+
+static void _vtuAdviseFile(const int fd, const off_t offset, const off_t size)
+{
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+#endif
+}
+
+static bool _vtuReadFile(const int fd, void *data, const uint32_t size, const off_t offset)
+{
+	uint32_t done = 0;
+
+	while (done < size)
+	{
+		const ssize_t result = pread(fd, (char *) data + done, size - done, offset + done);
+
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			return false;
+
+		done += (uint32_t) result;
+	}
+
+	return true;
+}
+#endif
+
+// like vtuLoadPageFile() for each page, data is NULL for the pages that couldn't be loaded. the order of the pages is kept
+void vtuLoadPageFiles(vtCompressedPage *pages, const uint32_t count, const uint32_t offset)
+{
+	vector< pair<uint64_t, uint32_t> > order(count);
+
+	for (uint32_t i = 0; i < count; i++)
+		order[i] = make_pair(_vtuPageFileLocation(pages[i].pageInfo), i);
+	sort(order.begin(), order.end());
+
+#ifdef WIN32
+	for (uint32_t i = 0; i < count; i++)
+	{
+		vtCompressedPage &page = pages[order[i].second];
+
+		page.size = 0;
+		page.data = vtuLoadPageFile(page.pageInfo, offset, &page.size);
+	}
+#else
+	vector<int> files(count, -1);
+	vector< pair< pair<uint64_t, uint64_t>, uint32_t> > fileOrder;	// device and inode of the opened tile files
+
+	// open all files before reading the first one
+	for (uint32_t i = 0; i < count; i++)
+	{
+		vtCompressedPage &page = pages[order[i].second];
+
+		page.size = 0;
+		page.data = NULL;
+
+		if (PAGE_STORE(page.pageInfo).archiveData)
+		{
+			page.data = vtuLoadPageFile(page.pageInfo, offset, &page.size);
+			if (page.data)
+				_vtuAdviseArchiveData(page.data, page.size);
+			continue;
+		}
+
+		char buf[255];
+		struct stat fileStat;
+
+		_vtuTileFilePath(page.pageInfo, buf);
+
+		files[i] = open(buf, O_RDONLY);
+		if (files[i] < 0)
+		{
+			printf("Error: tried to load nonexisting file %s\n", buf);
+			continue;
+		}
+
+		if ((fstat(files[i], &fileStat) != 0) || (fileStat.st_size <= (off_t) offset))
+		{
+			printf("Error: tried to load empty file %s\n", buf);
+			close(files[i]);
+			files[i] = -1;
+			continue;
+		}
+
+		page.size = (uint32_t) (fileStat.st_size - offset);
+		fileOrder.push_back(make_pair(make_pair((uint64_t) fileStat.st_dev, (uint64_t) fileStat.st_ino), i));
+	}
+	sort(fileOrder.begin(), fileOrder.end());
+
+	// announce all reads before waiting for the first one
+	for (uint32_t f = 0; f < fileOrder.size(); f++)
+	{
+		const uint32_t i = fileOrder[f].second;
+
+		_vtuAdviseFile(files[i], offset, pages[order[i].second].size);
+	}
+
+	for (uint32_t f = 0; f < fileOrder.size(); f++)
+	{
+		const uint32_t i = fileOrder[f].second;
+		vtCompressedPage &page = pages[order[i].second];
+
+		page.data = vtpAlloc(page.size);
+		assert(page.data);
+
+		if (!_vtuReadFile(files[i], page.data, page.size, offset))
+		{
+			printf("Error: couldn't read the tile of page Mip:%u %u/%u\n", EXTRACT_MIP(page.pageInfo), EXTRACT_X(page.pageInfo), EXTRACT_Y(page.pageInfo));
+			vtpFree(page.data);
+			page.data = NULL;
+			page.size = 0;
+		}
+
+		close(files[i]);
+	}
+#endif
+}
+
+// lets the OS read a page's tile into its file cache
+void vtuAdvisePageFile(const uint32_t pageInfo)
+{
+#ifndef WIN32
+	const uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
+	const vtStore &st = STORE(store);
+
+	if (st.archiveData)
+	{
+		uint32_t size;
+		const void *tile = vtuArchiveTile(store, mip, EXTRACT_X(pageInfo), st.mipTranslation[mip] - EXTRACT_Y(pageInfo), &size);
+
+		if (tile)
+			_vtuAdviseArchiveData(tile, size);
+	}
+	else
+	{
+		char buf[255];
+
+		_vtuTileFilePath(pageInfo, buf);
+
+		const int fd = open(buf, O_RDONLY);
+		if (fd >= 0)
+		{
+			_vtuAdviseFile(fd, 0, 0);
+			close(fd);
+		}
+	}
+#endif
+}
+
+// speculative: lets the OS read the other children of the parents of the given pages into its file cache, they are likely to be requested next.
+// the opens are round trips on network shares, with ENABLE_MT they are left to the low priority readahead thread instead of the loading thread
+void vtuReadaheadSiblingPages(const vtCompressedPage *pages, const uint32_t count)
+{
+#ifndef WIN32
+	vector<uint32_t> siblings;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t pageInfo = pages[i].pageInfo;
+		const uint8_t mip = EXTRACT_MIP(pageInfo), store = EXTRACT_STORE(pageInfo);
+		const vtStore &st = STORE(store);
+
+		if (!pages[i].data || (mip >= st.mipChainLength - 1))
+			continue;
+
+		const uint16_t x = EXTRACT_X(pageInfo), y = EXTRACT_Y(pageInfo);
+
+		for (uint8_t s = 1; s < 4; s++)
+		{
+			const uint32_t sibling = MAKE_PAGE_INFO(store, mip, x ^ (s & 1), y ^ (s >> 1));
+
+			if (vtuPageExists(sibling) && !vtcIsPageInCacheLOCK(sibling))
+				siblings.push_back(sibling);
+		}
+	}
+
+#if ENABLE_MT
+	vtReadaheadPages(siblings);
+#else
+	for (uint32_t i = 0; i < siblings.size(); i++)
+		vtuAdvisePageFile(siblings[i]);
+#endif
+#endif
+}
+
+// the existence map is built when the store is opened, from the archive index or from one listing of each level directory, so requests
+// for pages outside the footprint of a sparse store resolve to the fallback entry without touching the disk. pages that fail to load later
+// are cleared in it, so they are requested only once.
+void vtuInitPageExistence(const uint8_t store)
+{
+	vtStore &st = STORE(store);
+
+	vtuFreePageExistence(store);
+
+	const uint32_t pageCount = st.pageTableMipOffsets[st.mipChainLength - 1] + 1;
+	const bool statTiles = !c.pageCacheDir.empty(); // only the page cache needs to notice tiles that were rewritten in place
+	uint32_t presentCount = 0;
+
+	st.newestTileTime = 0;
+
+	st.pageExistence = (uint8_t *) calloc(1, (pageCount + 7) / 8);
+	assert(st.pageExistence);
+
+	if (st.archiveData)
+	{
+		uint32_t position = 0;
+
+		for (uint8_t mip = 0; mip < st.mipChainLength; mip++)
+			for (uint16_t y_disk = 0; y_disk < (st.virtTexDimensionPages >> mip); y_disk++)
+				for (uint16_t x = 0; x < (st.virtTexDimensionPages >> mip); x++, position++) // archive index order
+				{
+					if (st.archiveIndex[position].length == 0)
+						continue;
+
+					const uint32_t i = PAGE_INDEX(store, mip, x, st.mipTranslation[mip] - y_disk);
+					st.pageExistence[i >> 3] |= (uint8_t) (1 << (i & 7));
+					presentCount++;
+				}
+	}
+	else
+	{
+		const string suffix = string(".") + c.pageCodec;
+		char buf[255];
+
+		for (uint8_t mip = 0; mip < st.mipChainLength; mip++)
+		{
+			const uint32_t dimension = st.virtTexDimensionPages >> mip;
+
+			snprintf(buf, 255, "%s%stiles_b%u_level%u", st.tileDir.c_str(), PATH_SEPERATOR, c.pageBorder, mip);
+
+			DIR *dp = opendir(buf);
+			if (!dp) // can't list it, assume the level is complete and let the loader find the holes
+			{
+				for (uint32_t i = PAGE_INDEX(store, mip, 0, 0); i < PAGE_INDEX(store, mip, 0, 0) + dimension * dimension; i++)
+					st.pageExistence[i >> 3] |= (uint8_t) (1 << (i & 7));
+				presentCount += dimension * dimension;
+				continue;
+			}
+
+			struct dirent *ep;
+			while ((ep = readdir(dp)))
+			{
+				const string file = string(ep->d_name);
+				unsigned int m, x, y_disk;
+
+				if ((file.length() <= suffix.length()) || (file.compare(file.length() - suffix.length(), suffix.length(), suffix) != 0) ||
+					(sscanf(ep->d_name, "tile_%u_%u_%u.", &m, &x, &y_disk) != 3) || (m != mip) || (x >= dimension) || (y_disk >= dimension))
+					continue;
+
+				const uint32_t i = PAGE_INDEX(store, mip, x, st.mipTranslation[mip] - y_disk);
+				if (!(st.pageExistence[i >> 3] & (1 << (i & 7))))
+				{
+					st.pageExistence[i >> 3] |= (uint8_t) (1 << (i & 7));
+					presentCount++;
+				}
+
+				struct stat info;
+				if (statTiles && (stat((string(buf) + PATH_SEPERATOR + file).c_str(), &info) == 0) && ((uint64_t) info.st_mtime > st.newestTileTime))
+					st.newestTileTime = (uint64_t) info.st_mtime;
+			}
+			closedir(dp);
+		}
+	}
+
+	if (presentCount < pageCount)
+		printf("Sparse page store %s: %u of %u pages present\n", st.tileDir.c_str(), presentCount, pageCount);
+}
+
+void vtuFreePageExistence(const uint8_t store)
+{
+	free(STORE(store).pageExistence);
+	STORE(store).pageExistence = NULL;
+}
+
+bool vtuPageExists(uint32_t pageInfo)
+{
+	const vtStore &st = PAGE_STORE(pageInfo);
+
+	if (!st.pageExistence)
+		return true;
+
+	const uint32_t i = PAGE_INDEX(EXTRACT_STORE(pageInfo), EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo));
+
+	// no lock on the render thread, vtuMarkPageMissing() stores whole bytes and bits only ever get cleared. a stale bit just costs one more request
+	const uint8_t bits = ((const volatile uint8_t *) st.pageExistence)[i >> 3];
+
+	return (bits & (1 << (i & 7))) != 0;
+}
+
+void vtuMarkPageMissing(uint32_t pageInfo)
+{
+	vtStore &st = PAGE_STORE(pageInfo);
+
+	if (!st.pageExistence)
+		return;
+
+	const uint32_t i = PAGE_INDEX(EXTRACT_STORE(pageInfo), EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo));
+
+	{	// lock
+		LOCK(vt.pageExistenceMutex) // the loading threads clear bits of the same bytes concurrently, readers don't lock
+
+		volatile uint8_t *byte = (volatile uint8_t *) &st.pageExistence[i >> 3];
+		*byte = (uint8_t) (*byte & ~(1 << (i & 7)));
+	}	// unlock
+}
+
+// drops the half written archive, an existing one stays untouched
+static bool _vtuAbortPacking(FILE *out, vtArchiveEntry *index, const string &tmpPath, const char *message)
+{
+	printf("Error: %s, %s is removed\n", message, tmpPath.c_str());
+
+	if (out)
+		fclose(out);
+	free(index);
+	remove(tmpPath.c_str());
+
+	return false;
+}
+
+bool vtPackTileStore(const char *_tileDir)
+{
+	char ext[5] = "    ";
+	uint8_t border, length;
+	uint32_t dim;
+
+	if (!vtuScanTileDirectory(_tileDir, ext, &border, &length, &dim))
+		return false;
+
+	const string codec = string(ext);
+	const string archivePath = vtuTileArchivePath(_tileDir);
+	const string tmpPath = archivePath + string(".tmp");
+	const uint32_t virtTexDimensionPages = 2 << (length - 2);
+
+	vtArchiveHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, VT_ARCHIVE_MAGIC, 4);
+	header.version = VT_ARCHIVE_VERSION;
+	header.pageDimension = dim;
+	header.pageBorder = border;
+	header.mipChainLength = length;
+	memcpy(header.codec, ext, 4);
+	header.indexCount = _vtuArchiveIndexCount(length);
+	header.indexOffset = sizeof(vtArchiveHeader);
+
+	vtArchiveEntry *index = (vtArchiveEntry *) calloc(header.indexCount, sizeof(vtArchiveEntry));
+	assert(index);
+
+	FILE *out = fopen(tmpPath.c_str(), "wb");
+	if (!out)
+	{
+		printf("Error: can't create %s\n", tmpPath.c_str());
+		free(index);
+		return false;
+	}
+
+	// reserve header and index, they are rewritten once the data offsets are known
+	if ((fwrite(&header, sizeof(header), 1, out) != 1) || (fwrite(index, sizeof(vtArchiveEntry), header.indexCount, out) != header.indexCount))
+		return _vtuAbortPacking(out, index, tmpPath, "writing the archive index failed");
+
+	uint64_t offset = header.indexOffset + (uint64_t) header.indexCount * sizeof(vtArchiveEntry);
+	uint32_t missing = 0;
+	char buf[255];
+
+	for (uint8_t mip = 0; mip < length; mip++)
+	{
+		for (uint16_t y = 0; y < (virtTexDimensionPages >> mip); y++)
+		{
+			for (uint16_t x = 0; x < (virtTexDimensionPages >> mip); x++)
+			{
+				snprintf(buf, 255, "%s%stiles_b%u_level%u%stile_%u_%u_%u.%s", _tileDir, PATH_SEPERATOR, border, mip, PATH_SEPERATOR, mip, x, y, codec.c_str());
+
+				if (!vtuFileExists(buf))
+				{
+					missing++;
+					continue;
+				}
+
+				uint32_t size = 0;
+				void *data = vtuLoadFile(buf, 0, &size);
+
+				if (!data)
+					return _vtuAbortPacking(out, index, tmpPath, "a tile couldn't be read");
+
+				const bool written = (fwrite(data, 1, size, out) == size);
+				vtpFree(data);
+
+				if (!written)
+					return _vtuAbortPacking(out, index, tmpPath, "writing the tile data failed");
+
+				vtArchiveEntry &entry = index[_vtuArchiveIndexPosition(length, mip, x, y)];
+				entry.offset = offset;
+				entry.length = size;
+				offset += size;
+			}
+		}
+	}
+
+	if ((fseek(out, 0, SEEK_SET) != 0) || (fwrite(&header, sizeof(header), 1, out) != 1) || (fwrite(index, sizeof(vtArchiveEntry), header.indexCount, out) != header.indexCount))
+		return _vtuAbortPacking(out, index, tmpPath, "writing the archive index failed");
+
+	const bool closed = (fclose(out) == 0); // the buffered data may only fail to reach the disk here
+	if (!closed)
+		return _vtuAbortPacking(NULL, index, tmpPath, "writing the archive failed");
+	free(index);
+
+	// replaces the old archive in one step, it is only ever swapped for a complete one
+#ifdef WIN32
+	if (!MoveFileExA(tmpPath.c_str(), archivePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+	if (rename(tmpPath.c_str(), archivePath.c_str()) != 0)
+#endif
+	{
+		printf("Error: can't move %s into place\n", tmpPath.c_str());
+		remove(tmpPath.c_str());
+		return false;
+	}
+
+	printf("Packed %u tiles (%u missing) into %s (%llu bytes)\n", header.indexCount - missing, missing, archivePath.c_str(), (long long unsigned int) offset);
+
+	return true;
+}
@@ -18,13 +18,18 @@
 #include "LibVT_Internal.h"
 #include "LibVT.h"
 #include <fcntl.h>
+#ifdef WIN32
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+#endif
 
 extern vtConfig c;
 
 
 uint32_t * vtuDownsampleImageRGBA(const uint32_t *tex)
 {
-	uint32_t *smallTex = (uint32_t *)malloc(c.pageDimension * c.pageDimension);
+	uint32_t *smallTex = (uint32_t *)vtpAlloc(c.pageDimension * c.pageDimension);
 	assert(smallTex);
 
 	for (uint16_t x = 0; x < c.pageDimension / 2; x++)
@@ -56,7 +61,7 @@ uint32_t * vtuDownsampleImageRGBA(const uint32_t *tex)
 uint32_t * vtuDownsampleImageRGB(const uint32_t *_tex)
 {
 	uint8_t *tex = (uint8_t *) _tex;
-	uint8_t *smallTex = (uint8_t *)malloc((c.pageDimension * c.pageDimension * 3) / 4);
+	uint8_t *smallTex = (uint8_t *)vtpAlloc((c.pageDimension * c.pageDimension * 3) / 4);
 	assert(smallTex);
 
 	for (uint16_t x = 0; x < c.pageDimension / 2; x++)
@@ -139,7 +144,7 @@ void * vtuLoadFile(const char *filePath, const uint32_t offset, uint32_t *file_s
 	f = fopen(filePath, "rb");
 	if (!f)
 	{
-		printf("Error: tried to load nonexisting file");
+		printf("Error: tried to load nonexisting file %s\n", filePath);
 		return NULL;
 	}
 //#if !defined(WIN32)
@@ -164,7 +169,7 @@ void * vtuLoadFile(const char *filePath, const uint32_t offset, uint32_t *file_s
 	fseek(f, offset, SEEK_SET);
 
 
-	fileData = (char *) malloc(*fsp);
+	fileData = (char *) vtpAlloc(*fsp);
 	assert(fileData);
 
 	result = fread(fileData, 1, *fsp, f);
@@ -175,3 +180,17 @@ void * vtuLoadFile(const char *filePath, const uint32_t offset, uint32_t *file_s
 
 	return fileData;
 }
+
+double vtuTime()
+{
+#ifdef WIN32
+	LARGE_INTEGER f, t;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&t);
+	return (double) t.QuadPart / (double) f.QuadPart;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
@@ -29,16 +29,27 @@
 	#endif
 #endif
 
+#if PHYS_TEX_LAYERS > 1
+	#extension GL_EXT_texture_array: require
+#endif
+
 struct vtexcoord
 {
    vec2 coord;
+#if PHYS_TEX_LAYERS > 1
+   float layer;
+#endif
 #ifdef VTEX_GRAD
    vec4 grad;
 #endif
 };
 
 uniform sampler2D pageTableTexture;
+#if PHYS_TEX_LAYERS > 1
+uniform sampler2DArray physicalTexture;
+#else
 uniform sampler2D physicalTexture;
+#endif
 uniform sampler2D mipcalcTexture;
 uniform float mip_bias;
 
@@ -94,10 +105,10 @@ vec4 calculatePageRequest(vec2 uv)
 	result.rg = page;
 	result.b = mip / 255.0;
 #endif
-
-	result.a = 1.0;		// BGRA		mip, x, y, 255
 #endif
 
+	result.a = (255.0 - float(STORE_ID)) / 255.0;		// BGRA		mip, x, y, 255 - store
+
 	return result;
 }
 
@@ -136,6 +147,10 @@ vtexcoord calulateCoordinatesFromSample(vec4 pageTableEntry)
 	float mipExp = pageTableEntry.a + 1.0;
 #endif
 	vec2 pageCoord = pageTableEntry.bg;
+#if PHYS_TEX_LAYERS > 1
+	vec2 layerBits = floor((pageCoord + 0.5) / 64.0); // the layer is stored above the page position, see SLOT_X() in LibVT_Internal.h
+	pageCoord -= layerBits * 64.0;
+#endif
 	vec2 withinPageCoord = fract(texcoord.xy * mipExp);
 
 #if PAGE_BORDER
@@ -145,6 +160,9 @@ vtexcoord calulateCoordinatesFromSample(vec4 pageTableEntry)
 
    	vtexcoord result;
 	result.coord = ((pageCoord + withinPageCoord) / phys_tex_dimension_pages);
+#if PHYS_TEX_LAYERS > 1
+	result.layer = layerBits.x + layerBits.y * 4.0;
+#endif
 #ifdef VTEX_GRAD
 	float page_unit_to_phys = ((page_dimension - border_width * 2.0) /page_dimension) / phys_tex_dimension_pages;
 	float gradient_scale = exp2(mip_bias + mip_trilerp_bias) * page_unit_to_phys * mipExp;
@@ -199,6 +217,9 @@ vtexcoord calulateVirtualTextureCoordinates()
 		{
 		   	vtexcoord result;
 			result.coord = vec2(2.0, 2.0);
+#if PHYS_TEX_LAYERS > 1
+			result.layer = 0.0;
+#endif
 			return result;
 		}
 	}
@@ -207,11 +228,19 @@ vtexcoord calulateVirtualTextureCoordinates()
 
 vec4 sampleVirtualTexture(vtexcoord coordinates)
 {
+#if PHYS_TEX_LAYERS > 1
+#ifdef VTEX_GRAD
+		return texture2DArrayGrad(physicalTexture, vec3(coordinates.coord, coordinates.layer), coordinates.grad.xy, coordinates.grad.zw);
+#else
+		return texture2DArray(physicalTexture, vec3(coordinates.coord, coordinates.layer));
+#endif
+#else
 #ifdef VTEX_GRAD
 		return texture2DGrad(physicalTexture, coordinates.coord, coordinates.grad.xy, coordinates.grad.zw);
 #else
 		return texture2D(physicalTexture, coordinates.coord);
 #endif
+#endif
 }
 
 
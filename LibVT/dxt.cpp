@@ -0,0 +1,534 @@
+/*
+ *  dxt.cpp
+ *
+ *
+ *  DXT1 / DXT5 (BC1 / BC3) compression of RGBA images, after "Real-Time DXT Compression" by J.M.P. van Waveren.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "dxt.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define DXT_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define DXT_SSE2 0
+#endif
+
+typedef unsigned char byte;
+
+// the fast mode encodes every 4x4 block with the end points of its color (and alpha) bounding box, inset a little to reduce the error of the interpolated colors.
+// the SSE2 and the scalar version of the fast mode produce identical blocks: both pick the palette entry with the smallest squared RGB distance, the lower index on ties.
+// blocks at the right and bottom edge of images with sizes that are no multiple of 4 repeat their last row / column.
+
+#define INSET_SHIFT		4
+#define HQ_ITERATIONS	2
+
+static void _extractBlock(const byte *inBuf, int width, int height, int bx, int by, byte block[64])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		const int sy = (by + y < height) ? by + y : height - 1;
+
+		for (int x = 0; x < 4; x++)
+		{
+			const int sx = (bx + x < width) ? bx + x : width - 1;
+
+			memcpy(block + (y * 4 + x) * 4, inBuf + (sy * width + sx) * 4, 4);
+		}
+	}
+}
+
+static unsigned short _colorTo565(const byte color[4])
+{
+	return (unsigned short) (((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static void _color565ToRGB(unsigned short c, int rgb[3])
+{
+	const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void _colorPalette(unsigned short color0, unsigned short color1, int palette[4][3])
+{
+	_color565ToRGB(color0, palette[0]);
+	_color565ToRGB(color1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+}
+
+static void _alphaPalette(byte maxAlpha, byte minAlpha, int palette[8])
+{
+	palette[0] = maxAlpha;
+	palette[1] = minAlpha;
+	for (int p = 1; p < 7; p++)
+		palette[p + 1] = ((7 - p) * maxAlpha + p * minAlpha) / 7;
+}
+
+static byte * _writeColorBlock(unsigned short color0, unsigned short color1, unsigned int indices, byte *out)
+{
+	out[0] = (byte) color0;
+	out[1] = (byte) (color0 >> 8);
+	out[2] = (byte) color1;
+	out[3] = (byte) (color1 >> 8);
+	out[4] = (byte) indices;
+	out[5] = (byte) (indices >> 8);
+	out[6] = (byte) (indices >> 16);
+	out[7] = (byte) (indices >> 24);
+
+	return out + 8;
+}
+
+static byte * _writeAlphaBlock(byte maxAlpha, byte minAlpha, const byte indices[16], byte *out)
+{
+	unsigned long long bits = 0;
+
+	for (int i = 15; i >= 0; i--)
+		bits = (bits << 3) | indices[i];
+
+	out[0] = maxAlpha;
+	out[1] = minAlpha;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (byte) (bits >> (8 * i));
+
+	return out + 8;
+}
+
+// nearest palette entry for every pixel, returns the squared error of the block
+static int _colorIndices(const byte *src, int stride, const int palette[4][3], unsigned int &indices)
+{
+	int error = 0;
+
+	indices = 0;
+	for (int i = 15; i >= 0; i--)
+	{
+		const byte *p = src + (i / 4) * stride + (i % 4) * 4;
+		int best = 0, bestDistance = 0x7FFFFFFF;
+
+		for (int e = 0; e < 4; e++)
+		{
+			const int dr = p[0] - palette[e][0], dg = p[1] - palette[e][1], db = p[2] - palette[e][2];
+			const int distance = dr * dr + dg * dg + db * db;
+
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = e;
+			}
+		}
+
+		indices = (indices << 2) | best;
+		error += bestDistance;
+	}
+
+	return error;
+}
+
+static void _alphaIndices(const byte *src, int stride, const int palette[8], byte indices[16])
+{
+	for (int i = 0; i < 16; i++)
+	{
+		const int a = src[(i / 4) * stride + (i % 4) * 4 + 3];
+		int best = 0, bestDistance = 256;
+
+		for (int e = 0; e < 8; e++)
+		{
+			const int distance = (a > palette[e]) ? a - palette[e] : palette[e] - a;
+
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = e;
+			}
+		}
+
+		indices[i] = (byte) best;
+	}
+}
+
+
+// fast mode, scalar
+
+static void _getMinMaxColors(const byte *src, int stride, byte minColor[4], byte maxColor[4])
+{
+	minColor[0] = minColor[1] = minColor[2] = minColor[3] = 255;
+	maxColor[0] = maxColor[1] = maxColor[2] = maxColor[3] = 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		const byte *p = src + (i / 4) * stride + (i % 4) * 4;
+
+		for (int c = 0; c < 4; c++)
+		{
+			if (p[c] < minColor[c]) minColor[c] = p[c];
+			if (p[c] > maxColor[c]) maxColor[c] = p[c];
+		}
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		const byte inset = (maxColor[c] - minColor[c]) >> INSET_SHIFT;
+
+		minColor[c] += inset;
+		maxColor[c] -= inset;
+	}
+}
+
+static byte * _compressBlockFast(const byte *src, int stride, bool alpha, byte *out)
+{
+	byte minColor[4], maxColor[4];
+
+	_getMinMaxColors(src, stride, minColor, maxColor);
+
+	if (alpha)
+	{
+		int palette[8];
+		byte indices[16];
+
+		_alphaPalette(maxColor[3], minColor[3], palette);
+		_alphaIndices(src, stride, palette, indices);
+		out = _writeAlphaBlock(maxColor[3], minColor[3], indices, out);
+	}
+
+	const unsigned short color0 = _colorTo565(maxColor), color1 = _colorTo565(minColor);
+	int palette[4][3];
+	unsigned int indices;
+
+	_colorPalette(color0, color1, palette);
+	_colorIndices(src, stride, palette, indices);
+
+	return _writeColorBlock(color0, color1, indices, out);
+}
+
+
+// fast mode, SSE2
+
+#if DXT_SSE2
+static inline __m128i _select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// squared RGB distance of the 4 pixels of a row (unpacked to 16 bit, alpha zeroed) to a palette entry
+static inline __m128i _rowDistance(__m128i lo, __m128i hi, __m128i color)
+{
+	__m128i dl = _mm_sub_epi16(lo, color), dh = _mm_sub_epi16(hi, color);
+
+	dl = _mm_madd_epi16(dl, dl);	// r²+g², b²+0 of pixel 0, 1
+	dh = _mm_madd_epi16(dh, dh);	// ... of pixel 2, 3
+	dl = _mm_add_epi32(dl, _mm_shuffle_epi32(dl, _MM_SHUFFLE(2, 3, 0, 1)));
+	dh = _mm_add_epi32(dh, _mm_shuffle_epi32(dh, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return _mm_unpacklo_epi64(_mm_shuffle_epi32(dl, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(dh, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+static byte * _compressBlockFastSSE2(const byte *src, int stride, bool alpha, byte *out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i rows[4];
+
+	for (int y = 0; y < 4; y++)
+		rows[y] = _mm_loadu_si128((const __m128i *) (src + y * stride));
+
+	// bounding box, every lane ends up with the min / max of all 16 pixels
+	__m128i minColor = _mm_min_epu8(_mm_min_epu8(rows[0], rows[1]), _mm_min_epu8(rows[2], rows[3]));
+	__m128i maxColor = _mm_max_epu8(_mm_max_epu8(rows[0], rows[1]), _mm_max_epu8(rows[2], rows[3]));
+
+	minColor = _mm_min_epu8(minColor, _mm_shuffle_epi32(minColor, _MM_SHUFFLE(1, 0, 3, 2)));
+	minColor = _mm_min_epu8(minColor, _mm_shuffle_epi32(minColor, _MM_SHUFFLE(2, 3, 0, 1)));
+	maxColor = _mm_max_epu8(maxColor, _mm_shuffle_epi32(maxColor, _MM_SHUFFLE(1, 0, 3, 2)));
+	maxColor = _mm_max_epu8(maxColor, _mm_shuffle_epi32(maxColor, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	const __m128i inset = _mm_and_si128(_mm_srli_epi16(_mm_subs_epu8(maxColor, minColor), INSET_SHIFT), _mm_set1_epi8(0xFF >> INSET_SHIFT));
+	minColor = _mm_adds_epu8(minColor, inset);
+	maxColor = _mm_subs_epu8(maxColor, inset);
+
+	const unsigned int minBits = (unsigned int) _mm_cvtsi128_si32(minColor), maxBits = (unsigned int) _mm_cvtsi128_si32(maxColor);
+	const byte minC[4] = {(byte) minBits, (byte) (minBits >> 8), (byte) (minBits >> 16), (byte) (minBits >> 24)};
+	const byte maxC[4] = {(byte) maxBits, (byte) (maxBits >> 8), (byte) (maxBits >> 16), (byte) (maxBits >> 24)};
+
+	if (alpha)
+	{
+		int palette[8];
+		byte indices[16];
+
+		_alphaPalette(maxC[3], minC[3], palette);
+
+		const __m128i a = _mm_packus_epi16(_mm_packs_epi32(_mm_srli_epi32(rows[0], 24), _mm_srli_epi32(rows[1], 24)),
+										   _mm_packs_epi32(_mm_srli_epi32(rows[2], 24), _mm_srli_epi32(rows[3], 24)));
+		__m128i best = _mm_set1_epi8((char) 0xFF), index = zero;
+
+		for (int e = 0; e < 8; e++)
+		{
+			const __m128i p = _mm_set1_epi8((char) palette[e]);
+			const __m128i d = _mm_or_si128(_mm_subs_epu8(a, p), _mm_subs_epu8(p, a));
+			const __m128i notLess = _mm_cmpeq_epi8(_mm_min_epu8(d, best), best);
+
+			best = _mm_min_epu8(d, best);
+			index = _select(notLess, index, _mm_set1_epi8((char) e));
+		}
+
+		_mm_storeu_si128((__m128i *) indices, index);
+		out = _writeAlphaBlock(maxC[3], minC[3], indices, out);
+	}
+
+	const unsigned short color0 = _colorTo565(maxC), color1 = _colorTo565(minC);
+	int palette[4][3];
+	__m128i colors[4], index[4];
+
+	_colorPalette(color0, color1, palette);
+	for (int e = 0; e < 4; e++)
+		colors[e] = _mm_setr_epi16((short) palette[e][0], (short) palette[e][1], (short) palette[e][2], 0, (short) palette[e][0], (short) palette[e][1], (short) palette[e][2], 0);
+
+	for (int y = 0; y < 4; y++)
+	{
+		const __m128i p = _mm_and_si128(rows[y], _mm_set1_epi32(0x00FFFFFF));
+		const __m128i lo = _mm_unpacklo_epi8(p, zero), hi = _mm_unpackhi_epi8(p, zero);
+		__m128i best = _rowDistance(lo, hi, colors[0]);
+
+		index[y] = zero;
+		for (int e = 1; e < 4; e++)
+		{
+			const __m128i d = _rowDistance(lo, hi, colors[e]);
+			const __m128i less = _mm_cmplt_epi32(d, best);
+
+			best = _select(less, d, best);
+			index[y] = _select(less, _mm_set1_epi32(e), index[y]);
+		}
+	}
+
+	// 16 indices of one byte each -> 2 bits each, pixel 0 in the lowest bits
+	__m128i packed = _mm_packus_epi16(_mm_packs_epi32(index[0], index[1]), _mm_packs_epi32(index[2], index[3]));
+	packed = _mm_and_si128(_mm_or_si128(packed, _mm_srli_epi16(packed, 6)), _mm_set1_epi16(0x000F));
+	packed = _mm_and_si128(_mm_or_si128(packed, _mm_srli_epi32(packed, 12)), _mm_set1_epi32(0x000000FF));
+	packed = _mm_packus_epi16(_mm_packs_epi32(packed, packed), zero);
+
+	return _writeColorBlock(color0, color1, (unsigned int) _mm_cvtsi128_si32(packed), out);
+}
+#endif
+
+
+// high quality mode: end points along the principal axis of the block's colors, then least squares refinement of the end points for the chosen indices
+
+static unsigned short _quantize565(const float color[3])
+{
+	int q[3];
+	const float scale[3] = {31.0f, 63.0f, 31.0f};
+
+	for (int c = 0; c < 3; c++)
+	{
+		const float v = color[c] < 0.0f ? 0.0f : (color[c] > 255.0f ? 255.0f : color[c]);
+		q[c] = (int) (v * scale[c] / 255.0f + 0.5f);
+	}
+
+	return (unsigned short) ((q[0] << 11) | (q[1] << 5) | q[2]);
+}
+
+// color0 > color1 selects the 4 color mode, equal end points only work with index 0 everywhere
+static void _orderColorBlock(unsigned short &color0, unsigned short &color1, unsigned int &indices)
+{
+	if (color0 < color1)
+	{
+		const unsigned short t = color0;
+		color0 = color1;
+		color1 = t;
+		indices ^= 0x55555555;	// 0 <-> 1, 2 <-> 3
+	}
+	else if (color0 == color1)
+		indices = 0;
+}
+
+static byte * _compressColorBlockHQ(const byte *src, int stride, byte *out)
+{
+	float mean[3] = {0.0f, 0.0f, 0.0f}, cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+	for (int i = 0; i < 16; i++)
+	{
+		const byte *p = src + (i / 4) * stride + (i % 4) * 4;
+
+		for (int c = 0; c < 3; c++)
+			mean[c] += p[c] / 16.0f;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		const byte *p = src + (i / 4) * stride + (i % 4) * 4;
+		const float r = p[0] - mean[0], g = p[1] - mean[1], b = p[2] - mean[2];
+
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+
+	float axis[3] = {1.0f, 1.0f, 1.0f};
+
+	for (int i = 0; i < 8; i++) // power iteration
+	{
+		const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		const float length = sqrtf(x * x + y * y + z * z);
+
+		if (length < 1e-6f)
+			break;
+
+		axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+	}
+
+	float tMin = 0.0f, tMax = 0.0f;
+
+	for (int i = 0; i < 16; i++)
+	{
+		const byte *p = src + (i / 4) * stride + (i % 4) * 4;
+		const float t = (p[0] - mean[0]) * axis[0] + (p[1] - mean[1]) * axis[1] + (p[2] - mean[2]) * axis[2];
+
+		if (t < tMin) tMin = t;
+		if (t > tMax) tMax = t;
+	}
+
+	float end0[3], end1[3];
+	for (int c = 0; c < 3; c++)
+	{
+		end0[c] = mean[c] + tMax * axis[c];
+		end1[c] = mean[c] + tMin * axis[c];
+	}
+
+	unsigned short color0 = _quantize565(end0), color1 = _quantize565(end1);
+	unsigned int indices;
+	int palette[4][3];
+
+	_colorPalette(color0, color1, palette);
+	int error = _colorIndices(src, stride, palette, indices);
+
+	for (int iteration = 0; (iteration < HQ_ITERATIONS) && error; iteration++)
+	{
+		// solve for the end points that minimize the error of the current indices, index 0..3 weighs end point 0 with 1, 0, 2/3, 1/3
+		static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {0.0f, 0.0f, 0.0f}, bx[3] = {0.0f, 0.0f, 0.0f};
+
+		for (int i = 0; i < 16; i++)
+		{
+			const byte *p = src + (i / 4) * stride + (i % 4) * 4;
+			const float w = weights[(indices >> (2 * i)) & 3];
+
+			aa += w * w;
+			ab += w * (1.0f - w);
+			bb += (1.0f - w) * (1.0f - w);
+			for (int c = 0; c < 3; c++)
+			{
+				ax[c] += w * p[c];
+				bx[c] += (1.0f - w) * p[c];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f)
+			break;
+
+		for (int c = 0; c < 3; c++)
+		{
+			end0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+			end1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+		}
+
+		const unsigned short newColor0 = _quantize565(end0), newColor1 = _quantize565(end1);
+		unsigned int newIndices;
+
+		if ((newColor0 == color0) && (newColor1 == color1))
+			break;
+
+		_colorPalette(newColor0, newColor1, palette);
+		const int newError = _colorIndices(src, stride, palette, newIndices);
+
+		if (newError >= error)
+			break;
+
+		color0 = newColor0;
+		color1 = newColor1;
+		indices = newIndices;
+		error = newError;
+	}
+
+	_orderColorBlock(color0, color1, indices);
+
+	return _writeColorBlock(color0, color1, indices, out);
+}
+
+static byte * _compressBlockHQ(const byte *src, int stride, bool alpha, byte *out)
+{
+	if (alpha) // the exact alpha range, alpha has 8 levels to spread over it
+	{
+		byte minAlpha = 255, maxAlpha = 0, indices[16];
+		int palette[8];
+
+		for (int i = 0; i < 16; i++)
+		{
+			const byte a = src[(i / 4) * stride + (i % 4) * 4 + 3];
+
+			if (a < minAlpha) minAlpha = a;
+			if (a > maxAlpha) maxAlpha = a;
+		}
+
+		_alphaPalette(maxAlpha, minAlpha, palette);
+		_alphaIndices(src, stride, palette, indices);
+		out = _writeAlphaBlock(maxAlpha, minAlpha, indices, out);
+	}
+
+	return _compressColorBlockHQ(src, stride, out);
+}
+
+
+static void _compressImage(const byte *inBuf, byte *outBuf, int width, int height, int &outputBytes, bool alpha, DXTQuality quality)
+{
+	byte *(*compressBlock)(const byte *, int, bool, byte *) = (quality == kDXTHighQuality) ? _compressBlockHQ : _compressBlockFast;
+	byte block[64];
+	byte *out = outBuf;
+
+#if DXT_SSE2
+	if (quality == kDXTFast)
+		compressBlock = _compressBlockFastSSE2;
+#endif
+
+	for (int by = 0; by < height; by += 4)
+	{
+		for (int bx = 0; bx < width; bx += 4)
+		{
+			if ((bx + 4 <= width) && (by + 4 <= height))
+				out = compressBlock(inBuf + (by * width + bx) * 4, width * 4, alpha, out);
+			else
+			{
+				_extractBlock(inBuf, width, height, bx, by, block);
+				out = compressBlock(block, 16, alpha, out);
+			}
+		}
+	}
+
+	outputBytes = (int) (out - outBuf);
+}
+
+void CompressImageDXT1(const byte *inBuf, byte *outBuf, int width, int height, int &outputBytes, DXTQuality quality)
+{
+	_compressImage(inBuf, outBuf, width, height, outputBytes, false, quality);
+}
+
+void CompressImageDXT5(const byte *inBuf, byte *outBuf, int width, int height, int &outputBytes, DXTQuality quality)
+{
+	_compressImage(inBuf, outBuf, width, height, outputBytes, true, quality);
+}
@@ -0,0 +1,34 @@
+/*
+ *  dxt.h
+ *
+ *
+ *  DXT1 / DXT5 (BC1 / BC3) compression of RGBA images, after "Real-Time DXT Compression" by J.M.P. van Waveren.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef DXT_H
+#define DXT_H
+
+// kDXTFast uses the inset bounding box of each block and is vectorised with SSE2 where available, it is meant for compressing pages while they are loaded.
+// kDXTHighQuality fits the end points along the principal axis of each block and refines them by least squares, it is several times slower and meant for offline tools.
+enum DXTQuality
+{
+	kDXTFast,
+	kDXTHighQuality
+};
+
+// inBuf holds width * height RGBA pixels, row by row. outBuf must have room for ((width + 3) / 4) * ((height + 3) / 4) blocks of 8 (DXT1) or 16 (DXT5) bytes.
+// blocks are written in the order of the rows of inBuf, so the first row of inBuf ends up at texture coordinate t = 0 when uploaded with glCompressedTexSubImage2D().
+// both functions are reentrant, so pages can be compressed on any number of threads at once.
+void CompressImageDXT1(const unsigned char *inBuf, unsigned char *outBuf, int width, int height, int &outputBytes, DXTQuality quality = kDXTFast);
+void CompressImageDXT5(const unsigned char *inBuf, unsigned char *outBuf, int width, int height, int &outputBytes, DXTQuality quality = kDXTFast);
+
+#endif
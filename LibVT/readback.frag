@@ -76,9 +76,9 @@ vec4 calculatePageRequest(vec2 uv)
 	result.rg = page;
 	result.b = mip / 255.0;
 #endif
-
-	result.a = 1.0;		// BGRA		mip, x, y, 255
 #endif
+
+	result.a = (255.0 - float(STORE_ID)) / 255.0;		// BGRA		mip, x, y, 255 - store
     return result;
 }
 
@@ -29,9 +29,16 @@
 	#endif
 #endif
 
+#if PHYS_TEX_LAYERS > 1
+	#extension GL_EXT_texture_array: require
+#endif
+
 struct vtexcoord
 {
    vec2 coord;
+#if PHYS_TEX_LAYERS > 1
+   float layer;
+#endif
 #ifdef VTEX_GRAD
    vec4 grad;
 #endif
@@ -42,7 +49,11 @@ uniform highp sampler2D pageTableTexture;
 #else
 uniform  sampler2D pageTableTexture;
 #endif
+#if PHYS_TEX_LAYERS > 1
+uniform sampler2DArray physicalTexture;
+#else
 uniform sampler2D physicalTexture;
+#endif
 uniform float mip_bias;
 
 const float mip_trilerp_bias = 0.0;
@@ -112,6 +123,10 @@ vtexcoord calulateCoordinatesFromSample(vec4 pageTableEntry)
 	float mipExp = pageTableEntry.a + 1.0;
 #endif
 	vec2 pageCoord = pageTableEntry.bg;
+#if PHYS_TEX_LAYERS > 1
+	vec2 layerBits = floor((pageCoord + 0.5) / 64.0); // the layer is stored above the page position, see SLOT_X() in LibVT_Internal.h
+	pageCoord -= layerBits * 64.0;
+#endif
 #if MAC_GL_DRIVER_HACK
            vec2 withinPageCoord = fract((texcoord.xy+vec2(0.000015,0.000015)) * mipExp); // Retina macbook pro
 	   //2560 x1440 imac no retina  vec2 withinPageCoord = fract((texcoord.xy+vec2(0.0000005,0.0000005)) * mipExp);
@@ -125,6 +140,9 @@ vtexcoord calulateCoordinatesFromSample(vec4 pageTableEntry)
 
    	vtexcoord result;
 	result.coord = ((pageCoord + withinPageCoord) / phys_tex_dimension_pages);
+#if PHYS_TEX_LAYERS > 1
+	result.layer = layerBits.x + layerBits.y * 4.0;
+#endif
 #ifdef VTEX_GRAD
 	float page_unit_to_phys = ((page_dimension - border_width * 2.0) /page_dimension) / phys_tex_dimension_pages;
 	float gradient_scale = exp2(mip_bias + mip_trilerp_bias) * page_unit_to_phys * mipExp;
@@ -179,19 +197,41 @@ vtexcoord calulateVirtualTextureCoordinates()
 		{
 		   	vtexcoord result;
 			result.coord = vec2(2.0, 2.0);
+#if PHYS_TEX_LAYERS > 1
+			result.layer = 0.0;
+#endif
 			return result;
 		}
 	}
 #endif
 }
 
+#ifdef DEBUG
+vec4 samplePhysicalTexture(vec2 coord) // the debug views only look at the first layer
+{
+#if PHYS_TEX_LAYERS > 1
+	return texture2DArray(physicalTexture, vec3(coord, 0.0));
+#else
+	return texture2D(physicalTexture, coord);
+#endif
+}
+#endif
+
 vec4 sampleVirtualTexture(vtexcoord coordinates)
 {
+#if PHYS_TEX_LAYERS > 1
+#ifdef VTEX_GRAD
+		return texture2DArrayGrad(physicalTexture, vec3(coordinates.coord, coordinates.layer), coordinates.grad.xy, coordinates.grad.zw);
+#else
+		return texture2DArray(physicalTexture, vec3(coordinates.coord, coordinates.layer));
+#endif
+#else
 #ifdef VTEX_GRAD
 		return texture2DGrad(physicalTexture, coordinates.coord, coordinates.grad.xy, coordinates.grad.zw);
 #else
 		return texture2D(physicalTexture, coordinates.coord);
 #endif
+#endif
 }
 
 
@@ -389,7 +429,7 @@ void main(void)
 	#endif
 			vec2 finalCoord = (pageCoord + withinPageCoord) / phys_tex_dimension_pages;
 
-			gl_FragColor	= texture2D(physicalTexture, finalCoord);
+			gl_FragColor	= samplePhysicalTexture(finalCoord);
 		}
 		else
 		{
@@ -471,7 +511,7 @@ void main(void)
 	#endif
 			vec2 finalCoord = (pageCoord + withinPageCoord) / phys_tex_dimension_pages;
 
-			gl_FragColor	= texture2D(physicalTexture, finalCoord);
+			gl_FragColor	= samplePhysicalTexture(finalCoord);
 		}
 		else
 		{
@@ -553,7 +593,7 @@ void main(void)
 	#endif
 			vec2 finalCoord = (pageCoord + withinPageCoord) / phys_tex_dimension_pages;
 
-			gl_FragColor	= texture2D(physicalTexture, finalCoord);
+			gl_FragColor	= samplePhysicalTexture(finalCoord);
 			gl_FragColor	= vec4(0.0, 0.9, 0.0, 1.0);
 		}
 		else
@@ -588,7 +628,7 @@ void main(void)
 	{
 		vec2 coord = gl_FragCoord.xy / 1000.0;
 		if ((coord.x < 1.0) && (coord.y < 1.0))
-			gl_FragColor = texture2D(physicalTexture, coord);
+			gl_FragColor = samplePhysicalTexture(coord);
 	}
 	else if ((debugMode == 8) || (debugMode == 9)) // non vt tex
 	{
@@ -0,0 +1,914 @@
+/*
+ *  bqt_build_vtex.cpp
+ *
+ *
+ *  Builds a LibVT page store (tiles_b<border>_level<N>/tile_<N>_<x>_<y>.<codec>) from a mosaic or a grid of images.
+ *
+ *  Usage: bqt_build_vtex [-o outDir] [-f jpg|png|dxt1|dxt5] [-Q] [-p pageDimension] [-b border] [-q quality] [-j threads] [-n pages] [-g columns] image...
+ *    -o		write the page store to outDir (default .)
+ *    -f		page codec (default jpg)
+ *    -Q		compress DXT pages in high quality mode instead of the fast mode LibVT uses while loading
+ *    -p		page dimension including the border: 64, 128, 256 or 512 (default 256)
+ *    -b		page border in pixels (default 1, 4 for dxt1 / dxt5)
+ *    -q		JPEG quality (default 90)
+ *    -j		encoding threads (default one per processor)
+ *    -n		pages per side of mip level 0, a power of two (default the smallest that doesn't shrink the mosaic)
+ *    -g		the images are a grid with this many columns in row major order, images in a row must have the same height and images in a column the same width
+ *  Images are JPEG or PNG. The mosaic is resampled to fill the whole virtual texture, so texture coordinates 0..1 keep addressing all of it.
+ *  The input is read once from top to bottom and every mip level is built from the one above while rows stream through, only the rows of the current
+ *  row of pages of each level are held in memory. Pages are encoded on worker threads as soon as their row of pages is complete.
+ *  vt_pack packs the written store into a single tile archive, which pages in with far fewer file system calls.
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+#include <OpenThreads/ScopedLock>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "../dxt.h"
+
+#ifdef WIN32
+	#include <windows.h>
+	#include <direct.h>
+	#define PATH_SEPERATOR "\\"
+#else
+	#include <sys/time.h>
+	#include <sys/stat.h>
+	#define PATH_SEPERATOR "/"
+#endif
+
+using namespace std;
+
+#define LOCK(x)		OpenThreads::ScopedLock<OpenThreads::Mutex> scoped_lock(x);
+
+static double _now()
+{
+#ifdef WIN32
+	LARGE_INTEGER f, t;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&t);
+	return (double) t.QuadPart / (double) f.QuadPart;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static bool _makeDirectory(const string &path)
+{
+#ifdef WIN32
+	return (_mkdir(path.c_str()) == 0) || (errno == EEXIST);
+#else
+	return (mkdir(path.c_str(), 0755) == 0) || (errno == EEXIST);
+#endif
+}
+
+
+// input images, read one RGB row at a time from top to bottom
+
+class vtexImage
+{
+public:
+	uint32_t width, height;
+
+	virtual ~vtexImage() {}
+	virtual bool open(const char *path) = 0;
+	virtual void readRow(uint8_t *rgb) = 0;
+
+	static vtexImage * create(const char *path);
+};
+
+class vtexJPEGImage : public vtexImage
+{
+	FILE *f;
+	jpeg_decompress_struct cinfo;
+	jpeg_error_mgr jerr;
+
+public:
+	vtexJPEGImage() : f(NULL) {}
+
+	~vtexJPEGImage()
+	{
+		if (!f)
+			return;
+
+		jpeg_abort_decompress(&cinfo);
+		jpeg_destroy_decompress(&cinfo);
+		fclose(f);
+	}
+
+	bool open(const char *path)
+	{
+		if (!(f = fopen(path, "rb")))
+			return false;
+
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_decompress(&cinfo);
+		jpeg_stdio_src(&cinfo, f);
+		jpeg_read_header(&cinfo, TRUE);
+		cinfo.out_color_space = JCS_RGB;
+		jpeg_start_decompress(&cinfo);
+
+		width = cinfo.output_width;
+		height = cinfo.output_height;
+
+		return true;
+	}
+
+	void readRow(uint8_t *rgb)
+	{
+		JSAMPROW row = rgb;
+
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+};
+
+class vtexPNGImage : public vtexImage
+{
+	FILE *f;
+	png_structp png;
+	png_infop info;
+
+public:
+	vtexPNGImage() : f(NULL), png(NULL), info(NULL) {}
+
+	~vtexPNGImage()
+	{
+		if (png)
+			png_destroy_read_struct(&png, &info, NULL);
+		if (f)
+			fclose(f);
+	}
+
+	bool open(const char *path)
+	{
+		if (!(f = fopen(path, "rb")))
+			return false;
+
+		png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+		info = png_create_info_struct(png);
+		if (setjmp(png_jmpbuf(png)))
+			return false;
+
+		png_init_io(png, f);
+		png_read_info(png, info);
+
+		if (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE)
+		{
+			printf("Error: %s is interlaced, interlaced PNGs can't be read row by row\n", path);
+			return false;
+		}
+
+		png_set_expand(png);
+		png_set_strip_16(png);
+		png_set_strip_alpha(png);
+		png_set_gray_to_rgb(png);
+		png_read_update_info(png, info);
+
+		width = png_get_image_width(png, info);
+		height = png_get_image_height(png, info);
+
+		return true;
+	}
+
+	void readRow(uint8_t *rgb)
+	{
+		if (setjmp(png_jmpbuf(png)))
+		{
+			memset(rgb, 0, width * 3);
+			return;
+		}
+
+		png_read_row(png, rgb, NULL);
+	}
+};
+
+vtexImage * vtexImage::create(const char *path)
+{
+	uint8_t magic[4] = {0, 0, 0, 0};
+	FILE *f = fopen(path, "rb");
+	vtexImage *image = NULL;
+
+	if (!f)
+	{
+		printf("Error: can't open %s\n", path);
+		return NULL;
+	}
+
+	size_t result = fread(magic, 1, 4, f);
+	fclose(f);
+
+	if ((result == 4) && (magic[0] == 0xFF) && (magic[1] == 0xD8))
+		image = new vtexJPEGImage();
+	else if ((result == 4) && (magic[0] == 0x89) && (magic[1] == 'P') && (magic[2] == 'N') && (magic[3] == 'G'))
+		image = new vtexPNGImage();
+	else
+	{
+		printf("Error: %s is neither a JPEG nor a PNG\n", path);
+		return NULL;
+	}
+
+	if (!image->open(path))
+	{
+		printf("Error: can't read %s\n", path);
+		delete image;
+		return NULL;
+	}
+
+	return image;
+}
+
+
+// a grid of images read as one big image, only the images of the current grid row are open
+
+class vtexMosaic
+{
+	vector<string>		paths;
+	uint32_t			columns, gridRows;
+	vector<uint32_t>	columnWidths, rowHeights;
+	vector<vtexImage *>	open;
+	uint32_t			gridRow, rowInGridRow;
+
+	void closeGridRow()
+	{
+		for (uint32_t i = 0; i < open.size(); i++)
+			delete open[i];
+		open.clear();
+	}
+
+public:
+	uint32_t width, height;
+
+	vtexMosaic() : columns(1), gridRows(0), gridRow(0), rowInGridRow(0), width(0), height(0) {}
+	~vtexMosaic() { closeGridRow(); }
+
+	bool init(const vector<string> &_paths, uint32_t _columns)
+	{
+		paths = _paths;
+		columns = _columns;
+
+		if (paths.empty() || (paths.size() % columns))
+		{
+			printf("Error: %u images don't make a grid with %u columns\n", (uint32_t) paths.size(), columns);
+			return false;
+		}
+
+		gridRows = (uint32_t) paths.size() / columns;
+		columnWidths.assign(columns, 0);
+		rowHeights.assign(gridRows, 0);
+
+		for (uint32_t i = 0; i < paths.size(); i++) // only the headers are read here
+		{
+			vtexImage *image = vtexImage::create(paths[i].c_str());
+			const uint32_t column = i % columns, row = i / columns;
+
+			if (!image)
+				return false;
+
+			if (!columnWidths[column]) columnWidths[column] = image->width;
+			if (!rowHeights[row]) rowHeights[row] = image->height;
+
+			if ((image->width != columnWidths[column]) || (image->height != rowHeights[row]))
+			{
+				printf("Error: %s is %ux%u, but its grid row is %u high and its grid column %u wide\n", paths[i].c_str(), image->width, image->height, rowHeights[row], columnWidths[column]);
+				delete image;
+				return false;
+			}
+
+			delete image;
+		}
+
+		for (uint32_t i = 0; i < columns; i++)
+			width += columnWidths[i];
+		for (uint32_t i = 0; i < gridRows; i++)
+			height += rowHeights[i];
+
+		return true;
+	}
+
+	bool readRow(uint8_t *rgb)
+	{
+		if (open.empty() || (rowInGridRow == rowHeights[gridRow]))
+		{
+			if (!open.empty())
+			{
+				closeGridRow();
+				gridRow++;
+			}
+
+			rowInGridRow = 0;
+
+			for (uint32_t i = 0; i < columns; i++)
+			{
+				vtexImage *image = vtexImage::create(paths[gridRow * columns + i].c_str());
+
+				if (!image)
+					return false;
+
+				open.push_back(image);
+			}
+		}
+
+		for (uint32_t i = 0; i < columns; i++)
+		{
+			open[i]->readRow(rgb);
+			rgb += columnWidths[i] * 3;
+		}
+
+		rowInGridRow++;
+
+		return true;
+	}
+};
+
+
+// page encoding on worker threads
+
+enum { kCodecJPG, kCodecPNG, kCodecDXT1, kCodecDXT5 };
+
+struct vtexSettings
+{
+	string		outDir;
+	uint8_t		codec;
+	string		extension;
+	uint32_t	pageDimension, border, content;
+	int			quality;
+	DXTQuality	dxtQuality;
+};
+
+struct vtexPage
+{
+	uint8_t				level;
+	uint32_t			x, y;				// y counts from the top like the tile names on disk
+	vector<uint8_t>		rgb;				// pageDimension * pageDimension, top row first
+};
+
+class vtexEncoder
+{
+	const vtexSettings	&s;
+	deque<vtexPage *>	queue;
+	uint32_t			maxQueued;
+	bool				finished;
+	OpenThreads::Mutex	mutex;
+	OpenThreads::Condition	pageAvailableCondition, spaceAvailableCondition;
+
+	bool writeJPG(const vtexPage *page, FILE *f)
+	{
+		jpeg_compress_struct cinfo;
+		jpeg_error_mgr jerr;
+
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_compress(&cinfo);
+		jpeg_stdio_dest(&cinfo, f);
+
+		cinfo.image_width = cinfo.image_height = s.pageDimension;
+		cinfo.input_components = 3;
+		cinfo.in_color_space = JCS_RGB;
+		jpeg_set_defaults(&cinfo);
+		jpeg_set_quality(&cinfo, s.quality, TRUE);
+		jpeg_start_compress(&cinfo, TRUE);
+
+		while (cinfo.next_scanline < cinfo.image_height)
+		{
+			JSAMPROW row = (JSAMPROW) &page->rgb[cinfo.next_scanline * s.pageDimension * 3];
+			jpeg_write_scanlines(&cinfo, &row, 1);
+		}
+
+		jpeg_finish_compress(&cinfo);
+		jpeg_destroy_compress(&cinfo);
+
+		return true;
+	}
+
+	bool writePNG(const vtexPage *page, FILE *f)
+	{
+		png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+		png_infop info = png_create_info_struct(png);
+
+		if (setjmp(png_jmpbuf(png)))
+		{
+			png_destroy_write_struct(&png, &info);
+			return false;
+		}
+
+		png_init_io(png, f);
+		png_set_IHDR(png, info, s.pageDimension, s.pageDimension, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_write_info(png, info);
+
+		for (uint32_t y = 0; y < s.pageDimension; y++)
+			png_write_row(png, (png_bytep) &page->rgb[y * s.pageDimension * 3]);
+
+		png_write_end(png, info);
+		png_destroy_write_struct(&png, &info);
+
+		return true;
+	}
+
+	bool writeDXT(const vtexPage *page, FILE *f)
+	{
+		// LibVT uploads DXT pages as they are, so the block rows go bottom up like OpenGL's, behind an 8 byte header LibVT skips: codec and page dimension
+		vector<uint8_t> rgba(s.pageDimension * s.pageDimension * 4), dxt(s.pageDimension * s.pageDimension);
+		int dxtBytes = 0;
+		uint32_t header[2];
+
+		for (uint32_t y = 0; y < s.pageDimension; y++)
+		{
+			const uint8_t *src = &page->rgb[(s.pageDimension - 1 - y) * s.pageDimension * 3];
+			uint8_t *dst = &rgba[y * s.pageDimension * 4];
+
+			for (uint32_t x = 0; x < s.pageDimension; x++, src += 3, dst += 4)
+			{
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+				dst[3] = 255;
+			}
+		}
+
+		if (s.codec == kCodecDXT1)
+			CompressImageDXT1(&rgba[0], &dxt[0], s.pageDimension, s.pageDimension, dxtBytes, s.dxtQuality);
+		else
+			CompressImageDXT5(&rgba[0], &dxt[0], s.pageDimension, s.pageDimension, dxtBytes, s.dxtQuality);
+
+		memcpy(&header[0], (s.codec == kCodecDXT1) ? "DXT1" : "DXT5", 4);
+		header[1] = s.pageDimension;
+
+		return (fwrite(header, sizeof(header), 1, f) == 1) && (fwrite(&dxt[0], 1, dxtBytes, f) == (size_t) dxtBytes);
+	}
+
+	void encode(const vtexPage *page)
+	{
+		char path[1024];
+
+		snprintf(path, sizeof(path), "%s%stiles_b%u_level%u%stile_%u_%u_%u.%s", s.outDir.c_str(), PATH_SEPERATOR, s.border, page->level, PATH_SEPERATOR, page->level, page->x, page->y, s.extension.c_str());
+
+		FILE *f = fopen(path, "wb");
+		bool success = (f != NULL);
+
+		if (f)
+		{
+			if (s.codec == kCodecJPG)
+				success = writeJPG(page, f);
+			else if (s.codec == kCodecPNG)
+				success = writePNG(page, f);
+			else
+				success = writeDXT(page, f);
+
+			success = (fclose(f) == 0) && success;
+		}
+
+		if (!success)
+		{
+			printf("Error: writing %s failed\n", path);
+			exit(1);
+		}
+	}
+
+public:
+	vtexEncoder(const vtexSettings &settings, uint32_t threads) : s(settings), maxQueued(threads * 4), finished(false) {}
+
+	void submit(vtexPage *page) // blocks while the workers are behind, so at most maxQueued pages wait in memory
+	{
+		LOCK(mutex)
+
+		while (queue.size() >= maxQueued)
+			spaceAvailableCondition.wait(&mutex);
+
+		queue.push_back(page);
+		pageAvailableCondition.signal();
+	}
+
+	void finish()
+	{
+		LOCK(mutex)
+
+		finished = true;
+		pageAvailableCondition.broadcast();
+	}
+
+	void work()
+	{
+		while (1)
+		{
+			vtexPage *page;
+
+			{	// lock
+				LOCK(mutex)
+
+				while (queue.empty() && !finished)
+					pageAvailableCondition.wait(&mutex);
+
+				if (queue.empty())
+					return;
+
+				page = queue.front();queue.pop_front();
+				spaceAvailableCondition.signal();
+			}	// unlock
+
+			encode(page);
+			delete page;
+		}
+	}
+};
+
+class vtexWorker : public OpenThreads::Thread
+{
+	vtexEncoder *encoder;
+
+public:
+	vtexWorker() : encoder(NULL) {}
+	void setEncoder(vtexEncoder *_encoder) { encoder = _encoder; }
+	virtual void run() { encoder->work(); }
+};
+
+
+// one mip level: receives its rows from the top, cuts a row of pages as soon as it and the border below it are complete and hands every pair of rows down to the next level
+
+class vtexLevel
+{
+	const vtexSettings	&s;
+	vtexEncoder			&encoder;
+	uint8_t				level;
+	uint32_t			size, pages;		// pixels and pages per side
+	deque<vector<uint8_t> >	rows;			// the rows from firstRow on
+	uint32_t			firstRow, receivedRows, nextPageRow;
+	vector<uint8_t>		evenRow;			// waits for the next row to be averaged with it for the next level
+	vtexLevel			*next;
+
+	const uint8_t * pixel(int32_t x, int32_t y) const // clamped to the edge of the level
+	{
+		x = (x < 0) ? 0 : ((x >= (int32_t) size) ? size - 1 : x);
+		y = (y < 0) ? 0 : ((y >= (int32_t) size) ? size - 1 : y);
+
+		return &rows[y - firstRow][x * 3];
+	}
+
+	void cutPageRow(uint32_t pageRow)
+	{
+		const int32_t top = pageRow * s.content - s.border;
+
+		for (uint32_t pageX = 0; pageX < pages; pageX++)
+		{
+			const int32_t left = pageX * s.content - s.border;
+			vtexPage *page = new vtexPage;
+
+			page->level = level;
+			page->x = pageX;
+			page->y = pageRow;
+			page->rgb.resize(s.pageDimension * s.pageDimension * 3);
+
+			for (uint32_t y = 0; y < s.pageDimension; y++)
+			{
+				uint8_t *dst = &page->rgb[y * s.pageDimension * 3];
+
+				if ((left >= 0) && (left + s.pageDimension <= size)) // interior pages copy whole rows, only the edges need clamping
+					memcpy(dst, pixel(left, top + y), s.pageDimension * 3);
+				else
+					for (uint32_t x = 0; x < s.pageDimension; x++)
+						memcpy(dst + x * 3, pixel(left + x, top + y), 3);
+			}
+
+			encoder.submit(page);
+		}
+	}
+
+public:
+	vtexLevel(const vtexSettings &settings, vtexEncoder &_encoder, uint8_t _level, uint32_t _pages, vtexLevel *_next) :
+		s(settings), encoder(_encoder), level(_level), size(_pages * settings.content), pages(_pages), firstRow(0), receivedRows(0), nextPageRow(0), next(_next) {}
+
+	uint32_t width() const { return size; }
+
+	void addRow(const uint8_t *rgb)
+	{
+		rows.push_back(vector<uint8_t>(rgb, rgb + size * 3));
+		receivedRows++;
+
+		if (next)
+		{
+			if (receivedRows & 1)
+				evenRow.assign(rgb, rgb + size * 3);
+			else
+			{
+				vector<uint8_t> half((size / 2) * 3);
+
+				for (uint32_t x = 0; x < size / 2; x++)
+					for (uint8_t c = 0; c < 3; c++)
+						half[x * 3 + c] = (uint8_t) ((evenRow[x * 6 + c] + evenRow[x * 6 + 3 + c] + rgb[x * 6 + c] + rgb[x * 6 + 3 + c] + 2) / 4);
+
+				next->addRow(&half[0]);
+			}
+		}
+
+		while (nextPageRow < pages)
+		{
+			uint32_t needed = (nextPageRow + 1) * s.content + s.border;
+
+			if (needed > size)
+				needed = size;
+			if (receivedRows < needed)
+				break;
+
+			cutPageRow(nextPageRow++);
+
+			// the rows above the top border of the next row of pages aren't needed anymore
+			const int32_t keepFrom = (int32_t) (nextPageRow * s.content) - (int32_t) s.border;
+			while ((int32_t) firstRow < keepFrom)
+			{
+				rows.pop_front();
+				firstRow++;
+			}
+		}
+	}
+};
+
+
+// bilinear resampling of the mosaic to the size of mip level 0, keeps two rows of the mosaic
+
+class vtexResampler
+{
+	vtexMosaic			&mosaic;
+	uint32_t			size;
+	vector<uint8_t>		upper, lower, out;
+	int32_t				upperRow, lowerRow;	// mosaic rows held in upper and lower
+	vector<uint32_t>	x0;
+	vector<uint16_t>	fx;					// weight of x0 + 1 in 1/256
+
+	bool advanceTo(int32_t row)
+	{
+		const int32_t lastRow = mosaic.height - 1;
+
+		while (lowerRow < row + 1 && lowerRow < lastRow)
+		{
+			upper.swap(lower);
+			upperRow = lowerRow;
+
+			if (!mosaic.readRow(&lower[0]))
+				return false;
+			lowerRow++;
+		}
+
+		if (upperRow < row) // only with one row left in the mosaic
+		{
+			upper = lower;
+			upperRow = lowerRow;
+		}
+
+		return true;
+	}
+
+public:
+	vtexResampler(vtexMosaic &_mosaic, uint32_t _size) : mosaic(_mosaic), size(_size), upperRow(-1), lowerRow(-1)
+	{
+		upper.resize(mosaic.width * 3);
+		lower.resize(mosaic.width * 3);
+		out.resize(size * 3);
+		x0.resize(size);
+		fx.resize(size);
+
+		for (uint32_t x = 0; x < size; x++)
+		{
+			double u = (x + 0.5) * mosaic.width / size - 0.5;
+			if (u < 0.0) u = 0.0;
+
+			x0[x] = (uint32_t) u;
+			fx[x] = (uint16_t) ((u - x0[x]) * 256.0);
+			if (x0[x] >= mosaic.width - 1)
+			{
+				x0[x] = mosaic.width - 1;
+				fx[x] = 0;
+			}
+		}
+	}
+
+	const uint8_t * row(uint32_t y)
+	{
+		double v = (y + 0.5) * mosaic.height / size - 0.5;
+		if (v < 0.0) v = 0.0;
+
+		const int32_t y0 = (int32_t) v;
+		const uint32_t fy = (y0 >= (int32_t) mosaic.height - 1) ? 0 : (uint32_t) ((v - y0) * 256.0);
+
+		if (!advanceTo(y0))
+			return NULL;
+
+		const uint8_t *a = (upperRow == y0) ? &upper[0] : &lower[0];
+		const uint8_t *b = &lower[0];
+
+		for (uint32_t x = 0; x < size; x++)
+		{
+			const uint32_t i = x0[x] * 3, j = (x0[x] + ((fx[x] > 0) ? 1 : 0)) * 3;
+
+			for (uint8_t c = 0; c < 3; c++)
+			{
+				const uint32_t top = a[i + c] * (256 - fx[x]) + a[j + c] * fx[x];
+				const uint32_t bottom = b[i + c] * (256 - fx[x]) + b[j + c] * fx[x];
+
+				out[x * 3 + c] = (uint8_t) ((top * (256 - fy) + bottom * fy + 32768) >> 16);
+			}
+		}
+
+		return &out[0];
+	}
+};
+
+
+static void _usage(const char *name)
+{
+	printf("Usage: %s [-o outDir] [-f jpg|png|dxt1|dxt5] [-Q] [-p pageDimension] [-b border] [-q quality] [-j threads] [-n pages] [-g columns] image...\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	vtexSettings s;
+	vector<string> paths;
+	uint32_t columns = 1, pages = 0, threads = 0;
+	int border = -1;
+
+	s.outDir = ".";
+	s.codec = kCodecJPG;
+	s.extension = "jpg";
+	s.pageDimension = 256;
+	s.quality = 90;
+	s.dxtQuality = kDXTFast;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)			s.outDir = argv[++i];
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc)	s.extension = argv[++i];
+		else if (!strcmp(argv[i], "-Q"))					s.dxtQuality = kDXTHighQuality;
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc)	s.pageDimension = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc)	border = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-q") && i + 1 < argc)	s.quality = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc)	threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)	pages = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-g") && i + 1 < argc)	columns = atoi(argv[++i]);
+		else if (argv[i][0] == '-')
+		{
+			_usage(argv[0]);
+			return 1;
+		}
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.empty() || !columns)
+	{
+		_usage(argv[0]);
+		return 1;
+	}
+
+	if (s.extension == "jpg")			s.codec = kCodecJPG;
+	else if (s.extension == "png")		s.codec = kCodecPNG;
+	else if (s.extension == "dxt1")		s.codec = kCodecDXT1;
+	else if (s.extension == "dxt5")		s.codec = kCodecDXT5;
+	else
+	{
+		printf("Error: unknown page codec %s, LibVT reads jpg, png, dxt1 and dxt5\n", s.extension.c_str());
+		return 1;
+	}
+
+	if ((s.pageDimension != 64) && (s.pageDimension != 128) && (s.pageDimension != 256) && (s.pageDimension != 512))
+	{
+		printf("Error: LibVT supports page dimensions of 64, 128, 256 and 512\n");
+		return 1;
+	}
+
+	s.border = (border >= 0) ? border : (((s.codec == kCodecDXT1) || (s.codec == kCodecDXT5)) ? 4 : 1);
+	if (s.border * 2 >= s.pageDimension)
+	{
+		printf("Error: the border leaves no room in the page\n");
+		return 1;
+	}
+	if (((s.codec == kCodecDXT1) || (s.codec == kCodecDXT5)) && (s.border % 4))
+		printf("Warning: the border should be a multiple of 4 for DXT pages\n");
+	s.content = s.pageDimension - 2 * s.border;
+
+	if (!threads)
+		threads = OpenThreads::GetNumberOfProcessors();
+	if (threads < 1)
+		threads = 1;
+
+
+	vtexMosaic mosaic;
+
+	if (!mosaic.init(paths, columns))
+		return 1;
+
+	if (!pages)
+	{
+		const uint32_t mosaicSize = (mosaic.width > mosaic.height) ? mosaic.width : mosaic.height;
+
+		pages = 2;
+		while ((pages * s.content < mosaicSize) && (pages < 1024))
+			pages *= 2;
+	}
+	if ((pages < 2) || (pages > 1024) || (pages & (pages - 1)))
+	{
+		printf("Error: the pages per side must be a power of two from 2 to 1024\n");
+		return 1;
+	}
+
+	uint8_t mipChainLength = 1;
+	while ((1u << (mipChainLength - 1)) < pages)
+		mipChainLength++;
+
+	const uint32_t size = pages * s.content;
+
+	printf("Mosaic %ux%u from %u images, virtual texture %ux%u: %u pages per side of %u pixels with border %u, mip chain length %u%s\n",
+		   mosaic.width, mosaic.height, (uint32_t) paths.size(), size, size, pages, s.pageDimension, s.border, mipChainLength, (mipChainLength >= 10) ? " (LONG_MIP_CHAIN)" : "");
+	if ((size < mosaic.width) || (size < mosaic.height))
+		printf("Warning: the mosaic is shrunk to fit, bilinear filtering will alias\n");
+
+
+	// set up the output directories, the levels and the encoding threads
+	vector<vtexLevel *> levels(mipChainLength, (vtexLevel *) NULL);
+	vtexEncoder encoder(s, threads);
+	vector<vtexWorker *> workers(threads, (vtexWorker *) NULL);
+	const double start = _now();
+
+	_makeDirectory(s.outDir);
+	for (uint8_t i = 0; i < mipChainLength; i++)
+	{
+		char dir[1024];
+
+		snprintf(dir, sizeof(dir), "%s%stiles_b%u_level%u", s.outDir.c_str(), PATH_SEPERATOR, s.border, i);
+		if (!_makeDirectory(dir))
+		{
+			printf("Error: can't create %s\n", dir);
+			return 1;
+		}
+	}
+
+	for (int i = mipChainLength - 1; i >= 0; i--)
+		levels[i] = new vtexLevel(s, encoder, (uint8_t) i, pages >> i, (i + 1 < mipChainLength) ? levels[i + 1] : NULL);
+
+	for (uint32_t i = 0; i < threads; i++)
+	{
+		workers[i] = new vtexWorker();
+		workers[i]->setEncoder(&encoder);
+		workers[i]->start();
+	}
+
+
+	// stream the mosaic through the levels
+	vtexResampler resampler(mosaic, size);
+
+	for (uint32_t y = 0; y < size; y++)
+	{
+		const uint8_t *row = resampler.row(y);
+
+		if (!row)
+		{
+			printf("Error: reading the mosaic failed\n");
+			return 1;
+		}
+
+		levels[0]->addRow(row);
+
+		if ((y % 1024 == 1023) || (y == size - 1))
+		{
+			printf("\r%5.1f%% ", 100.0 * (y + 1) / size);
+			fflush(stdout);
+		}
+	}
+
+	encoder.finish();
+	for (uint32_t i = 0; i < threads; i++)
+	{
+		workers[i]->join();
+		delete workers[i];
+	}
+
+	for (uint8_t i = 0; i < mipChainLength; i++)
+		delete levels[i];
+
+	uint32_t pageCount = 0;
+	for (uint8_t i = 0; i < mipChainLength; i++)
+		pageCount += (pages >> i) * (pages >> i);
+
+	printf("\nWrote %u pages to %s in %.1f s\n", pageCount, s.outDir.c_str(), _now() - start);
+
+	return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ *  vt_extract_bench.cpp
+ *
+ *
+ *  Microbenchmark for the page request extraction kernel, runs without a GPU.
+ *
+ *  Usage: vt_extract_bench [-w width] [-h height] [-m mipChainLength] [-l] [-s] [-i iterations] [readback dumps...]
+ *    -l		buffers use the long mip chain encoding
+ *    -s		coordinates are stored at mip 0 resolution (USE_MIPCALC_TEXTURE 0)
+ *  A readback dump is the raw BGRA buffer as passed to vtExtractNeededPages(), width * height * 4 bytes.
+ *  Without dumps a synthetic buffer is generated.
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "../LibVT_Extract.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+#ifdef WIN32
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+#endif
+
+using namespace std;
+
+static double _now()
+{
+#ifdef WIN32
+	LARGE_INTEGER f, t;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&t);
+	return (double) t.QuadPart / (double) f.QuadPart;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+// the extraction as it was done before the kernel: a std::map per frame, sorted through a std::multimap. the benchmark only uses store 0
+static void _referenceExtract(const vteParams *p, const uint32_t *buffer, vector<vtePageCount> &result)
+{
+	const vteStoreParams &s = p->stores[0];
+	map<uint32_t, uint32_t> tmpPages1;
+	multimap<uint32_t, uint32_t> tmpPages2;
+
+	for (uint32_t y = 0; y < p->h; y++)
+	{
+		for (uint32_t x = 0; x < p->w; x++)
+		{
+			const uint32_t pixel = buffer[y * p->w + x];
+			const uint8_t b1 = (uint8_t) pixel, b2 = (uint8_t) (pixel >> 8), b3 = (uint8_t) (pixel >> 16), b4 = (uint8_t) (pixel >> 24);
+			const uint8_t mip = s.longMipChain ? (b1 & 0x0F) : b1;
+			const uint8_t shift = p->shiftByMip ? mip : 0;
+			const uint16_t y_coord = s.longMipChain ? ((b2 | ((b1 & 0xC0) << 2)) >> shift) : (b2 >> shift);
+			const uint16_t x_coord = s.longMipChain ? ((b3 | ((b1 & 0x30) << 4)) >> shift) : (b3 >> shift);
+
+			if ((b4 == 255) && (mip < s.mipChainLength) && (y_coord < (s.virtTexDimensionPages >> mip)) && (x_coord < (s.virtTexDimensionPages >> mip)))
+			{
+				const uint32_t pageInfo = s.longMipChain ? ((x_coord << 20) + (y_coord << 8) + mip) : ((x_coord << 16) + (y_coord << 8) + mip);
+
+				if (tmpPages1.count(pageInfo))
+					tmpPages1[pageInfo] = tmpPages1[pageInfo] + 1;
+				else
+					tmpPages1[pageInfo] = 1;
+			}
+		}
+	}
+
+	for (map<uint32_t, uint32_t>::iterator it = tmpPages1.begin(); it != tmpPages1.end(); ++it)
+		tmpPages2.insert(pair<uint32_t, uint32_t>(it->second, it->first));
+
+	result.clear();
+	for (multimap<uint32_t, uint32_t>::reverse_iterator it = tmpPages2.rbegin(); it != tmpPages2.rend(); ++it)
+	{
+		vtePageCount pc;
+		pc.pageInfo = it->second;
+		pc.count = it->first;
+		result.push_back(pc);
+	}
+}
+
+// a screen full of screen aligned page rectangles with a mip gradient from bottom to top and some background, roughly what a terrain flyover looks like
+static void _generateSynthetic(const vteParams *p, uint32_t *buffer)
+{
+	const vteStoreParams &s = p->stores[0];
+
+	srand(1);
+
+	for (uint32_t y = 0; y < p->h; y++)
+	{
+		const uint32_t mip = (uint32_t) ((p->h - 1 - y) * (s.mipChainLength - 1) / p->h / 2);
+		const uint32_t pagePixels = 8 << mip; // pages get bigger on screen towards the camera
+
+		for (uint32_t x = 0; x < p->w; x++)
+		{
+			if (y < p->h / 8) // sky
+			{
+				buffer[y * p->w + x] = 0;
+				continue;
+			}
+
+			const uint32_t dim = s.virtTexDimensionPages >> mip;
+			uint32_t x_coord = (x / pagePixels) % dim, y_coord = (y / pagePixels) % dim;
+
+			if (p->shiftByMip)
+			{
+				x_coord <<= mip;
+				y_coord <<= mip;
+			}
+
+			uint32_t b1 = mip, b2 = y_coord & 0xFF, b3 = x_coord & 0xFF;
+			if (s.longMipChain)
+				b1 |= ((y_coord >> 8) & 0x3) << 6 | ((x_coord >> 8) & 0x3) << 4;
+
+			buffer[y * p->w + x] = (255u << 24) | (b3 << 16) | (b2 << 8) | b1;
+		}
+	}
+}
+
+static bool _compare(vtePageCount *pages, uint32_t count, vector<vtePageCount> &reference)
+{
+	if (count != reference.size())
+	{
+		printf("MISMATCH: %u unique pages, reference has %u\n", count, (uint32_t) reference.size());
+		return false;
+	}
+
+	vteSortPagesByPriority(pages, count);
+	vteSortPagesByPriority(&reference[0], count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if ((pages[i].pageInfo != reference[i].pageInfo) || (pages[i].count != reference[i].count))
+		{
+			printf("MISMATCH at %u: page %u x%u, reference page %u x%u\n", i, pages[i].pageInfo, pages[i].count, reference[i].pageInfo, reference[i].count);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool _bench(const char *name, const vteParams *p, const uint32_t *buffer, int iterations)
+{
+	vteTable table;
+	vector<vtePageCount> reference;
+	double t, tReference, tScalar, tKernel;
+	uint32_t count = 0;
+
+	memset(&table, 0, sizeof(table));
+	if (!vteInitTable(&table, p->w * p->h))
+	{
+		printf("Error: out of memory\n");
+		return false;
+	}
+
+	t = _now();
+	for (int i = 0; i < iterations; i++)
+		_referenceExtract(p, buffer, reference);
+	tReference = (_now() - t) / iterations;
+
+	t = _now();
+	for (int i = 0; i < iterations; i++)
+	{
+		count = vteExtractPagesScalar(p, buffer, &table);
+		vteSortPagesByPriority(table.pages, count);
+	}
+	tScalar = (_now() - t) / iterations;
+
+	bool ok = _compare(table.pages, count, reference);
+
+	t = _now();
+	for (int i = 0; i < iterations; i++)
+	{
+		count = vteExtractPages(p, buffer, &table);
+		vteSortPagesByPriority(table.pages, count);
+	}
+	tKernel = (_now() - t) / iterations;
+
+	ok = _compare(table.pages, count, reference) && ok;
+
+	printf("%s: %ux%u, %u unique pages\n", name, p->w, p->h, count);
+	printf("  map/multimap reference: %8.3f ms\n", tReference * 1000.0);
+	printf("  scalar kernel:          %8.3f ms  (%.1fx)\n", tScalar * 1000.0, tReference / tScalar);
+	printf("  %-6s kernel:          %8.3f ms  (%.1fx)\n", vteKernelName(), tKernel * 1000.0, tReference / tKernel);
+
+	vteFreeTable(&table);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	vteParams p;
+	int iterations = 100;
+	vector<const char *> files;
+
+	memset(&p, 0, sizeof(p));
+	p.w = 480;
+	p.h = 270;
+	p.stores[0].mipChainLength = 9;
+	p.shiftByMip = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-w") && i + 1 < argc)			p.w = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-h") && i + 1 < argc)	p.h = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc)	p.stores[0].mipChainLength = (uint8_t) atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-i") && i + 1 < argc)	iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-l"))					p.stores[0].longMipChain = true;
+		else if (!strcmp(argv[i], "-s"))					p.shiftByMip = true;
+		else if (argv[i][0] == '-')
+		{
+			printf("Usage: %s [-w width] [-h height] [-m mipChainLength] [-l] [-s] [-i iterations] [readback dumps...]\n", argv[0]);
+			return 1;
+		}
+		else
+			files.push_back(argv[i]);
+	}
+
+	if ((p.stores[0].mipChainLength < 2) || (p.stores[0].mipChainLength > 11) || !p.w || !p.h || (iterations < 1))
+	{
+		printf("Error: invalid parameters\n");
+		return 1;
+	}
+
+	p.stores[0].virtTexDimensionPages = 2 << (p.stores[0].mipChainLength - 2);
+
+	uint32_t *buffer = (uint32_t *) malloc(p.w * p.h * 4);
+	bool ok = true;
+
+	if (files.empty())
+	{
+		_generateSynthetic(&p, buffer);
+		ok = _bench("synthetic", &p, buffer, iterations);
+	}
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		FILE *f = fopen(files[i], "rb");
+
+		if (!f || (fread(buffer, 4, p.w * p.h, f) != p.w * p.h))
+		{
+			printf("Error: can't read %ux%u pixels from %s\n", p.w, p.h, files[i]);
+			if (f) fclose(f);
+			ok = false;
+			continue;
+		}
+		fclose(f);
+
+		ok = _bench(files[i], &p, buffer, iterations) && ok;
+	}
+
+	free(buffer);
+
+	return ok ? 0 : 1;
+}
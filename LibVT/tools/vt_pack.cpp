@@ -0,0 +1,43 @@
+/*
+ *  vt_pack.cpp
+ *
+ *
+ *  Packs page stores into a single memory mapped tile archive each, see vtPackTileStore().
+ *
+ *  Usage: vt_pack tileDir...
+ *  The archive is written as tiles.vta into every tileDir, vtInit() and vtAddStore() prefer it over the tile directories, which are left as they are.
+ *  Stores written by bqt_build_vtex can be packed right away.
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "../LibVT_Internal.h"
+#include "../LibVT.h"
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s tileDir...\n", argv[0]);
+		return 1;
+	}
+
+	int result = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!vtPackTileStore(argv[i]))
+		{
+			printf("Error: %s is not a page store or couldn't be packed\n", argv[i]);
+			result = 1;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,315 @@
+/*
+ *  vt_replay.cpp
+ *
+ *
+ *  Headless replay of a feedback capture through page extraction, the RAM cache, the loading threads and the slot allocator.
+ *
+ *  Usage: vt_replay [-t tileDir] [-d decompressionThreads] [-c trace.csv] [-P pageCacheDir] [-l physTexLayers] [-f] [-q] [-s settleSeconds] capture
+ *    -t		read the pages from tileDir instead of the directory stored in the capture
+ *    -c		write the vtGetStats() of every frame to trace.csv, see vtStartStatsTrace()
+ *    -P		keep decoded pages in a persistent cache in pageCacheDir, see vtSetPageCacheDirectory(), a second run shows the warm start
+ *    -l		use a physical texture of physTexLayers layers instead of the one of the capture, see vtSetPhysicalTextureLayers()
+ *    -f		replay as fast as possible instead of at the recorded frame times
+ *    -q		only print the summary
+ *    -s		after the last frame keep rendering it until it is at full resolution, at most settleSeconds (default 10)
+ *  Captures are recorded with vtStartCapture(), bqt does so if BQT_VT_CAPTURE is set to the capture path.
+ *  All OpenGL calls are stubbed out (vt_replay_gl.cpp), so this runs on machines without a GPU.
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "../LibVT_Internal.h"
+#include "../LibVT.h"
+
+#include <algorithm>
+
+extern vtData vt;
+extern vtConfig c;
+
+struct replayStats
+{
+	vector<double>	latencies;					// vtMapNewPages() + vtExtractNeededPages() per frame, in seconds
+	uint64_t		pagesUploaded, cachedRequests, diskRequests;
+	uint32_t		framesAtFullResolution;
+	vector<double>	timesToFullResolution;		// from the first frame missing pages until the first frame without, for every such episode
+	double			missingSince;				// < 0 while at full resolution
+};
+
+// the fraction of the frame's requesting pixels whose page is mapped, i.e. shown at the requested resolution, pages missing from the store don't count
+static double _residency(const uint32_t *buffer, vteTable *table)
+{
+	vteParams params;
+	uint64_t pixels = 0, residentPixels = 0;
+
+	memset(&params, 0, sizeof(params)); // captures cover store 0
+	params.w = vt.w;
+	params.h = vt.h;
+	params.stores[0].virtTexDimensionPages = STORE(0).virtTexDimensionPages;
+	params.stores[0].mipChainLength = STORE(0).mipChainLength;
+	params.stores[0].longMipChain = STORE(0).longMipChain;
+	params.shiftByMip = !USE_MIPCALC_TEXTURE;
+
+	const uint32_t uniquePages = vteExtractPages(&params, buffer, table);
+
+	for (uint32_t i = 0; i < uniquePages; i++)
+	{
+		const uint32_t pageInfo = table->pages[i].pageInfo;
+
+		if (!vtuPageExists(pageInfo)) // not in a sparse store, its pixels already show the best the store has
+			continue;
+
+		pixels += table->pages[i].count;
+		if ((uint8_t) PAGE_TABLE(EXTRACT_STORE(pageInfo), EXTRACT_MIP(pageInfo), EXTRACT_X(pageInfo), EXTRACT_Y(pageInfo)) == kTableMapped)
+			residentPixels += table->pages[i].count;
+	}
+
+	return pixels ? (double) residentPixels / (double) pixels : 1.0;
+}
+
+// one frame the way bqt draws it: pages are mapped in the pre draw callback, the readback is analyzed in the post draw callback
+static double _replayFrame(const uint32_t *buffer, vteTable *table, replayStats *stats, double now, bool quiet, uint32_t frame)
+{
+	const double t0 = vtuTime();
+	vtMapNewPages();
+	const double t1 = vtuTime();
+
+	const double residency = _residency(buffer, table);
+
+	const double t2 = vtuTime();
+	vtExtractNeededPages(buffer);
+	const double t3 = vtuTime();
+
+	const double latency = (t1 - t0) + (t3 - t2);
+
+	stats->latencies.push_back(latency);
+	stats->pagesUploaded += vt.newPageCount;
+	stats->cachedRequests += vt.cachedRequestCount;
+	stats->diskRequests += vt.diskRequestCount;
+
+	if (residency >= 1.0)
+	{
+		stats->framesAtFullResolution++;
+
+		if (stats->missingSince >= 0.0)
+		{
+			stats->timesToFullResolution.push_back(now - stats->missingSince);
+			stats->missingSince = -1.0;
+		}
+	}
+	else if (stats->missingSince < 0.0)
+		stats->missingSince = now;
+
+	if (!quiet)
+		printf("%6u %9.3f %8.3f %8.3f %6u %6u %6u %7.1f%%\n", frame, now, latency * 1000.0, (t1 - t0) * 1000.0, vt.newPageCount, vt.cachedRequestCount, vt.diskRequestCount, residency * 100.0);
+
+	return residency;
+}
+
+static double _percentile(vector<double> v, double p)
+{
+	if (v.empty())
+		return 0.0;
+
+	sort(v.begin(), v.end());
+
+	return v[(size_t) (p * (v.size() - 1) + 0.5)];
+}
+
+static void _waitUntil(double t)
+{
+	double now;
+
+	while ((now = vtuTime()) < t)
+		OpenThreads::Thread::microSleep((unsigned int) ((t - now) * 1000000.0));
+}
+
+int main(int argc, char *argv[])
+{
+	const char *capturePath = NULL, *tileDir = NULL, *tracePath = NULL, *pageCacheDir = NULL;
+	bool fast = false, quiet = false;
+	double settleSeconds = 10.0;
+	int threads = -1, layers = -1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-t") && i + 1 < argc)			tileDir = argv[++i];
+		else if (!strcmp(argv[i], "-d") && i + 1 < argc)	threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc)	settleSeconds = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc)	tracePath = argv[++i];
+		else if (!strcmp(argv[i], "-P") && i + 1 < argc)	pageCacheDir = argv[++i];
+		else if (!strcmp(argv[i], "-l") && i + 1 < argc)	layers = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-f"))					fast = true;
+		else if (!strcmp(argv[i], "-q"))					quiet = true;
+		else if ((argv[i][0] == '-') || capturePath)
+		{
+			printf("Usage: %s [-t tileDir] [-d decompressionThreads] [-c trace.csv] [-P pageCacheDir] [-l physTexLayers] [-f] [-q] [-s settleSeconds] capture\n", argv[0]);
+			return 1;
+		}
+		else
+			capturePath = argv[i];
+	}
+
+	if (!capturePath)
+	{
+		printf("Usage: %s [-t tileDir] [-d decompressionThreads] [-c trace.csv] [-P pageCacheDir] [-l physTexLayers] [-f] [-q] [-s settleSeconds] capture\n", argv[0]);
+		return 1;
+	}
+
+
+	// read the configuration and start LibVT like bqt does
+	FILE *f = fopen(capturePath, "rb");
+	vtCaptureHeader header;
+	char codec[9];
+
+	if (!f || (fread(&header, sizeof(header), 1, f) != 1) || memcmp(header.magic, VT_CAPTURE_MAGIC, 4) || (header.version != VT_CAPTURE_VERSION))
+	{
+		printf("Error: %s is not a LibVT capture\n", capturePath);
+		return 1;
+	}
+
+	string storedTileDir(header.tileDirLength, ' ');
+	if (header.tileDirLength && (fread(&storedTileDir[0], 1, header.tileDirLength, f) != header.tileDirLength))
+	{
+		printf("Error: %s is truncated\n", capturePath);
+		return 1;
+	}
+
+	memcpy(codec, header.codec, 8);
+	codec[8] = 0;
+
+	if (threads >= 0)
+		vtSetDecompressionThreads((uint8_t) threads);
+	if (pageCacheDir)
+		vtSetPageCacheDirectory(pageCacheDir);
+	vtSetPhysicalTextureLayers((uint8_t) ((layers >= 0) ? layers : header.physTexLayers)); // 0 in older captures means the default
+
+	if (!vtInit(tileDir ? tileDir : storedTileDir.c_str(), codec, header.pageBorder, header.mipChainLength, header.pageDimension, header.physTexSize))
+	{
+		printf("Error: can't open the page store of the capture, pass it with -t\n");
+		return 1;
+	}
+
+	vtPrepare(0, 0);
+
+	if (tracePath && !vtStartStatsTrace(tracePath))
+		return 1;
+
+
+	// replay
+	replayStats stats;
+	vtCaptureFrame frame;
+	vector<uint32_t> buffer;
+	vteTable table;
+	uint32_t frames = 0;
+	double start = vtuTime(), frameTime = 0.0;
+
+	memset(&table, 0, sizeof(table));
+	stats.pagesUploaded = stats.cachedRequests = stats.diskRequests = 0;
+	stats.framesAtFullResolution = 0;
+	stats.missingSince = -1.0;
+
+	if (!quiet)
+		printf(" frame    time s  lat. ms   map ms upload cached   disk resident\n");
+
+	while (fread(&frame, sizeof(frame), 1, f) == 1)
+	{
+		if ((frame.w != vt.w) || (frame.h != vt.h) || buffer.empty())
+		{
+			vtReshape((uint16_t) frame.real_w, (uint16_t) frame.real_h, 0.0, 0.0, 0.0);
+
+			if ((frame.w != vt.w) || (frame.h != vt.h))
+			{
+				printf("Error: the capture was recorded with PREPASS_RESOLUTION_REDUCTION_SHIFT different from this build\n");
+				return 1;
+			}
+
+			buffer.resize(frame.w * frame.h);
+			vteFreeTable(&table);
+			vteInitTable(&table, frame.w * frame.h);
+		}
+
+		if (fread(&buffer[0], 4, frame.w * frame.h, f) != frame.w * frame.h)
+		{
+			printf("Warning: the capture is truncated after %u frames\n", frames);
+			break;
+		}
+
+		if (!fast)
+			_waitUntil(start + frame.time);
+
+		frameTime = frame.time;
+		_replayFrame(&buffer[0], &table, &stats, vtuTime() - start, quiet, frames++);
+	}
+	fclose(f);
+
+	if (!frames)
+	{
+		printf("Error: the capture contains no frames\n");
+		return 1;
+	}
+
+
+	// keep looking at the last frame until every page it needs is mapped
+	const uint32_t recordedFrames = frames;
+	const double settleStart = vtuTime();
+	double settled = -1.0;
+
+	while (settleSeconds > 0.0)
+	{
+		const double now = vtuTime();
+
+		if (_replayFrame(&buffer[0], &table, &stats, now - start, quiet, frames++) >= 1.0)
+		{
+			settled = now - settleStart;
+			break;
+		}
+		if (now - settleStart > settleSeconds)
+			break;
+
+		_waitUntil(now + 1.0 / 60.0);
+	}
+
+
+	// summary
+	vtPoolStats pagePool, bufferPools;
+	vtStats totals;
+	double mean = 0.0, meanTimeToFullResolution = 0.0;
+
+	vtGetPoolStats(&pagePool, &bufferPools);
+	vtGetStats(&totals);
+
+	for (size_t i = 0; i < stats.latencies.size(); i++)
+		mean += stats.latencies[i];
+	mean /= stats.latencies.size();
+
+	for (size_t i = 0; i < stats.timesToFullResolution.size(); i++)
+		meanTimeToFullResolution += stats.timesToFullResolution[i] / stats.timesToFullResolution.size();
+
+	printf("\n%u frames over %.2f s recorded, %u frames over %.2f s replayed (%s)\n", recordedFrames, frameTime, frames, vtuTime() - start, fast ? "fast" : "real time");
+	printf("frame latency:            mean %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n", mean * 1000.0, _percentile(stats.latencies, 0.5) * 1000.0, _percentile(stats.latencies, 0.95) * 1000.0, _percentile(stats.latencies, 0.99) * 1000.0, _percentile(stats.latencies, 1.0) * 1000.0);
+	printf("pages uploaded:           %llu\n", (unsigned long long) stats.pagesUploaded);
+	printf("page requests:            %llu from the RAM cache, %llu from disk, cache hit rate %.1f%%\n", (unsigned long long) stats.cachedRequests, (unsigned long long) stats.diskRequests,
+		   (stats.cachedRequests + stats.diskRequests) ? 100.0 * stats.cachedRequests / (stats.cachedRequests + stats.diskRequests) : 100.0);
+	printf("cancelled loads:          %llu\n", (unsigned long long) totals.pagesCancelled);
+	printf("page reads:               %llu from disk (%.1f MB), %llu from the compressed cache, %llu from the page cache\n", (unsigned long long) totals.pagesRead, totals.diskBytesRead / (1024.0 * 1024.0),
+		   (unsigned long long) totals.compressedCacheHits, (unsigned long long) totals.pageCacheHits);
+	printf("full resolution frames:   %u (%.1f%%)\n", stats.framesAtFullResolution, 100.0 * stats.framesAtFullResolution / frames);
+	printf("time to full resolution:  %u times, mean %.3f s, max %.3f s\n", (uint32_t) stats.timesToFullResolution.size(), meanTimeToFullResolution, _percentile(stats.timesToFullResolution, 1.0));
+	if (settled >= 0.0)
+		printf("last frame settled after: %.3f s\n", settled);
+	else
+		printf("last frame settled after: not within %.1f s\n", settleSeconds);
+	printf("page pool:                %u blocks high water (%.1f MB), hit rate %.1f%%\n", pagePool.blocksHighWater, pagePool.bytesHighWater / (1024.0 * 1024.0),
+		   (pagePool.hits + pagePool.misses) ? 100.0 * pagePool.hits / (pagePool.hits + pagePool.misses) : 0.0);
+
+	vteFreeTable(&table);
+	vtShutdown();
+
+	return 0;
+}
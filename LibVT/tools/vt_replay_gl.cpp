@@ -0,0 +1,159 @@
+/*
+ *  vt_replay_gl.cpp
+ *
+ *
+ *  No-op OpenGL entry points for running LibVT headless in vt_replay.
+ *
+ */
+
+/*
+ This library is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License as published by the Free Software Foundation; either version 3.0 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License along with this library; if not, see <http://www.gnu.org/licenses/> or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+// every GL call LibVT makes succeeds without doing anything, except that buffer objects are backed by memory so the PBO paths can be replayed too.
+// texture uploads still touch their source data through a checksum so the cost of reading the page isn't optimized away, uploads from a PBO are checked to stay inside it.
+
+#include "../LibVT_Internal.h"
+
+static map<GLuint, vector<uint8_t> >	_buffers;
+static GLuint							_boundBuffers[2];		// GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER
+static GLuint							_nextName = 1;
+volatile uint32_t						vtReplayUploadChecksum;
+
+static GLuint & _bound(GLenum target)
+{
+	return _boundBuffers[(target == GL_PIXEL_PACK_BUFFER) ? 0 : 1];
+}
+
+static void _touch(const GLvoid *data, GLsizei size)
+{
+	const uint8_t *bytes = (const uint8_t *) data;
+	uint32_t sum = 0;
+
+	if (!bytes)
+		return;
+
+	for (GLsizei i = 0; i < size; i += 64)
+		sum += bytes[i];
+
+	vtReplayUploadChecksum += sum;
+}
+
+
+// resolves the offset of an upload from the bound unpack buffer
+static const GLvoid * _source(const GLvoid *data, GLsizei size)
+{
+	if (!_bound(GL_PIXEL_UNPACK_BUFFER))
+		return data;
+
+	vector<uint8_t> &b = _buffers[_bound(GL_PIXEL_UNPACK_BUFFER)];
+	const size_t offset = (const uint8_t *) data - (const uint8_t *) NULL;
+
+	assert(offset + size <= b.size());
+
+	return &b[0] + offset;
+}
+
+
+static void APIENTRY _glGenBuffers(GLsizei n, GLuint *buffers)					{ for (GLsizei i = 0; i < n; i++) buffers[i] = _nextName++; }
+static void APIENTRY _glBindBuffer(GLenum target, GLuint buffer)				{ _bound(target) = buffer; }
+static void APIENTRY _glBufferData(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum)
+{
+	vector<uint8_t> &b = _buffers[_bound(target)];
+
+	b.resize(size);
+	if (data)
+		memcpy(&b[0], data, size);
+}
+static void APIENTRY _glDeleteBuffers(GLsizei n, const GLuint *buffers)			{ for (GLsizei i = 0; i < n; i++) _buffers.erase(buffers[i]); }
+static GLvoid * APIENTRY _glMapBuffer(GLenum target, GLenum)					{ vector<uint8_t> &b = _buffers[_bound(target)]; return b.empty() ? NULL : &b[0]; }
+static GLboolean APIENTRY _glUnmapBuffer(GLenum)								{ return GL_TRUE; }
+static void APIENTRY _glUseProgram(GLuint)										{}
+static GLint APIENTRY _glGetUniformLocation(GLuint, const GLchar *)				{ return -1; }
+static void APIENTRY _glUniform1i(GLint, GLint)									{}
+static void APIENTRY _glGenFramebuffersEXT(GLsizei n, GLuint *framebuffers)		{ for (GLsizei i = 0; i < n; i++) framebuffers[i] = _nextName++; }
+static void APIENTRY _glBindFramebufferEXT(GLenum, GLuint)						{}
+static void APIENTRY _glFramebufferTexture2DEXT(GLenum, GLenum, GLenum, GLuint, GLint) {}
+static GLenum APIENTRY _glCheckFramebufferStatusEXT(GLenum)						{ return GL_FRAMEBUFFER_COMPLETE_EXT; }
+static void APIENTRY _glDeleteFramebuffersEXT(GLsizei, const GLuint *)			{}
+
+PFNGLGENBUFFERSPROC					glGenBuffers = _glGenBuffers;
+PFNGLBINDBUFFERPROC					glBindBuffer = _glBindBuffer;
+PFNGLBUFFERDATAPROC					glBufferData = _glBufferData;
+PFNGLDELETEBUFFERSPROC				glDeleteBuffers = _glDeleteBuffers;
+PFNGLMAPBUFFERPROC					glMapBuffer = _glMapBuffer;
+PFNGLUNMAPBUFFERPROC				glUnmapBuffer = _glUnmapBuffer;
+PFNGLUSEPROGRAMPROC					glUseProgram = _glUseProgram;
+PFNGLGETUNIFORMLOCATIONPROC			glGetUniformLocation = _glGetUniformLocation;
+PFNGLUNIFORM1IPROC					glUniform1i = _glUniform1i;
+PFNGLGENFRAMEBUFFERSEXTPROC			glGenFramebuffersEXT = _glGenFramebuffersEXT;
+PFNGLBINDFRAMEBUFFEREXTPROC			glBindFramebufferEXT = _glBindFramebufferEXT;
+PFNGLFRAMEBUFFERTEXTURE2DEXTPROC	glFramebufferTexture2DEXT = _glFramebufferTexture2DEXT;
+PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC	glCheckFramebufferStatusEXT = _glCheckFramebufferStatusEXT;
+PFNGLDELETEFRAMEBUFFERSEXTPROC		glDeleteFramebuffersEXT = _glDeleteFramebuffersEXT;
+
+
+void glActiveTexture(GLenum)																			{}
+void glBindTexture(GLenum, GLuint)																		{}
+void glClear(GLbitfield)																				{}
+void glCopyTexSubImage2D(GLenum, GLint, GLint, GLint, GLint, GLint, GLsizei, GLsizei)					{}
+void glDeleteTextures(GLsizei, const GLuint *)															{}
+void glDisable(GLenum)																					{}
+void glEnable(GLenum)																					{}
+void glGenTextures(GLsizei n, GLuint *textures)															{ for (GLsizei i = 0; i < n; i++) textures[i] = _nextName++; }
+void glGetTexImage(GLenum, GLint, GLenum, GLenum, GLvoid *)												{}
+void glLoadMatrixd(const GLdouble *)																	{}
+void glMatrixMode(GLenum)																				{}
+void glPixelStorei(GLenum, GLint)																		{}
+void glPopMatrix()																						{}
+void glPushMatrix()																						{}
+void glReadPixels(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, GLvoid *)								{}
+void glTexImage2D(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid *)		{}
+void glTexParameterf(GLenum, GLenum, GLfloat)															{}
+void glTexParameteri(GLenum, GLenum, GLint)																{}
+void glViewport(GLint, GLint, GLsizei, GLsizei)															{}
+
+void glGetIntegerv(GLenum pname, GLint *params)
+{
+	*params = (pname == GL_MAX_TEXTURE_SIZE) ? 16384 : 32;
+}
+
+void glCompressedTexImage2D(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei imageSize, const GLvoid *data)
+{
+	_touch(data, imageSize);
+}
+
+void glCompressedTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLsizei imageSize, const GLvoid *data)
+{
+	_touch(_source(data, imageSize), imageSize);
+}
+
+void glTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum, const GLvoid *pixels)
+{
+	const GLsizei size = width * height * ((format == GL_RGBA || format == GL_BGRA) ? 4 : 3);
+
+	_touch(_source(pixels, size), size);
+}
+
+void glTexImage3D(GLenum, GLint, GLint, GLsizei, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid *)	{}
+
+void glCompressedTexImage3D(GLenum, GLint, GLenum, GLsizei, GLsizei, GLsizei, GLint, GLsizei imageSize, const GLvoid *data)
+{
+	_touch(data, imageSize);
+}
+
+void glCompressedTexSubImage3D(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLsizei imageSize, const GLvoid *data)
+{
+	_touch(_source(data, imageSize), imageSize);
+}
+
+void glTexSubImage3D(GLenum, GLint, GLint, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum, const GLvoid *pixels)
+{
+	const GLsizei size = width * height * depth * ((format == GL_RGBA || format == GL_BGRA) ? 4 : 3);
+
+	_touch(_source(pixels, size), size);
+}
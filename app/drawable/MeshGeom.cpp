@@ -29,7 +29,16 @@
 #include <osg/Material>
 #include <osg/CullFace>
 #include <osg/Camera>
+#include <osg/PagedLOD>
 #include <osgDB/ReadFile>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <osgDB/DatabasePager>
+#include <osgDB/Registry>
+#include <osg/Texture>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <map>
 #include "MyShaderGen.h"
 
 
@@ -42,14 +51,16 @@
 #include <osgViewer/ViewerEventHandlers>
 
 #include <osgManipulator/Translate2DDragger>
+#include <algorithm>
+#include <cstdlib>
 #include "PositionHandler.h"
 #include "MeshGeom.h"
 #include "PotentialUpdater.h"
 #include "BQTDebug.h"
 #include "BarrierSet.h"
 #include "SimulationState.h"
-#include "ProgressBar.h"
 #include "FindNode.h"
+#include "MeshLoader.h"
 
 
 namespace ews {
@@ -61,10 +72,143 @@ namespace ews {
             
 
             
+            /** Hands the meshes parsed by the loader to the scene, the update traversal is the only place the graph may change. */
+            class MeshInsertCallback : public osg::NodeCallback {
+            public:
+                virtual void operator()(osg::Node* node, osg::NodeVisitor* nv) {
+                    static_cast<MeshGeom*>(node)->insertLoadedMeshes();
+                    traverse(node, nv);
+                }
+            };
+
+            /**
+             * Reads the tiles of a paged model for the DatabasePager. bosgtiler writes the textures
+             * once and the tiles reference them by name, this makes the tiles share one osg::Texture
+             * per file so each is decoded and uploaded once however many tiles are resident.
+             */
+            class PagedTileReadFileCallback : public osgDB::ReadFileCallback {
+            public:
+                virtual osgDB::ReaderWriter::ReadResult readNode(const std::string& filename, const osgDB::Options* options);
+
+                /** Share the textures below node and read its tiles through this. */
+                void setupTiles(osg::Node *node);
+
+                /** Image memory of the textures shared so far. */
+                size_t textureBytes() const {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                    size_t bytes=0;
+                    for(std::map<std::string,osg::ref_ptr<osg::Texture> >::const_iterator it=_textures.begin(); it != _textures.end(); ++it)
+                        for(unsigned int i=0; i < it->second->getNumImages(); i++)
+                            if(it->second->getImage(i))
+                                bytes+=it->second->getImage(i)->getTotalSizeInBytesIncludingMipmaps();
+                    return bytes;
+                }
+
+                osg::Texture *share(osg::Texture *texture) {
+                    if(!texture->getNumImages() || !texture->getImage(0) || texture->getImage(0)->getFileName().empty())
+                        return texture;
+                    // the root file and the tiles reference the same file through different directories
+                    const std::string name=osgDB::getSimpleFileName(texture->getImage(0)->getFileName());
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                    osg::ref_ptr<osg::Texture> &shared=_textures[name];
+                    if(!shared.valid())
+                        shared=texture;
+                    return shared.get();
+                }
+
+                osgDB::Options *createOptions() {
+                    osgDB::Options *options=new osgDB::Options;
+                    options->setObjectCacheHint(osgDB::Options::CACHE_IMAGES); // tiles still referencing a known file don't decode it again
+                    options->setReadFileCallback(this);
+                    return options;
+                }
+
+            private:
+                mutable OpenThreads::Mutex _mutex;
+                std::map<std::string,osg::ref_ptr<osg::Texture> > _textures;   // by file name, guarded by _mutex
+            };
+
+            class ShareTexturesVisitor : public osg::NodeVisitor {
+            public:
+                ShareTexturesVisitor(PagedTileReadFileCallback *tiles) : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), _tiles(tiles) {}
+
+                virtual void apply(osg::Node& node) {
+                    share(node.getStateSet());
+                    traverse(node);
+                }
+
+                virtual void apply(osg::Geode& geode) {
+                    share(geode.getStateSet());
+                    for(unsigned int i=0; i < geode.getNumDrawables(); i++)
+                        share(geode.getDrawable(i)->getStateSet());
+                    traverse(geode);
+                }
+
+                virtual void apply(osg::PagedLOD& plod) {
+                    plod.setDatabaseOptions(_tiles->createOptions());
+                    apply((osg::Node&) plod);
+                }
+
+            private:
+                void share(osg::StateSet *ss) {
+                    if(!ss)
+                        return;
+                    for(unsigned int unit=0; unit < ss->getTextureAttributeList().size(); unit++)
+                        if(osg::Texture *texture=dynamic_cast<osg::Texture *>(ss->getTextureAttribute(unit,osg::StateAttribute::TEXTURE)))
+                            ss->setTextureAttribute(unit,_tiles->share(texture));
+                }
+
+                PagedTileReadFileCallback *_tiles;
+            };
+
+            osgDB::ReaderWriter::ReadResult PagedTileReadFileCallback::readNode(const std::string& filename, const osgDB::Options* options) {
+                osgDB::ReaderWriter::ReadResult result=osgDB::ReadFileCallback::readNode(filename,options);
+                if(result.validNode()) // on the pager thread, the tile isn't in the scene yet
+                    setupTiles(result.getNode());
+                return result;
+            }
+
+            void PagedTileReadFileCallback::setupTiles(osg::Node *node) {
+                ShareTexturesVisitor shareTextures(this);
+                node->accept(shareTextures);
+            }
+
+            /** Adds up the vertex and index data of the geometry below a node. */
+            class GeometrySizeVisitor : public osg::NodeVisitor {
+            public:
+                GeometrySizeVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), bytes(0) {}
+
+                virtual void apply(osg::Geode& geode) {
+                    for(unsigned int i=0; i < geode.getNumDrawables(); i++){
+                        osg::Geometry *geom=geode.getDrawable(i)->asGeometry();
+                        if(!geom)
+                            continue;
+                        add(geom->getVertexArray());
+                        add(geom->getNormalArray());
+                        add(geom->getColorArray());
+                        for(unsigned int unit=0; unit < geom->getNumTexCoordArrays(); unit++)
+                            add(geom->getTexCoordArray(unit));
+                        for(unsigned int index=0; index < geom->getNumVertexAttribArrays(); index++)
+                            add(geom->getVertexAttribArray(index));
+                        for(unsigned int p=0; p < geom->getNumPrimitiveSets(); p++)
+                            bytes+=geom->getPrimitiveSet(p)->getTotalDataSize();
+                    }
+                    traverse(geode);
+                }
+
+                size_t bytes;
+
+            private:
+                void add(const osg::Array *array) {
+                    if(array)
+                        bytes+=array->getTotalDataSize();
+                }
+            };
+
             /** Primary constructor. */
             MeshGeom::MeshGeom(MeshFile& dataModel)
             : DrawableQtAdapter(), _dataModel(dataModel), _switch(new Switch),
-            _meshGeom(new PositionAttitudeTransform)
+            _meshGeom(new PositionAttitudeTransform), _pagedTileBytes(0), _pagedTextureBytes(0)
        {
                 
 //qDebug() << " In Mesh Geom const";
@@ -99,11 +243,14 @@ namespace ews {
                 // and update the databmodel.
          //       setUpdateCallback(new PotentialUpdater);
                 
+                setUpdateCallback(new MeshInsertCallback);
                 respondToSignals(true);
             }
             
             
             MeshGeom::~MeshGeom() {
+                if(_loading.valid())
+                    _loading->cancel();
             }
             
             void MeshGeom::respondToSignals(bool respond) {
@@ -134,101 +281,112 @@ namespace ews {
             void MeshGeom::updateGeom() {
                 //qDebug() << " In Mesh Geom update";
 
+                if(_loading.valid())
+                    _loading->cancel();
                 _meshGeom->removeChildren(0, _meshGeom->getNumChildren());
+                _dataModel.clearVTStuff(); // the tile stores of the models are opened again below
+                _pagedTileBytes=0;
+                _pagedTextureBytes=0;
                 QStringList list=_dataModel.getFileNames();
                 qDebug() << "Number of files  "<<_dataModel.getFileNames().size();
-                QStringList::Iterator it = list.begin();
-                while( it != list.end() ) {
-                   //_dataModel.getPBarD()->reset();
-
-                    qDebug() << "Loading " << *it;
-                string filename = it->toStdString();
-                //osgDB::Registry::instance()->setReadFileCallback(new MyReadCallback(*sseh));
-                ShaderGenReadFileCallback *readFileCallback = new ShaderGenReadFileCallback;
-                   // All read nodes will inherit root state set.
-
-                osg::ref_ptr<osgDB::ReaderWriter> rw = osgDB::Registry::instance()->getReaderWriterForExtension(osgDB::getLowerCaseFileExtension(filename));
-                std::auto_ptr<progbuf> pb(new progbuf(osgDB::findDataFile(filename),_dataModel.getPBarD()));
-                if (!rw || !pb->is_open())
-                {
-                    string errmsg= "Error: could not open file `" + filename +"'" +" Might be plugin not found\n";
-                    QString errStr=errmsg.c_str();
-                    std::cerr << errmsg;
-                    errorD.showMessage(errStr);
-                    errorD.exec();
-                    ++it;
-                    continue;
-                }
-                _dataModel.getPBarD()->setLabelText("Loading Mesh: "+*it);
-                 _dataModel.getPBarD()->setRange(0,100);
-                _dataModel.getPBarD()->show();
-                osg::ref_ptr<osgDB::ReaderWriter::Options> local_opt = new osgDB::ReaderWriter::Options;
-                local_opt->setDatabasePath(osgDB::getFilePath(filename));
-                std::istream mis(pb.get());
-                osg::MatrixTransform *transRev=new osg::MatrixTransform;
-                osgDB::ReaderWriter::ReadResult rr = rw->readNode(mis,local_opt);
-                if (rr.validNode()) {
-                    osg::ref_ptr<osg::Node> node = rr.getNode();
-                    if(!node.valid()){
-                        string errmsg= "Invalid Node: could not open file `" + filename +"'";
-                        QString errStr=errmsg.c_str();
-                        std::cerr << errmsg;
-                        errorD.showMessage(errStr);
-                        errorD.exec();
-                    }
-                    osg::CoordinateSystemNode *pCoordSystem =findTopMostNodeOfType<osg::CoordinateSystemNode>(node.get());
-
 
-                    osg::StateSet *ss=_meshGeom->getOrCreateStateSet();
-
-                    if(ss){
-                        std::vector<osg::Uniform *> &shared_uniforms=_dataModel.getShaderOutUniform();
-                        for(int i=0; i < shared_uniforms.size(); i++)
-                            ss->addUniform(shared_uniforms[i]);
-
-                        ss->setTextureAttribute(TEXUNIT_ATTRIB,_dataModel.getSharedTex());
-                    }
-                    readFileCallback->setRootStateSet(ss);
-                   // osgDB::Registry::instance()->setReadFileCallback(readFileCallback);
-
-                    if( pCoordSystem ){
-                        printf("New Node type with CSN\n");
-                        osg::MatrixTransform *trans =findTopMostNodeOfType<osg::MatrixTransform>(node.get());
-            if(trans){
-                transRev->setMatrix(osg::Matrix::inverse(trans->getMatrix())*osg::Matrix::rotate(osg::DegreesToRadians(-90.0f),0,0,1.0));
+                // the files are parsed on the thread pool, insertLoadedMeshes() adds them as they come in
+                _loading=new MeshLoadBatch(list);
+                _dataModel.setMeshLoadProgress(0,_loading->size(),0.0);
+                _loading->start();
             }
 
-                        transRev->addChild(node.get());
-                        std::string tex_name=osgDB::getFilePath(filename)+"/vtex";
-                        osg::Node *vt_node=_dataModel.createVTStuff(transRev,tex_name);
-                        if(vt_node)
-                        _meshGeom->addChild(vt_node);
-                        else
-                            _meshGeom->addChild(transRev);
-                    }else{
-                    _meshGeom->addChild(node.get());
+            void MeshGeom::insertLoadedMeshes() {
+                if(!_loading.valid())
+                    return;
 
-                }
-                    setEnabled(true);
-                   //_dataModel.setStateSet(ss);
-                }else{
-                    if (rr.error()) {
-                        string errmsg= "Error: could not open file `" + filename +"'" +rr.message();
-                        QString errStr=errmsg.c_str();
-                        std::cerr << errmsg;
-                        errorD.showMessage(errStr);
-                        errorD.exec();
+                MeshLoadBatch::Result result;
+                while(_loading->takeResult(result)) {
+                    if(!result.error.empty()){
+                        std::cerr << result.error;
+                        errorD.showMessage(result.error.c_str());
+                        continue;
                     }
+                    qDebug() << "Loaded " << result.filename.c_str();
+                    addMesh(result.filename,result.node.get());
                 }
-                ++it;
+
+                _dataModel.setMeshLoadProgress(_loading->finishedCount(),_loading->size(),_loading->progress());
+                if(_loading->isDone())
+                    _loading=NULL;
             }
 
+            void MeshGeom::addMesh(const std::string &filename,osg::Node *node) {
+                const bool first=(_meshGeom->getNumChildren() == 0);
+                osg::MatrixTransform *transRev=new osg::MatrixTransform;
+                osg::CoordinateSystemNode *pCoordSystem =findTopMostNodeOfType<osg::CoordinateSystemNode>(node);
 
+                // models split up by bosgtiler stream their tiles through the viewer's DatabasePager,
+                // set up before the virtual texture so it can add its own handling of the tiles
+                if(osg::PagedLOD *paged=findTopMostNodeOfType<osg::PagedLOD>(node))
+                    setupPaging(filename,paged);
 
-            }
+                osg::StateSet *ss=_meshGeom->getOrCreateStateSet();
+
+                if(ss){
+                    std::vector<osg::Uniform *> &shared_uniforms=_dataModel.getShaderOutUniform();
+                    for(int i=0; i < shared_uniforms.size(); i++)
+                        ss->addUniform(shared_uniforms[i]);
+
+                    ss->setTextureAttribute(TEXUNIT_ATTRIB,_dataModel.getSharedTex());
+                }
 
+                if( pCoordSystem ){
+                    printf("New Node type with CSN\n");
+                    osg::MatrixTransform *trans =findTopMostNodeOfType<osg::MatrixTransform>(node);
+                    if(trans){
+                        transRev->setMatrix(osg::Matrix::inverse(trans->getMatrix())*osg::Matrix::rotate(osg::DegreesToRadians(-90.0f),0,0,1.0));
+                    }
 
+                    transRev->addChild(node);
+                    std::string tex_name=osgDB::getFilePath(filename)+"/vtex";
+                    osg::Node *vt_node=_dataModel.createVTStuff(transRev,tex_name);
+                    if(vt_node)
+                        _meshGeom->addChild(vt_node);
+                    else
+                        _meshGeom->addChild(transRev);
+                }else{
+                    _meshGeom->addChild(node);
+                }
+                setEnabled(true);
+
+                // the view was set up before anything was loaded
+                QOSGWidget *renderer=_dataModel.getRenderer();
+                renderer->computeHomePosition();
+                if(first && renderer->getCameraManipulator())
+                    renderer->getCameraManipulator()->home(0.0);
+                if(_dataModel._mapCam)
+                    updateOrthoView(_dataModel._mapCam,_meshGeom.get());
+            }
 
+            void MeshGeom::setupPaging(const std::string &filename,osg::PagedLOD *root) {
+                // the tiles are next to the file, not every reader records that for a stream
+                if(root->getDatabasePath().empty())
+                    root->setDatabasePath(osgDB::getFilePath(osgDB::findDataFile(filename)));
+
+                // the root's textures are the ones the tiles use, they stay resident once for all tiles
+                osg::ref_ptr<PagedTileReadFileCallback> tiles=new PagedTileReadFileCallback;
+                tiles->setupTiles(root);
+                _pagedTextureBytes+=tiles->textureBytes();
+
+                // every tile is simplified to about the size of the root's, the pager is given as many as fit next to the textures
+                GeometrySizeVisitor tileSize;
+                if(root->getNumChildren())
+                    root->getChild(0)->accept(tileSize);
+                _pagedTileBytes=std::max(_pagedTileBytes,std::max(tileSize.bytes,(size_t)1));
+
+                const char *env=getenv("BQT_PAGED_MEMORY_MB");
+                const double ceiling=(env ? atof(env) : PAGED_MEMORY_MB)*1024.0*1024.0;
+                const unsigned int count=(unsigned int)std::max(1.0,(ceiling-_pagedTextureBytes)/_pagedTileBytes);
+                _dataModel.getRenderer()->getDatabasePager()->setTargetMaximumNumberOfPageLOD(count);
+                printf("Paged model %s, keeping up to %u tiles of %.2f MB next to %.2f MB of textures\n",filename.c_str(),count,
+                       _pagedTileBytes/(1024.0*1024.0),_pagedTextureBytes/(1024.0*1024.0));
+            }
 
         }
     }
@@ -29,8 +29,10 @@
 #include <osg/Group>
 #include <osg/Switch>
 #include <osg/Geode>
+#include <osg/PagedLOD>
 #include <osgManipulator/Translate2DDragger>
 #include "MeshFile.h"
+#include "MeshLoader.h"
 #include "DrawableQtAdapter.h"
 #include <QErrorMessage>
 #include "ScreenTools.h"
@@ -70,6 +72,10 @@ namespace ews {
                 /** Recompute geometric representation to match data model. */
                 void updateGeom();
 
+            public:
+                /** Add the meshes the loader has finished since the last call, from the update traversal. */
+                void insertLoadedMeshes();
+
                 
             protected:
                 /** Protected to enforce use with ref_ptr. */
@@ -80,10 +86,17 @@ namespace ews {
 
                 /** Turn on/off whether this responds to signals. */
                 void respondToSignals(bool respond);
+                /** Put a parsed mesh into the scene, with its virtual texture if it has one. */
+                void addMesh(const std::string &filename,osg::Node *node);
+                /** Let the DatabasePager stream the tiles of a paged model within the memory ceiling. */
+                void setupPaging(const std::string &filename,osg::PagedLOD *root);
 
                 MeshFile& _dataModel;
                 ref_ptr<Switch> _switch;
                 ref_ptr<PositionAttitudeTransform> _meshGeom;
+                ref_ptr<MeshLoadBatch> _loading;    // the files of the last updateGeom() that haven't all been added yet
+                size_t _pagedTileBytes;             // largest tile of the paged models loaded
+                size_t _pagedTextureBytes;          // textures the paged models share between their tiles
 
                 QErrorMessage errorD;
             };
@@ -0,0 +1,149 @@
+/* Copyright (C) 2012 Matthew Johnson-Roberson
+ * See COPYING for license details
+ */
+#include <osgDB/Registry>
+#include <osgDB/ReaderWriter>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/ScopedLock>
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+#include "MeshLoader.h"
+#include "ProgressBar.h"
+
+namespace ews {
+    namespace app {
+        namespace drawable {
+
+            namespace {
+                /** Parses one file of a batch on a thread of the pool. */
+                class MeshLoadTask : public QRunnable {
+                public:
+                    MeshLoadTask(MeshLoadBatch *batch, int index, const std::string &path, osgDB::ReaderWriter *rw)
+                    : _batch(batch), _index(index), _path(path), _rw(rw) {
+                    }
+
+                    virtual void run() {
+                        const std::string &filename = _batch->filename(_index);
+
+                        if (_batch->isCancelled()) {
+                            _batch->finish(_index, NULL, std::string());
+                            return;
+                        }
+
+                        countbuf pb(_path, _batch->progressOf(_index));
+                        if (!pb.is_open()) {
+                            _batch->finish(_index, NULL, "Error: could not open file `" + filename + "'\n");
+                            return;
+                        }
+
+                        osg::ref_ptr<osgDB::ReaderWriter::Options> local_opt = new osgDB::ReaderWriter::Options;
+                        local_opt->setDatabasePath(osgDB::getFilePath(_path)); // where the tiles of paged models are found
+                        std::istream mis(&pb);
+                        osgDB::ReaderWriter::ReadResult rr = _rw->readNode(mis, local_opt.get());
+
+                        if (rr.validNode())
+                            _batch->finish(_index, rr.getNode(), std::string());
+                        else
+                            _batch->finish(_index, NULL, rr.error() ? "Error: could not open file `" + filename + "'" + rr.message() : std::string());
+                    }
+
+                private:
+                    osg::ref_ptr<MeshLoadBatch> _batch;
+                    int _index;
+                    std::string _path;
+                    osg::ref_ptr<osgDB::ReaderWriter> _rw;
+                };
+            }
+
+            MeshLoadBatch::MeshLoadBatch(const QStringList &files)
+            : _progress(new OpenThreads::Atomic[files.size()]), _done(files.size(), false), _finished(0) {
+                for (QStringList::const_iterator it = files.begin(); it != files.end(); ++it)
+                    _files.push_back(it->toStdString());
+            }
+
+            MeshLoadBatch::~MeshLoadBatch() {
+                delete [] _progress;
+            }
+
+            void MeshLoadBatch::start() {
+                for (int i = 0; i < size(); i++) {
+                    // plugins are loaded here rather than on the pool
+                    osg::ref_ptr<osgDB::ReaderWriter> rw = osgDB::Registry::instance()->getReaderWriterForExtension(osgDB::getLowerCaseFileExtension(_files[i]));
+                    std::string path = osgDB::findDataFile(_files[i]);
+
+                    if (!rw || path.empty()) {
+                        finish(i, NULL, "Error: could not open file `" + _files[i] + "'" + " Might be plugin not found\n");
+                        continue;
+                    }
+
+                    QThreadPool::globalInstance()->start(new MeshLoadTask(this, i, path, rw.get()));
+                }
+            }
+
+            void MeshLoadBatch::cancel() {
+                _cancelled.exchange(1);
+
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                _results.clear();
+            }
+
+            bool MeshLoadBatch::isCancelled() const {
+                return _cancelled != 0;
+            }
+
+            bool MeshLoadBatch::takeResult(Result &result) {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+                if (_results.empty())
+                    return false;
+
+                result = _results.front();
+                _results.pop_front();
+                return true;
+            }
+
+            bool MeshLoadBatch::isDone() const {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+                return _finished == size() && _results.empty();
+            }
+
+            int MeshLoadBatch::finishedCount() const {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+                return _finished;
+            }
+
+            double MeshLoadBatch::progress() const {
+                if (!size())
+                    return 1.0;
+
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                double sum = 0.0;
+
+                for (int i = 0; i < size(); i++)
+                    sum += _done[i] ? 1.0 : std::min(unsigned(_progress[i]), 1000u) / 1000.0;
+
+                return sum / size();
+            }
+
+            void MeshLoadBatch::finish(int index, osg::Node *node, const std::string &error) {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+                _done[index] = true;
+                _finished++;
+
+                if (isCancelled() || (!node && error.empty()))
+                    return;
+
+                Result result;
+                result.filename = _files[index];
+                result.node = node;
+                result.error = error;
+                _results.push_back(result);
+            }
+        }
+    }
+}
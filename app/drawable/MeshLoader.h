@@ -0,0 +1,76 @@
+/* Copyright (C) 2012 Matthew Johnson-Roberson
+ * See COPYING for license details
+ */
+
+#ifndef __MESH_LOADER_H
+#define __MESH_LOADER_H
+
+#include <osg/Node>
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Atomic>
+#include <QStringList>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ews {
+    namespace app {
+        namespace drawable {
+
+            /**
+             * The mesh files of one load. They are parsed concurrently on the global QThreadPool
+             * and collected here until the update traversal takes them, so the GUI thread never
+             * waits for a file.
+             */
+            class MeshLoadBatch : public osg::Referenced {
+            public:
+                /** A parsed mesh, or the error message if it couldn't be read. */
+                struct Result {
+                    std::string filename;
+                    osg::ref_ptr<osg::Node> node;
+                    std::string error;
+                };
+
+                explicit MeshLoadBatch(const QStringList &files);
+
+                /** Queue all files on the thread pool. Must be called on the GUI thread. */
+                void start();
+                /** Drop all results, files that haven't started parsing yet are skipped. */
+                void cancel();
+                bool isCancelled() const;
+
+                /** Take the next parsed mesh, false if none is ready. */
+                bool takeResult(Result &result);
+                /** All files are parsed and all results have been taken. */
+                bool isDone() const;
+
+                int size() const { return (int) _files.size(); }
+                int finishedCount() const;
+                /** The parsed fraction over all files, 0 - 1. */
+                double progress() const;
+
+                // used by the loading tasks
+                const std::string &filename(int index) const { return _files[index]; }
+                OpenThreads::Atomic *progressOf(int index) { return &_progress[index]; }
+                void finish(int index, osg::Node *node, const std::string &error);
+
+            protected:
+                /** Protected to enforce use with ref_ptr, the tasks hold one each. */
+                virtual ~MeshLoadBatch();
+
+            private:
+                std::vector<std::string> _files;
+                OpenThreads::Atomic *_progress;     // per file in permille
+                OpenThreads::Atomic _cancelled;
+                mutable OpenThreads::Mutex _mutex;
+                std::deque<Result> _results;        // guarded by _mutex
+                std::vector<bool> _done;            // guarded by _mutex
+                int _finished;                      // guarded by _mutex
+            };
+        }
+    }
+}
+
+#endif // __MESH_LOADER_H
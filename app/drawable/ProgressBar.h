@@ -8,6 +8,7 @@
 #include <fstream>
 #include <memory>
 #include <QProgressDialog>
+#include <OpenThreads/Atomic>
 template<typename Elem, typename Tr = std::char_traits<Elem> >
 class progress_streambuf: public std::basic_filebuf<Elem, Tr>
 {
@@ -52,4 +53,42 @@ private:
 
 typedef progress_streambuf<char> progbuf;
 
+// reads on a worker thread, it only stores the progress in permille for the GUI thread to poll
+template<typename Elem, typename Tr = std::char_traits<Elem> >
+class counting_streambuf: public std::basic_filebuf<Elem, Tr>
+{
+public:
+        typedef Tr traits_type;
+
+        typedef std::basic_filebuf<Elem, Tr> base_type;
+        typedef typename traits_type::int_type int_type;
+        explicit counting_streambuf(const std::string &filename,OpenThreads::Atomic *permille)
+        :	base_type(),
+                size_(0),
+                permille_(permille)
+        {
+                if (this->open(filename.c_str(), std::ios_base::in | std::ios_base::binary))
+                {
+                        size_ = static_cast<double>(this->pubseekoff(0, std::ios_base::end, std::ios_base::in));
+                        permille_->exchange(0);
+                        this->pubseekoff(0, std::ios_base::beg, std::ios_base::in);
+                }
+        }
+
+protected:
+        virtual int_type uflow()
+        {
+                int_type v = base_type::uflow();
+                if (size_ > 0)
+                        permille_->exchange(unsigned(((size_ - this->showmanyc())/size_)*1000));
+                return v;
+        }
+
+private:
+        double size_;
+        OpenThreads::Atomic *permille_;
+};
+
+typedef counting_streambuf<char> countbuf;
+
 #endif // PROGRESSBAR_H
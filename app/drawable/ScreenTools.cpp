@@ -516,6 +516,37 @@ void addMapSqaure(osg::Group *mapGroup,WorldWindManipulatorNew *om,osg::Camera *
   transgeode ->addChild( geode);
   mapGroup->addChild(transgeode);
 }
+// frames the bound in the render to texture camera of the map
+static void setOrthoViewBound(osg::Camera *camera,const osg::BoundingSphere& bs){
+  if(!bs.valid())
+      return; // nothing loaded yet, updateOrthoView() is called again once there is
+  osg::Matrix viewMatrix;
+  if(oldmesh){
+      viewMatrix.makeLookAt(bs.center()-osg::Vec3(0.0,2.0f*bs.radius(),0.0),
+                        bs.center(),osg::Vec3(0.0f,0.0f,1.0f));
+  }else
+      viewMatrix.makeLookAt(bs.center()+osg::Vec3(0.0f,-1.0f,-3.5f)*bs.radius(),bs.center(),osg::Vec3(0.0f,0.0f,1.0f));
+
+  //viewMatrix.makeLookAt(bs.center()+osg::Vec3(0.0,0.0,3.5f*bs.radius()),
+        //		bs.center(),osg::Vec3(0.0f,0.0f,1.0f));
+  if(oldmesh){
+      camera->setProjectionMatrixAsOrtho(-(bs.radius()+bs.radius()/2),
+				     bs.radius()+bs.radius()/2,
+                                     -bs.radius(), bs.radius(),0, 0);
+  }else
+     camera->setProjectionMatrixAsOrtho2D(-bs.radius(),bs.radius(),-bs.radius(),bs.radius());
+
+  camera->setViewMatrix(viewMatrix);
+}
+
+void updateOrthoView(osg::Camera *quad_cam,osg::Node* subgraph){
+  for(unsigned int i=0; i < quad_cam->getNumChildren(); i++){
+      osg::Camera *camera=dynamic_cast<osg::Camera*>(quad_cam->getChild(i));
+      if(camera && camera->getRenderOrder() == osg::Camera::PRE_RENDER)
+          setOrthoViewBound(camera,subgraph->getBound());
+  }
+}
+
 osg::Camera* createOrthoView(osg::Node* subgraph, const osg::Vec4& clearColour, WorldWindManipulatorNew *om,int screen_width,int screen_height,int hud_width,int hud_height,int hud_margin){
   osg::Texture* texture = 0;
   unsigned int samples = 0;
@@ -543,24 +574,7 @@ osg::Camera* createOrthoView(osg::Node* subgraph, const osg::Vec4& clearColour,
   camera->setRenderTargetImplementation( osg::Camera::FRAME_BUFFER_OBJECT);
   camera->setPostDrawCallback(new MyCameraPostDrawCallback(camera)) ;
   
-  const osg::BoundingSphere& bs = subgraph->getBound();
-  osg::Matrix viewMatrix;
-  if(oldmesh){
-      viewMatrix.makeLookAt(bs.center()-osg::Vec3(0.0,2.0f*bs.radius(),0.0),
-                        bs.center(),osg::Vec3(0.0f,0.0f,1.0f));
-  }else
-      viewMatrix.makeLookAt(bs.center()+osg::Vec3(0.0f,-1.0f,-3.5f)*bs.radius(),bs.center(),osg::Vec3(0.0f,0.0f,1.0f));
-
-  //viewMatrix.makeLookAt(bs.center()+osg::Vec3(0.0,0.0,3.5f*bs.radius()),
-        //		bs.center(),osg::Vec3(0.0f,0.0f,1.0f));
-  if(oldmesh){
-      camera->setProjectionMatrixAsOrtho(-(bs.radius()+bs.radius()/2),
-				     bs.radius()+bs.radius()/2,
-                                     -bs.radius(), bs.radius(),0, 0);
-  }else
-     camera->setProjectionMatrixAsOrtho2D(-bs.radius(),bs.radius(),-bs.radius(),bs.radius());
-
-  camera->setViewMatrix(viewMatrix);
+  setOrthoViewBound(camera,subgraph->getBound());
   // set clear the color and depth buffer
   camera->setClearColor(clearColour);
   camera->setClearMask(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
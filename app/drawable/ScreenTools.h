@@ -371,6 +371,7 @@ protected:
 
 
 osg::Camera* createOrthoView(osg::Node* subgraph, const osg::Vec4& clearColour, WorldWindManipulatorNew *om,int screen_width,int screen_height,int hud_width,int hud_height,int hud_margin);
+void updateOrthoView(osg::Camera *quad_cam,osg::Node* subgraph);
 osg::Group* createRTTQuad(osg::Texture *texture);
 double computePixelSizeAtDistance(double distance, double fieldOfView, double viewportWidth);
 osg::Node *createScaleBar(osgText::Text *textNode,WorldWindManipulatorNew *om,osg::Camera *cam);
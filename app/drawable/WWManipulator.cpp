@@ -373,6 +373,46 @@ bool WorldWindManipulatorNew::handle(const GUIEventAdapter& ea,GUIActionAdapter&
 }
 
 
+unsigned int WorldWindManipulatorNew::getLookAheadViewMatrices(osg::Matrixd *matrices, unsigned int maxCount, double seconds){
+    if(_loaded_mat || !maxCount)
+        return 0;
+
+    bool animating = _isAnimating && !_isPaused && _animationPath.valid();
+    if(!animating && isDoneMoving())
+        return 0;
+
+    // SlerpToTargetOrientation() closes a fixed fraction of the gap every frame, so the remaining gap decays geometrically
+    double dt = _dt > 0.0 ? _dt : 1.0/60.0;
+    double step = osg::clampBetween(cameraSlerpPercentage*dt*1000.0, 0.0, 1.0);
+
+    for(unsigned int i=0; i < maxCount; i++){
+        double t = seconds*(i+1)/maxCount;
+        osg::Vec3d center;
+        osg::Quat orientation;
+        double distance,tilt;
+
+        if(animating){
+            MyAnimationPath::ControlPoint cp;
+            _animationPath->getInterpolatedControlPoint((_lastFrame+t+_timeOffset)*_timeScale, cp);
+            center=cp.getCenter();
+            orientation=cp.getOrientation();
+            distance=cp.getDistance();
+            tilt=cp.getTilt();
+        }else{
+            double percent = 1.0 - pow(1.0-step, t/dt);
+            orientation.slerp(percent,m_Orientation, _targetOrientation);
+            tilt = _tilt + (_targetTilt - _tilt)*percent;
+            distance = _distance + (_targetDistance - _distance)*percent;
+            center = _center + ( _targetCenter -_center)*percent;
+        }
+
+        osg::Matrixd invMatrix=osg::Matrixd::translate(0.0,0.0,distance)* osg::Matrixd::rotate(osg::Quat(osg::DegreesToRadians(tilt),osg::Vec3d(1,0,0)))*
+                               osg::Matrixd::rotate(orientation)*osg::Matrixd::translate(center);
+        matrices[i].invert(invMatrix);
+    }
+    return maxCount;
+}
+
 void WorldWindManipulatorNew::SlerpToTargetOrientation(double percent){
 
 
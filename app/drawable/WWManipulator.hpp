@@ -127,6 +127,11 @@ public:
     double getTargetDistance() { return _targetDistance; }
     bool isDoneMoving();
 
+    /** Predict where the camera will be over the next seconds, from the playing animation path or
+        the slerp towards the target pose. Fills up to maxCount view matrices evenly spaced in time
+        and returns how many were written, 0 if the camera is expected to stay where it is. */
+    unsigned int getLookAheadViewMatrices(osg::Matrixd *matrices, unsigned int maxCount, double seconds);
+
     osg::Vec3d getTargetCenter() { return  _targetCenter; }
     bool notMoving(void);
     /** Get the distance of the trackball. */
@@ -27,6 +27,10 @@
 //#include "SimulationState.h"
 #include <osg/Vec2>
 #include <osg/ref_ptr>
+#include <osg/Geometry>
+#include <osg/TriangleIndexFunctor>
+#include <osg/PagedLOD>
+#include <osgDB/Registry>
 #include <QDesktopServices>
 #include "BQTDebug.h"
 #include <QApplication>
@@ -112,34 +116,22 @@ void clearVTState(void){
   printf("Shutting down libvt\n");
   vtShutdown();
         
-  c.tileDir = "";
   c.pageDimension=0;
         
-  c.tileDir="";
   c.pageCodec="";
         
   c.pageBorder=0; 
-  c.mipChainLength=0;
         
   // derived values:
-  c.pageMemsize=c.maxCachedPages=c.physTexDimensionPages=c.virtTexDimensionPages=c.residentPages=0;
+  c.pageMemsize=c.maxCachedPages=c.physTexDimensionPages=c.residentPages=0;
+  c.physTexLayers=0;
   c.pageDataFormat=c.pageDataType=c.pageDXTCompression=0;
-  long int sizeofzero= ((long int)&(vt.fovInDegrees)-(long int)&(vt.mipTranslation));
-  bzero(&vt,sizeofzero);
+  long int sizeofzero= ((long int)&(vt.fovInDegrees)-(long int)&(vt.storeCount));
+  bzero(&vt.storeCount,sizeofzero); // the stores are reset by vtShutdown()
   vt.neededPages.clear();
   std::queue<uint32_t> empty;
   std::swap(             vt.newPages, empty );
-  map<uint32_t, void *>::iterator cachedIter;
-        
-            
-  for(cachedIter = vt.cachedPages.begin(); cachedIter != vt.cachedPages.end(); ++cachedIter)
-    {
-      free(cachedIter->second);
-    }
-                
-
-  vt.cachedPages.clear();
-  vt.cachedPagesAccessTimes.clear();
+  vtcClearCache();
   vt.memValid=false;
 
 }
@@ -156,9 +148,13 @@ namespace ews {
             {
                 //    QObject::connect(this, SIGNAL(dataChanged()), this, SLOT(generatePotential()));
                 _mapCam=NULL;
+                pre_camera=NULL;
                 progress = new QProgressDialog();
                 progress->setWindowModality(Qt::WindowModal);
                 progress->setCancelButtonText(0);
+                QObject::connect(&progress_timer, SIGNAL(timeout()), this, SLOT(updateLoadProgress()));
+                meshes_loaded=meshes_total=0;
+                meshes_fraction=0.0;
                 shared_uniforms.resize(NUM_UNI_ENUM);
                 shared_uniforms[UNI_SHADER_OUT]= new osg::Uniform("shaderOut",0);
                 shared_uniforms[UNI_COLORMAP_SIZE]=new osg::Uniform("colormapSize",0);
@@ -247,6 +243,71 @@ namespace ews {
                 }
             };
 
+            class VTStatsHandler : public osgViewer::StatsHandler // the usual stats pages plus LibVT's paging statistics on the viewer page
+            {
+            public:
+                VTStatsHandler()
+                {
+                    const osg::Vec4 textColor(0.9f, 0.6f, 0.2f, 1.0f), barColor(0.9f, 0.6f, 0.2f, 0.5f);
+
+                    memset(&_last, 0, sizeof(_last));
+
+                    addUserStatsLine("VT needed pages: ", textColor, barColor, "VT needed pages", 1.0, false, false, "", "", 0.0);
+                    addUserStatsLine("VT new pages: ", textColor, barColor, "VT new pages", 1.0, true, false, "", "", 0.0);
+                    addUserStatsLine("VT disk queue: ", textColor, barColor, "VT disk queue", 1.0, false, false, "", "", 0.0);
+                    addUserStatsLine("VT decode queue: ", textColor, barColor, "VT decode queue", 1.0, false, false, "", "", 0.0);
+                    addUserStatsLine("VT map queue: ", textColor, barColor, "VT map queue", 1.0, false, false, "", "", 0.0);
+                    addUserStatsLine("VT cache MB: ", textColor, barColor, "VT cache MB", 1.0, false, false, "", "", 0.0);
+                    addUserStatsLine("VT compressed cache MB: ", textColor, barColor, "VT compressed cache MB", 1.0, false, false, "", "", 0.0);
+                    addUserStatsLine("VT evictions: ", textColor, barColor, "VT evictions", 1.0, true, false, "", "", 0.0);
+                    addUserStatsLine("VT compressed hits: ", textColor, barColor, "VT compressed hits", 1.0, true, false, "", "", 0.0);
+                    addUserStatsLine("VT disk KB read: ", textColor, barColor, "VT disk KB read", 1.0, true, false, "", "", 0.0);
+                    addUserStatsLine("VT decode ms: ", textColor, barColor, "VT decode ms", 1.0, true, false, "", "", 0.0);
+                    addUserStatsLine("VT upload ms: ", textColor, barColor, "VT upload ms", 1.0, true, false, "", "", 0.0);
+                    addUserStatsLine("VT bias: ", textColor, barColor, "VT bias", 1.0, false, false, "", "", 0.0);
+                }
+
+                bool handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa)
+                {
+                    osgViewer::View* view = dynamic_cast<osgViewer::View*>(&aa);
+
+                    if (ea.getEventType() == osgGA::GUIEventAdapter::FRAME && view && view->getViewerBase()->getViewerStats())
+                        record(view->getViewerBase());
+
+                    return osgViewer::StatsHandler::handle(ea, aa);
+                }
+
+            private:
+                void record(osgViewer::ViewerBase* viewer)
+                {
+                    osg::Stats* stats = viewer->getViewerStats();
+                    const unsigned int frame = viewer->getViewerFrameStamp()->getFrameNumber();
+                    vtStats s;
+
+                    vtGetStats(&s);
+                    if (s.pagesRead < _last.pagesRead || s.cacheEvictions < _last.cacheEvictions) // vtInit() was called again
+                        memset(&_last, 0, sizeof(_last));
+
+                    stats->setAttribute(frame, "VT needed pages", s.necessaryPageCount);
+                    stats->setAttribute(frame, "VT new pages", s.newPageCount);
+                    stats->setAttribute(frame, "VT disk queue", s.neededQueueDepth);
+                    stats->setAttribute(frame, "VT decode queue", s.compressedQueueDepth);
+                    stats->setAttribute(frame, "VT map queue", s.newQueueDepth);
+                    stats->setAttribute(frame, "VT cache MB", s.cachedBytes / (1024.0 * 1024.0));
+                    stats->setAttribute(frame, "VT compressed cache MB", s.compressedCachedBytes / (1024.0 * 1024.0));
+                    stats->setAttribute(frame, "VT evictions", (double) (s.cacheEvictions - _last.cacheEvictions));
+                    stats->setAttribute(frame, "VT compressed hits", (double) (s.compressedCacheHits - _last.compressedCacheHits));
+                    stats->setAttribute(frame, "VT disk KB read", (s.diskBytesRead - _last.diskBytesRead) / 1024.0);
+                    stats->setAttribute(frame, "VT decode ms", (s.decompressionSeconds - _last.decompressionSeconds) * 1000.0);
+                    stats->setAttribute(frame, "VT upload ms", s.uploadSeconds * 1000.0);
+                    stats->setAttribute(frame, "VT bias", s.bias);
+
+                    _last = s;
+                }
+
+                vtStats _last;
+            };
+
             class VTWindowResizeHandler : public osgViewer::WindowSizeHandler
             {
             public:
@@ -288,6 +349,76 @@ namespace ews {
 
 
 
+            // keeps "mip_bias" in step with the dynamic LoD adjustment done by vtMapNewPages()
+            struct MipBiasCallback : public osg::Uniform::Callback
+            {
+                virtual void operator () (osg::Uniform* uniform, osg::NodeVisitor*)
+                {
+                    uniform->set(vtGetBias());
+                }
+            };
+
+            // every model has its own tile store, its page table has to be bound before it is drawn in either pass
+            struct BindStoreDrawCallback : public osg::Drawable::DrawCallback
+            {
+                BindStoreDrawCallback(uint8_t store) : _store(store) {}
+
+                virtual void drawImplementation(osg::RenderInfo& renderInfo, const osg::Drawable* drawable) const
+                {
+                    vtBindStore(_store);
+                    renderInfo.getState()->setActiveTextureUnit(0); // vtBindStore() leaves unit 0 active
+                    drawable->drawImplementation(renderInfo);
+                }
+
+                uint8_t _store;
+            };
+
+            // the tiles of a paged model are bound as the DatabasePager reads them, after the reading set up by MeshGeom
+            struct BindStoreReadFileCallback : public osgDB::ReadFileCallback
+            {
+                BindStoreReadFileCallback(uint8_t store, osgDB::ReadFileCallback *next) : _store(store), _next(next) {}
+
+                virtual osgDB::ReaderWriter::ReadResult readNode(const std::string& filename, const osgDB::Options* options);
+
+                uint8_t _store;
+                osg::ref_ptr<osgDB::ReadFileCallback> _next;
+            };
+
+            class BindStoreVisitor : public osg::NodeVisitor
+            {
+            public:
+                BindStoreVisitor(uint8_t store) : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), _store(store) {}
+
+                virtual void apply(osg::Geode& geode)
+                {
+                    for (unsigned int i = 0; i < geode.getNumDrawables(); i++)
+                        geode.getDrawable(i)->setDrawCallback(new BindStoreDrawCallback(_store));
+                    traverse(geode);
+                }
+
+                virtual void apply(osg::PagedLOD& plod)
+                {
+                    osgDB::Options *previous = dynamic_cast<osgDB::Options *>(plod.getDatabaseOptions());
+                    osgDB::Options *options = previous ? previous->cloneOptions() : new osgDB::Options;
+                    options->setReadFileCallback(new BindStoreReadFileCallback(_store, previous ? previous->getReadFileCallback() : NULL));
+                    plod.setDatabaseOptions(options);
+                    traverse(plod);
+                }
+
+                uint8_t _store;
+            };
+
+            osgDB::ReaderWriter::ReadResult BindStoreReadFileCallback::readNode(const std::string& filename, const osgDB::Options* options)
+            {
+                osgDB::ReaderWriter::ReadResult result = _next.valid() ? _next->readNode(filename, options) : osgDB::ReadFileCallback::readNode(filename, options);
+                if (result.validNode()) // still on the pager thread, the tile isn't in the scene yet
+                {
+                    BindStoreVisitor bindStore(_store);
+                    result.getNode()->accept(bindStore);
+                }
+                return result;
+            }
+
             struct PreDrawCallback : public osg::Camera::DrawCallback
             {
                 virtual void operator () (const osg::Camera&) const
@@ -296,20 +427,88 @@ namespace ews {
                 }
             };
 
+            // flattens the textured triangles of the model into world space for vtSetPrefetchGeometry()
+            struct PrefetchTriangle
+            {
+                void operator() (unsigned int i1, unsigned int i2, unsigned int i3)
+                {
+                    indices->push_back(base + i1);
+                    indices->push_back(base + i2);
+                    indices->push_back(base + i3);
+                }
+
+                std::vector<uint32_t> *indices;
+                uint32_t base;
+            };
+
+            class PrefetchGeometryVisitor : public osg::NodeVisitor
+            {
+            public:
+                PrefetchGeometryVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+                virtual void apply(osg::Geode& geode)
+                {
+                    osg::Matrixd toWorld = osg::computeLocalToWorld(getNodePath());
+
+                    for (unsigned int i = 0; i < geode.getNumDrawables(); i++)
+                    {
+                        osg::Geometry *geom = geode.getDrawable(i)->asGeometry();
+                        if (!geom)
+                            continue;
+                        osg::Vec3Array *verts = dynamic_cast<osg::Vec3Array *>(geom->getVertexArray());
+                        osg::Vec2Array *coords = dynamic_cast<osg::Vec2Array *>(geom->getTexCoordArray(0));
+                        if (!verts || !coords || coords->size() != verts->size())
+                            continue;
+
+                        osg::TriangleIndexFunctor<PrefetchTriangle> triangles;
+                        triangles.indices = &indices;
+                        triangles.base = (uint32_t) (positions.size() / 3);
+                        geom->accept(triangles);
+
+                        for (unsigned int v = 0; v < verts->size(); v++)
+                        {
+                            osg::Vec3 world = (*verts)[v] * toWorld;
+                            positions.push_back(world.x());
+                            positions.push_back(world.y());
+                            positions.push_back(world.z());
+                            texcoords.push_back((*coords)[v].x());
+                            texcoords.push_back((*coords)[v].y());
+                        }
+                    }
+                    traverse(geode);
+                }
+
+                std::vector<float> positions, texcoords;
+                std::vector<uint32_t> indices;
+            };
+
             struct PostDrawCallback : public osg::Camera::DrawCallback
             {
-                PostDrawCallback(osg::Image* image): _image(image)
+                PostDrawCallback(osg::Image* image, WorldWindManipulatorNew *manip): _image(image), _manip(manip)
                 {
                 }
 
-                virtual void operator () (const osg::Camera&) const
+                virtual void operator () (const osg::Camera& camera) const
                 {
                     if (_image && _image->getPixelFormat()==GL_BGRA && _image->getDataType()==GL_UNSIGNED_INT_8_8_8_8_REV)
                     {
                         //std::string filename = std::string("/Users/julian/Desktop/test.rgb");
                         //osgDB::writeImageFile(*_image, filename);
 
+                        osg::Matrixd view = camera.getViewMatrix(), projection = camera.getProjectionMatrix();
+                        vtSetCameraPose(view.ptr(), projection.ptr()); // only recorded while capturing for vt_replay
                         vtExtractNeededPages((const uint32_t *) _image->data());
+
+                        // warm the cache with the pages the camera is heading for over the next second
+                        osg::Matrixd lookAhead[3];
+                        double views[3 * 16], projections[3 * 16];
+                        unsigned int poses = _manip ? _manip->getLookAheadViewMatrices(lookAhead, 3, 1.0) : 0;
+                        for (unsigned int i = 0; i < poses; i++)
+                        {
+                            memcpy(views + i * 16, lookAhead[i].ptr(), 16 * sizeof(double));
+                            memcpy(projections + i * 16, projection.ptr(), 16 * sizeof(double));
+                        }
+                        vtPrefetch(views, projections, poses);
                     }
                     else
                     {
@@ -321,7 +520,7 @@ namespace ews {
                 osg::Image* _image;
             };
 
-            osg::Group* MeshFile::loadVTModel(osg::Node *vtgeode,osg::Camera *&pre_camera,
+            osg::Group* MeshFile::loadVTModel(osg::Node *vtgeode,uint8_t store,osg::Camera *&pre_camera,
                                               osg::TextureRectangle *&texture,osg::Image *&image)
 
             {
@@ -337,28 +536,38 @@ namespace ews {
 #else
 _pix_ratio=1.0;
 #endif
-                texture = new osg::TextureRectangle;
-                texture->setTextureSize(_renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT, _renderer->height() >> PREPASS_RESOLUTION_REDUCTION_SHIFT);
-                texture->setInternalFormat(GL_BGRA);
-                texture->setFilter(osg::Texture2D::MIN_FILTER, osg::Texture2D::LINEAR);
-                texture->setFilter(osg::Texture2D::MAG_FILTER, osg::Texture2D::LINEAR);
-
-                pre_camera = new osg::Camera;
-                pre_camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                pre_camera->setClearColor(osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f));
-                pre_camera->setViewport(0, 0, _renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT,_renderer->width()>> PREPASS_RESOLUTION_REDUCTION_SHIFT); // TODO: fix the hardcoding
-                pre_camera->setRenderOrder(osg::Camera::PRE_RENDER);
-                pre_camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+                // one prepass renders all tile stores, the models of later stores are added to it
+                if (!pre_camera)
+                {
+                    texture = new osg::TextureRectangle;
+                    texture->setTextureSize(_renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT, _renderer->height() >> PREPASS_RESOLUTION_REDUCTION_SHIFT);
+                    texture->setInternalFormat(GL_BGRA);
+                    texture->setFilter(osg::Texture2D::MIN_FILTER, osg::Texture2D::LINEAR);
+                    texture->setFilter(osg::Texture2D::MAG_FILTER, osg::Texture2D::LINEAR);
+
+                    pre_camera = new osg::Camera;
+                    pre_camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    pre_camera->setClearColor(osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+                    pre_camera->setViewport(0, 0, _renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT,_renderer->width()>> PREPASS_RESOLUTION_REDUCTION_SHIFT); // TODO: fix the hardcoding
+                    pre_camera->setRenderOrder(osg::Camera::PRE_RENDER);
+                    pre_camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+
+                    image = new osg::Image;
+                    image->allocateImage(_renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT, _renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT, 1, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV);
+                    image->setInternalTextureFormat(GL_RGBA);
+                    pre_camera->attach(osg::Camera::COLOR_BUFFER, image, 0, 0);
+                    pre_camera->setPostDrawCallback(new PostDrawCallback(image, _renderer->getWWManip()));
+                    texture->setImage(0, image);
+                    group->addChild(pre_camera);
+                }
 
-                image = new osg::Image;
-                image->allocateImage(_renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT, _renderer->width() >> PREPASS_RESOLUTION_REDUCTION_SHIFT, 1, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV);
-                image->setInternalTextureFormat(GL_RGBA);
-                pre_camera->attach(osg::Camera::COLOR_BUFFER, image, 0, 0);
-                pre_camera->setPostDrawCallback(new PostDrawCallback(image));
-                texture->setImage(0, image);
 
+                char *prelude = vtGetShaderPrelude(store);
 
-                char *prelude = vtGetShaderPrelude();
+                // shared by both passes, updated every frame
+                osg::Uniform* mipBias = new osg::Uniform("mip_bias", vtGetBias());
+                mipBias->setDataVariance(osg::Object::DYNAMIC);
+                mipBias->setUpdateCallback(new MipBiasCallback);
 
                 // setup the shaders used for virtual textured objects prepass
                 osg::StateSet* vtpreState = vtgroup_prerender->getOrCreateStateSet();
@@ -369,7 +578,7 @@ _pix_ratio=1.0;
                 vtpreProgramObject->addShader( vtpreVertexObject );
                 vtpreState->addUniform( new osg::Uniform("pageTableTexture", TEXUNIT_FOR_PAGETABLE) );
                 vtpreState->addUniform( new osg::Uniform("mipcalcTexture", TEXUNIT_FOR_MIPCALC) );
-                vtpreState->addUniform( new osg::Uniform("mip_bias", vtGetBias()) ); // this shold be done every frame if we want dynamic LoD adjustment
+                vtpreState->addUniform( mipBias );
 
 
                 loadShaderSourceFromStr(vtpreVertexObject, readback_vert, string(prelude));
@@ -386,7 +595,7 @@ _pix_ratio=1.0;
                 vtmainProgramObject->addShader( vtmainVertexObject );
                 vtmainState->addUniform( new osg::Uniform("pageTableTexture", TEXUNIT_FOR_PAGETABLE) ); // TODO: we gotta make sure OSG NEVER USES THESE TEXUNITS!!
                 vtmainState->addUniform( new osg::Uniform("physicalTexture", TEXUNIT_FOR_PHYSTEX) );
-                vtmainState->addUniform( new osg::Uniform("mip_bias", vtGetBias()) );
+                vtmainState->addUniform( mipBias );
 
                 int stateMask = 0;
 
@@ -409,12 +618,19 @@ _pix_ratio=1.0;
 
 
 
+                PrefetchGeometryVisitor prefetchGeometry;
+                vtgeode->accept(prefetchGeometry);
+                if (!prefetchGeometry.indices.empty())
+                    vtSetPrefetchGeometry(store, &prefetchGeometry.positions[0], &prefetchGeometry.texcoords[0], &prefetchGeometry.indices[0], (uint32_t) (prefetchGeometry.indices.size() / 3));
+
+                BindStoreVisitor bindStore(store);
+                vtgeode->accept(bindStore);
+
                 vtgroup_prerender->addChild(vtgeode);
                 vtgroup_mainpass->addChild(vtgeode);
 
                 pre_camera->addChild(vtgroup_prerender);
 
-                group->addChild(pre_camera);
                 group->addChild(vtgroup_mainpass);
                     //group->addChild(nonvtgeode);
 
@@ -439,13 +655,27 @@ _pix_ratio=1.0;
                         GLint textureSize = osg::Texture2D::getExtensions(0,true)->maxTextureSize();
 #endif
                         printf("Physical texture size %dx%d\n",textureSize,textureSize);
-			if (c.tileDir != "")
-			  clearVTState();
+			if (vt.memValid) // another model of the same load, it shares the physical texture and the prepass with the first
+			{
+			  const int8_t store = vtAddStore(tex_name.c_str(), ext, border, length, dim);
+			  if (store < 0){
+			    fprintf(stderr,"Failed to add tile store %s border: %d length: %d dim: %d\n",tex_name.c_str(),border,length,dim);
+			    return NULL;
+			  }
+			  return loadVTModel(node,(uint8_t) store,pre_camera,texture,image);
+			}
+			if (getenv("BQT_VT_PAGE_CACHE")) // keep decoded pages on disk across sessions
+			  vtSetPageCacheDirectory(getenv("BQT_VT_PAGE_CACHE"));
 			if(!vtInit(tex_name.c_str(), ext, border, length, dim,textureSize)){
 			  fprintf(stderr,"Failed to load vtInit  border: %d length: %d dim: %d textureSize: %d \n",border,length,dim,textureSize);
 			  return NULL;
 			}
-			retNode= loadVTModel(node,pre_camera,texture,image);
+			pre_camera=NULL;
+			retNode= loadVTModel(node,0,pre_camera,texture,image);
+			if (getenv("BQT_VT_CAPTURE")) // record the feedback for offline benchmarking with vt_replay
+			  vtStartCapture(getenv("BQT_VT_CAPTURE"));
+			if (getenv("BQT_VT_TRACE")) // per frame paging statistics as CSV
+			  vtStartStatsTrace(getenv("BQT_VT_TRACE"));
                     }
                              else{
                                  fprintf(stderr,"can't open %s\n",tex_name.c_str());
@@ -454,7 +684,7 @@ _pix_ratio=1.0;
 
 
                 _renderer->addEventHandler(new VTWindowResizeHandler(_pix_ratio));
-                         _renderer->addEventHandler(new osgViewer::StatsHandler());
+                         _renderer->addEventHandler(new VTStatsHandler());
 
                   _renderer->addEventHandler(new VTExitHandler());
                         _renderer->getCamera()->setPreDrawCallback(new PreDrawCallback());
@@ -468,6 +698,67 @@ _pix_ratio=1.0;
                 return NULL;
             }
 
+            void MeshFile::clearVTStuff(){
+                stopLoadProgress();
+                clearVTState();
+                pre_camera=NULL;
+            }
+
+            void MeshFile::setMeshLoadProgress(int loaded,int total,double fraction){
+                meshes_loaded=loaded;
+                meshes_total=total;
+                meshes_fraction=fraction;
+            }
+
+            // the meshes are parsed and the coarse mip levels precached in the background, the dialog shows both without blocking the window
+            void MeshFile::showLoadProgress(){
+                if(!updateLoadProgressDialog()){
+                    progress->close();
+                    return;
+                }
+                progress->hide();
+                progress->setWindowModality(Qt::NonModal);
+                progress->show();
+                progress_timer.start(100);
+            }
+
+            void MeshFile::updateLoadProgress(){
+                if(!updateLoadProgressDialog()){
+                    stopLoadProgress();
+                    progress->close();
+                }
+            }
+
+            // false once everything is loaded
+            bool MeshFile::updateLoadProgressDialog(){
+                if(meshes_loaded < meshes_total){
+                    progress->setLabelText(QString("Loading meshes (%1 of %2 done)").arg(meshes_loaded).arg(meshes_total));
+                    progress->setRange(0,1000);
+                    progress->setValue(int(meshes_fraction*1000));
+                    return true;
+                }
+                uint32_t done=0, total=0;
+                if(vt.memValid)
+                    vtGetWarmupProgress(&done, &total);
+                if(done >= total)
+                    return false;
+                progress->setLabelText("Loading coarse texture levels");
+                progress->setRange(0,total);
+                progress->setValue(done);
+                return true;
+            }
+
+            void MeshFile::stopLoadProgress(){
+                if(!progress_timer.isActive())
+                    return;
+                progress_timer.stop();
+                bool visible=progress->isVisible();
+                progress->hide();
+                progress->setWindowModality(Qt::WindowModal);
+                if(visible)
+                    progress->show();
+            }
+
             MeshFile::~MeshFile() {
                 clearVTState();
             }
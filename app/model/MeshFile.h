@@ -151,6 +151,10 @@ namespace ews {
                 static const int hud_margin=20;
                 float _pix_ratio;
                 osg::Node * createVTStuff(osg::Node *node,std::string tex_name);
+                void clearVTStuff();
+                void showLoadProgress();
+                /** Called by the mesh loader on the GUI thread, fraction is the parsed part of all files. */
+                void setMeshLoadProgress(int loaded,int total,double fraction);
 
                 /**
                  * Default constructor.
@@ -323,6 +327,7 @@ namespace ews {
 
             private slots:
               //  void generatePotential();
+                void updateLoadProgress();
                 
             private:
                 Q_DISABLE_COPY(MeshFile)
@@ -331,13 +336,18 @@ namespace ews {
                 QStringList filenames;
                 RTree *_tree;
                 QProgressDialog *progress;
+                QTimer progress_timer;
+                int meshes_loaded, meshes_total;
+                double meshes_fraction;
+                bool updateLoadProgressDialog();
+                void stopLoadProgress();
                 std::vector<osg::Uniform*> shared_uniforms;
                 double latOrigin, longOrigin;
                  std::vector<string>  shader_names;
                  QStringList  *colormap_names;
                  std::vector<string>  dataused_names;
                  osg::ref_ptr<osg::Texture2D> shared_tex;
-                 osg::Group* loadVTModel(osg::Node *vtgeode,osg::Camera *&pre_camera
+                 osg::Group* loadVTModel(osg::Node *vtgeode,uint8_t store,osg::Camera *&pre_camera
                                                                                               ,osg::TextureRectangle *&texture,osg::Image *&image);
 
                  osg::ref_ptr<osg::Image> dataImage;
@@ -346,7 +346,7 @@ namespace ews {
                 _ui->renderer->paintGL();
                 qApp->processEvents();
                 //Redo rendering delay
-                _state->getMeshFiles().getPBarD()->close();
+                _state->getMeshFiles().showLoadProgress(); // closes the dialog once the meshes and the coarse texture levels are loaded
                 _ui->barrierEditor->updateOverlayWidget();
                   _ui->barrierEditor->updateDataUsedWidget(0);
                 QApplication::restoreOverrideCursor();
@@ -0,0 +1,622 @@
+/* Copyright (C) 2012 Matthew Johnson-Roberson
+ * See COPYING for license details
+ */
+
+// Splits a mesh into a quadtree of PagedLOD tiles so the viewer only keeps the
+// part of the survey it needs for the current view in memory.
+//
+// Every tile holds at most -t triangles. Leaves are the original
+// triangles, the inner tiles are simplified from the four tiles below them. An
+// inner tile is replaced by its children once it covers more pixels than its
+// simplified triangles allow for the -e screen space error.
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/CoordinateSystemNode>
+#include <osg/MatrixTransform>
+#include <osg/PagedLOD>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/TriangleIndexFunctor>
+#include <osg/Texture>
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <osgUtil/Optimizer>
+#include <osgUtil/Simplifier>
+#include <osgUtil/MeshOptimizers>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+#include "FindNode.h"
+
+// one per vertex array of a geometry
+struct Slot
+{
+    enum Kind { VERTEX, NORMAL, COLOR, TEXCOORD, ATTRIB } kind;
+    unsigned int unit;
+
+    bool operator < (const Slot &other) const { return kind != other.kind ? kind < other.kind : unit < other.unit; }
+};
+
+// the triangles of the model with the same state and vertex layout, unindexed so they can be split freely
+struct Soup
+{
+    osg::ref_ptr<osg::StateSet> stateSet;
+    std::vector<Slot> slots;
+    std::vector<osg::ref_ptr<osg::Array> > arrays;
+
+    unsigned int triangleCount() const { return arrays[0]->getNumElements() / 3; }
+};
+
+// a triangle of a soup
+struct TriangleRef
+{
+    uint32_t soup, triangle;
+};
+
+struct TileOptions
+{
+    unsigned int maxTriangles, maxDepth;
+    float refinePixels;
+    std::string tileDirectory, extension;
+    osg::ref_ptr<osgDB::Options> writeOptions;
+    unsigned int tilesWritten;
+};
+
+static void appendElement(osg::Array *dst, const osg::Array *src, unsigned int index)
+{
+    const unsigned int size = dst->getElementSize(), count = dst->getNumElements();
+
+    dst->resizeArray(count + 1);
+    memcpy((char *) dst->getDataPointer() + count * size, (const char *) src->getDataPointer() + index * size, size);
+}
+
+struct CollectTriangle
+{
+    void operator() (unsigned int i1, unsigned int i2, unsigned int i3)
+    {
+        const unsigned int indices[3] = {i1, i2, i3};
+
+        for (unsigned int a = 0; a < soup->arrays.size(); a++)
+            for (unsigned int v = 0; v < 3; v++)
+                appendElement(soup->arrays[a].get(), (*sources)[a], indices[v]);
+    }
+
+    Soup *soup;
+    const std::vector<const osg::Array *> *sources;
+};
+
+struct CountTriangle
+{
+    CountTriangle() : count(0) {}
+    void operator() (unsigned int, unsigned int, unsigned int) { count++; }
+
+    unsigned int count;
+};
+
+// flattens the triangles below the node it is applied to into soups, in the coordinates of that node
+class CollectSoupsVisitor : public osg::NodeVisitor
+{
+public:
+    CollectSoupsVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), dropped(0) {}
+
+    virtual void apply(osg::Geode &geode)
+    {
+        const osg::Matrixd toRoot = osg::computeLocalToWorld(getNodePath());
+        const osg::Matrixd normalMatrix = osg::Matrixd::inverse(toRoot);
+
+        for (unsigned int i = 0; i < geode.getNumDrawables(); i++)
+        {
+            osg::Geometry *geom = geode.getDrawable(i)->asGeometry();
+            if (!geom || !dynamic_cast<osg::Vec3Array *>(geom->getVertexArray()))
+            {
+                dropped++;
+                continue;
+            }
+
+            const unsigned int vertexCount = geom->getVertexArray()->getNumElements();
+            std::vector<Slot> slots;
+            std::vector<const osg::Array *> sources;
+            addSlot(slots, sources, Slot::VERTEX, 0, geom->getVertexArray(), vertexCount);
+            if (geom->getNormalBinding() == osg::Geometry::BIND_PER_VERTEX)
+                addSlot(slots, sources, Slot::NORMAL, 0, geom->getNormalArray(), vertexCount);
+            if (geom->getColorBinding() == osg::Geometry::BIND_PER_VERTEX)
+                addSlot(slots, sources, Slot::COLOR, 0, geom->getColorArray(), vertexCount);
+            for (unsigned int unit = 0; unit < geom->getNumTexCoordArrays(); unit++)
+                addSlot(slots, sources, Slot::TEXCOORD, unit, geom->getTexCoordArray(unit), vertexCount);
+            for (unsigned int index = 0; index < geom->getNumVertexAttribArrays(); index++)
+                if (geom->getVertexAttribBinding(index) == osg::Geometry::BIND_PER_VERTEX)
+                    addSlot(slots, sources, Slot::ATTRIB, index, geom->getVertexAttribArray(index), vertexCount);
+
+            osg::StateSet *stateSet = geom->getStateSet() ? geom->getStateSet() : geode.getStateSet();
+            Soup &soup = soupFor(stateSet, slots, sources);
+            const unsigned int first = soup.arrays[0]->getNumElements();
+
+            osg::TriangleIndexFunctor<CollectTriangle> triangles;
+            triangles.soup = &soup;
+            triangles.sources = &sources;
+            geom->accept(triangles);
+
+            // into the coordinates of the tiles
+            osg::Vec3Array *verts = static_cast<osg::Vec3Array *>(soup.arrays[0].get());
+            for (unsigned int v = first; v < verts->size(); v++)
+                (*verts)[v] = (*verts)[v] * toRoot;
+            if (soup.slots.size() > 1 && soup.slots[1].kind == Slot::NORMAL)
+                if (osg::Vec3Array *normals = dynamic_cast<osg::Vec3Array *>(soup.arrays[1].get()))
+                    for (unsigned int v = first; v < normals->size(); v++)
+                    {
+                        (*normals)[v] = osg::Matrixd::transform3x3(normalMatrix, (*normals)[v]);
+                        (*normals)[v].normalize();
+                    }
+        }
+
+        // the source geometry isn't needed any more, unless the geode is instanced elsewhere
+        if (geode.getNumParents() <= 1)
+            geode.removeDrawables(0, geode.getNumDrawables());
+        traverse(geode);
+    }
+
+    std::vector<Soup> soups;
+    unsigned int dropped;
+
+private:
+    static void addSlot(std::vector<Slot> &slots, std::vector<const osg::Array *> &sources, Slot::Kind kind, unsigned int unit, const osg::Array *array, unsigned int vertexCount)
+    {
+        if (!array || array->getNumElements() != vertexCount)
+            return;
+
+        Slot slot = {kind, unit};
+        slots.push_back(slot);
+        sources.push_back(array);
+    }
+
+    Soup &soupFor(osg::StateSet *stateSet, const std::vector<Slot> &slots, const std::vector<const osg::Array *> &sources)
+    {
+        for (unsigned int i = 0; i < soups.size(); i++)
+            if (soups[i].stateSet == stateSet && soups[i].slots.size() == slots.size() && std::equal(slots.begin(), slots.end(), soups[i].slots.begin(), sameSlot))
+            {
+                bool sameTypes = true;
+                for (unsigned int a = 0; a < sources.size(); a++)
+                    sameTypes &= soups[i].arrays[a]->getType() == sources[a]->getType();
+                if (sameTypes)
+                    return soups[i];
+            }
+
+        Soup soup;
+        soup.stateSet = stateSet;
+        soup.slots = slots;
+        for (unsigned int a = 0; a < sources.size(); a++)
+            soup.arrays.push_back((osg::Array *) sources[a]->cloneType());
+        soups.push_back(soup);
+
+        return soups.back();
+    }
+
+    static bool sameSlot(const Slot &a, const Slot &b) { return !(a < b) && !(b < a); }
+};
+
+static osg::Geometry *createGeometry(const Soup &soup)
+{
+    osg::Geometry *geom = new osg::Geometry;
+
+    for (unsigned int a = 0; a < soup.slots.size(); a++)
+    {
+        osg::Array *array = (osg::Array *) soup.arrays[a]->cloneType();
+
+        switch (soup.slots[a].kind)
+        {
+            case Slot::VERTEX:
+                geom->setVertexArray(array);
+                break;
+            case Slot::NORMAL:
+                geom->setNormalArray(array);
+                geom->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
+                break;
+            case Slot::COLOR:
+                geom->setColorArray(array);
+                geom->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
+                break;
+            case Slot::TEXCOORD:
+                geom->setTexCoordArray(soup.slots[a].unit, array);
+                break;
+            case Slot::ATTRIB:
+                geom->setVertexAttribArray(soup.slots[a].unit, array);
+                geom->setVertexAttribBinding(soup.slots[a].unit, osg::Geometry::BIND_PER_VERTEX);
+                break;
+        }
+    }
+    geom->setStateSet(soup.stateSet.get());
+
+    return geom;
+}
+
+static osg::Array *geometryArray(osg::Geometry *geom, const Slot &slot)
+{
+    switch (slot.kind)
+    {
+        case Slot::VERTEX:   return geom->getVertexArray();
+        case Slot::NORMAL:   return geom->getNormalArray();
+        case Slot::COLOR:    return geom->getColorArray();
+        case Slot::TEXCOORD: return geom->getTexCoordArray(slot.unit);
+        case Slot::ATTRIB:   return geom->getVertexAttribArray(slot.unit);
+    }
+    return NULL;
+}
+
+typedef std::vector<TriangleRef>::iterator TriangleIterator;
+
+// the full resolution triangles of a leaf, indexed again
+static osg::Geode *createLeaf(const std::vector<Soup> &soups, TriangleIterator begin, TriangleIterator end)
+{
+    std::map<uint32_t, osg::Geometry *> geoms;
+
+    for (TriangleIterator t = begin; t != end; ++t)
+    {
+        const Soup &soup = soups[t->soup];
+        osg::Geometry *&geom = geoms[t->soup];
+        if (!geom)
+            geom = createGeometry(soup);
+
+        for (unsigned int a = 0; a < soup.slots.size(); a++)
+            for (unsigned int v = 0; v < 3; v++)
+                appendElement(geometryArray(geom, soup.slots[a]), soup.arrays[a].get(), t->triangle * 3 + v);
+    }
+
+    osg::Geode *geode = new osg::Geode;
+    for (std::map<uint32_t, osg::Geometry *>::iterator it = geoms.begin(); it != geoms.end(); ++it)
+    {
+        it->second->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, it->second->getVertexArray()->getNumElements()));
+        geode->addDrawable(it->second);
+    }
+
+    osgUtil::IndexMeshVisitor indexMesh;
+    geode->accept(indexMesh);
+    indexMesh.makeMesh();
+
+    return geode;
+}
+
+static unsigned int countTriangles(osg::Geode *geode)
+{
+    osg::TriangleIndexFunctor<CountTriangle> counter;
+
+    for (unsigned int i = 0; i < geode->getNumDrawables(); i++)
+        geode->getDrawable(i)->accept(counter);
+
+    return counter.count;
+}
+
+// merges the coarsest representation of the children and simplifies it down to one tile
+static osg::Geode *createCoarse(const std::vector<osg::ref_ptr<osg::Geode> > &children, unsigned int maxTriangles)
+{
+    osg::Geode *geode = new osg::Geode;
+
+    for (unsigned int c = 0; c < children.size(); c++)
+        for (unsigned int i = 0; i < children[c]->getNumDrawables(); i++)
+            geode->addDrawable((osg::Drawable *) children[c]->getDrawable(i)->clone(osg::CopyOp::DEEP_COPY_ARRAYS | osg::CopyOp::DEEP_COPY_PRIMITIVES));
+
+    osgUtil::Optimizer::MergeGeometryVisitor merge;
+    merge.setTargetMaximumNumberOfVertices(UINT_MAX);
+    geode->accept(merge);
+
+    const unsigned int count = countTriangles(geode);
+    if (count > maxTriangles)
+    {
+        osgUtil::Simplifier simplifier((double) maxTriangles / count);
+        for (unsigned int i = 0; i < geode->getNumDrawables(); i++)
+            if (osg::Geometry *geom = geode->getDrawable(i)->asGeometry())
+                simplifier.simplify(*geom);
+    }
+
+    return geode;
+}
+
+static osg::BoundingBox triangleBounds(const std::vector<Soup> &soups, TriangleIterator begin, TriangleIterator end)
+{
+    osg::BoundingBox box;
+
+    for (TriangleIterator t = begin; t != end; ++t)
+    {
+        const osg::Vec3Array *verts = static_cast<const osg::Vec3Array *>(soups[t->soup].arrays[0].get());
+        for (unsigned int v = 0; v < 3; v++)
+            box.expandBy((*verts)[t->triangle * 3 + v]);
+    }
+
+    return box;
+}
+
+// whether the centroid of a triangle lies below the middle of a cell along one axis
+struct BelowSplit
+{
+    BelowSplit(const std::vector<Soup> &soups, int axis, float split) : _soups(soups), _axis(axis), _split(split) {}
+
+    bool operator() (const TriangleRef &t) const
+    {
+        const osg::Vec3Array *verts = static_cast<const osg::Vec3Array *>(_soups[t.soup].arrays[0].get());
+        const unsigned int first = t.triangle * 3;
+
+        return (*verts)[first][_axis] + (*verts)[first + 1][_axis] + (*verts)[first + 2][_axis] <= 3.0f * _split;
+    }
+
+    const std::vector<Soup> &_soups;
+    int _axis;
+    float _split;
+};
+
+typedef std::set<osg::Image *> ImageSet;
+
+/*
+ * Writes every texture image of the model once into the tile directory, the tile files only
+ * reference them by name. Without this every .ive tile would carry its own copy.
+ */
+static ImageSet externalizeTextures(const std::vector<Soup> &soups, const std::string &tileDirectory)
+{
+    ImageSet images;
+
+    for (unsigned int s = 0; s < soups.size(); s++)
+    {
+        osg::StateSet *stateSet = soups[s].stateSet.get();
+        if (!stateSet)
+            continue;
+
+        for (unsigned int unit = 0; unit < stateSet->getTextureAttributeList().size(); unit++)
+        {
+            osg::Texture *texture = dynamic_cast<osg::Texture *>(stateSet->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+            if (!texture)
+                continue;
+
+            for (unsigned int i = 0; i < texture->getNumImages(); i++)
+            {
+                osg::Image *image = texture->getImage(i);
+                if (!image || images.count(image))
+                    continue;
+
+                // the original file is copied if it can be found, so it isn't compressed again
+                const std::string source = image->getFileName().empty() ? std::string() : osgDB::findDataFile(image->getFileName());
+                const std::string extension = source.empty() ? std::string("png") : osgDB::getLowerCaseFileExtension(source);
+                std::ostringstream name;
+                name << "texture" << images.size() << "." << extension;
+
+                const std::string path = tileDirectory + "/" + name.str();
+                if (source.empty() ? !osgDB::writeImageFile(*image, path) : osgDB::copyFile(source, path) != osgDB::FileOpResult::OK)
+                {
+                    std::cerr << "Error: could not write texture " << path << std::endl;
+                    exit(1);
+                }
+                image->setFileName(name.str());
+                images.insert(image);
+            }
+        }
+    }
+
+    return images;
+}
+
+// the root file is outside the tile directory, its copy of the state references the textures through it
+static void referenceTexturesFromRoot(osg::Geode *geode, const ImageSet &images, const std::string &tileDirectory)
+{
+    std::map<osg::StateSet *, osg::ref_ptr<osg::StateSet> > rootStateSets;
+
+    for (unsigned int i = 0; i < geode->getNumDrawables(); i++)
+    {
+        osg::StateSet *stateSet = geode->getDrawable(i)->getStateSet();
+        if (!stateSet)
+            continue;
+
+        osg::ref_ptr<osg::StateSet> &rootStateSet = rootStateSets[stateSet];
+        if (!rootStateSet.valid())
+        {
+            rootStateSet = (osg::StateSet *) stateSet->clone(osg::CopyOp::DEEP_COPY_STATEATTRIBUTES);
+            for (unsigned int unit = 0; unit < rootStateSet->getTextureAttributeList().size(); unit++)
+                if (osg::Texture *texture = dynamic_cast<osg::Texture *>(rootStateSet->getTextureAttribute(unit, osg::StateAttribute::TEXTURE)))
+                    for (unsigned int face = 0; face < texture->getNumImages(); face++)
+                        if (images.count(texture->getImage(face)))
+                        {
+                            osg::Image *reference = new osg::Image;
+                            reference->setFileName(osgDB::getSimpleFileName(tileDirectory) + "/" + texture->getImage(face)->getFileName());
+                            texture->setImage(face, reference);
+                        }
+        }
+        geode->getDrawable(i)->setStateSet(rootStateSet.get());
+    }
+}
+
+/*
+ * Builds the tiles below a quadtree cell, its triangles are reordered in place. The children
+ * of an inner cell are written to their own file, the returned node pages them in. coarse is
+ * set to the triangles the node shows before anything below it is loaded, the parent
+ * simplifies its own from them.
+ */
+static osg::Node *buildCell(const std::vector<Soup> &soups, TriangleIterator begin, TriangleIterator end, const osg::BoundingBox &cell,
+                            const int axes[2], unsigned int depth, const std::string &name, TileOptions &options, osg::ref_ptr<osg::Geode> &coarse)
+{
+    if ((unsigned int) (end - begin) <= options.maxTriangles || depth >= options.maxDepth)
+    {
+        coarse = createLeaf(soups, begin, end);
+        return coarse.get();
+    }
+
+    // split by the centroids along the two longest axes of the model
+    const osg::Vec3 center = cell.center();
+    TriangleIterator bounds[5];
+    bounds[0] = begin;
+    bounds[4] = end;
+    bounds[2] = std::partition(begin, end, BelowSplit(soups, axes[1], center[axes[1]]));
+    bounds[1] = std::partition(bounds[0], bounds[2], BelowSplit(soups, axes[0], center[axes[0]]));
+    bounds[3] = std::partition(bounds[2], bounds[4], BelowSplit(soups, axes[0], center[axes[0]]));
+
+    osg::ref_ptr<osg::Group> children = new osg::Group;
+    std::vector<osg::ref_ptr<osg::Geode> > childCoarse;
+    for (unsigned int q = 0; q < 4; q++)
+    {
+        if (bounds[q] == bounds[q + 1])
+            continue;
+
+        osg::BoundingBox quadrant = cell;
+        (q & 1 ? quadrant._min : quadrant._max)[axes[0]] = center[axes[0]];
+        (q & 2 ? quadrant._min : quadrant._max)[axes[1]] = center[axes[1]];
+
+        osg::ref_ptr<osg::Geode> childLevel;
+        children->addChild(buildCell(soups, bounds[q], bounds[q + 1], quadrant, axes, depth + 1, name + char('0' + q), options, childLevel));
+        childCoarse.push_back(childLevel);
+    }
+
+    const std::string filename = name + "." + options.extension;
+    if (!osgDB::writeNodeFile(*children, options.tileDirectory + "/" + filename, options.writeOptions.get()))
+    {
+        std::cerr << "Error: could not write tile " << options.tileDirectory << "/" << filename << std::endl;
+        exit(1);
+    }
+    options.tilesWritten++;
+
+    coarse = createCoarse(childCoarse, options.maxTriangles);
+
+    const osg::BoundingSphere sphere(triangleBounds(soups, begin, end));
+    osg::PagedLOD *plod = new osg::PagedLOD;
+    plod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+    plod->setCenter(sphere.center());
+    plod->setRadius(sphere.radius());
+    plod->setRangeMode(osg::LOD::PIXEL_SIZE_ON_SCREEN);
+    plod->addChild(coarse.get(), 0.0f, options.refinePixels);
+    // the files of the tiles reference each other from within the tile directory, only the root file is outside
+    plod->setFileName(1, depth ? filename : osgDB::getSimpleFileName(options.tileDirectory) + "/" + filename);
+    plod->setRange(1, options.refinePixels, FLT_MAX);
+
+    return plod;
+}
+
+int main(int argc, char **argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName() +
+            " splits a mesh into a quadtree of paged level of detail tiles for viewing models larger than memory."
+            " The tiler itself holds the whole model and an unindexed copy of its triangles, about three to four"
+            " times the size of the model, so run it on a machine with enough RAM; the viewer only loads the tiles in view.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options] input output.ive");
+    arguments.getApplicationUsage()->addCommandLineOption("-t <count>", "Maximum number of triangles per tile (default 20000)");
+    arguments.getApplicationUsage()->addCommandLineOption("-e <pixels>", "Screen space error of the simplified tiles (default 3)");
+    arguments.getApplicationUsage()->addCommandLineOption("-d <levels>", "Maximum depth of the quadtree (default 16)");
+
+    unsigned int helpType = 0;
+    if ((helpType = arguments.readHelpType()))
+    {
+        arguments.getApplicationUsage()->write(std::cout, helpType);
+        return 1;
+    }
+
+    TileOptions options;
+    options.maxTriangles = 20000;
+    options.maxDepth = 16;
+    options.tilesWritten = 0;
+    float errorPixels = 3.0f;
+    while (arguments.read("-t", options.maxTriangles)) {}
+    while (arguments.read("-e", errorPixels)) {}
+    while (arguments.read("-d", options.maxDepth)) {}
+
+    arguments.reportRemainingOptionsAsUnrecognized();
+    if (arguments.errors())
+    {
+        arguments.writeErrorMessages(std::cout);
+        return 1;
+    }
+    if (arguments.argc() != 3 || options.maxTriangles < 4)
+    {
+        arguments.getApplicationUsage()->write(std::cout, osg::ApplicationUsage::COMMAND_LINE_OPTION);
+        return 1;
+    }
+
+    const std::string input = arguments[1], output = arguments[2];
+    osgDB::getDataFilePathList().push_front(osgDB::getFilePath(input)); // for the texture files of the model
+    osg::ref_ptr<osg::Node> model = osgDB::readNodeFile(input);
+    if (!model.valid())
+    {
+        std::cerr << "Error: could not open file `" << input << "'" << std::endl;
+        return 1;
+    }
+
+    // models with a coordinate system keep it and their top transform, the tiles replace what is below
+    osg::MatrixTransform *trans = NULL;
+    if (findTopMostNodeOfType<osg::CoordinateSystemNode>(model.get()))
+        trans = findTopMostNodeOfType<osg::MatrixTransform>(model.get());
+
+    CollectSoupsVisitor collect;
+    if (trans)
+    {
+        for (unsigned int i = 0; i < trans->getNumChildren(); i++)
+            trans->getChild(i)->accept(collect);
+        trans->removeChildren(0, trans->getNumChildren());
+    }
+    else
+    {
+        model->accept(collect);
+        model = NULL;
+    }
+    if (collect.dropped)
+        std::cerr << "Warning: skipped " << collect.dropped << " drawables without triangles in float vertices" << std::endl;
+
+    std::vector<TriangleRef> triangles;
+    for (uint32_t s = 0; s < collect.soups.size(); s++)
+        for (uint32_t t = 0; t < collect.soups[s].triangleCount(); t++)
+        {
+            TriangleRef ref = {s, t};
+            triangles.push_back(ref);
+        }
+    if (triangles.empty())
+    {
+        std::cerr << "Error: no triangles in `" << input << "'" << std::endl;
+        return 1;
+    }
+
+    // a tile of n triangles has about sqrt(n / 2) edges across, refine once those get longer than the error
+    options.refinePixels = errorPixels * sqrtf(options.maxTriangles / 2.0f);
+    options.extension = osgDB::getLowerCaseFileExtension(output);
+    options.tileDirectory = osgDB::getNameLessExtension(output) + "_tiles";
+    options.writeOptions = new osgDB::Options("noTexturesInIVEFile WriteImageHint=UseExternal");
+    if (!osgDB::makeDirectory(options.tileDirectory))
+    {
+        std::cerr << "Error: could not create " << options.tileDirectory << std::endl;
+        return 1;
+    }
+
+    const ImageSet textures = externalizeTextures(collect.soups, options.tileDirectory);
+
+    const osg::BoundingBox bounds = triangleBounds(collect.soups, triangles.begin(), triangles.end());
+    const float extent[3] = {bounds.xMax() - bounds.xMin(), bounds.yMax() - bounds.yMin(), bounds.zMax() - bounds.zMin()};
+    const int shortest = extent[0] < extent[1] ? (extent[0] < extent[2] ? 0 : 2) : (extent[1] < extent[2] ? 1 : 2);
+    const int axes[2] = {shortest == 0 ? 1 : 0, shortest == 2 ? 1 : 2};
+
+    std::cout << "Tiling " << triangles.size() << " triangles, refining tiles above " << options.refinePixels << " pixels" << std::endl;
+
+    osg::ref_ptr<osg::Geode> coarse;
+    osg::ref_ptr<osg::Node> root = buildCell(collect.soups, triangles.begin(), triangles.end(), bounds, axes, 0, "r", options, coarse);
+    collect.soups.clear();
+    triangles.clear();
+    referenceTexturesFromRoot(coarse.get(), textures, options.tileDirectory);
+
+    if (trans)
+        trans->addChild(root.get());
+    else
+        model = root;
+    if (!osgDB::writeNodeFile(*model, output, options.writeOptions.get()))
+    {
+        std::cerr << "Error: could not write " << output << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << output << ", " << options.tilesWritten << " tile files and " << textures.size() << " textures to " << options.tileDirectory << std::endl;
+
+    return 0;
+}